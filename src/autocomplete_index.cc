@@ -0,0 +1,362 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "autocomplete_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <iterator>
+
+#include <Poco/UTF8String.h>
+
+namespace toggl {
+
+namespace {
+
+// ASCII punctuation and whitespace separate words,
+// multibyte UTF-8 characters are part of them
+bool isSeparator(const char c) {
+    const unsigned char u = static_cast<unsigned char>(c);
+    return u < 0x80 && !std::isalnum(u);
+}
+
+void splitWords(
+    const std::string &text,
+    std::vector<std::string> *words) {
+    size_t start = std::string::npos;
+    for (size_t i = 0; i <= text.size(); i++) {
+        if (i == text.size() || isSeparator(text[i])) {
+            if (start != std::string::npos) {
+                words->push_back(text.substr(start, i - start));
+                start = std::string::npos;
+            }
+        } else if (start == std::string::npos) {
+            start = i;
+        }
+    }
+}
+
+void intersect(
+    const std::vector<Poco::UInt32> &other,
+    std::vector<Poco::UInt32> *result) {
+    std::vector<Poco::UInt32> both;
+    std::set_intersection(result->begin(), result->end(),
+                          other.begin(), other.end(),
+                          std::back_inserter(both));
+    result->swap(both);
+}
+
+}  // namespace
+
+AutocompleteIndex::Trigram AutocompleteIndex::trigram(
+    const std::string &s,
+    const size_t pos) {
+    return (static_cast<Trigram>(static_cast<unsigned char>(s[pos])) << 16)
+           | (static_cast<Trigram>(static_cast<unsigned char>(s[pos + 1])) << 8)
+           | static_cast<Trigram>(static_cast<unsigned char>(s[pos + 2]));
+}
+
+std::string AutocompleteIndex::searchText(const view::Autocomplete &item) {
+    std::string text(item.Text);
+    const std::string *extra[] = {
+        &item.Description,
+        &item.ProjectAndTaskLabel,
+        &item.ClientLabel
+    };
+    for (const std::string *part : extra) {
+        if (!part->empty() && text.find(*part) == std::string::npos) {
+            text += " " + *part;
+        }
+    }
+    return Poco::UTF8::toLower(text);
+}
+
+void AutocompleteIndex::Build(std::vector<view::Autocomplete> *items) {
+    poco_check_ptr(items);
+
+    shared_items_.reset();
+    items_.clear();
+    search_.clear();
+    live_.clear();
+    dead_ = 0;
+    order_.clear();
+    positions_.clear();
+    slots_.clear();
+    trigrams_.clear();
+    words_.clear();
+
+    items_.reserve(items->size());
+    search_.reserve(items->size());
+    order_.reserve(items->size());
+    for (auto it = items->begin(); it != items->end(); ++it) {
+        if (slots_.find(it->Text) == slots_.end()) {
+            order_.push_back(add(std::move(*it)));
+        }
+    }
+    renumber(0);
+    std::sort(words_.begin(), words_.end());
+    items->clear();
+
+    stale_ = false;
+}
+
+void AutocompleteIndex::Items(
+    std::vector<view::Autocomplete> *result) const {
+    poco_check_ptr(result);
+
+    result->reserve(result->size() + order_.size());
+    for (auto it = order_.begin(); it != order_.end(); ++it) {
+        result->push_back(items_[*it]);
+    }
+}
+
+std::shared_ptr<const std::vector<view::Autocomplete> >
+AutocompleteIndex::SharedItems() const {
+    if (!shared_items_) {
+        std::shared_ptr<std::vector<view::Autocomplete> > items =
+            std::make_shared<std::vector<view::Autocomplete> >();
+        Items(items.get());
+        shared_items_ = items;
+    }
+    return shared_items_;
+}
+
+const view::Autocomplete *AutocompleteIndex::Find(
+    const std::string &text) const {
+    auto it = slots_.find(text);
+    if (it == slots_.end()) {
+        return nullptr;
+    }
+    return &items_[it->second];
+}
+
+size_t AutocompleteIndex::PartitionPoint(
+    const std::function<bool(const view::Autocomplete &)> &before) const {
+    auto it = std::partition_point(order_.begin(), order_.end(),
+    [&](const Poco::UInt32 slot) {
+        return before(items_[slot]);
+    });
+    return it - order_.begin();
+}
+
+void AutocompleteIndex::Insert(
+    const size_t position,
+    const view::Autocomplete &item) {
+    if (Replace(item)) {
+        return;
+    }
+    const size_t from = words_.size();
+    const Poco::UInt32 slot = add(item);
+    mergeWords(from);
+    shared_items_.reset();
+    const size_t at = std::min(position, order_.size());
+    order_.insert(order_.begin() + at, slot);
+    renumber(at);
+}
+
+bool AutocompleteIndex::Replace(const view::Autocomplete &item) {
+    auto it = slots_.find(item.Text);
+    if (it == slots_.end()) {
+        return false;
+    }
+    shared_items_.reset();
+    const Poco::UInt32 position = positions_[it->second];
+    drop(it->second);
+
+    const size_t from = words_.size();
+    order_[position] = add(item);
+    positions_[order_[position]] = position;
+    mergeWords(from);
+    compact();
+    return true;
+}
+
+bool AutocompleteIndex::Remove(const std::string &text) {
+    auto it = slots_.find(text);
+    if (it == slots_.end()) {
+        return false;
+    }
+    shared_items_.reset();
+    const Poco::UInt32 position = positions_[it->second];
+    order_.erase(order_.begin() + position);
+    renumber(position);
+    drop(it->second);
+    compact();
+    return true;
+}
+
+Poco::UInt32 AutocompleteIndex::add(view::Autocomplete item) {
+    const Poco::UInt32 slot = static_cast<Poco::UInt32>(items_.size());
+    items_.push_back(std::move(item));
+    search_.push_back(searchText(items_.back()));
+    live_.push_back(true);
+    positions_.push_back(0);
+    slots_[items_.back().Text] = slot;
+
+    const std::string &text = search_.back();
+    for (size_t pos = 0; pos + 3 <= text.size(); pos++) {
+        Postings &postings = trigrams_[trigram(text, pos)];
+        // Slots are added in order, so the lists stay sorted
+        if (postings.empty() || postings.back() != slot) {
+            postings.push_back(slot);
+        }
+    }
+
+    std::vector<std::string> words;
+    splitWords(text, &words);
+    for (auto it = words.begin(); it != words.end(); ++it) {
+        words_.push_back(std::make_pair(*it, slot));
+    }
+    return slot;
+}
+
+void AutocompleteIndex::mergeWords(const size_t from) {
+    std::sort(words_.begin() + from, words_.end());
+    std::inplace_merge(words_.begin(), words_.begin() + from, words_.end());
+}
+
+void AutocompleteIndex::drop(const Poco::UInt32 slot) {
+    slots_.erase(items_[slot].Text);
+    live_[slot] = false;
+    dead_++;
+}
+
+void AutocompleteIndex::renumber(const size_t from) {
+    for (size_t i = from; i < order_.size(); i++) {
+        positions_[order_[i]] = static_cast<Poco::UInt32>(i);
+    }
+}
+
+void AutocompleteIndex::compact() {
+    if (dead_ < 64 || dead_ < order_.size()) {
+        return;
+    }
+    std::vector<view::Autocomplete> items;
+    Items(&items);
+    Build(&items);
+}
+
+bool AutocompleteIndex::candidates(
+    const std::string &word,
+    Postings *result) const {
+
+    result->clear();
+
+    if (word.size() >= 3) {
+        std::vector<const Postings *> lists;
+        for (size_t pos = 0; pos + 3 <= word.size(); pos++) {
+            auto it = trigrams_.find(trigram(word, pos));
+            if (it == trigrams_.end()) {
+                return false;
+            }
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end(),
+        [](const Postings *a, const Postings *b) {
+            return a->size() < b->size();
+        });
+        *result = *lists.front();
+        for (size_t i = 1; i < lists.size() && !result->empty(); i++) {
+            intersect(*lists[i], result);
+        }
+        return !result->empty();
+    }
+
+    for (auto it = std::lower_bound(
+                words_.begin(), words_.end(),
+                std::make_pair(word, Poco::UInt32(0)));
+            it != words_.end() && it->first.compare(0, word.size(), word) == 0;
+            ++it) {
+        result->push_back(it->second);
+    }
+    std::sort(result->begin(), result->end());
+    result->erase(std::unique(result->begin(), result->end()), result->end());
+    return !result->empty();
+}
+
+int AutocompleteIndex::match(
+    const Poco::UInt32 slot,
+    const std::string &word) const {
+
+    const std::string &text = search_[slot];
+    int best = 0;
+    for (size_t pos = text.find(word);
+            pos != std::string::npos;
+            pos = text.find(word, pos + 1)) {
+        if (0 == pos) {
+            return 3;
+        }
+        if (isSeparator(text[pos - 1])) {
+            best = 2;
+        } else if (word.size() >= 3 && !best) {
+            best = 1;
+        }
+    }
+    return best;
+}
+
+void AutocompleteIndex::Query(
+    const std::string &query,
+    const size_t limit,
+    std::vector<view::Autocomplete> *result) const {
+
+    poco_check_ptr(result);
+
+    std::vector<std::string> words;
+    splitWords(Poco::UTF8::toLower(query), &words);
+
+    const size_t count = limit ? limit : order_.size();
+
+    if (words.empty()) {
+        const size_t n = std::min(count, order_.size());
+        for (size_t i = 0; i < n; i++) {
+            result->push_back(Item(i));
+        }
+        return;
+    }
+
+    // Only items in the candidate lists of all words can match
+    Postings driver;
+    Postings other;
+    for (size_t i = 0; i < words.size(); i++) {
+        Postings &target = i ? other : driver;
+        if (!candidates(words[i], &target)) {
+            return;
+        }
+        if (i) {
+            intersect(other, &driver);
+            if (driver.empty()) {
+                return;
+            }
+        }
+    }
+
+    std::vector<std::pair<int, Poco::UInt32> > ranked;
+    for (auto it = driver.begin(); it != driver.end(); ++it) {
+        if (!live_[*it]) {
+            continue;
+        }
+        int score = 0;
+        for (auto word = words.begin(); word != words.end(); ++word) {
+            int rank = match(*it, *word);
+            if (!rank) {
+                score = 0;
+                break;
+            }
+            score += rank;
+        }
+        if (score) {
+            // Negated, so equal scores keep the order of the list
+            ranked.push_back(std::make_pair(-score, positions_[*it]));
+        }
+    }
+
+    const size_t n = std::min(count, ranked.size());
+    std::partial_sort(ranked.begin(), ranked.begin() + n, ranked.end());
+
+    result->reserve(result->size() + n);
+    for (size_t i = 0; i < n; i++) {
+        result->push_back(Item(ranked[i].second));
+    }
+}
+
+}  // namespace toggl
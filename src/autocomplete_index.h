@@ -0,0 +1,147 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_AUTOCOMPLETE_INDEX_H_
+#define SRC_AUTOCOMPLETE_INDEX_H_
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gui.h"
+#include "types.h"
+
+#include <Poco/Types.h>
+
+namespace toggl {
+
+/**
+ * One autocomplete list together with a search index over it, so
+ * the list is built once per data change instead of once per
+ * keystroke. Every item is lowercased once when it's added.
+ * Query words of three or more characters are looked up through a
+ * trigram index and match anywhere in the item. Shorter words match
+ * the start of a word of the item, through a sorted word list.
+ *
+ * Items are keyed by their text. Single items can be inserted,
+ * replaced and removed without building the whole list again.
+ */
+class TOGGL_INTERNAL_EXPORT AutocompleteIndex {
+ public:
+    AutocompleteIndex()
+        : stale_(true)
+    , dead_(0) {}
+
+    // The list needs to be built again before it's used
+    void Invalidate() {
+        stale_ = true;
+        shared_items_.reset();
+    }
+
+    bool Stale() const {
+        return stale_;
+    }
+
+    void Build(std::vector<view::Autocomplete> *items);
+
+    // Appends the items in list order
+    void Items(std::vector<view::Autocomplete> *result) const;
+
+    // The items in list order, copied once until the list changes.
+    // Can be read after the index has moved on.
+    std::shared_ptr<const std::vector<view::Autocomplete> >
+    SharedItems() const;
+
+    size_t Size() const {
+        return order_.size();
+    }
+
+    // The item at a position of the list
+    const view::Autocomplete &Item(const size_t position) const {
+        return items_[order_[position]];
+    }
+
+    // nullptr if no item has the text
+    const view::Autocomplete *Find(const std::string &text) const;
+
+    // The first position whose item isn't before, found by binary
+    // search. The items before have to come first in the list.
+    size_t PartitionPoint(
+        const std::function<bool(const view::Autocomplete &)> &before) const;
+
+    // Inserts the item before the given position of the list,
+    // replacing the item with the same text if there is one
+    void Insert(const size_t position, const view::Autocomplete &item);
+
+    // Replaces the item with the same text in place,
+    // false if there is none
+    bool Replace(const view::Autocomplete &item);
+
+    // false if no item has the text
+    bool Remove(const std::string &text);
+
+    // Up to limit items matching every word of the query, best
+    // matches first. Equal matches keep their order in the list.
+    // An empty query returns the head of the list.
+    void Query(
+        const std::string &query,
+        const size_t limit,
+        std::vector<view::Autocomplete> *result) const;
+
+ private:
+    typedef Poco::UInt32 Trigram;
+    typedef std::vector<Poco::UInt32> Postings;
+
+    static Trigram trigram(const std::string &s, const size_t pos);
+    static std::string searchText(const view::Autocomplete &item);
+
+    // Indexes the item in a new slot and returns the slot. The words
+    // of the item are appended to words_, which the caller sorts.
+    Poco::UInt32 add(view::Autocomplete item);
+
+    // Sorts the words appended to words_ after the first from
+    void mergeWords(const size_t from);
+
+    // Removed slots stay in the postings until the list is built
+    // again, which happens once they outnumber the live ones
+    void drop(const Poco::UInt32 slot);
+    void compact();
+
+    // Updates the positions of the slots in order_ from the given one
+    void renumber(const size_t from);
+
+    // Fills candidates with the slots the word may match,
+    // false when the index rules out every item
+    bool candidates(const std::string &word, Postings *result) const;
+
+    // 0 when the word doesn't match the item, otherwise a rank,
+    // higher for matches at the start of the item or of its words
+    int match(const Poco::UInt32 slot, const std::string &word) const;
+
+    bool stale_;
+
+    mutable std::shared_ptr<const std::vector<view::Autocomplete> >
+    shared_items_;
+
+    // By slot, only ever appended to
+    std::vector<view::Autocomplete> items_;
+    std::vector<std::string> search_;
+    std::vector<bool> live_;
+    size_t dead_;
+
+    // Live slots in list order
+    std::vector<Poco::UInt32> order_;
+    // Position in order_, by slot
+    std::vector<Poco::UInt32> positions_;
+    std::unordered_map<std::string, Poco::UInt32> slots_;
+
+    std::unordered_map<Trigram, Postings> trigrams_;
+    // Lowercased words of all items, ascending, for prefix lookups
+    std::vector<std::pair<std::string, Poco::UInt32> > words_;
+};
+
+}  // namespace toggl
+
+#endif  // SRC_AUTOCOMPLETE_INDEX_H_
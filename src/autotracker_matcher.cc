@@ -0,0 +1,125 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "autotracker_matcher.h"
+
+#include <algorithm>
+#include <deque>
+
+#include "model/autotracker.h"
+
+namespace toggl {
+
+void AutotrackerMatcher::Invalidate() {
+    stale_ = true;
+    rules_.clear();
+    nodes_.assign(1, Node());
+    nodes_[0].fail = 0;
+    nodes_[0].first = 0;
+}
+
+AutotrackerMatcher::State AutotrackerMatcher::child(
+    const State state,
+    const unsigned char c) const {
+    const std::vector<std::pair<unsigned char, State> > &next =
+        nodes_[state].next;
+    auto it = std::lower_bound(next.begin(), next.end(),
+                               std::make_pair(c, State(0)));
+    if (it == next.end() || it->first != c) {
+        return -1;
+    }
+    return it->second;
+}
+
+AutotrackerMatcher::State AutotrackerMatcher::step(
+    State state,
+    const unsigned char c) const {
+    State next = child(state, c);
+    while (next < 0 && state) {
+        state = nodes_[state].fail;
+        next = child(state, c);
+    }
+    return next < 0 ? 0 : next;
+}
+
+void AutotrackerMatcher::Build(const std::vector<AutotrackerRule *> &rules) {
+    Invalidate();
+    rules_ = rules;
+
+    const size_t none = rules_.size();
+    nodes_[0].first = none;
+
+    // Trie of the terms, the first rule wins if terms repeat
+    for (size_t i = 0; i < rules_.size(); i++) {
+        const std::string &term = rules_[i]->Term();
+        State state = 0;
+        for (size_t pos = 0; pos < term.size(); pos++) {
+            const unsigned char c = static_cast<unsigned char>(term[pos]);
+            State next = child(state, c);
+            if (next < 0) {
+                next = static_cast<State>(nodes_.size());
+                Node node;
+                node.fail = 0;
+                node.first = none;
+                nodes_.push_back(node);
+                std::vector<std::pair<unsigned char, State> > &edges =
+                    nodes_[state].next;
+                edges.insert(
+                    std::lower_bound(edges.begin(), edges.end(),
+                                     std::make_pair(c, State(0))),
+                    std::make_pair(c, next));
+            }
+            state = next;
+        }
+        nodes_[state].first = std::min(nodes_[state].first, i);
+    }
+
+    // Failure links breadth first, so shorter suffixes are done first
+    std::deque<State> queue;
+    for (auto edge : nodes_[0].next) {
+        nodes_[edge.second].first =
+            std::min(nodes_[edge.second].first, nodes_[0].first);
+        queue.push_back(edge.second);
+    }
+    while (!queue.empty()) {
+        const State state = queue.front();
+        queue.pop_front();
+        for (auto edge : nodes_[state].next) {
+            const State next = edge.second;
+            State fail = nodes_[state].fail;
+            State target = child(fail, edge.first);
+            while (target < 0 && fail) {
+                fail = nodes_[fail].fail;
+                target = child(fail, edge.first);
+            }
+            nodes_[next].fail = target < 0 ? 0 : target;
+            nodes_[next].first = std::min(nodes_[next].first,
+                                          nodes_[nodes_[next].fail].first);
+            queue.push_back(next);
+        }
+    }
+
+    stale_ = false;
+}
+
+void AutotrackerMatcher::scan(const std::string &text, size_t *first) const {
+    State state = 0;
+    for (size_t pos = 0; pos < text.size() && *first; pos++) {
+        state = step(state, static_cast<unsigned char>(text[pos]));
+        *first = std::min(*first, nodes_[state].first);
+    }
+}
+
+AutotrackerRule *AutotrackerMatcher::Find(
+    const std::string &lowercase_filename,
+    const std::string &lowercase_title) const {
+    // Rules with an empty term match anything
+    size_t first = nodes_[0].first;
+    scan(lowercase_filename, &first);
+    scan(lowercase_title, &first);
+    if (first >= rules_.size()) {
+        return nullptr;
+    }
+    return rules_[first];
+}
+
+}  // namespace toggl
@@ -0,0 +1,71 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_AUTOTRACKER_MATCHER_H_
+#define SRC_AUTOTRACKER_MATCHER_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+
+#include <Poco/Types.h>
+
+namespace toggl {
+
+class AutotrackerRule;
+
+/**
+ * The terms of all autotracker rules compiled into one Aho-Corasick
+ * automaton, so a window title is matched against every rule in a
+ * single pass instead of once per rule. Every state knows the first
+ * rule, in list order, whose term ends there or in any of its
+ * suffixes, which keeps the result the same as checking the rules
+ * one by one. Terms are expected not to change once a rule is listed.
+ */
+class TOGGL_INTERNAL_EXPORT AutotrackerMatcher {
+ public:
+    AutotrackerMatcher() {
+        Invalidate();
+    }
+
+    void Invalidate();
+
+    // Whether the matcher was built from exactly these rules. A freed
+    // rule's address can be reused by a new one, so adding or deleting
+    // rules must Invalidate() too instead of relying on this check.
+    bool Built(const std::vector<AutotrackerRule *> &rules) const {
+        return !stale_ && rules == rules_;
+    }
+
+    void Build(const std::vector<AutotrackerRule *> &rules);
+
+    // First rule whose term is in either of the lowercase texts
+    AutotrackerRule *Find(
+        const std::string &lowercase_filename,
+        const std::string &lowercase_title) const;
+
+ private:
+    typedef Poco::Int32 State;
+
+    struct Node {
+        // Transitions by byte, sorted
+        std::vector<std::pair<unsigned char, State> > next;
+        // Longest proper suffix that is also a state
+        State fail;
+        // First rule ending here or at a suffix, or the rule count
+        size_t first;
+    };
+
+    State child(const State state, const unsigned char c) const;
+    State step(State state, const unsigned char c) const;
+    void scan(const std::string &text, size_t *first) const;
+
+    bool stale_;
+    std::vector<AutotrackerRule *> rules_;
+    std::vector<Node> nodes_;
+};
+
+}  // namespace toggl
+
+#endif  // SRC_AUTOTRACKER_MATCHER_H_
@@ -12,8 +12,39 @@
 
 #define kMaxTimeEntryDurationSeconds 3596400
 #define kHTTPClientTimeoutSeconds 30
+// Requests in flight at once when pushing changes to the legacy API
+#define kLegacyPushConcurrency 4
+// Idle keep-alive connections kept open per server
+#define kHTTPSessionPoolSize 4
 #define kSyncIntervalRangeSeconds 900
+// Pulls are incremental, but a full one catches zombies this often
+#define kFullSyncIntervalSeconds 86400
+// Database clean up starts once the app is up and runs in short steps
+#define kDatabaseMaintenanceDelaySeconds 5
+#define kStartupRecentTimeEntryDays 14
+#define kDatabaseLoadBatchRows 1000
+// Work waiting for the data loaded after startup is retried, not blocked on
+#define kDeferredUserDataRetryMillis 500
+#define kDeferredLoaderStopMillis 2000
+// Synced data older than this is deleted from the database at startup
+#define kTimeEntryRetentionDays 30
+#define kTimelineEventRetentionDays 9
+// All time entries kept on disk are read at startup. Older ones come
+// from the API with load more, and are read back from the database
+// in pages if they're evicted while the app runs.
+#define kTimeEntryHotWindowDays kTimeEntryRetentionDays
+#define kTimeEntryPageDays 7
+#define kTimeEntryResidentPages 26
+#define kDatabaseMaintenanceStepMillis 100
+// Failed maintenance is retried, backing off up to the maximum
+#define kDatabaseMaintenanceRetrySeconds 30
+#define kDatabaseMaintenanceMaxRetrySeconds 3600
+// The one-time full vacuum waits until the user has been idle this long
+#define kDatabaseVacuumIdleSeconds 300
+#define kDatabaseVacuumCheckSeconds 60
 #define kWebsocketRestartRangeSeconds 45
+#define kWebSocketPollMillis 500
+#define kWebSocketUpdateCoalesceMillis 200
 #define kCheckUpdateIntervalSeconds 86400
 #define kCheckInAppMessageIntervalSeconds 14400
 #define kRequestThrottleSeconds 2
@@ -27,6 +58,9 @@
 #define kDebianPackage (TOGGL_BUILD_TYPE == std::string("deb"))
 #define kTimelineUploadIntervalSeconds 60
 #define kTimelineUploadMaxBackoffSeconds (kTimelineUploadIntervalSeconds * 10)  // NOLINT
+#define kTimelineFlushIntervalSeconds 30
+#define kTimelineFlushBatchSize 50
+#define kTimelineUploadMaxEvents 500
 #define kMaxFileSize 5242880  // 5MB
 #define kMaxDurationSeconds (999 * 3600)
 #define kMaxTagsPerTimeEntry 50
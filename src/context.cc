@@ -12,6 +12,7 @@
 #include "context.h"
 
 #include <iostream>  // NOLINT
+#include <unordered_map>
 
 #include "model/autotracker.h"
 #include "model/client.h"
@@ -39,6 +40,7 @@
 #include <Poco/FormattingChannel.h>
 #include <Poco/Net/FilePartSource.h>
 #include <Poco/Net/HTMLForm.h>
+#include <Poco/Net/HTTPRequest.h>
 #include <Poco/Net/HTTPStreamFactory.h>
 #include <Poco/Net/HTTPSStreamFactory.h>
 #include <Poco/Net/NetSSL.h>
@@ -64,6 +66,12 @@ std::string Context::log_path_ = "";
 Context::Context(const std::string &app_name, const std::string &app_version)
     : db_(nullptr)
 , user_(nullptr)
+, save_count_(0)
+, update_batch_count_(0)
+, snapshot_(std::make_shared<UserSnapshot>())
+, snapshot_version_(0)
+, unsaved_timeline_events_(0)
+, timeline_flush_seconds_(kTimelineFlushIntervalSeconds)
 , timeline_uploader_(nullptr)
 , window_change_recorder_(nullptr)
 , next_sync_at_(0)
@@ -71,6 +79,7 @@ Context::Context(const std::string &app_name, const std::string &app_version)
 , next_fetch_updates_at_(0)
 , next_update_timeline_settings_at_(0)
 , next_wake_at_(0)
+, database_maintenance_retry_seconds_(0)
 , time_entry_editor_guid_("")
 , environment_(APP_ENVIRONMENT)
 , idle_(&ui_)
@@ -84,6 +93,13 @@ Context::Context(const std::string &app_name, const std::string &app_version)
 , ui_updater_(this, &Context::uiUpdaterActivity)
 , reminder_(this, &Context::reminderActivity)
 , syncer_(this, &Context::syncerActivityWrapper)
+, deferred_loader_(this, &Context::deferredLoaderActivity)
+, deferred_uid_(0)
+, deferred_since_(0)
+, deferred_hot_since_(0)
+, deferred_user_data_(false)
+, database_vacuum_(this, &Context::databaseVacuumActivity)
+, idle_seconds_(0)
 , update_path_("")
 , overlay_visible_(false)
 , last_message_id_("")
@@ -105,6 +121,9 @@ Context::Context(const std::string &app_name, const std::string &app_version)
 
     Poco::Crypto::OpenSSLInitializer::initialize();
 
+    // Nothing is left to load until a user is loaded in stages
+    deferred_user_data_.set();
+
     startPeriodicUpdateCheck();
 
     startPeriodicSync();
@@ -142,6 +161,16 @@ Context::~Context() {
         }
     }
 
+    flushTimelineEvents();
+
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        for (auto event : deferred_timeline_events_) {
+            delete event;
+        }
+        deferred_timeline_events_.clear();
+    }
+
     {
         Poco::Mutex::ScopedLock lock(timeline_uploader_m_);
         if (timeline_uploader_) {
@@ -180,6 +209,7 @@ void Context::stopActivities() {
             Poco::Mutex::ScopedLock lock(reminder_m_);
             if (reminder_.isRunning()) {
                 reminder_.stop();
+                reminder_wakeup_.set();
                 reminder_.wait(2000);
             }
         }
@@ -188,6 +218,7 @@ void Context::stopActivities() {
             Poco::Mutex::ScopedLock lock(ui_updater_m_);
             if (ui_updater_.isRunning()) {
                 ui_updater_.stop();
+                ui_updater_wakeup_.set();
                 ui_updater_.wait(2000);
             }
         }
@@ -197,9 +228,35 @@ void Context::stopActivities() {
             Poco::Mutex::ScopedLock lock(syncer_m_);
             if (syncer_.isRunning()) {
                 syncer_.stop();
+                syncer_wakeup_.set();
                 syncer_.wait(2000);
             }
         }
+
+        // Reads from the database, so it has to finish before
+        // the database is closed
+        {
+            Poco::Mutex::ScopedLock lock(deferred_loader_m_);
+            if (deferred_loader_.isRunning()) {
+                // Gives up between batches of rows once stopped
+                deferred_loader_.stop();
+                try {
+                    deferred_loader_.wait(kDeferredLoaderStopMillis);
+                } catch(const Poco::TimeoutException&) {
+                    logger.error("Deferred user data loader did not stop in ",
+                                 kDeferredLoaderStopMillis, " ms");
+                }
+            }
+        }
+
+        // A VACUUM can't be interrupted, it runs on its own
+        // connection so the database can be closed meanwhile
+        {
+            Poco::Mutex::ScopedLock lock(database_vacuum_m_);
+            if (database_vacuum_.isRunning()) {
+                database_vacuum_.stop();
+            }
+        }
     } catch(const Poco::Exception& exc) {
         logger.debug(exc.displayText());
     } catch(const std::exception& ex) {
@@ -233,6 +290,11 @@ void Context::stopActivities() {
 void Context::Shutdown() {
     stopActivities();
 
+    error err = flushTimelineEvents();
+    if (err != noError) {
+        logger.error(err);
+    }
+
     // cancel tasks but allow them finish
     {
         Poco::Mutex::ScopedLock lock(timer_m_);
@@ -268,30 +330,110 @@ error Context::StartEvents() {
             return displayError("UI is not properly wired up!");
         }
 
+        Poco::Stopwatch stopwatch;
+        stopwatch.start();
+
         UIElements render;
         render.display_settings = true;
         updateUI(render);
 
-        // See if user was logged in into app previously
+        logger.debug("Startup: settings rendered in ",
+                     stopwatch.elapsed() / 1000, " ms");
+
+        // Old synced rows go before the user is loaded, so none of
+        // them backs a model in memory. Giving the freed pages back
+        // waits until it doesn't hold up the start.
+        stopwatch.restart();
+        err = db()->PurgeOldSyncedData();
+        if (err != noError) {
+            logger.error("Failed to delete old synced data: ", err);
+        }
+        logger.debug("Startup: old synced data deleted in ",
+                     stopwatch.elapsed() / 1000, " ms");
+        scheduleDatabaseMaintenance(kDatabaseMaintenanceDelaySeconds);
+
+        // See if user was logged in into app previously. Only what the
+        // first screen shows is loaded here, older time entries and
+        // the timeline are read in the background.
+        stopwatch.restart();
+        const Poco::Int64 recent_since = (Poco::Timestamp()
+                                          - Poco::Timespan(kStartupRecentTimeEntryDays, 0, 0, 0, 0)).epochTime();
         User *user = new User();
-        err = db()->LoadCurrentUser(user);
+        err = db()->LoadCurrentUserStaged(user, recent_since);
         if (err != noError) {
             delete user;
             setUser(nullptr);
             return displayError(err);
         }
+        logger.debug("Startup: user loaded in ",
+                     stopwatch.elapsed() / 1000, " ms");
         if (!user->ID()) {
             delete user;
             setUser(nullptr);
             return noError;
         }
+        stopwatch.restart();
+        // Time entries older than the hot window are paged in
+        // from the database when they're scrolled to or synced
+        const Poco::Int64 hot_since = (Poco::Timestamp()
+                                       - Poco::Timespan(kTimeEntryHotWindowDays, 0, 0, 0, 0)).epochTime();
+        const Poco::UInt64 uid = user->ID();
+        RelatedData::TimeEntryReaders readers;
+        // The database may be replaced or closed while the user
+        // is still around, so it's looked up on every read
+        readers.Page = [this, uid](
+                           const Poco::Int64 from,
+                           const Poco::Int64 to,
+        std::vector<TimeEntry *> *list) {
+            Poco::Mutex::ScopedLock lock(db_m_);
+            if (!db_) {
+                return error("cannot page in time entries without database");
+            }
+            return db_->LoadTimeEntryPage(uid, from, to, list);
+        };
+        readers.StartsBefore = [this, uid](
+                                   const Poco::Int64 before,
+        std::map<Poco::UInt64, Poco::Int64> *starts) {
+            Poco::Mutex::ScopedLock lock(db_m_);
+            if (!db_) {
+                return error("cannot page in time entries without database");
+            }
+            return db_->TimeEntryStartsBefore(uid, before, starts);
+        };
+        readers.StartBefore = [this, uid](
+                                  const Poco::Int64 before,
+                                  Poco::Int64 *start,
+        bool *found) {
+            Poco::Mutex::ScopedLock lock(db_m_);
+            if (!db_) {
+                return error("cannot page in time entries without database");
+            }
+            return db_->LatestTimeEntryStartBefore(uid, before, start, found);
+        };
+        user->related.SetTimeEntryReaders(hot_since, readers);
+
+        // Sync waits for the rest of the data from here on
+        deferred_user_data_.reset();
         setUser(user);
+        {
+            Poco::Mutex::ScopedLock lock(deferred_loader_m_);
+            deferred_uid_ = uid;
+            deferred_since_ = recent_since;
+            deferred_hot_since_ = hot_since;
+            deferred_loader_.start();
+        }
+        logger.debug("Startup: user set up in ",
+                     stopwatch.elapsed() / 1000, " ms");
 
-        // Set since param to 0 to force full sync on app start
-        user->SetSince(0);
-        logger.debug("fullSyncOnAppStart");
+        // The UI renders what's in the database, the first sync only
+        // pulls what changed since, unless a full sync is due anyway
+        logger.debug("Incremental sync on app start, since=", user->Since(),
+                     " full_synced_at=", user->FullSyncedAt());
 
+        stopwatch.restart();
         updateUI(UIElements::Reset());
+        logger.debug("Startup: user data rendered in ",
+                     stopwatch.elapsed() / 1000, " ms");
 
         if ("production" == environment_) {
             std::string update_channel("");
@@ -320,6 +462,7 @@ error Context::StartEvents() {
 
 error Context::save(const bool push_changes) {
     logger.debug("save");
+    save_count_++;
     try {
         std::vector<ModelChange> changes;
 
@@ -329,6 +472,10 @@ error Context::save(const bool push_changes) {
             if (err != noError) {
                 return err;
             }
+            time_entry_list_.ApplyChanges(changes);
+            user_->related.ApplyAutocompleteChanges(changes);
+            updateSnapshot(changes);
+            unsaved_timeline_events_ = 0;
         }
 
         UIElements render;
@@ -342,6 +489,7 @@ error Context::save(const bool push_changes) {
 
             // Always sync asyncronously with syncerActivity
             trigger_push_ = true;
+            syncer_wakeup_.set();
             if (!syncer_.isRunning()) {
                 syncer_.start();
             }
@@ -521,6 +669,13 @@ void Context::updateUI(const UIElements &what) {
     std::vector<view::Autocomplete> time_entry_autocompletes;
     std::vector<view::Autocomplete> minitimer_autocompletes;
     std::vector<view::Autocomplete> project_autocompletes;
+    // Shared with the autocomplete indexes, copied once unlocked
+    std::shared_ptr<const std::vector<view::Autocomplete> >
+    shared_time_entry_autocompletes;
+    std::shared_ptr<const std::vector<view::Autocomplete> >
+    shared_minitimer_autocompletes;
+    std::shared_ptr<const std::vector<view::Autocomplete> >
+    shared_project_autocompletes;
 
     // For timeline UI view data
     std::vector<const TimelineEvent*> timeline;
@@ -532,6 +687,9 @@ void Context::updateUI(const UIElements &what) {
 
     view::TimeEntry running_entry_view;
 
+    bool render_time_entries(false);
+    bool show_load_more(false);
+    std::map<std::string, bool_t> time_entry_groups;
     std::vector<view::TimeEntry> time_entry_views;
     std::vector<view::TimeEntry> timeline_views;
 
@@ -672,133 +830,31 @@ void Context::updateUI(const UIElements &what) {
                 time_entry_editor_guid_ = "";
             }
 
-            // Get a sorted list of time entries
-            std::vector<TimeEntry *> time_entries =
-                user_->related.VisibleTimeEntries();
-            std::sort(time_entries.begin(), time_entries.end(),
-                      CompareByStart);
-
-            // Collect the time entries into a list
-            std::map<std::string, Poco::Int64> date_durations;
-
-            // Group data maps
-            std::map<std::string, Poco::Int64> group_durations;
-            std::map<std::string, Poco::UInt64> group_header_id;
-            std::map<std::string, std::vector<Poco::UInt64> > group_items;
-
-            for (unsigned int i = 0; i < time_entries.size(); i++) {
-                TimeEntry *te = time_entries[i];
-
-                std::string date_header =
-                    toggl::Formatter::FormatDateHeader(te->StartTime());
-
-                // Calculate total duration for each date:
-                // will be displayed in date header
-                Poco::Int64 duration = date_durations[date_header];
-                duration += Formatter::AbsDuration(te->Duration());
-                date_durations[date_header] = duration;
-
-                // Dont render running entry in list,
-                // although its calculated into totals per date.
-                if (te->Duration() < 0) {
-                    // Don't display running entries
-                    continue;
-                }
-
-                // Calculate total duration of group
-                if (user_->CollapseEntries()) {
-                    std::string group_name = te->GroupHash();
+            // Only the changes are applied here, the views
+            // are rendered once the lock is released
+            time_entry_list_.Update(user_, [this](TimeEntry *te) {
+                return isTimeEntryLocked(te);
+            });
+            time_entry_groups = entry_groups;
+            show_load_more = !user_->HasLoadedMore();
+            render_time_entries = true;
+        }
 
-                    group_header_id[group_name] = i;
-                    duration = group_durations[group_name];
-                    duration += Formatter::AbsDuration(te->Duration());
-                    group_durations[group_name] = duration;
-                    group_items[group_name].push_back(i);
-                }
+        if (what.first_load && user_) {
+            if (what.display_time_entry_autocomplete) {
+                shared_time_entry_autocompletes =
+                    user_->related.SharedAutocompleteItems(
+                        kAutocompleteListTimeEntry);
             }
-
-            // Assign the date durations we calculated previously
-            for (unsigned int i = 0; i < time_entries.size(); i++) {
-                TimeEntry *te = time_entries[i];
-
-                // Dont render running entry in list,
-                // although its calculated into totals per date.
-                if (te->Duration() < 0) {
-                    // Don't display running entries
-                    continue;
-                }
-
-                view::TimeEntry view;
-                view.Fill(te);
-
-                // Assign group info
-                if (user_->CollapseEntries()) {
-                    if (group_items[view.GroupName].size() > 1) {
-                        if (group_header_id[view.GroupName] == i) {
-                            // If Group open add all entries in group
-                            if (entry_groups[view.GroupName]) {
-                                for (unsigned int j = 0; j < group_items[view.GroupName].size(); j++) {
-                                    TimeEntry *group_entry =
-                                        time_entries[group_items[view.GroupName][j]];
-
-                                    view::TimeEntry group_entry_view;
-                                    group_entry_view.Fill(group_entry);
-
-                                    group_entry_view.GroupOpen = entry_groups[view.GroupName];
-
-                                    user_->related.ProjectLabelAndColorCode(
-                                        group_entry,
-                                        &group_entry_view);
-
-                                    group_entry_view.Locked = isTimeEntryLocked(group_entry);
-
-                                    group_entry_view.Duration = toggl::Formatter::FormatDuration(
-                                        group_entry_view.DurationInSeconds,
-                                        Formatter::DurationFormat);
-                                    group_entry_view.DateDuration =
-                                        Formatter::FormatDurationForDateHeader(
-                                            date_durations[group_entry_view.DateHeader]);
-                                    time_entry_views.push_back(group_entry_view);
-                                }
-                            }
-
-                            // Add Group header
-                            view::TimeEntry group_view;
-                            group_view.Fill(te);
-                            user_->related.ProjectLabelAndColorCode(
-                                te,
-                                &group_view);
-                            group_view.Group = true;
-                            group_view.GroupOpen = entry_groups[group_view.GroupName];
-                            group_view.DurationInSeconds = group_durations[view.GroupName];
-                            group_view.Duration =
-                                Formatter::FormatDuration(
-                                    group_durations[view.GroupName],
-                                    Formatter::DurationFormat);
-                            group_view.DateDuration =
-                                Formatter::FormatDurationForDateHeader(
-                                    date_durations[view.DateHeader]);
-                            group_view.GroupItemCount = group_items[group_view.GroupName].size();
-                            time_entry_views.push_back(group_view);
-                        }
-                        continue;
-                    }
-                    view.GroupItemCount = 1;
-                }
-                user_->related.ProjectLabelAndColorCode(
-                    te,
-                    &view);
-
-                view.Locked = isTimeEntryLocked(te);
-                view.GroupOpen = false;
-
-                view.Duration = toggl::Formatter::FormatDuration(
-                    view.DurationInSeconds,
-                    Formatter::DurationFormat);
-                view.DateDuration =
-                    Formatter::FormatDurationForDateHeader(
-                        date_durations[view.DateHeader]);
-                time_entry_views.push_back(view);
+            if (what.display_mini_timer_autocomplete) {
+                shared_minitimer_autocompletes =
+                    user_->related.SharedAutocompleteItems(
+                        kAutocompleteListMiniTimer);
+            }
+            if (what.display_project_autocomplete) {
+                shared_project_autocompletes =
+                    user_->related.SharedAutocompleteItems(
+                        kAutocompleteListProject);
             }
         }
 
@@ -865,15 +921,12 @@ void Context::updateUI(const UIElements &what) {
             Poco::LocalDateTime date(UI()->TimelineDateAt());
             timeline = user_->CompressedTimelineForUI(&date);
 
-            // Get a sorted list of time entries
-            std::vector<TimeEntry *> time_entries =
+            // Only the time entries of the day are sorted
+            std::vector<TimeEntry *> time_entries;
+            const std::vector<TimeEntry *> visible =
                 user_->related.VisibleTimeEntries();
-            std::sort(time_entries.begin(), time_entries.end(),
-                      CompareByStart);
-
-            // Collect the time entries into a list
-            for (unsigned int i = 0; i < time_entries.size(); i++) {
-                TimeEntry *te = time_entries[i];
+            for (unsigned int i = 0; i < visible.size(); i++) {
+                TimeEntry *te = visible[i];
                 if (te->Duration() < 0) {
                     // Don't account running entries
                     continue;
@@ -883,20 +936,27 @@ void Context::updateUI(const UIElements &what) {
                 if (te_date.year() == UI()->TimelineDateAt().year()
                         && te_date.month() == UI()->TimelineDateAt().month()
                         && te_date.day() == UI()->TimelineDateAt().day()) {
-
-                    view::TimeEntry view;
-                    view.Fill(te);
-                    view.GenerateRoundedTimes();
-                    view.Duration = toggl::Formatter::FormatDuration(
-                        view.DurationInSeconds,
-                        Formatter::DurationFormat);
-                    view.DateDuration = Formatter::FormatDurationForDateHeader(view.DurationInSeconds);
-                    user_->related.ProjectLabelAndColorCode(
-                        te,
-                        &view);
-                    timeline_views.push_back(view);
+                    time_entries.push_back(te);
                 }
             }
+            std::sort(time_entries.begin(), time_entries.end(),
+                      CompareByStart);
+
+            // Collect the time entries into a list
+            for (unsigned int i = 0; i < time_entries.size(); i++) {
+                TimeEntry *te = time_entries[i];
+                view::TimeEntry view;
+                view.Fill(te);
+                view.GenerateRoundedTimes();
+                view.Duration = toggl::Formatter::FormatDuration(
+                    view.DurationInSeconds,
+                    Formatter::DurationFormat);
+                view.DateDuration = Formatter::FormatDurationForDateHeader(view.DurationInSeconds);
+                user_->related.ProjectLabelAndColorCode(
+                    te,
+                    &view);
+                timeline_views.push_back(view);
+            }
         }
     }
 
@@ -910,11 +970,12 @@ void Context::updateUI(const UIElements &what) {
             what.time_entry_editor_field);
     }
 
-    if (what.display_time_entries && user_) {
+    if (render_time_entries) {
+        time_entry_list_.Render(time_entry_groups, &time_entry_views);
         UI()->DisplayTimeEntryList(
             what.open_time_entry_list,
             time_entry_views,
-            !user_->HasLoadedMore());
+            show_load_more);
         last_time_entry_list_render_at_ = Poco::LocalDateTime();
     }
 
@@ -924,8 +985,8 @@ void Context::updateUI(const UIElements &what) {
 
     if (what.display_time_entry_autocomplete) {
         if (what.first_load) {
-            if (user_) {
-                user_->related.TimeEntryAutocompleteItems(&time_entry_autocompletes);
+            if (shared_time_entry_autocompletes) {
+                time_entry_autocompletes = *shared_time_entry_autocompletes;
             }
             UI()->DisplayTimeEntryAutocomplete(&time_entry_autocompletes);
         } else {
@@ -937,8 +998,8 @@ void Context::updateUI(const UIElements &what) {
 
     if (what.display_mini_timer_autocomplete) {
         if (what.first_load) {
-            if (user_) {
-                user_->related.MinitimerAutocompleteItems(&minitimer_autocompletes);
+            if (shared_minitimer_autocompletes) {
+                minitimer_autocompletes = *shared_minitimer_autocompletes;
             }
             UI()->DisplayMinitimerAutocomplete(&minitimer_autocompletes);
         } else {
@@ -992,8 +1053,8 @@ void Context::updateUI(const UIElements &what) {
     // as its depending on selects on Windows
     if (what.display_project_autocomplete) {
         if (what.first_load) {
-            if (user_) {
-                user_->related.ProjectAutocompleteItems(&project_autocompletes);
+            if (shared_project_autocompletes) {
+                project_autocompletes = *shared_project_autocompletes;
             }
             UI()->DisplayProjectAutocomplete(&project_autocompletes);
         } else {
@@ -1104,35 +1165,83 @@ void Context::Sync() {
 
     // Always sync asyncronously with syncerActivity
     trigger_sync_ = true;
+    syncer_wakeup_.set();
     if (!syncer_.isRunning()) {
         syncer_.start();
     }
 }
 
 void Context::onTimeEntryAutocompletes(Poco::Util::TimerTask&) {  // NOLINT
+    std::shared_ptr<const std::vector<view::Autocomplete> > items;
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (user_) {
+            items = user_->related.SharedAutocompleteItems(
+                kAutocompleteListTimeEntry);
+        }
+    }
     std::vector<view::Autocomplete> time_entry_autocompletes;
-    if (user_) {
-        user_->related.TimeEntryAutocompleteItems(&time_entry_autocompletes);
+    if (items) {
+        time_entry_autocompletes = *items;
     }
     UI()->DisplayTimeEntryAutocomplete(&time_entry_autocompletes);
 }
 
 void Context::onMiniTimerAutocompletes(Poco::Util::TimerTask&) {  // NOLINT
+    std::shared_ptr<const std::vector<view::Autocomplete> > items;
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (user_) {
+            items = user_->related.SharedAutocompleteItems(
+                kAutocompleteListMiniTimer);
+        }
+    }
     std::vector<view::Autocomplete> minitimer_autocompletes;
-    if (user_) {
-        user_->related.MinitimerAutocompleteItems(&minitimer_autocompletes);
+    if (items) {
+        minitimer_autocompletes = *items;
     }
     UI()->DisplayMinitimerAutocomplete(&minitimer_autocompletes);
 }
 
 void Context::onProjectAutocompletes(Poco::Util::TimerTask&) {  // NOLINT
+    std::shared_ptr<const std::vector<view::Autocomplete> > items;
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (user_) {
+            items = user_->related.SharedAutocompleteItems(
+                kAutocompleteListProject);
+        }
+    }
     std::vector<view::Autocomplete> project_autocompletes;
-    if (user_) {
-        user_->related.ProjectAutocompleteItems(&project_autocompletes);
+    if (items) {
+        project_autocompletes = *items;
     }
     UI()->DisplayProjectAutocomplete(&project_autocompletes);
 }
 
+error Context::AutocompleteQuery(
+    const Poco::Int64 list,
+    const std::string &query,
+    const size_t limit,
+    std::vector<view::Autocomplete> *result) {
+    try {
+        poco_check_ptr(result);
+
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (!user_) {
+            return noError;
+        }
+        user_->related.AutocompleteQuery(list, query, limit, result);
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+    return noError;
+}
+
 void Context::setOnline(const std::string &reason) {
     logger.debug("setOnline, reason:", reason);
 
@@ -1166,6 +1275,78 @@ void Context::onSwitchWebSocketOff(Poco::Util::TimerTask&) {  // NOLINT
 error Context::LoadUpdateFromJSONString(const std::string &json) {
     logger.debug("LoadUpdateFromJSONString json=", json);
 
+    if (json.empty()) {
+        return noError;
+    }
+
+    Json::Value root;
+    Json::Reader reader;
+    if (!reader.parse(json, root)) {
+        return displayError(error("Failed to LoadUserUpdateFromJSONString"));
+    }
+
+    return applyUpdates(std::vector<Json::Value> { root });
+}
+
+void Context::QueueWebSocketUpdate(const Json::Value &update) {
+    {
+        Poco::Mutex::ScopedLock lock(websocket_updates_m_);
+        websocket_updates_.push_back(update);
+        // The first update of a burst schedules applying all of it
+        if (websocket_updates_.size() > 1) {
+            return;
+        }
+    }
+
+    Poco::Util::TimerTask::Ptr ptask =
+        new Poco::Util::TimerTaskAdapter<Context>(
+            *this, &Context::onApplyWebSocketUpdates);
+
+    Poco::Mutex::ScopedLock lock(timer_m_);
+    timer_.schedule(ptask,
+                    postpone(kWebSocketUpdateCoalesceMillis * 1000));
+}
+
+void Context::onApplyWebSocketUpdates(Poco::Util::TimerTask&) {  // NOLINT
+    std::vector<Json::Value> updates;
+    {
+        Poco::Mutex::ScopedLock lock(websocket_updates_m_);
+        updates.swap(websocket_updates_);
+    }
+    applyUpdates(updates);
+}
+
+void Context::requeueUpdates(const std::vector<Json::Value> &updates) {
+    {
+        Poco::Mutex::ScopedLock lock(websocket_updates_m_);
+        bool scheduled = !websocket_updates_.empty();
+        // Ahead of anything that arrived in the meantime
+        websocket_updates_.insert(websocket_updates_.begin(),
+                                  updates.begin(), updates.end());
+        if (scheduled) {
+            return;
+        }
+    }
+
+    Poco::Util::TimerTask::Ptr ptask =
+        new Poco::Util::TimerTaskAdapter<Context>(
+            *this, &Context::onApplyWebSocketUpdates);
+
+    Poco::Mutex::ScopedLock lock(timer_m_);
+    timer_.schedule(ptask,
+                    postpone(kDeferredUserDataRetryMillis * 1000));
+}
+
+error Context::applyUpdates(const std::vector<Json::Value> &updates) {
+    logger.debug("applyUpdates count=", updates.size());
+
+    // Updates on top of part of the data would duplicate the rest,
+    // queue them again instead of holding up the timer thread
+    if (!deferredUserDataLoaded()) {
+        requeueUpdates(updates);
+        return noError;
+    }
+
     Poco::Mutex::ScopedLock lock(user_m_);
     if (!user_) {
         logger.warning("User is logged out, cannot update");
@@ -1174,10 +1355,10 @@ error Context::LoadUpdateFromJSONString(const std::string &json) {
 
     TimeEntry *running_entry = user_->RunningTimeEntry();
 
-    error err = user_->LoadUserUpdateFromJSONString(json);
-    if (err != noError) {
-        return displayError(err);
+    for (auto it = updates.begin(); it != updates.end(); ++it) {
+        user_->LoadUserUpdateFromJSON(*it);
     }
+    update_batch_count_++;
 
     TimeEntry *new_running_entry = user_->RunningTimeEntry();
 
@@ -1186,6 +1367,8 @@ error Context::LoadUpdateFromJSONString(const std::string &json) {
         resetLastTrackingReminderTime();
     }
 
+    evictTimeEntryPagesOverLimit();
+
     return displayError(save(false));
 }
 
@@ -2338,7 +2521,11 @@ error Context::SetDBPath(
             delete db_;
             db_ = nullptr;
         }
+        Poco::Stopwatch stopwatch;
+        stopwatch.start();
         db_ = new Database(path);
+        logger.debug("Startup: database opened in ",
+                     stopwatch.elapsed() / 1000, " ms");
         OnboardingService::getInstance()->SetDatabase(db());
     } catch(const Poco::Exception& exc) {
         return displayError(exc.displayText());
@@ -2367,9 +2554,11 @@ void Context::SetEnvironment(const std::string &value) {
     if (value == "test") {
         if (ui_updater_.isRunning()) {
             ui_updater_.stop();
+            ui_updater_wakeup_.set();
         }
         if (reminder_.isRunning()) {
             reminder_.stop();
+            reminder_wakeup_.set();
         }
     }
 }
@@ -2763,10 +2952,19 @@ void Context::setUser(User *value, const bool logged_in) {
 
     {
         Poco::Mutex::ScopedLock lock(user_m_);
+        if (user_ != value) {
+            error err = flushTimelineEvents();
+            if (err != noError) {
+                logger.error(err);
+            }
+        }
         if (user_) {
             delete user_;
         }
         user_ = value;
+        unsaved_timeline_events_ = 0;
+        time_entry_list_.Reset();
+        publishSnapshot();
         if (user_) {
             user_id = user_->ID();
         }
@@ -2948,6 +3146,8 @@ error Context::ClearCache() {
                 return noError;
             }
             err = db()->DeleteUser(user_, true);
+            // Nothing to flush into the deleted data
+            unsaved_timeline_events_ = 0;
         }
 
         if (err != noError) {
@@ -4210,6 +4410,7 @@ error Context::AddAutotrackerRule(
         }
         rule->SetUID(user_->ID());
         user_->related.AutotrackerRules.push_back(rule);
+        user_->related.AutotrackerRulesChanged();
     }
 
     error err = save(false);
@@ -4617,12 +4818,8 @@ void Context::displayReminder() {
     }
 
     {
-        Poco::Mutex::ScopedLock lock(user_m_);
-        if (!user_) {
-            return;
-        }
-
-        if (user_ && user_->RunningTimeEntry()) {
+        std::shared_ptr<const UserSnapshot> snapshot = Snapshot();
+        if (!snapshot->UserID || snapshot->Tracking()) {
             return;
         }
 
@@ -4684,6 +4881,21 @@ void Context::displayPomodoro() {
         return;
     }
 
+    // Most ticks end here, without waiting for the user lock
+    {
+        std::shared_ptr<const UserSnapshot> snapshot = Snapshot();
+        if (!snapshot->Tracking() || snapshot->RunningSkipPomodoro) {
+            return;
+        }
+        Poco::Int64 started = snapshot->RunningStart;
+        if (snapshot->RunningDurOnly && snapshot->RunningLastStartAt != 0) {
+            started = snapshot->RunningLastStartAt;
+        }
+        if (time(nullptr) - started < settings_.pomodoro_minutes * 60) {
+            return;
+        }
+    }
+
     Poco::UInt64 wid(0);
 
     {
@@ -4750,6 +4962,17 @@ void Context::displayPomodoroBreak() {
         return;
     }
 
+    {
+        std::shared_ptr<const UserSnapshot> snapshot = Snapshot();
+        if (!snapshot->Tracking()) {
+            return;
+        }
+        if (time(nullptr) - snapshot->RunningStart
+                < settings_.pomodoro_break_minutes * 60) {
+            return;
+        }
+    }
+
     {
         Poco::Mutex::ScopedLock lock(user_m_);
         if (!user_) {
@@ -4847,6 +5070,7 @@ error Context::CreateCompressedTimelineBatchForUpload(TimelineBatch *batch) {
         }
 
         batch->SetEvents(user_->CompressedTimelineForUpload());
+        user_->related.CloseTimelineChunks(batch->Events());
         batch->SetUserID(user_->ID());
         batch->SetAPIToken(user_->APIToken());
         batch->SetDesktopID(db_->DesktopID());
@@ -4864,6 +5088,7 @@ error Context::StartTimelineEvent(TimelineEvent *event) {
     // Prevent a leak in case of an early exit
     std::unique_ptr<TimelineEvent> handler { event };
 
+    Poco::UInt64 flush_seconds(0);
     try {
         poco_check_ptr(event);
 
@@ -4874,8 +5099,17 @@ error Context::StartTimelineEvent(TimelineEvent *event) {
 
         if (user_ && user_->RecordTimeline()) {
             event->SetUID(static_cast<unsigned int>(user_->ID()));
-            user_->related.TimelineEvents.push_back(handler.release());
-            return displayError(save(false));
+            // The chunk of the same window may still be on its way
+            // from the database, merge into it once it's here
+            if (!deferredUserDataLoaded()) {
+                deferred_timeline_events_.push_back(handler.release());
+                return noError;
+            }
+            error err = recordTimelineEvent(std::move(handler),
+                                            &flush_seconds);
+            if (err != noError) {
+                return displayError(err);
+            }
         }
     } catch(const Poco::Exception& exc) {
         return displayError(exc.displayText());
@@ -4884,9 +5118,231 @@ error Context::StartTimelineEvent(TimelineEvent *event) {
     } catch(const std::string & ex) {
         return displayError(ex);
     }
+
+    scheduleTimelineFlush(flush_seconds);
+    return noError;
+}
+
+error Context::recordTimelineEvent(
+    std::unique_ptr<TimelineEvent> event,
+    Poco::UInt64 *flush_seconds) {
+    poco_check_ptr(flush_seconds);
+
+    // Merged into the chunk of the same window, if there is one
+    if (!user_->related.CompressTimelineEvent(event.get())) {
+        TimelineEvent *model = event.release();
+        user_->related.TimelineEvents.push_back(model);
+        user_->related.Index(model);
+    }
+
+    // Window focus changes can come every few seconds,
+    // write them in batches instead of a transaction each
+    unsaved_timeline_events_++;
+    if (!timeline_flush_seconds_
+            || unsaved_timeline_events_ >= kTimelineFlushBatchSize) {
+        return flushTimelineEvents();
+    }
+    if (unsaved_timeline_events_ == 1) {
+        *flush_seconds = timeline_flush_seconds_;
+    }
+    return noError;
+}
+
+void Context::scheduleTimelineFlush(const Poco::UInt64 seconds) {
+    if (!seconds) {
+        return;
+    }
+
+    Poco::Util::TimerTask::Ptr ptask =
+        new Poco::Util::TimerTaskAdapter<Context>(
+            *this, &Context::onFlushTimelineEvents);
+
+    // Not under user_m_, see timer_m_ in context.h
+    Poco::Mutex::ScopedLock lock(timer_m_);
+    timer_.schedule(ptask, postpone(seconds * kOneSecondInMicros));
+}
+
+error Context::flushTimelineEvents() {
+    std::vector<ModelChange> changes;
+    try {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (!user_ || !unsaved_timeline_events_) {
+            return noError;
+        }
+
+        logger.debug("flushTimelineEvents count=", unsaved_timeline_events_);
+
+        error err = db()->SaveUser(user_, true, &changes);
+        if (err != noError) {
+            return err;
+        }
+        time_entry_list_.ApplyChanges(changes);
+        user_->related.ApplyAutocompleteChanges(changes);
+        updateSnapshot(changes);
+        unsaved_timeline_events_ = 0;
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+
+    // Only timeline events are expected here, refresh the UI
+    // if anything else was waiting to be saved too
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        if (it->ModelType() != kModelTimelineEvent) {
+            UIElements render;
+            render.display_unsynced_items = true;
+            render.display_timer_state = true;
+            render.ApplyChanges(time_entry_editor_guid_, changes);
+            updateUI(render);
+            break;
+        }
+    }
     return noError;
 }
 
+void Context::publishSnapshot() {
+    std::shared_ptr<UserSnapshot> snapshot =
+        std::make_shared<UserSnapshot>();
+    snapshot->Fill(user_, ++snapshot_version_);
+    swapSnapshot(snapshot);
+}
+
+void Context::updateSnapshot(const std::vector<ModelChange> &changes) {
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        if (kModelTimeEntry == it->ModelType()) {
+            std::shared_ptr<UserSnapshot> snapshot =
+                std::make_shared<UserSnapshot>();
+            snapshot->Update(user_, *Snapshot(), changes, ++snapshot_version_);
+            swapSnapshot(snapshot);
+            return;
+        }
+    }
+}
+
+void Context::swapSnapshot(std::shared_ptr<const UserSnapshot> snapshot) {
+    std::shared_ptr<const UserSnapshot> previous = std::atomic_exchange(
+        &snapshot_, snapshot);
+
+    // The UI updater sleeps until there's a running time to show
+    if (snapshot->Tracking() && (!previous || !previous->Tracking())) {
+        ui_updater_wakeup_.set();
+    }
+}
+
+void Context::scheduleDatabaseMaintenance(const Poco::Int64 delay_seconds) {
+    Poco::Util::TimerTask::Ptr ptask =
+        new Poco::Util::TimerTaskAdapter<Context>(
+        *this, &Context::onDatabaseMaintenance);
+
+    Poco::Timestamp next_step_at =
+        Poco::Timestamp() + delay_seconds * kOneSecondInMicros;
+
+    Poco::Mutex::ScopedLock lock(timer_m_);
+    timer_.schedule(ptask, next_step_at);
+}
+
+void Context::onDatabaseMaintenance(Poco::Util::TimerTask&) {  // NOLINT
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+
+    bool enabled(false);
+    bool finished(false);
+    std::string db_path("");
+    error err = noError;
+    {
+        Poco::Mutex::ScopedLock lock(db_m_);
+        if (!db_) {
+            return;
+        }
+        err = db_->IncrementalVacuumEnabled(&enabled);
+        if (err == noError && enabled) {
+            err = db_->Maintain(
+                Poco::Timespan(
+                    kDatabaseMaintenanceStepMillis * Poco::Timespan::MILLISECONDS),
+                &finished);
+        }
+        db_path = db_->DBPath();
+    }
+    if (err != noError) {
+        // Only the timer thread gets here, one step at a time
+        database_maintenance_retry_seconds_ = (std::min)(
+            Poco::Int64(kDatabaseMaintenanceMaxRetrySeconds),
+            (std::max)(Poco::Int64(kDatabaseMaintenanceRetrySeconds),
+                       2 * database_maintenance_retry_seconds_));
+        logger.error("Database maintenance failed: ", err,
+                     ", retrying in ", database_maintenance_retry_seconds_, " s");
+        scheduleDatabaseMaintenance(database_maintenance_retry_seconds_);
+        return;
+    }
+    database_maintenance_retry_seconds_ = 0;
+
+    if (!enabled) {
+        // The full vacuum can't be split into steps, so it waits
+        // until the user is away and runs off the timer thread.
+        // The activity schedules maintenance again once it's done.
+        if (idle_seconds_ >= kDatabaseVacuumIdleSeconds) {
+            Poco::Mutex::ScopedLock lock(database_vacuum_m_);
+            if (!database_vacuum_.isRunning()) {
+                database_vacuum_path_ = db_path;
+                database_vacuum_.start();
+            }
+            return;
+        }
+        scheduleDatabaseMaintenance(kDatabaseVacuumCheckSeconds);
+        return;
+    }
+
+    logger.debug("Database maintenance step took ",
+                 stopwatch.elapsed() / 1000, " ms",
+                 finished ? ", all done" : "");
+
+    // Give other database work a chance between the steps
+    if (!finished) {
+        scheduleDatabaseMaintenance(1);
+    }
+}
+
+void Context::databaseVacuumActivity() {
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+
+    std::string db_path("");
+    {
+        Poco::Mutex::ScopedLock lock(database_vacuum_m_);
+        db_path = database_vacuum_path_;
+    }
+
+    bool switched(false);
+    error err = Database::SwitchToIncrementalVacuum(db_path, &switched);
+    if (database_vacuum_.isStopped()) {
+        return;
+    }
+    if (err != noError) {
+        logger.error("Switching to incremental vacuum failed: ", err);
+        scheduleDatabaseMaintenance(kDatabaseMaintenanceMaxRetrySeconds);
+        return;
+    }
+    if (switched) {
+        logger.debug("Switched to incremental vacuum in ",
+                     stopwatch.elapsed() / 1000, " ms");
+    }
+    scheduleDatabaseMaintenance(1);
+}
+
+void Context::onFlushTimelineEvents(Poco::Util::TimerTask&) {  // NOLINT
+    displayError(flushTimelineEvents());
+}
+
+void Context::SetTimelineFlushSeconds(const Poco::UInt64 seconds) {
+    logger.debug("SetTimelineFlushSeconds ", seconds);
+
+    Poco::Mutex::ScopedLock lock(user_m_);
+    timeline_flush_seconds_ = seconds;
+}
+
 error Context::MarkTimelineBatchAsUploaded(const std::vector<const TimelineEvent*> &events) {
     try {
         Poco::Mutex::ScopedLock lock(user_m_);
@@ -4920,30 +5376,25 @@ error Context::SetPromotionResponse(
 void Context::uiUpdaterActivity() {
     std::string running_time("");
     while (!ui_updater_.isStopped()) {
-        // Sleep in increments for faster shutdown.
-        for (unsigned int i = 0; i < 4*10; i++) {
-            if (ui_updater_.isStopped()) {
-                return;
-            }
-            Poco::Thread::sleep(250);
+        // The running time only changes while tracking,
+        // starting a time entry wakes the updater up
+        if (Snapshot()->Tracking()) {
+            ui_updater_wakeup_.tryWait(10000);
+        } else {
+            ui_updater_wakeup_.wait();
+        }
+        if (ui_updater_.isStopped()) {
+            return;
         }
 
-        TimeEntry *te = nullptr;
-        Poco::Int64 duration(0);
-        {
-            Poco::Mutex::ScopedLock lock(user_m_);
-            if (!user_) {
-                continue;
-            }
-            te = user_->RunningTimeEntry();
-            if (!te) {
-                continue;
-            }
-            duration = user_->related.TotalDurationForDate(te);
+        std::shared_ptr<const UserSnapshot> snapshot = Snapshot();
+        if (!snapshot->Tracking()) {
+            continue;
         }
 
         std::string date_duration =
-            Formatter::FormatDurationForDateHeader(duration);
+            Formatter::FormatDurationForDateHeader(
+                snapshot->RunningDayDuration());
 
         if (running_time != date_duration) {
             UIElements render;
@@ -4963,12 +5414,10 @@ void Context::checkReminders() {
 
 void Context::reminderActivity() {
     while (true) {
-        // Sleep in increments for faster shutdown.
-        for (int i = 0; i < 4; i++) {
-            if (reminder_.isStopped()) {
-                return;
-            }
-            Poco::Thread::sleep(250);
+        // Reminders are due by the clock, so check them every second
+        reminder_wakeup_.tryWait(1000);
+        if (reminder_.isStopped()) {
+            return;
         }
 
         checkReminders();
@@ -4993,15 +5442,10 @@ void Context::syncerActivityWrapper() {
     };
 #endif
 
-    while (true) {
-        // Sleep in increments for faster shutdown.
-        for (int i = 0; i < 4; i++) {
-            if (syncer_.isStopped()) {
-                return;
-            }
-            Poco::Thread::sleep(250);
-        }
+    // Syncing with part of the data loaded would duplicate the rest
+    waitForDeferredUserData();
 
+    while (!syncer_.isStopped()) {
         switch (state) {
             case STARTUP: {
                 logger.log("Syncer bootup, will attempt to determine which protocol to use");
@@ -5011,7 +5455,8 @@ void Context::syncerActivityWrapper() {
                     break;
                 state = user_->AlphaFeatureSettings->IsSyncEnabled() ? state = BATCHED : LEGACY;
                 logger.log("Syncer - Syncing protocol was selected: ", (state == BATCHED ? "BATCHED" : "LEGACY"));
-                break;
+                // Go on with the sync that started the syncer
+                continue;
             }
             case LEGACY:
                 legacySyncerActivity();
@@ -5020,6 +5465,135 @@ void Context::syncerActivityWrapper() {
                 batchedSyncerActivity();
                 break;
         }
+
+        // Triggers still set after a run are from a failed attempt,
+        // retry them in a second instead of waiting for a new one
+        if (STARTUP == state || trigger_sync_ || trigger_push_) {
+            syncer_wakeup_.tryWait(1000);
+        } else {
+            syncer_wakeup_.wait();
+        }
+    }
+}
+
+void Context::deferredLoaderActivity() {
+    Poco::UInt64 uid(0);
+    Poco::Int64 since(0);
+    Poco::Int64 hot_since(0);
+    {
+        Poco::Mutex::ScopedLock lock(deferred_loader_m_);
+        uid = deferred_uid_;
+        since = deferred_since_;
+        hot_since = deferred_hot_since_;
+    }
+
+    std::vector<TimeEntry *> time_entries;
+    std::vector<TimelineEvent *> timeline_events;
+    error err = db()->LoadDeferredUserData(
+        uid, since, hot_since, &time_entries, &timeline_events,
+    [this] {
+        return deferred_loader_.isStopped();
+    });
+    if (err != noError && !deferred_loader_.isStopped()) {
+        displayError(err);
+    }
+
+    bool loaded(false);
+    Poco::UInt64 flush_seconds(0);
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        // Dropped when the user has logged out in the meantime
+        if (!deferred_loader_.isStopped() && user_ && user_->ID() == uid) {
+            if (err == noError) {
+                user_->related.AddDeferred(&time_entries, &timeline_events);
+                time_entry_list_.Reset();
+                publishSnapshot();
+                loaded = true;
+            }
+
+            // Recorded while the timeline was read, merged now
+            // so the same window doesn't get a second chunk
+            for (auto event : deferred_timeline_events_) {
+                error record_err = recordTimelineEvent(
+                    std::unique_ptr<TimelineEvent>(event), &flush_seconds);
+                if (record_err != noError) {
+                    logger.error(record_err);
+                }
+            }
+            deferred_timeline_events_.clear();
+        }
+        for (auto event : deferred_timeline_events_) {
+            delete event;
+        }
+        deferred_timeline_events_.clear();
+
+        // Set with user_m_ held, so no timeline event
+        // is queued after the ones above were merged
+        deferred_user_data_.set();
+    }
+
+    for (auto te : time_entries) {
+        delete te;
+    }
+    for (auto event : timeline_events) {
+        delete event;
+    }
+
+    scheduleTimelineFlush(flush_seconds);
+
+    if (loaded) {
+        UIElements render;
+        render.display_time_entries = true;
+        render.display_time_entry_autocomplete = true;
+        render.display_mini_timer_autocomplete = true;
+        render.display_timeline = true;
+        updateUI(render);
+    }
+}
+
+void Context::waitForDeferredUserData() {
+    deferred_user_data_.wait();
+}
+
+bool Context::deferredUserDataLoaded() {
+    return deferred_user_data_.tryWait(0);
+}
+
+void Context::pageInTimelineDate(UIElements *render) {
+    poco_check_ptr(render);
+
+    Poco::LocalDateTime date(UI()->TimelineDateAt());
+    const Poco::Int64 from = Poco::LocalDateTime(
+        date.year(), date.month(), date.day()).utc().timestamp().epochTime();
+
+    Poco::Mutex::ScopedLock lock(user_m_);
+    if (!user_) {
+        return;
+    }
+    const size_t resident = user_->related.TimeEntries.size();
+    error err = user_->related.PageInTimeEntries(from);
+    if (err == noError) {
+        err = user_->related.PageInTimeEntries(
+            from + 24 * 60 * 60 - 1);
+    }
+    if (err != noError) {
+        logger.error(err);
+    }
+    if (user_->related.TimeEntries.size() != resident) {
+        evictTimeEntryPages();
+        render->display_time_entries = true;
+    }
+}
+
+void Context::evictTimeEntryPages() {
+    user_->related.EvictTimeEntryPages();
+    time_entry_list_.Reset();
+    publishSnapshot();
+}
+
+void Context::evictTimeEntryPagesOverLimit() {
+    if (user_->related.TimeEntryPageCount() > kTimeEntryResidentPages) {
+        evictTimeEntryPages();
     }
 }
 
@@ -5044,7 +5618,12 @@ void Context::legacySyncerActivity() {
 
             setOnline("Data pulled");
 
-            err = pushChanges(&trigger_sync_);
+            bool sync = true;
+            trigger_sync_ = true;
+            err = pushChanges(&sync);
+            if (!sync) {
+                trigger_sync_ = false;
+            }
             trigger_push_ = false;
             if (err != noError) {
                 user_->ConfirmLoadedMore();
@@ -5064,7 +5643,12 @@ void Context::legacySyncerActivity() {
         Poco::Mutex::ScopedLock lock(syncer_m_);
 
         if (trigger_push_) {
-            error err = pushChanges(&trigger_sync_);
+            bool sync = true;
+            trigger_sync_ = true;
+            error err = pushChanges(&sync);
+            if (!sync) {
+                trigger_sync_ = false;
+            }
             if (err != noError) {
                 user_->ConfirmLoadedMore();
                 displayError(err);
@@ -5099,7 +5683,12 @@ void Context::batchedSyncerActivity() {
 
             setOnline("Data pulled");
 
-            err = pushBatchedChanges(&trigger_sync_);
+            bool sync = true;
+            trigger_sync_ = true;
+            err = pushBatchedChanges(&sync);
+            if (!sync) {
+                trigger_sync_ = false;
+            }
             trigger_push_ = false;
             if (err != noError) {
                 user_->ConfirmLoadedMore();
@@ -5133,7 +5722,20 @@ void Context::LoadMore() {
 }
 
 void Context::onLoadMore(Poco::Util::TimerTask&) {
+    // Older time entries may still be on their way from the database,
+    // check again later instead of holding up the timer thread
+    if (!deferredUserDataLoaded()) {
+        Poco::Util::TimerTask::Ptr task =
+            new Poco::Util::TimerTaskAdapter<Context>(*this,
+                    &Context::onLoadMore);
+        Poco::Mutex::ScopedLock lock(timer_m_);
+        timer_.schedule(task,
+                        postpone(kDeferredUserDataRetryMillis * 1000));
+        return;
+    }
+
     bool needs_render = !user_->HasLoadedMore();
+    bool paged_in(false);
     std::string api_token;
     {
         Poco::Mutex::ScopedLock lock(user_m_);
@@ -5141,6 +5743,22 @@ void Context::onLoadMore(Poco::Util::TimerTask&) {
             return;
         }
         api_token = user_->APIToken();
+
+        // Older time entries in the database come before the API
+        error err = user_->related.PageInOlderTimeEntries(&paged_in);
+        if (err != noError) {
+            logger.error(err);
+        }
+        if (paged_in) {
+            evictTimeEntryPages();
+        }
+    }
+
+    if (paged_in) {
+        UIElements render;
+        render.display_time_entries = true;
+        updateUI(render);
+        return;
     }
 
     if (api_token.empty()) {
@@ -5181,6 +5799,7 @@ void Context::onLoadMore(Poco::Util::TimerTask&) {
             }
 
             user_->ConfirmLoadedMore();
+            evictTimeEntryPagesOverLimit();
 
             // Removes load more button if nothing is to be loaded
             if (needs_render) {
@@ -5233,14 +5852,23 @@ void Context::SetLogPath(const std::string &path) {
 error Context::pullAllUserData() {
     std::string api_token("");
     Poco::Int64 since(0);
+    User *user(nullptr);
+    // Not a pointer, the entry may be freed while the pull is applied
+    std::string running_guid("");
     {
         Poco::Mutex::ScopedLock lock(user_m_);
         if (!user_) {
             logger.warning("cannot pull user data when logged out");
             return noError;
         }
+        user = user_;
+        TimeEntry *running_entry = user_->RunningTimeEntry();
+        if (running_entry) {
+            running_guid = running_entry->GUID();
+        }
         api_token = user_->APIToken();
-        if (user_->HasValidSinceDate()) {
+        // Since 0 pulls everything, which also removes zombies
+        if (user_->HasValidSinceDate() && !user_->FullSyncDue()) {
             since = user_->Since();
         }
     }
@@ -5253,33 +5881,30 @@ error Context::pullAllUserData() {
         Poco::Stopwatch stopwatch;
         stopwatch.start();
 
-        std::string user_data_json("");
+        // Models are loaded while the response is being received
+        User::LoadGuard guard = userLoadGuard(user);
         error err = me(
             api_token,
             "api_token",
-            &user_data_json,
-            since);
+            nullptr,
+            since,
+        [&](std::istream &is) {
+            return user->LoadUserAndRelatedDataFromJSONStream(
+                is, !since, false, guard);
+        });
         if (err != noError) {
             return err;
         }
 
         {
             Poco::Mutex::ScopedLock lock(user_m_);
-            if (!user_) {
+            if (user_ != user) {
                 return error("cannot load user data when logged out");
             }
-            TimeEntry *running_entry = user_->RunningTimeEntry();
-
-            err = user_->LoadUserAndRelatedDataFromJSONString(user_data_json, !since, false);
-
-            if (err != noError) {
-                return err;
-            }
             overlay_visible_ = false;
-            TimeEntry *new_running_entry = user_->RunningTimeEntry();
-
+            evictTimeEntryPagesOverLimit();
             // Reset reminder time when entry stopped by sync
-            if (running_entry && !new_running_entry) {
+            if (!running_guid.empty() && !user_->RunningTimeEntry()) {
                 resetLastTrackingReminderTime();
             }
         }
@@ -5304,19 +5929,29 @@ error Context::pullAllUserData() {
 error Context::pullBatchedUserData() {
     std::string api_token("");
     Poco::Int64 since(0);
+    bool full_sync(false);
+    User *user(nullptr);
+    // Not a pointer, the entry may be freed while the pull is applied
+    std::string running_guid("");
     {
         Poco::Mutex::ScopedLock lock(user_m_);
         if (!user_) {
             logger.warning("cannot pull user data when logged out");
             return noError;
         }
+        user = user_;
+        TimeEntry *running_entry = user_->RunningTimeEntry();
+        if (running_entry) {
+            running_guid = running_entry->GUID();
+        }
         api_token = user_->APIToken();
-        if (user_->HasValidSinceDate()) {
+        // Incremental unless a full sync is due, like pullAllUserData
+        if (user_->HasValidSinceDate() && !user_->FullSyncDue()) {
             since = user_->Since();
-        }
-        else {
+        } else {
             // just pull the last 10 days on full sync
             since = time(nullptr) - 10 * 24 * 60 * 60;
+            full_sync = true;
             user_->HasLoadedMore.Set(false);
         }
     }
@@ -5329,43 +5964,34 @@ error Context::pullBatchedUserData() {
         Poco::Stopwatch stopwatch;
         stopwatch.start();
 
-        std::string user_data_json("");
-        error err = noError;
-
-        err = syncPull(
+        // Models are loaded while the response is being received
+        User::LoadGuard guard = userLoadGuard(user);
+        error err = syncPull(
             api_token,
             "api_token",
-            &user_data_json,
-            since);
-
-        Json::Value json;
-        Json::Reader reader;
-        reader.parse(user_data_json, json);
-
-        std::cerr << "PULLED: " << std::endl << json.toStyledString() << std::endl;
-        logger.debug("Sync server pull response: ", json.toStyledString());
-
+            nullptr,
+            since,
+        [&](std::istream &is) {
+            return user->LoadUserAndRelatedDataFromJSONStream(
+                is, !since, true, guard);
+        });
         if (err != noError) {
             return err;
         }
 
         {
             Poco::Mutex::ScopedLock lock(user_m_);
-            if (!user_) {
+            if (user_ != user) {
                 return error("cannot load user data when logged out");
             }
-            TimeEntry *running_entry = user_->RunningTimeEntry();
-
-            user_->LoadUserAndRelatedDataFromJSON(json, !since, true);
-
-            if (err != noError) {
-                return err;
-            }
             overlay_visible_ = false;
-            TimeEntry *new_running_entry = user_->RunningTimeEntry();
-
+            evictTimeEntryPagesOverLimit();
+            // The window pulled in full is what the batched sync keeps
+            if (full_sync) {
+                user_->SetFullSyncedAt(time(nullptr));
+            }
             // Reset reminder time when entry stopped by sync
-            if (running_entry && !new_running_entry) {
+            if (!running_guid.empty() && !user_->RunningTimeEntry()) {
                 resetLastTrackingReminderTime();
             }
         }
@@ -5387,8 +6013,27 @@ error Context::pullBatchedUserData() {
     return noError;
 }
 
+User::LoadGuard Context::userLoadGuard(User *user) {
+    return [this, user](const std::function<void()> &step) {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        if (user_ != user) {
+            return false;
+        }
+        step();
+        return true;
+    };
+}
+
 error Context::pushBatchedChanges(
     bool *had_something_to_push) {
+    return PushBatchedChanges([](const HTTPRequest &req) {
+        return TogglClient::GetInstance().Post(req);
+    }, had_something_to_push);
+}
+
+error Context::PushBatchedChanges(
+    const std::function<HTTPResponse(const HTTPRequest &)> &post,
+    bool *had_something_to_push) {
 
     try {
         Poco::Stopwatch stopwatch;
@@ -5463,7 +6108,7 @@ error Context::pushBatchedChanges(
             req.basic_auth_username = api_token;
             req.basic_auth_password = "api_token";
 
-            auto response = TogglClient::GetInstance().Post(req);
+            auto response = post(req);
 
             std::cerr << "REQUEST: " << request.toStyledString() << std::endl;
             logger.debug("Sync request ", lastRequestUUID_, ": ", request.toStyledString());
@@ -5480,15 +6125,27 @@ error Context::pushBatchedChanges(
             std::cerr << "RESPONSE: " << responseJson.toStyledString() << std::endl;
             logger.debug("Sync response to request ", lastRequestUUID_, ": ", responseJson.toStyledString());
 
-            error err = syncHandleResponse(responseJson["clients"], clients);
-            if (err != noError)
-                return err;
-            updateProjectClients(clients, projects);
-            err = syncHandleResponse(responseJson["projects"], projects);
-            if (err != noError)
-                return err;
-            updateEntryProjects(projects, time_entries);
-            err = syncHandleResponse(responseJson["time_entries"], time_entries);
+            // Apply the whole response in memory and save it once,
+            // also when some item failed, so the ones before it aren't lost
+            bool applied(false);
+            error err = syncHandleResponse(responseJson["clients"], clients, &applied);
+            if (err == noError) {
+                updateProjectClients(clients, projects);
+                err = syncHandleResponse(responseJson["projects"], projects, &applied);
+            }
+            if (err == noError) {
+                updateEntryProjects(projects, time_entries);
+                err = syncHandleResponse(responseJson["time_entries"], time_entries, &applied);
+            }
+            if (applied) {
+                error save_err = save(false);
+                if (save_err != noError) {
+                    displayError(save_err);
+                    if (err == noError) {
+                        err = save_err;
+                    }
+                }
+            }
             if (err != noError)
                 return err;
         }
@@ -5638,24 +6295,32 @@ error Context::pushChanges(
 error Context::pushClients(
     const std::vector<Client *> &clients,
     const std::string &api_token) {
-    std::string client_json("");
     error err = noError;
+    Json::FastWriter writer;
+    std::vector<HTTPRequest> requests;
     for (std::vector<Client *>::const_iterator it =
         clients.begin();
             it != clients.end(); ++it) {
-        Json::Value clientJson = (*it)->SaveToJSON();
-
-        Json::StyledWriter writer;
-        client_json = writer.write(clientJson);
-
         HTTPRequest req;
+        req.method = Poco::Net::HTTPRequest::HTTP_POST;
         req.host = urls::API();
         req.relative_url = (*it)->ModelURL();
-        req.payload = client_json;
+        req.payload = writer.write((*it)->SaveToJSON());
         req.basic_auth_username = api_token;
         req.basic_auth_password = "api_token";
+        requests.push_back(req);
+    }
 
-        HTTPResponse resp = TogglClient::GetInstance().Post(req);
+    std::vector<HTTPResponse> responses;
+    std::vector<bool> sent;
+    sendLegacyRequests(requests, &responses, &sent);
+
+    for (size_t i = 0; i < clients.size(); i++) {
+        std::vector<Client *>::const_iterator it = clients.begin() + i;
+        if (!sent[i]) {
+            continue;
+        }
+        const HTTPResponse &resp = responses[i];
 
         if (resp.err != noError) {
             // if we're able to solve the error
@@ -5683,7 +6348,8 @@ error Context::pushProjects(
     const std::vector<Client *> &clients,
     const std::string &api_token) {
     error err = noError;
-    std::string project_json("");
+    Json::FastWriter writer;
+    std::vector<HTTPRequest> requests;
     for (std::vector<Project *>::const_iterator it =
         projects.begin();
             it != projects.end(); ++it) {
@@ -5699,19 +6365,26 @@ error Context::pushProjects(
             }
         }
 
-        Json::Value projectJson = (*it)->SaveToJSON();
-
-        Json::StyledWriter writer;
-        project_json = writer.write(projectJson);
-
         HTTPRequest req;
+        req.method = Poco::Net::HTTPRequest::HTTP_POST;
         req.host = urls::API();
         req.relative_url = (*it)->ModelURL();
-        req.payload = project_json;
+        req.payload = writer.write((*it)->SaveToJSON());
         req.basic_auth_username = api_token;
         req.basic_auth_password = "api_token";
+        requests.push_back(req);
+    }
 
-        HTTPResponse resp = TogglClient::GetInstance().Post(req);
+    std::vector<HTTPResponse> responses;
+    std::vector<bool> sent;
+    sendLegacyRequests(requests, &responses, &sent);
+
+    for (size_t i = 0; i < projects.size(); i++) {
+        std::vector<Project *>::const_iterator it = projects.begin() + i;
+        if (!sent[i]) {
+            continue;
+        }
+        const HTTPResponse &resp = responses[i];
 
         if (resp.err != noError) {
             // if we're able to solve the error
@@ -5734,6 +6407,14 @@ error Context::pushProjects(
     return err;
 }
 
+void Context::sendLegacyRequests(
+    const std::vector<HTTPRequest> &requests,
+    std::vector<HTTPResponse> *responses,
+    std::vector<bool> *sent) {
+    TogglClient::GetInstance().SendAllReportingOnce(
+        requests, kLegacyPushConcurrency, responses, sent);
+}
+
 error Context::updateProjectClients(const std::vector<Client *> &clients,
                                     const std::vector<Project *> &projects) {
     for (auto it = projects.cbegin(); it != projects.cend(); ++it) {
@@ -5777,45 +6458,49 @@ error Context::pushEntries(
     const std::vector<TimeEntry *> &time_entries,
     const std::string &api_token) {
 
-    std::string entry_json("");
     std::string error_message("");
     bool error_found = false;
-    bool offline = false;
 
+    Json::FastWriter writer;
+    std::vector<HTTPRequest> requests;
     for (std::vector<TimeEntry *>::const_iterator it =
         time_entries.begin();
             it != time_entries.end(); ++it) {
-        // Avoid trying to POST when we're offline
-        if (offline) {
-            // Mark the time entry as unsynced now
-            (*it)->SetUnsynced();
-            continue;
-        }
-
-        Json::Value entryJson = (*it)->SaveToJSON();
-
-        Json::StyledWriter writer;
-        entry_json = writer.write(entryJson);
-
-        // std::cout << entry_json;
-
         HTTPRequest req;
         req.host = urls::API();
         req.relative_url = (*it)->ModelURL();
-        req.payload = entry_json;
         req.basic_auth_username = api_token;
         req.basic_auth_password = "api_token";
 
-        HTTPResponse resp;
-
         if ((*it)->NeedsDELETE()) {
-            req.payload = "";
-            resp = TogglClient::GetInstance().Delete(req);
-        } else if ((*it)->ID()) {
-            resp = TogglClient::GetInstance().Put(req);
+            req.method = Poco::Net::HTTPRequest::HTTP_DELETE;
         } else {
-            resp = TogglClient::GetInstance().Post(req);
+            req.payload = writer.write((*it)->SaveToJSON());
+            if ((*it)->ID()) {
+                req.method = Poco::Net::HTTPRequest::HTTP_PUT;
+            } else {
+                req.method = Poco::Net::HTTPRequest::HTTP_POST;
+            }
+        }
+        requests.push_back(req);
+    }
+
+    std::vector<HTTPResponse> responses;
+    std::vector<bool> sent;
+    sendLegacyRequests(requests, &responses, &sent);
+
+    // Results are applied in the original order, as if the
+    // requests had been sent one after another
+    for (size_t i = 0; i < time_entries.size(); i++) {
+        std::vector<TimeEntry *>::const_iterator it = time_entries.begin() + i;
+        // Not sent because we went offline. Requests that were
+        // already in flight are applied, to not lose the new IDs.
+        if (!sent[i]) {
+            // Mark the time entry as unsynced now
+            (*it)->SetUnsynced();
+            continue;
         }
+        const HTTPResponse &resp = responses[i];
 
         if (resp.err != noError) {
             // if we're able to solve the error
@@ -5843,9 +6528,7 @@ error Context::pushEntries(
             // Mark the time entry as unsynced now
             (*it)->SetUnsynced();
 
-            offline = IsNetworkingError(resp.err);
-
-            if (offline) {
+            if (IsNetworkingError(resp.err)) {
                 trigger_sync_ = false;
             }
 
@@ -5897,7 +6580,8 @@ error Context::me(
     const std::string &email,
     const std::string &password,
     std::string *user_data_json,
-    const Poco::Int64 since) {
+    const Poco::Int64 since,
+    const std::function<error(std::istream &)> &body_reader) {
 
     if (email.empty()) {
         return "Empty email or API token";
@@ -5908,7 +6592,9 @@ error Context::me(
     }
 
     try {
-        poco_check_ptr(user_data_json);
+        if (!body_reader) {
+            poco_check_ptr(user_data_json);
+        }
 
         std::stringstream ss;
         ss << "/api/"
@@ -5925,12 +6611,16 @@ error Context::me(
         req.relative_url = ss.str();
         req.basic_auth_username = email;
         req.basic_auth_password = password;
+        req.body_reader = body_reader;
 
         HTTPResponse resp = TogglClient::GetInstance().Get(req);
         if (resp.err != noError) {
             return resp.err;
         }
 
+        if (body_reader) {
+            return noError;
+        }
         *user_data_json = resp.body;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -5946,7 +6636,8 @@ error Context::syncPull(
     const std::string &email,
     const std::string &password,
     std::string *user_data,
-    const Poco::Int64 since) {
+    const Poco::Int64 since,
+    const std::function<error(std::istream &)> &body_reader) {
 
     if (email.empty()) {
         return "Empty email or API token";
@@ -5957,7 +6648,9 @@ error Context::syncPull(
     }
 
     try {
-        poco_check_ptr(user_data);
+        if (!body_reader) {
+            poco_check_ptr(user_data);
+        }
 
         std::stringstream ss;
         ss << "/pull";
@@ -5970,12 +6663,16 @@ error Context::syncPull(
         req.relative_url = ss.str();
         req.basic_auth_username = email;
         req.basic_auth_password = password;
+        req.body_reader = body_reader;
 
         HTTPResponse resp = TogglClient::GetInstance().Get(req);
         if (resp.err != noError) {
             return resp.err;
         }
 
+        if (body_reader) {
+            return noError;
+        }
         *user_data = resp.body;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -6319,9 +7016,23 @@ bool Context::syncTranslateGUIDToLocalID(Json::Value &item) {
 }
 
 template<typename T>
-error Context::syncHandleResponse(Json::Value &array, const std::vector<T*> &source) {
+error Context::syncHandleResponse(
+    Json::Value &array,
+    const std::vector<T*> &source,
+    bool *applied) {
+    poco_check_ptr(applied);
+
     // this only looks into the container of modified items, not the whole RelatedData container
-    auto findByLocalID = [](auto &source, std::string &&localID) -> typename std::remove_reference<decltype(source)>::type::value_type {
+    std::unordered_map<Poco::Int64, T*> by_local_id;
+    std::unordered_map<Poco::UInt64, T*> by_id;
+    by_local_id.reserve(source.size());
+    for (auto i : source) {
+        by_local_id.emplace(i->LocalID(), i);
+        if (i->ID()) {
+            by_id.emplace(i->ID(), i);
+        }
+    }
+    auto findByLocalID = [&by_local_id](std::string &&localID) -> T* {
         int64_t id = 0;
         try {
             id = stoi(localID);
@@ -6329,26 +7040,18 @@ error Context::syncHandleResponse(Json::Value &array, const std::vector<T*> &sou
         } catch (...) {
             return nullptr;
         }
-        for (auto i : source) {
-            if (i->LocalID() == id) {
-                return i;
-            }
-        }
-        return nullptr;
+        auto it = by_local_id.find(id);
+        return it != by_local_id.end() ? it->second : nullptr;
     };
-    auto findByID = [](auto &source, auto ID) -> typename std::remove_reference<decltype(source)>::type::value_type {
-        for (auto i : source) {
-            if (i->ID() == ID) {
-                return i;
-            }
-        }
-        return nullptr;
+    auto findByID = [&by_id](Poco::UInt64 ID) -> T* {
+        auto it = by_id.find(ID);
+        return it != by_id.end() ? it->second : nullptr;
     };
     for (auto i : array) {
         if (!i["payload"].empty()) {
-            auto model = findByLocalID(source, i["meta"]["client_assigned_id"].asString());
+            auto model = findByLocalID(i["meta"]["client_assigned_id"].asString());
             if (!model)
-                model = findByID(source, i["meta"]["id"].asUInt64());
+                model = findByID(i["meta"]["id"].asUInt64());
             std::string modelInfo = model ? (model->ModelName() + "-localID:" + std::to_string(model->LocalID())) : "<nullptr>";
             if (i["payload"]["success"].asBool()) {
                 if (model) {
@@ -6362,6 +7065,7 @@ error Context::syncHandleResponse(Json::Value &array, const std::vector<T*> &sou
 
                     if (!model->ID()) {
                         user_->SetModelID(id, model);
+                        by_id.emplace(id, model);
                     }
 
                     if (model->ID() != id) {
@@ -6371,11 +7075,7 @@ error Context::syncHandleResponse(Json::Value &array, const std::vector<T*> &sou
                     if (!root.isNull())
                         model->LoadFromJSON(i["payload"]["result"], isUsingSyncServer());
                     model->ClearUnsynced();
-                    error err = save(false);
-                    if (err != noError) {
-                        displayError(err);
-                        return err;
-                    }
+                    *applied = true;
                 }
             }
             else if (i["payload"]["result"].isMember("error_message") && i["payload"]["result"]["error_message"].isMember("default_message")) {
@@ -6543,6 +7243,7 @@ void Context::OpenTimelineDataView() {
     UIElements render;
     render.open_timeline = true;
     render.display_timeline = true;
+    pageInTimelineDate(&render);
     updateUI(render);
 }
 
@@ -6550,6 +7251,7 @@ void Context::ViewTimelineCurrentDay() {
     UI()->SetTimelineDateAt(UI()->TimelineDateAt());
     UIElements render;
     render.display_timeline = true;
+    pageInTimelineDate(&render);
     updateUI(render);
 }
 
@@ -6559,6 +7261,7 @@ void Context::ViewTimelinePrevDay() {
 
     UIElements render;
     render.display_timeline = true;
+    pageInTimelineDate(&render);
     updateUI(render);
 }
 
@@ -6568,6 +7271,7 @@ void Context::ViewTimelineNextDay() {
 
     UIElements render;
     render.display_timeline = true;
+    pageInTimelineDate(&render);
     updateUI(render);
 }
 
@@ -6577,6 +7281,7 @@ void Context::ViewTimelineSetDate(const Poco::Int64 unix_timestamp) {
 
     UIElements render;
     render.display_timeline = true;
+    pageInTimelineDate(&render);
     updateUI(render);
 }
 
@@ -6614,7 +7319,10 @@ error Context::ToSAccept() {
 }
 
 error Context::ToggleEntriesGroup(std::string name) {
-    entry_groups[name] = !entry_groups[name];
+    {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        entry_groups[name] = !entry_groups[name];
+    }
     OpenTimeEntryList();
     return noError;
 }
@@ -6692,16 +7400,12 @@ void Context::collectPushableModels(
 
 void on_websocket_message(
     void *context,
-    std::string json) {
+    const Json::Value &message) {
 
     poco_check_ptr(context);
 
-    if (json.empty()) {
-        return;
-    }
-
     Context *ctx = reinterpret_cast<Context *>(context);
-    ctx->LoadUpdateFromJSONString(json);
+    ctx->QueueWebSocketUpdate(message);
 }
 
 void Context::TrackWindowSize(const Poco::UInt64 width,
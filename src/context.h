@@ -3,6 +3,8 @@
 #ifndef SRC_CONTEXT_H_
 #define SRC_CONTEXT_H_
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <vector>
 #include <map>
@@ -15,16 +17,20 @@
 #include "feedback.h"
 #include "gui.h"
 #include "help_article.h"
+#include "https_client.h"
 #include "idle.h"
 #include "util/logger.h"
 #include "model_change.h"
 #include "model/timeline_event.h"
+#include "time_entry_list_model.h"
 #include "timeline_notifications.h"
 #include "types.h"
+#include "user_snapshot.h"
 #include "websocket_client.h"
 #include "model/alpha_features.h"
 
 #include <Poco/Activity.h>
+#include <Poco/Event.h>
 #include <Poco/LocalDateTime.h>
 #include <Poco/Timestamp.h>
 #include <Poco/Util/Timer.h>
@@ -125,6 +131,10 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     // Load model update from JSON string (from WebSocket)
     error LoadUpdateFromJSONString(const std::string &json);
 
+    // Queues a parsed WebSocket update. Updates coming in a burst are
+    // applied, saved and rendered together once the burst is over.
+    void QueueWebSocketUpdate(const Json::Value &update);
+
     void SetWebSocketClientURL(const std::string &value);
 
     error SetDBPath(const std::string &path);
@@ -346,6 +356,28 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
         const std::string &json,
         const bool isSignup = false);
 
+    // Batched push with the request sent to the given function
+    // instead of the sync server, for tests and benchmarks
+    error PushBatchedChanges(
+        const std::function<HTTPResponse(const HTTPRequest &)> &post,
+        bool *had_something_to_push);
+
+    // Number of times the user has been saved, for tests and benchmarks
+    Poco::UInt64 SaveCount() const {
+        return save_count_;
+    }
+
+    // Number of update batches applied to the user, for tests
+    Poco::UInt64 UpdateBatchCount() const {
+        return update_batch_count_;
+    }
+
+    // Timeline events recorded but not written yet, for tests
+    Poco::UInt64 UnsavedTimelineEvents() {
+        Poco::Mutex::ScopedLock lock(user_m_);
+        return unsaved_timeline_events_;
+    }
+
     error ClearCache();
 
     TimeEntry *Start(
@@ -510,11 +542,29 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     error ToSAccept();
 
     void SetIdleSeconds(const Poco::UInt64 idle_seconds) {
+        idle_seconds_ = idle_seconds;
         idle_.SetIdleSeconds(idle_seconds, user_);
     }
 
     void LoadMore();
 
+    // Ranked autocomplete suggestions, see RelatedData::AutocompleteQuery
+    error AutocompleteQuery(
+        const Poco::Int64 list,
+        const std::string &query,
+        const size_t limit,
+        std::vector<view::Autocomplete> *result);
+
+    // Upper bound of how long recorded timeline events may wait in
+    // memory before they are written to the database. 0 writes every
+    // event as soon as it's recorded.
+    void SetTimelineFlushSeconds(const Poco::UInt64 seconds);
+
+    // Latest published user snapshot, readable without the user lock
+    std::shared_ptr<const UserSnapshot> Snapshot() const {
+        return std::atomic_load(&snapshot_);
+    }
+
     static void SetLogPath(const std::string &path);
 
     void SetQuit() {
@@ -586,6 +636,24 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     void checkReminders();
     void reminderActivity();
     void syncerActivityWrapper();
+    void deferredLoaderActivity();
+    void databaseVacuumActivity();
+
+    // Blocks until the user data left out at startup is in memory,
+    // must not be called with user_m_ held or on the timer thread
+    void waitForDeferredUserData();
+    // Whether the user data left out at startup is in memory already
+    bool deferredUserDataLoaded();
+
+    // Pages in the time entries of the day shown in the timeline,
+    // renders the list too if the time entries in memory changed
+    void pageInTimelineDate(UIElements *render);
+    // Drops the least recently used pages of time entries, the
+    // list is rebuilt as it points to them. Call with user_m_ held.
+    void evictTimeEntryPages();
+    // Sync pages in the older time entries it changes, so pages
+    // past kTimeEntryResidentPages are dropped once it's applied
+    void evictTimeEntryPagesOverLimit();
     void legacySyncerActivity();
     void batchedSyncerActivity();
 
@@ -604,6 +672,31 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
 
     error save(const bool push_changes = true);
 
+    // Writes the timeline events queued by StartTimelineEvent
+    error flushTimelineEvents();
+
+    // Merges the event into the timeline and queues it for writing,
+    // sets flush_seconds when a flush has to be scheduled. Call with
+    // user_m_ held.
+    error recordTimelineEvent(
+        std::unique_ptr<TimelineEvent> event,
+        Poco::UInt64 *flush_seconds);
+    void scheduleTimelineFlush(const Poco::UInt64 seconds);
+
+    // Applies model updates and saves them in one go
+    error applyUpdates(const std::vector<Json::Value> &updates);
+    // Puts updates back in front of the queue and applies it later
+    void requeueUpdates(const std::vector<Json::Value> &updates);
+
+    void scheduleDatabaseMaintenance(const Poco::Int64 delay_seconds);
+
+    // Builds and publishes a new user snapshot, call with user_m_ held
+    void publishSnapshot();
+    // Publishes a new snapshot if the saved changes may affect it,
+    // built from the previous one and the changed time entries
+    void updateSnapshot(const std::vector<ModelChange> &changes);
+    void swapSnapshot(std::shared_ptr<const UserSnapshot> snapshot);
+
     void fetchUpdates();
 
     // timer_ callbacks
@@ -620,6 +713,9 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     void onTrackSettingsUsage(Poco::Util::TimerTask& task);  // NOLINT
     void onWake(Poco::Util::TimerTask& task);  // NOLINT
     void onLoadMore(Poco::Util::TimerTask& task); // NOLINT
+    void onFlushTimelineEvents(Poco::Util::TimerTask& task);  // NOLINT
+    void onApplyWebSocketUpdates(Poco::Util::TimerTask& task);  // NOLINT
+    void onDatabaseMaintenance(Poco::Util::TimerTask& task);  // NOLINT
 
     void onTimeEntryAutocompletes(Poco::Util::TimerTask& task);  // NOLINT
     void onMiniTimerAutocompletes(Poco::Util::TimerTask& task);  // NOLINT
@@ -694,7 +790,10 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     void syncStripPremiumDataFromModelJSON(Json::Value &item);
     bool syncTranslateGUIDToLocalID(Json::Value &item);
     template <typename T>
-    error syncHandleResponse(Json::Value &array, const std::vector<T*> &source);
+    error syncHandleResponse(
+        Json::Value &array,
+        const std::vector<T*> &source,
+        bool *applied);
 
     error pushBatchedChanges(
         bool *had_something_to_push);
@@ -711,6 +810,11 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
         const std::map<std::string, BaseModel *> &models,
         const std::vector<TimeEntry *> &time_entries,
         const std::string &api_token);
+    // Sends legacy API requests a few at a time over the Toggl client
+    static void sendLegacyRequests(
+        const std::vector<HTTPRequest> &requests,
+        std::vector<HTTPResponse> *responses,
+        std::vector<bool> *sent);
     error updateProjectClients(
         const std::vector<Client *> &clients,
         const std::vector<Project *> &projects);
@@ -738,14 +842,21 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
         const std::string &full_name,
         const std::string provider);
 
+    // With a body reader the response is passed to it while it's
+    // being received, and user_data is left untouched
     static error me(const std::string &email,
                     const std::string &password,
                     std::string *user_data,
-                    const Poco::Int64 since);
+                    const Poco::Int64 since,
+                    const std::function<error(std::istream &)> &body_reader = nullptr);
     static error syncPull(const std::string &email,
                           const std::string &password,
                           std::string *user_data,
-                          const Poco::Int64 since);
+                          const Poco::Int64 since,
+                          const std::function<error(std::istream &)> &body_reader = nullptr);
+
+    // Runs a user data loading step under user_m_, while user is current
+    User::LoadGuard userLoadGuard(User *user);
 
     bool isTimeEntryLocked(TimeEntry* te);
     bool isTimeLockedInWorkspace(time_t t, Workspace* ws);
@@ -771,9 +882,24 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     Poco::Mutex user_m_;
     User *user_;
 
+    std::atomic<Poco::UInt64> save_count_;
+    std::atomic<Poco::UInt64> update_batch_count_;
+
+    // Replaced as a whole under user_m_, read with atomic loads
+    std::shared_ptr<const UserSnapshot> snapshot_;
+    Poco::UInt64 snapshot_version_;
+
+    // Timeline events recorded but not written yet, guarded by user_m_
+    Poco::UInt64 unsaved_timeline_events_;
+    Poco::UInt64 timeline_flush_seconds_;
+
     Poco::Mutex ws_client_m_;
     WebSocketClient ws_client_;
 
+    // WebSocket updates waiting for the burst to end
+    Poco::Mutex websocket_updates_m_;
+    std::vector<Json::Value> websocket_updates_;
+
     Poco::Mutex timeline_uploader_m_;
     TimelineUploader *timeline_uploader_;
 
@@ -791,7 +917,13 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
     Poco::Timestamp next_update_timeline_settings_at_;
     Poco::Timestamp next_wake_at_;
 
+    // Backoff of failed database maintenance, 0 while it succeeds
+    Poco::Int64 database_maintenance_retry_seconds_;
+
     // Schedule tasks using a timer:
+    // timer_m_ only guards scheduling and cancelling. It may be taken
+    // while user_m_ is held, so never lock user_m_ (or anything else)
+    // while holding it; prefer scheduling after user_m_ is released.
     Poco::Mutex timer_m_;
     Poco::Util::Timer timer_;
 
@@ -811,14 +943,21 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
 
     bool update_check_disabled_;
 
-    bool trigger_sync_;
-    bool trigger_push_;
-    bool trigger_full_sync_;
+    // Set by any thread, the syncer is woken up after setting them
+    std::atomic<bool> trigger_sync_;
+    std::atomic<bool> trigger_push_;
+    std::atomic<bool> trigger_full_sync_;
 
     Poco::LocalDateTime last_time_entry_list_render_at_;
 
     bool quit_;
 
+    // Setting the events wakes the activities up before their
+    // next scheduled run, so triggers and shutdown act at once
+    Poco::Event ui_updater_wakeup_;
+    Poco::Event reminder_wakeup_;
+    Poco::Event syncer_wakeup_;
+
     Poco::Mutex ui_updater_m_;
     Poco::Activity<Context> ui_updater_;
 
@@ -827,6 +966,28 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
 
     Poco::Mutex syncer_m_;
     Poco::Activity<Context> syncer_;
+
+    // Reads older time entries and the timeline after startup,
+    // the event is set when they're in memory (or dropped)
+    Poco::Mutex deferred_loader_m_;
+    Poco::Activity<Context> deferred_loader_;
+    Poco::UInt64 deferred_uid_;
+    Poco::Int64 deferred_since_;
+    Poco::Int64 deferred_hot_since_;
+    Poco::Event deferred_user_data_;
+    // Recorded while the timeline is still being read, merged into it
+    // once it's in memory. Guarded by user_m_; the event above is set
+    // with user_m_ held too, so none are left behind.
+    std::vector<TimelineEvent *> deferred_timeline_events_;
+
+    // Switches the database to incremental auto vacuum once the user
+    // is idle, on a connection of its own
+    Poco::Mutex database_vacuum_m_;
+    Poco::Activity<Context> database_vacuum_;
+    std::string database_vacuum_path_;
+    // Last reported by the UI
+    std::atomic<Poco::UInt64> idle_seconds_;
+
     std::string lastRequestUUID_;
 
     Analytics analytics_;
@@ -843,9 +1004,12 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
 
     TimeEntry *pomodoro_break_entry_;
 
-    // To cache grouped entries open/close status
+    // To cache grouped entries open/close status, guarded by user_m_
     std::map<std::string, bool_t> entry_groups;
 
+    // Updated under user_m_, rendered without it
+    TimeEntryListModel time_entry_list_;
+
     bool overlay_visible_;
 
     std::string last_message_id_;
@@ -879,7 +1043,7 @@ class TOGGL_INTERNAL_EXPORT Context : public TimelineDatasource {
 };
 void on_websocket_message(
     void *context,
-    std::string json);
+    const Json::Value &message);
 
 }  // namespace toggl
 
@@ -5,6 +5,7 @@
 #include "database.h"
 
 #include <limits>
+#include <sstream>
 #include <string>
 #include <vector>
 
@@ -42,8 +43,80 @@ using Poco::Data::Keywords::into;
 using Poco::Data::Keywords::now;
 using Poco::Data::Keywords::bind;
 
+// Time entries of the first screen, the rest and a page
+const std::string kRecentTimeEntries("start >= :since OR duration < 0");
+const std::string kOlderTimeEntries("start < :since AND duration >= 0");
+const std::string kOlderUnsyncedOrHotTimeEntries(
+    "start < :since AND duration >= 0 "
+    "AND (start >= :hot OR id IS NULL "
+    "OR ui_modified_at > 0 "
+    "OR deleted_at > 0)");
+const std::string kTimeEntryPage("start >= :from AND start < :to");
+
+const std::string kTimeEntryStartsBeforeSQL(
+    "SELECT id, start FROM time_entries "
+    "WHERE uid = :uid AND id NOT NULL AND start < :before");
+const std::string kLatestTimeEntryStartBeforeSQL(
+    "SELECT start FROM time_entries "
+    "WHERE uid = :uid AND start < :before "
+    "ORDER BY start DESC LIMIT 1");
+const std::string kTimelineEventsSQL(
+    "SELECT local_id, title, filename, "
+    "start_time, end_time, idle, "
+    "uploaded, chunked, guid, uid "
+    "FROM timeline_events "
+    "WHERE uid = :uid");
+const std::string kDeleteSyncedTimelineEventsSQL(
+    "delete from timeline_events where local_id in ("
+    "select local_id from timeline_events where "
+    "uploaded = 1 AND end_time < :end_time limit :max_rows)");
+
+std::vector<std::string> Database::HotStatements() {
+    return {
+        timeEntriesSQL(kRecentTimeEntries),
+        timeEntriesSQL(kOlderUnsyncedOrHotTimeEntries),
+        timeEntriesSQL(kOlderTimeEntries),
+        timeEntriesSQL(kTimeEntryPage),
+        timeEntriesSQL(""),
+        kTimeEntryStartsBeforeSQL,
+        kLatestTimeEntryStartBeforeSQL,
+        kTimelineEventsSQL,
+        deleteSyncedByDateSQL("time_entries"),
+        kDeleteSyncedTimelineEventsSQL
+    };
+}
+
+std::string Database::timeEntriesSQL(const std::string &range) {
+    std::string sql(
+        "SELECT local_id, id, uid, description, wid, guid, pid, "
+        "tid, billable, duronly, ui_modified_at, start, stop, "
+        "duration, tags, created_with, deleted_at, updated_at, "
+        "project_guid, validation_error, "
+        "previous_pid, previous_project_guid, previous_tid, previous_billable, previous_start, previous_stop, previous_duration, previous_description, previous_created_with, previous_tags "
+        "FROM time_entries "
+        "WHERE uid = :uid ");
+    if (!range.empty()) {
+        sql += "AND (" + range + ") ";
+    }
+    sql += "ORDER BY start DESC";
+    return sql;
+}
+
+std::string Database::deleteSyncedByDateSQL(const std::string &table_name) {
+    return "delete from " + table_name + " where local_id in ("
+           "select local_id from " + table_name + " where "
+           "id NOT NULL and stop < :stop limit :max_rows)";
+}
+
 Database::Database(const std::string &db_path)
-    : session_(nullptr)
+    : db_path_(db_path)
+, session_(nullptr)
+, last_insert_rowid_(0)
+, insert_time_entry_(nullptr)
+, update_time_entry_(nullptr)
+, insert_timeline_event_(nullptr)
+, update_timeline_event_(nullptr)
+, select_last_insert_rowid_(nullptr)
 , desktop_id_("")
 , analytics_client_id_("") {
     Poco::Data::SQLite::Connector::registerConnector();
@@ -81,37 +154,7 @@ Database::Database(const std::string &db_path)
         return;
     }
 
-    // Remove Time Entries older than 30 days from local db
-    Poco::LocalDateTime today;
-
-    Poco::LocalDateTime start =
-        today - Poco::Timespan(30 * Poco::Timespan::DAYS);
-
-    err = deleteAllFromTableByDate(
-        "time_entries", start.timestamp());
-
-    if (err != noError) {
-        logger.error("failed to clean Up Time Entries Data: " + err);
-        // but will continue, its not vital
-    }
-
-    // Remove Synced Timeline Events older than 9 days from local db
-    Poco::LocalDateTime timeline_start =
-        today - Poco::Timespan(9 * Poco::Timespan::DAYS);
-
-    err = deleteAllSyncedTimelineEventsByDate(
-        timeline_start.timestamp());
-
-    if (err != noError) {
-        logger.error("failed to clean Up Timeline Events Data: " + err);
-        // but will continue, its not vital
-    }
-
-    err = vacuum();
-    if (err != noError) {
-        logger.error("failed to vacuum: " + err);
-        // but will continue, its not vital
-    }
+    // Old data is cleaned up by Maintain(), after the app has started
 
     Poco::Stopwatch stopwatch;
     stopwatch.start();
@@ -129,6 +172,7 @@ Database::Database(const std::string &db_path)
 }
 
 Database::~Database() {
+    clearStatements();
     if (session_) {
         delete session_;
         session_ = nullptr;
@@ -221,12 +265,16 @@ error Database::deleteAllFromTableByUID(
 
 error Database::deleteAllFromTableByDate(
     const std::string &table_name,
-    const Poco::Timestamp &time) {
+    const Poco::Timestamp &time,
+    const Poco::Int64 max_rows,
+    Poco::Int64 *deleted) {
 
     if (table_name.empty()) {
         return error("Cannot delete from table without table name");
     }
 
+    poco_check_ptr(deleted);
+
     const Poco::Int64 stopTime = time.epochTime();
 
     try {
@@ -235,9 +283,18 @@ error Database::deleteAllFromTableByDate(
         poco_check_ptr(session_);
 
         *session_ <<
-                  "delete from " + table_name + " where "
-                  "id NOT NULL and stop < :stop",
+                  deleteSyncedByDateSQL(table_name),
                   useRef(stopTime),
+                  useRef(max_rows),
+                  now;
+        error err = last_error("deleteAllFromTableByDate");
+        if (err != noError) {
+            return err;
+        }
+
+        *session_ <<
+                  "select changes()",
+                  into(*deleted),
                   now;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -250,7 +307,12 @@ error Database::deleteAllFromTableByDate(
 }
 
 error Database::deleteAllSyncedTimelineEventsByDate(
-    const Poco::Timestamp &time) {
+    const Poco::Timestamp &time,
+    const Poco::Int64 max_rows,
+    Poco::Int64 *deleted) {
+
+    poco_check_ptr(deleted);
+
     const Poco::Int64 endTime = time.epochTime();
 
     try {
@@ -259,9 +321,18 @@ error Database::deleteAllSyncedTimelineEventsByDate(
         poco_check_ptr(session_);
 
         *session_ <<
-                  "delete from timeline_events where "
-                  "uploaded = 1 AND end_time < :end_time",
+                  kDeleteSyncedTimelineEventsSQL,
                   useRef(endTime),
+                  useRef(max_rows),
+                  now;
+        error err = last_error("deleteAllSyncedTimelineEventsByDate");
+        if (err != noError) {
+            return err;
+        }
+
+        *session_ <<
+                  "select changes()",
+                  into(*deleted),
                   now;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -273,17 +344,146 @@ error Database::deleteAllSyncedTimelineEventsByDate(
     return last_error("deleteAllSyncedTimelineEventsByDate");
 }
 
+error Database::PurgeOldSyncedData() {
+    // Entries loaded from the API with load more stay until the
+    // next start, so evicted pages can be read back from here
+    Poco::LocalDateTime today;
+    Poco::LocalDateTime time_entries_until =
+        today - Poco::Timespan(kTimeEntryRetentionDays * Poco::Timespan::DAYS);
+    Poco::LocalDateTime timeline_until =
+        today - Poco::Timespan(kTimelineEventRetentionDays * Poco::Timespan::DAYS);
+
+    // Small chunks, so queries from other threads aren't held up for long
+    const Poco::Int64 chunk_rows = 500;
+    Poco::Int64 deleted(0);
+    do {
+        error err = deleteAllFromTableByDate(
+            "time_entries", time_entries_until.timestamp(),
+            chunk_rows, &deleted);
+        if (err != noError) {
+            return err;
+        }
+    } while (deleted);
+
+    do {
+        error err = deleteAllSyncedTimelineEventsByDate(
+            timeline_until.timestamp(), chunk_rows, &deleted);
+        if (err != noError) {
+            return err;
+        }
+    } while (deleted);
+
+    return noError;
+}
+
+error Database::IncrementalVacuumEnabled(bool *enabled) {
+    poco_check_ptr(enabled);
+
+    // The setting is cached per connection until it next reads the
+    // database, which it may not have done since another connection
+    // switched it
+    Poco::Int64 schema_version(0);
+    error err = pragma("schema_version", &schema_version);
+    if (err != noError) {
+        return err;
+    }
+    Poco::Int64 auto_vacuum(0);
+    err = pragma("auto_vacuum", &auto_vacuum);
+    // 2 stands for INCREMENTAL
+    *enabled = 2 == auto_vacuum;
+    return err;
+}
+
+error Database::SwitchToIncrementalVacuum(
+    const std::string &db_path,
+    bool *switched) {
+
+    poco_check_ptr(switched);
+
+    *switched = false;
 
-error Database::journalMode(std::string *mode) {
+    try {
+        Poco::Data::Session session("SQLite", db_path);
+
+        Poco::Int64 auto_vacuum(0);
+        session << "PRAGMA auto_vacuum", into(auto_vacuum), now;
+        // 2 stands for INCREMENTAL
+        if (2 == auto_vacuum) {
+            return noError;
+        }
+        session << "PRAGMA auto_vacuum=INCREMENTAL", now;
+        session << "VACUUM", now;
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+    *switched = true;
+    return noError;
+}
+
+error Database::Maintain(
+    const Poco::Timespan &budget,
+    bool *finished) {
+
+    poco_check_ptr(finished);
+
+    *finished = false;
+
+    Poco::Timestamp started;
+    auto over_budget = [&]() {
+        return started.isElapsed(budget.totalMicroseconds());
+    };
+
+    error err = noError;
+
+    const Poco::Int64 chunk_pages = 256;
+    Poco::Int64 free_pages(0);
+    Poco::Int64 previous_free_pages(std::numeric_limits<Poco::Int64>::max());
+    while (true) {
+        err = pragma("freelist_count", &free_pages);
+        if (err != noError) {
+            return err;
+        }
+        // Stop if vacuuming doesn't get anywhere, rather than retrying
+        if (!free_pages || free_pages >= previous_free_pages) {
+            break;
+        }
+        previous_free_pages = free_pages;
+        std::stringstream ss;
+        ss << "PRAGMA incremental_vacuum(" << chunk_pages << ")";
+        err = execute(ss.str());
+        if (err != noError) {
+            return err;
+        }
+        if (over_budget()) {
+            return noError;
+        }
+    }
+
+    // The deletes went to the WAL, move them into the database
+    // without waiting for other connections
+    err = walCheckpoint();
+    if (err != noError) {
+        return err;
+    }
+
+    *finished = true;
+    return noError;
+}
+
+error Database::pragma(const std::string &name, Poco::Int64 *value) {
     try {
         Poco::Mutex::ScopedLock lock(session_m_);
 
         poco_check_ptr(session_);
-        poco_check_ptr(mode);
+        poco_check_ptr(value);
 
         *session_ <<
-                  "PRAGMA journal_mode",
-                  into(*mode),
+                  "PRAGMA " + name,
+                  into(*value),
                   now;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -292,21 +492,49 @@ error Database::journalMode(std::string *mode) {
     } catch(const std::string & ex) {
         return ex;
     }
-    return last_error("journalMode");
+    return last_error("pragma");
 }
 
-error Database::setJournalMode(const std::string &mode) {
-    if (mode.empty()) {
-        return error("Cannot set journal mode without a mode");
+error Database::walCheckpoint() {
+    try {
+        Poco::Mutex::ScopedLock lock(session_m_);
+
+        poco_check_ptr(session_);
+
+        Poco::Int64 busy(0);
+        Poco::Int64 log_pages(0);
+        Poco::Int64 checkpointed_pages(0);
+        *session_ <<
+                  "PRAGMA wal_checkpoint(PASSIVE)",
+                  into(busy),
+                  into(log_pages),
+                  into(checkpointed_pages),
+                  now;
+
+        logger.debug("WAL checkpoint busy=", busy,
+                     " log=", log_pages,
+                     " checkpointed=", checkpointed_pages);
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
     }
+    return last_error("walCheckpoint");
+}
 
 
+error Database::journalMode(std::string *mode) {
     try {
         Poco::Mutex::ScopedLock lock(session_m_);
+
         poco_check_ptr(session_);
+        poco_check_ptr(mode);
 
         *session_ <<
-                  "PRAGMA journal_mode=" << mode,
+                  "PRAGMA journal_mode",
+                  into(*mode),
                   now;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -315,16 +543,22 @@ error Database::setJournalMode(const std::string &mode) {
     } catch(const std::string & ex) {
         return ex;
     }
-    return last_error("setJournalMode");
+    return last_error("journalMode");
 }
 
-error Database::vacuum() {
+error Database::setJournalMode(const std::string &mode) {
+    if (mode.empty()) {
+        return error("Cannot set journal mode without a mode");
+    }
+
+
     try {
         Poco::Mutex::ScopedLock lock(session_m_);
         poco_check_ptr(session_);
 
         *session_ <<
-                  "VACUUM;" << now;
+                  "PRAGMA journal_mode=" << mode,
+                  now;
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
     } catch(const std::exception& ex) {
@@ -332,7 +566,7 @@ error Database::vacuum() {
     } catch(const std::string & ex) {
         return ex;
     }
-    return last_error("vacuum");
+    return last_error("setJournalMode");
 }
 
 error Database::DeleteFromTable(
@@ -387,9 +621,21 @@ std::string Database::GenerateGUID() {
 }
 
 error Database::LoadCurrentUser(User *user) {
+    return loadCurrentUser(user, 0);
+}
+
+error Database::LoadCurrentUserStaged(
+    User *user,
+    const Poco::Int64 recent_since) {
+    return loadCurrentUser(user, recent_since);
+}
+
+error Database::loadCurrentUser(
+    User *user,
+    const Poco::Int64 recent_since) {
     poco_check_ptr(user);
 
-    logger.debug("LoadCurrentUser");
+    logger.debug("LoadCurrentUser recent_since=", recent_since);
 
     std::string api_token("");
     Poco::UInt64 uid(0);
@@ -404,7 +650,7 @@ error Database::LoadCurrentUser(User *user) {
         return noError;
     }
     user->SetAPIToken(api_token);
-    return LoadUserByID(uid, user);
+    return loadUserByID(uid, user, recent_since);
 }
 
 error Database::LoadSettings(Settings *settings) {
@@ -1104,7 +1350,9 @@ error Database::LoadUserByEmail(
     return LoadUserByID(uid, model);
 }
 
-error Database::loadUsersRelatedData(User *user) {
+error Database::loadUsersRelatedData(
+    User *user,
+    const Poco::Int64 recent_since) {
     error err = loadWorkspaces(user->ID(), &user->related.Workspaces);
     if (err != noError) {
         return err;
@@ -1130,7 +1378,18 @@ error Database::loadUsersRelatedData(User *user) {
         return err;
     }
 
-    err = loadTimeEntries(user->ID(), &user->related.TimeEntries);
+    {
+        Poco::Mutex::ScopedLock lock(session_m_);
+        if (recent_since) {
+            err = loadTimeEntries(session_, user->ID(),
+                                  kRecentTimeEntries,
+                                  { recent_since },
+                                  &user->related.TimeEntries);
+        } else {
+            err = loadTimeEntries(session_, user->ID(), "", {},
+                                  &user->related.TimeEntries);
+        }
+    }
     if (err != noError) {
         return err;
     }
@@ -1140,17 +1399,30 @@ error Database::loadUsersRelatedData(User *user) {
         return err;
     }
 
-    err = loadTimelineEvents(user->ID(), &user->related.TimelineEvents);
-    if (err != noError) {
-        return err;
+    if (!recent_since) {
+        Poco::Mutex::ScopedLock lock(session_m_);
+        err = loadTimelineEvents(session_, user->ID(),
+                                 &user->related.TimelineEvents);
+        if (err != noError) {
+            return err;
+        }
     }
 
+    user->related.RebuildIndexes();
+
     return noError;
 }
 
 error Database::LoadUserByID(
     const Poco::UInt64 &UID,
     User *user) {
+    return loadUserByID(UID, user, 0);
+}
+
+error Database::loadUserByID(
+    const Poco::UInt64 &UID,
+    User *user,
+    const Poco::Int64 recent_since) {
 
     if (!UID) {
         return error("Cannot load user by ID without an ID");
@@ -1179,12 +1451,14 @@ error Database::LoadUserByID(
         Poco::UInt64 default_pid(0);
         Poco::UInt64 default_tid(0);
         bool collapse_entries(false);
+        Poco::Int64 full_synced_at(0);
         *session_ <<
                   "select local_id, id, default_wid, since, "
                   "fullname, "
                   "email, record_timeline, "
                   "timeofday_format, duration_format, offline_data, "
-                  "default_pid, default_tid, collapse_entries "
+                  "default_pid, default_tid, collapse_entries, "
+                  "full_synced_at "
                   "from users where id = :id limit 1",
                   into(local_id),
                   into(id),
@@ -1199,6 +1473,7 @@ error Database::LoadUserByID(
                   into(default_pid),
                   into(default_tid),
                   into(collapse_entries),
+                  into(full_synced_at),
                   useRef(UID),
                   limit(1),
                   now;
@@ -1226,6 +1501,7 @@ error Database::LoadUserByID(
         user->SetDefaultPID(default_pid);
         user->SetDefaultTID(default_tid);
         user->SetCollapseEntries(collapse_entries);
+        user->SetFullSyncedAt(full_synced_at);
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
     } catch(const std::exception& ex) {
@@ -1233,7 +1509,7 @@ error Database::LoadUserByID(
     } catch(const std::string & ex) {
         return ex;
     }
-    error err = loadUsersRelatedData(user);
+    error err = loadUsersRelatedData(user, recent_since);
     if (err != noError) {
         return err;
     }
@@ -1244,6 +1520,180 @@ error Database::LoadUserByID(
     return noError;
 }
 
+error Database::LoadDeferredUserData(
+    const Poco::UInt64 &UID,
+    const Poco::Int64 recent_since,
+    const Poco::Int64 hot_since,
+    std::vector<TimeEntry *> *time_entries,
+    std::vector<TimelineEvent *> *timeline_events,
+    const std::function<bool()> &cancelled) {
+
+    if (!UID) {
+        return error("Cannot load user data without an user ID");
+    }
+
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+
+    try {
+        poco_check_ptr(time_entries);
+        poco_check_ptr(timeline_events);
+
+        Poco::Data::Session session("SQLite", db_path_);
+        session << "PRAGMA query_only = ON", now;
+
+        error err = noError;
+        if (hot_since) {
+            // Unpushed changes stay in memory until they're synced
+            err = loadTimeEntries(&session, UID,
+                                  kOlderUnsyncedOrHotTimeEntries,
+                                  { recent_since, hot_since },
+                                  time_entries,
+                                  cancelled);
+        } else {
+            err = loadTimeEntries(&session, UID,
+                                  kOlderTimeEntries,
+                                  { recent_since },
+                                  time_entries,
+                                  cancelled);
+        }
+        if (err != noError) {
+            return err;
+        }
+
+        err = loadTimelineEvents(&session, UID, timeline_events, cancelled);
+        if (err != noError) {
+            return err;
+        }
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+
+    stopwatch.stop();
+    logger.debug("Deferred user data loaded in ",
+                 stopwatch.elapsed() / 1000, " ms");
+
+    return noError;
+}
+
+error Database::LoadTimeEntryPage(
+    const Poco::UInt64 &UID,
+    const Poco::Int64 from,
+    const Poco::Int64 to,
+    std::vector<TimeEntry *> *list) {
+
+    Poco::Mutex::ScopedLock lock(session_m_);
+    return loadTimeEntries(session_, UID,
+                           kTimeEntryPage,
+                           { from, to },
+                           list);
+}
+
+error Database::TimeEntryStartsBefore(
+    const Poco::UInt64 &UID,
+    const Poco::Int64 before,
+    std::map<Poco::UInt64, Poco::Int64> *starts) {
+
+    try {
+        Poco::Mutex::ScopedLock lock(session_m_);
+
+        poco_check_ptr(session_);
+        poco_check_ptr(starts);
+
+        starts->clear();
+
+        std::vector<Poco::UInt64> ids;
+        std::vector<Poco::Int64> times;
+        *session_ << kTimeEntryStartsBeforeSQL,
+                  into(ids),
+                  into(times),
+                  useRef(UID),
+                  useRef(before),
+                  now;
+        for (size_t i = 0; i < ids.size() && i < times.size(); i++) {
+            (*starts)[ids[i]] = times[i];
+        }
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+    return last_error("TimeEntryStartsBefore");
+}
+
+error Database::LatestTimeEntryStartBefore(
+    const Poco::UInt64 &UID,
+    const Poco::Int64 before,
+    Poco::Int64 *start,
+    bool *found) {
+
+    try {
+        Poco::Mutex::ScopedLock lock(session_m_);
+
+        poco_check_ptr(session_);
+        poco_check_ptr(start);
+        poco_check_ptr(found);
+
+        std::vector<Poco::Int64> starts;
+        *session_ << kLatestTimeEntryStartBeforeSQL,
+                  into(starts),
+                  useRef(UID),
+                  useRef(before),
+                  now;
+        *found = !starts.empty();
+        *start = *found ? starts.front() : 0;
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+    return last_error("LatestTimeEntryStartBefore");
+}
+
+template <class Row, class Model>
+error Database::loadRows(
+    Poco::Data::Statement *select,
+    std::vector<Model *> *list,
+    const std::function<bool()> &cancelled) {
+
+    poco_check_ptr(select);
+    poco_check_ptr(list);
+
+    try {
+        std::vector<Row> rows;
+        *select, into(rows), limit(kDatabaseLoadBatchRows);
+        while (!select->done()) {
+            if (cancelled && cancelled()) {
+                return error("Loading was cancelled");
+            }
+            select->execute();
+            list->reserve(list->size() + rows.size());
+            for (auto it = rows.begin(); it != rows.end(); ++it) {
+                Model *model = new Model();
+                it->Load(model);
+                model->ClearDirty();
+                list->push_back(model);
+            }
+            rows.clear();
+        }
+    } catch(const Poco::Exception& exc) {
+        return exc.displayText();
+    } catch(const std::exception& ex) {
+        return ex.what();
+    } catch(const std::string & ex) {
+        return ex;
+    }
+    return noError;
+}
+
 error Database::loadWorkspaces(
     const Poco::UInt64 &UID,
     std::vector<Workspace *> *list) {
@@ -1399,52 +1849,9 @@ error Database::loadProjects(
         if (err != noError) {
             return err;
         }
-        Poco::Data::RecordSet rs(select);
-        while (!select.done()) {
-            select.execute();
-            bool more = rs.moveFirst();
-            while (more) {
-                Project *model = new Project();
-                model->SetLocalID(rs[0].convert<Poco::Int64>());
-                if (rs[1].isEmpty()) {
-                    model->SetID(0);
-                } else {
-                    model->SetID(rs[1].convert<Poco::UInt64>());
-                }
-                model->SetUID(rs[2].convert<Poco::UInt64>());
-                model->SetName(rs[3].convert<std::string>());
-                if (rs[4].isEmpty()) {
-                    model->SetGUID("");
-                } else {
-                    model->SetGUID(rs[4].convert<std::string>());
-                }
-                model->SetWID(rs[5].convert<Poco::UInt64>());
-                if (rs[6].isEmpty()) {
-                    model->SetColor("");
-                } else {
-                    model->SetColor(rs[6].convert<std::string>());
-                }
-                if (rs[7].isEmpty()) {
-                    model->SetCID(0);
-                } else {
-                    model->SetCID(rs[7].convert<Poco::UInt64>());
-                }
-                model->SetActive(rs[8].convert<bool>());
-                model->SetBillable(rs[9].convert<bool>());
-                if (rs[10].isEmpty()) {
-                    model->SetClientGUID("");
-                } else {
-                    model->SetClientGUID(rs[10].convert<std::string>());
-                }
-                if (rs[11].isEmpty()) {
-                    model->SetClientName("");
-                } else {
-                    model->SetClientName(rs[11].convert<std::string>());
-                }
-                model->ClearDirty();
-                list->push_back(model);
-                more = rs.moveNext();
-            }
+        err = loadRows<ProjectRow>(&select, list);
+        if (err != noError) {
+            return err;
         }
     } catch(const Poco::Exception& exc) {
         return exc.displayText();
@@ -1634,63 +2041,28 @@ error Database::loadAutotrackerRules(
 }
 
 error Database::loadTimelineEvents(
+    Poco::Data::Session *session,
     const Poco::UInt64 &UID,
-    std::vector<TimelineEvent *> *list) {
+    std::vector<TimelineEvent *> *list,
+    const std::function<bool()> &cancelled) {
 
     if (!UID) {
         return error("Cannot load user timeline without an user ID");
     }
 
     try {
+        poco_check_ptr(session);
         poco_check_ptr(list);
 
         list->clear();
 
-        Poco::Mutex::ScopedLock lock(session_m_);
-
-        Poco::Data::Statement select(*session_);
-        select <<
-               "SELECT local_id, title, filename, "
-               "start_time, end_time, idle, "
-               "uploaded, chunked, guid "
-               "FROM timeline_events "
-               "WHERE uid = :uid",
+        Poco::Data::Statement select(*session);
+        select << kTimelineEventsSQL,
                useRef(UID);
-        error err = last_error("loadTimelineEvents");
+        error err = loadRows<TimelineEventRow>(&select, list, cancelled);
         if (err != noError) {
             return err;
         }
-        Poco::Data::RecordSet rs(select);
-        while (!select.done()) {
-            select.execute();
-            bool more = rs.moveFirst();
-            while (more) {
-                TimelineEvent *model = new TimelineEvent();
-                model->SetLocalID(rs[0].convert<unsigned int>());
-                if (!rs[1].isEmpty()) {
-                    model->SetTitle(rs[1].convert<std::string>());
-                }
-                if (!rs[2].isEmpty()) {
-                    model->SetFilename(rs[2].convert<std::string>());
-                }
-                model->SetStartTime(rs[3].convert<int>());
-                if (!rs[4].isEmpty()) {
-                    model->SetEndTime(rs[4].convert<int>());
-                }
-                model->SetIdle(rs[5].convert<bool>());
-                model->SetUploaded(rs[6].convert<bool>());
-                model->SetChunked(rs[7].convert<bool>());
-                model->SetGUID(rs[8].convert<std::string>());
-
-                model->SetUID(UID);
-
-                model->ClearDirty();
-
-                list->push_back(model);
-
-                more = rs.moveNext();
-            }
-        }
 
         // Ensure all timeline events have a GUID.
         for (std::vector<TimelineEvent *>::iterator it = list->begin();
@@ -1710,36 +2082,29 @@ error Database::loadTimelineEvents(
 }
 
 error Database::loadTimeEntries(
+    Poco::Data::Session *session,
     const Poco::UInt64 &UID,
-    std::vector<TimeEntry *> *list) {
+    const std::string &range,
+    const std::vector<Poco::Int64> &bounds,
+    std::vector<TimeEntry *> *list,
+    const std::function<bool()> &cancelled) {
 
     if (!UID) {
         return error("Cannot load user time entries without an user ID");
     }
 
     try {
+        poco_check_ptr(session);
         poco_check_ptr(list);
 
         list->clear();
 
-        Poco::Mutex::ScopedLock lock(session_m_);
-
-        Poco::Data::Statement select(*session_);
-        select <<
-               "SELECT local_id, id, uid, description, wid, guid, pid, "
-               "tid, billable, duronly, ui_modified_at, start, stop, "
-               "duration, tags, created_with, deleted_at, updated_at, "
-               "project_guid, validation_error, "
-               "previous_pid, previous_project_guid, previous_tid, previous_billable, previous_start, previous_stop, previous_duration, previous_description, previous_created_with, previous_tags "
-               "FROM time_entries "
-               "WHERE uid = :uid "
-               "ORDER BY start DESC",
-               useRef(UID);
-        error err = last_error("loadTimeEntries");
-        if (err != noError) {
-            return err;
+        Poco::Data::Statement select(*session);
+        select << timeEntriesSQL(range), useRef(UID);
+        for (const Poco::Int64 &bound : bounds) {
+            select.addBind(useRef(bound));
         }
-        err = loadTimeEntriesFromSQLStatement(&select, list);
+        error err = loadRows<TimeEntryRow>(&select, list, cancelled);
         if (err != noError) {
             return err;
         }
@@ -1764,163 +2129,44 @@ error Database::loadTimeEntries(
     return noError;
 }
 
-error Database::loadTimeEntriesFromSQLStatement(
-    Poco::Data::Statement *select,
-    std::vector<TimeEntry *> *list) {
+template <typename T>
+error Database::saveRelatedModels(
+    const Poco::UInt64 UID,
+    const std::string &table_name,
+    std::vector<T *> *list,
+    std::vector<ModelChange> *changes) {
 
-    poco_check_ptr(select);
     poco_check_ptr(list);
 
-    try {
-        Poco::Data::RecordSet rs(*select);
-        while (!select->done()) {
-            select->execute();
-            bool more = rs.moveFirst();
-            while (more) {
-                TimeEntry *model = new TimeEntry();
-
-                // "Current" values - the ones that are actually displayed in the UI
-                model->SetLocalID(rs[0].convert<Poco::Int64>());
-                if (rs[1].isEmpty()) {
-                    model->SetID(0);
-                } else {
-                    model->SetID(rs[1].convert<Poco::UInt64>());
-                }
-                model->SetUID(rs[2].convert<Poco::UInt64>());
-                if (rs[3].isEmpty()) {
-                    model->Description.SetCurrent("");
-                } else {
-                    model->Description.SetCurrent(rs[3].convert<std::string>());
-                }
-                model->SetWID(rs[4].convert<Poco::UInt64>());
-                model->SetGUID(rs[5].convert<std::string>());
-                if (rs[6].isEmpty()) {
-                    model->PID.SetCurrent(0);
-                } else {
-                    model->PID.SetCurrent(rs[6].convert<Poco::UInt64>());
-                }
-                if (rs[7].isEmpty()) {
-                    model->TID.SetCurrent(0);
-                } else {
-                    model->TID.SetCurrent(rs[7].convert<Poco::UInt64>());
-                }
-                model->Billable.SetCurrent(rs[8].convert<bool>());
-                model->SetDurOnly(rs[9].convert<bool>());
-                if (rs[10].isEmpty()) {
-                    model->SetUIModifiedAt(0);
-                } else {
-                    model->SetUIModifiedAt(rs[10].convert<Poco::Int64>());
-                }
-                model->StartTime.SetCurrent(rs[11].convert<Poco::Int64>());
-                if (rs[12].isEmpty()) {
-                    model->StopTime.SetCurrent(0);
-                } else {
-                    model->StopTime.SetCurrent(rs[12].convert<Poco::Int64>());
-                }
-                model->DurationInSeconds.SetCurrent(rs[13].convert<Poco::Int64>());
-                if (rs[14].isEmpty()) {
-                    model->TagNames.SetCurrent({});
-                } else {
-                    model->TagNames.SetCurrent(TimeEntry::TagsStringToVector(rs[14].convert<std::string>()));
-                }
-                if (rs[15].isEmpty()) {
-                    model->CreatedWith.SetCurrent("");
-                } else {
-                    model->CreatedWith.SetCurrent(rs[15].convert<std::string>());
-                }
-                if (rs[16].isEmpty()) {
-                    model->SetDeletedAt(0);
-                } else {
-                    model->SetDeletedAt(rs[16].convert<Poco::Int64>());
-                }
-                if (rs[17].isEmpty()) {
-                    model->SetUpdatedAt(0);
-                } else {
-                    model->SetUpdatedAt(rs[17].convert<Poco::Int64>());
-                }
-                if (rs[18].isEmpty()) {
-                    model->ProjectGUID.SetCurrent("");
-                } else {
-                    model->ProjectGUID.SetCurrent(rs[18].convert<std::string>());
-                }
-                if (rs[19].isEmpty()) {
-                    model->SetValidationError("");
-                } else {
-                    model->SetValidationError(rs[19].convert<std::string>());
-                }
+    // Copy, as saving purges deleted models from the list
+    std::vector<T *> models(*list);
+    return saveModels(UID, table_name, models, list, changes);
+}
 
-                // "Previous" values - used to track what the user has changed between server sync cycles
-                if (rs[20].isEmpty()) {
-                    model->PID.SetPrevious(0);
-                } else {
-                    model->PID.SetPrevious(rs[20].convert<Poco::UInt64>());
-                }
-                if (rs[21].isEmpty()) {
-                    model->ProjectGUID.SetPrevious("");
-                } else {
-                    model->ProjectGUID.SetPrevious(rs[21].convert<std::string>());
-                }
-                if (rs[22].isEmpty()) {
-                    model->TID.SetPrevious(0);
-                } else {
-                    model->TID.SetPrevious(rs[22].convert<Poco::UInt64>());
-                }
-                if (rs[23].isEmpty()) {
-                    model->Billable.SetPrevious(false);
-                } else {
-                    model->Billable.SetPrevious(rs[23].convert<bool>());
-                }
-                if (rs[24].isEmpty()) {
-                    model->StartTime.SetPrevious(0);
-                } else {
-                    model->StartTime.SetPrevious(rs[24].convert<Poco::Int64>());
-                }
-                if (rs[25].isEmpty()) {
-                    model->StopTime.SetPrevious(0);
-                } else {
-                    model->StopTime.SetPrevious(rs[25].convert<Poco::Int64>());
-                }
-                if (rs[26].isEmpty()) {
-                    model->DurationInSeconds.SetPrevious(0);
-                } else {
-                    model->DurationInSeconds.SetPrevious(rs[26].convert<Poco::Int64>());
-                }
-                if (rs[27].isEmpty()) {
-                    model->Description.SetPrevious("");
-                } else {
-                    model->Description.SetPrevious(rs[27].convert<std::string>());
-                }
-                if (rs[28].isEmpty()) {
-                    model->CreatedWith.SetPrevious("");
-                } else {
-                    model->CreatedWith.SetPrevious(rs[28].convert<std::string>());
-                }
-                if (rs[29].isEmpty()) {
-                    model->TagNames.SetPrevious({});
-                } else {
-                    model->TagNames.SetPrevious(TimeEntry::TagsStringToVector(rs[29].convert<std::string>()));
-                }
+template <typename T>
+error Database::saveDirtyRelatedModels(
+    const Poco::UInt64 UID,
+    const std::string &table_name,
+    const RelatedData &related,
+    std::vector<T *> *list,
+    std::vector<ModelChange> *changes) {
 
-                model->ClearDirty();
+    poco_check_ptr(list);
 
-                list->push_back(model);
-                more = rs.moveNext();
-            }
-        }
-    } catch(const Poco::Exception& exc) {
-        return exc.displayText();
-    } catch(const std::exception& ex) {
-        return ex.what();
-    } catch(const std::string & ex) {
-        return ex;
+    error err = saveModels(
+        UID, table_name, related.DirtyModels(list), list, changes);
+    if (err != noError) {
+        return err;
     }
+    related.PruneDirtyModels(list);
     return noError;
 }
 
 template <typename T>
-error Database::saveRelatedModels(
+error Database::saveModels(
     const Poco::UInt64 UID,
     const std::string &table_name,
+    const std::vector<T *> &models,
     std::vector<T *> *list,
     std::vector<ModelChange> *changes) {
 
@@ -1933,8 +2179,9 @@ error Database::saveRelatedModels(
 
     typedef typename std::vector<T *>::iterator iterator;
 
-    for (size_t i = 0; i < list->size(); i++) {
-        T *model = list->at(i);
+    bool deleted(false);
+    for (size_t i = 0; i < models.size(); i++) {
+        T *model = models.at(i);
         if (model->IsMarkedAsDeletedOnServer()) {
             error err = DeleteFromTable(table_name, model->LocalID());
             if (err != noError) {
@@ -1945,6 +2192,7 @@ error Database::saveRelatedModels(
                 kChangeTypeDelete,
                 model->ID(),
                 model->GUID()));
+            deleted = true;
             continue;
         }
         model->SetUID(UID);
@@ -1954,11 +2202,16 @@ error Database::saveRelatedModels(
         }
     }
 
+    if (!deleted) {
+        return noError;
+    }
+
     // Purge deleted models from memory
     iterator it = list->begin();
     while (it != list->end()) {
         T *model = *it;
         if (model->IsMarkedAsDeletedOnServer()) {
+            model->Unindex();
             it = list->erase(it);
         } else {
             ++it;
@@ -1968,6 +2221,217 @@ error Database::saveRelatedModels(
     return noError;
 }
 
+void Database::prepareStatements() {
+    // Compiled once and re-executed with the rows rebound,
+    // so saving a batch doesn't re-parse the SQL for every model
+    if (!update_time_entry_) {
+        TimeEntryRow &r = time_entry_row_;
+        update_time_entry_ = new Poco::Data::Statement(*session_);
+        *update_time_entry_ <<
+                            "update time_entries set "
+                            "id = nullif(:id, 0), uid = :uid, "
+                            "description = :description, wid = :wid, "
+                            "guid = :guid, pid = :pid, tid = :tid, "
+                            "billable = :billable, "
+                            "duronly = :duronly, "
+                            "ui_modified_at = :ui_modified_at, "
+                            "start = :start, stop = :stop, "
+                            "duration = :duration, "
+                            "tags = :tags, created_with = :created_with, "
+                            "deleted_at = :deleted_at, "
+                            "updated_at = :updated_at, "
+                            "project_guid = :project_guid, "
+                            "validation_error = :validation_error, "
+                            "previous_pid = :previous_pid, "
+                            "previous_project_guid = :previous_project_guid, "
+                            "previous_tid = :previous_tid, "
+                            "previous_billable = :previous_billable, "
+                            "previous_start = :previous_start, "
+                            "previous_stop = :previous_stop, "
+                            "previous_duration = :previous_duration, "
+                            "previous_description = :previous_description, "
+                            "previous_created_with = :previous_created_with, "
+                            "previous_tags = :previous_tags "
+                            "where local_id = :local_id",
+                            useRef(r.id),
+                            useRef(r.uid),
+                            useRef(r.description),
+                            useRef(r.wid),
+                            useRef(r.guid),
+                            useRef(r.pid),
+                            useRef(r.tid),
+                            useRef(r.billable),
+                            useRef(r.duronly),
+                            useRef(r.ui_modified_at),
+                            useRef(r.start),
+                            useRef(r.stop),
+                            useRef(r.duration),
+                            useRef(r.tags),
+                            useRef(r.created_with),
+                            useRef(r.deleted_at),
+                            useRef(r.updated_at),
+                            useRef(r.project_guid),
+                            useRef(r.validation_error),
+                            useRef(r.previous_pid),
+                            useRef(r.previous_project_guid),
+                            useRef(r.previous_tid),
+                            useRef(r.previous_billable),
+                            useRef(r.previous_start),
+                            useRef(r.previous_stop),
+                            useRef(r.previous_duration),
+                            useRef(r.previous_description),
+                            useRef(r.previous_created_with),
+                            useRef(r.previous_tags),
+                            useRef(r.local_id);
+    }
+    if (!insert_time_entry_) {
+        TimeEntryRow &r = time_entry_row_;
+        insert_time_entry_ = new Poco::Data::Statement(*session_);
+        *insert_time_entry_ <<
+                            "insert into time_entries(id, uid, description, "
+                            "wid, guid, pid, tid, billable, "
+                            "duronly, ui_modified_at, "
+                            "start, stop, duration, "
+                            "tags, created_with, deleted_at, updated_at, "
+                            "project_guid, validation_error, "
+                            "previous_pid, previous_project_guid, "
+                            "previous_tid, previous_billable, "
+                            "previous_start, previous_stop, "
+                            "previous_duration, previous_description, "
+                            "previous_created_with, previous_tags) "
+                            "values(nullif(:id, 0), :uid, :description, "
+                            ":wid, :guid, :pid, :tid, :billable, "
+                            ":duronly, :ui_modified_at, "
+                            ":start, :stop, :duration, "
+                            ":tags, :created_with, :deleted_at, "
+                            ":updated_at, "
+                            ":project_guid, :validation_error, "
+                            ":previous_pid, :previous_project_guid, "
+                            ":previous_tid, :previous_billable, "
+                            ":previous_start, :previous_stop, "
+                            ":previous_duration, :previous_description, "
+                            ":previous_created_with, :previous_tags)",
+                            useRef(r.id),
+                            useRef(r.uid),
+                            useRef(r.description),
+                            useRef(r.wid),
+                            useRef(r.guid),
+                            useRef(r.pid),
+                            useRef(r.tid),
+                            useRef(r.billable),
+                            useRef(r.duronly),
+                            useRef(r.ui_modified_at),
+                            useRef(r.start),
+                            useRef(r.stop),
+                            useRef(r.duration),
+                            useRef(r.tags),
+                            useRef(r.created_with),
+                            useRef(r.deleted_at),
+                            useRef(r.updated_at),
+                            useRef(r.project_guid),
+                            useRef(r.validation_error),
+                            useRef(r.previous_pid),
+                            useRef(r.previous_project_guid),
+                            useRef(r.previous_tid),
+                            useRef(r.previous_billable),
+                            useRef(r.previous_start),
+                            useRef(r.previous_stop),
+                            useRef(r.previous_duration),
+                            useRef(r.previous_description),
+                            useRef(r.previous_created_with),
+                            useRef(r.previous_tags);
+    }
+    if (!update_timeline_event_) {
+        TimelineEventRow &r = timeline_event_row_;
+        update_timeline_event_ = new Poco::Data::Statement(*session_);
+        *update_timeline_event_ <<
+                                "update timeline_events set "
+                                "guid = :guid, "
+                                "title = :title, "
+                                "filename = :filename, "
+                                "uid = :uid, "
+                                "start_time = :start_time, "
+                                "end_time = :end_time, "
+                                "idle = :idle, "
+                                "uploaded = :uploaded, "
+                                "chunked = :chunked "
+                                "where local_id = :local_id",
+                                useRef(r.guid),
+                                useRef(r.title),
+                                useRef(r.filename),
+                                useRef(r.uid),
+                                useRef(r.start_time),
+                                useRef(r.end_time),
+                                useRef(r.idle),
+                                useRef(r.uploaded),
+                                useRef(r.chunked),
+                                useRef(r.local_id);
+    }
+    if (!insert_timeline_event_) {
+        TimelineEventRow &r = timeline_event_row_;
+        insert_timeline_event_ = new Poco::Data::Statement(*session_);
+        *insert_timeline_event_ <<
+                                "insert into timeline_events("
+                                "guid, title, filename, uid, start_time, "
+                                "end_time, idle, uploaded, chunked"
+                                ") values ("
+                                ":guid, :title, :filename, :uid, "
+                                ":start_time, :end_time, :idle, "
+                                ":uploaded, :chunked"
+                                ")",
+                                useRef(r.guid),
+                                useRef(r.title),
+                                useRef(r.filename),
+                                useRef(r.uid),
+                                useRef(r.start_time),
+                                useRef(r.end_time),
+                                useRef(r.idle),
+                                useRef(r.uploaded),
+                                useRef(r.chunked);
+    }
+    if (!select_last_insert_rowid_) {
+        select_last_insert_rowid_ = new Poco::Data::Statement(*session_);
+        *select_last_insert_rowid_ <<
+                                   "select last_insert_rowid()",
+                                   into(last_insert_rowid_);
+    }
+}
+
+void Database::clearStatements() {
+    Poco::Mutex::ScopedLock lock(session_m_);
+
+    delete insert_time_entry_;
+    insert_time_entry_ = nullptr;
+    delete update_time_entry_;
+    update_time_entry_ = nullptr;
+    delete insert_timeline_event_;
+    insert_timeline_event_ = nullptr;
+    delete update_timeline_event_;
+    update_timeline_event_ = nullptr;
+    delete select_last_insert_rowid_;
+    select_last_insert_rowid_ = nullptr;
+}
+
+void Database::executeCached(Poco::Data::Statement *statement) {
+    poco_check_ptr(statement);
+    // A step failure throws; a successful run leaves the statement
+    // (and the connection's last result) at SQLITE_DONE until its
+    // next execute resets it, so last_error must not be read here.
+    statement->execute();
+}
+
+error Database::lastInsertRowID(
+    const std::string &was_doing,
+    Poco::Int64 *local_id) {
+
+    poco_check_ptr(local_id);
+
+    last_insert_rowid_ = 0;
+    executeCached(select_last_insert_rowid_);
+    *local_id = last_insert_rowid_;
+    return noError;
+}
+
 typedef toggl::error (Database::*saveModel)(
     BaseModel *model, std::vector<ModelChange> *changes);
 
@@ -1993,128 +2457,13 @@ error Database::saveModel(
         Poco::Mutex::ScopedLock lock(session_m_);
         poco_check_ptr(session_);
 
+        prepareStatements();
+        time_entry_row_.Fill(*model);
+
         if (model->LocalID()) {
             logger.debug("Updating time entry ", model->String(), " in thread ", Poco::Thread::currentTid());
 
-            if (model->ID()) {
-                *session_ <<
-                          "update time_entries set "
-                          "id = :id, uid = :uid, description = :description, "
-                          "wid = :wid, guid = :guid, pid = :pid, tid = :tid, "
-                          "billable = :billable, "
-                          "duronly = :duronly, "
-                          "ui_modified_at = :ui_modified_at, "
-                          "start = :start, stop = :stop, duration = :duration, "
-                          "tags = :tags, created_with = :created_with, "
-                          "deleted_at = :deleted_at, "
-                          "updated_at = :updated_at, "
-                          "project_guid = :project_guid, "
-                          "validation_error = :validation_error, "
-                          "previous_pid = :previous_pid, "
-                          "previous_project_guid = :previous_project_guid, "
-                          "previous_tid = :previous_tid, "
-                          "previous_billable = :previous_billable, "
-                          "previous_start = :previous_start, "
-                          "previous_stop = :previous_stop, "
-                          "previous_duration = :previous_duration, "
-                          "previous_description = :previous_description, "
-                          "previous_created_with = :previous_created_with, "
-                          "previous_tags = :previous_tags "
-                          "where local_id = :local_id",
-                          useRef(model->ID()),
-                          useRef(model->UID()),
-                          useRef(model->Description()),
-                          useRef(model->WID()),
-                          useRef(model->GUID()),
-                          useRef(model->PID()),
-                          useRef(model->TID()),
-                          useRef(model->Billable()),
-                          useRef(model->DurOnly()),
-                          useRef(model->UIModifiedAt()),
-                          useRef(model->StartTime()),
-                          useRef(model->StopTime()),
-                          useRef(model->DurationInSeconds()),
-                          bind(model->Tags()),
-                          useRef(model->CreatedWith()),
-                          useRef(model->DeletedAt()),
-                          useRef(model->UpdatedAt()),
-                          useRef(model->ProjectGUID()),
-                          useRef(model->ValidationError()),
-                          useRef(model->PID.GetPrevious()),
-                          useRef(model->ProjectGUID.GetPrevious()),
-                          useRef(model->TID.GetPrevious()),
-                          useRef(model->Billable.GetPrevious()),
-                          useRef(model->StartTime.GetPrevious()),
-                          useRef(model->StopTime.GetPrevious()),
-                          useRef(model->DurationInSeconds.GetPrevious()),
-                          useRef(model->Description.GetPrevious()),
-                          useRef(model->CreatedWith.GetPrevious()),
-                          bind(TimeEntry::TagsVectorToString(model->TagNames.GetPrevious())),
-                          useRef(model->LocalID()),
-                          now;
-            } else {
-                *session_ <<
-                          "update time_entries set "
-                          /* For cases where we need to remove the ID from the TE (like when changing the workspace) */
-                          "id = null, "
-                          /* Regular column updates */
-                          "uid = :uid, description = :description, wid = :wid, "
-                          "guid = :guid, pid = :pid, tid = :tid, "
-                          "billable = :billable, "
-                          "duronly = :duronly, "
-                          "ui_modified_at = :ui_modified_at, "
-                          "start = :start, stop = :stop, duration = :duration, "
-                          "tags = :tags, created_with = :created_with, "
-                          "deleted_at = :deleted_at, "
-                          "updated_at = :updated_at, "
-                          "project_guid = :project_guid, "
-                          "validation_error = :validation_error, "
-                          "previous_pid = :previous_pid, "
-                          "previous_project_guid = :previous_project_guid, "
-                          "previous_tid = :previous_tid, "
-                          "previous_billable = :previous_billable, "
-                          "previous_start = :previous_start, "
-                          "previous_stop = :previous_stop, "
-                          "previous_duration = :previous_duration, "
-                          "previous_description = :previous_description, "
-                          "previous_created_with = :previous_created_with, "
-                          "previous_tags = :previous_tags "
-                          "where local_id = :local_id",
-                          useRef(model->UID()),
-                          useRef(model->Description()),
-                          useRef(model->WID()),
-                          useRef(model->GUID()),
-                          useRef(model->PID()),
-                          useRef(model->TID()),
-                          useRef(model->Billable()),
-                          useRef(model->DurOnly()),
-                          useRef(model->UIModifiedAt()),
-                          useRef(model->StartTime()),
-                          useRef(model->StopTime()),
-                          useRef(model->DurationInSeconds()),
-                          bind(model->Tags()),
-                          useRef(model->CreatedWith()),
-                          useRef(model->DeletedAt()),
-                          useRef(model->UpdatedAt()),
-                          useRef(model->ProjectGUID()),
-                          useRef(model->ValidationError()),
-                          useRef(model->PID.GetPrevious()),
-                          useRef(model->ProjectGUID.GetPrevious()),
-                          useRef(model->TID.GetPrevious()),
-                          useRef(model->Billable.GetPrevious()),
-                          useRef(model->StartTime.GetPrevious()),
-                          useRef(model->StopTime.GetPrevious()),
-                          useRef(model->DurationInSeconds.GetPrevious()),
-                          useRef(model->Description.GetPrevious()),
-                          useRef(model->CreatedWith.GetPrevious()),
-                          bind(TimeEntry::TagsVectorToString(model->TagNames.GetPrevious())),
-                          useRef(model->LocalID()),
-                          now;
-            }
-            error err = last_error("saveTimeEntry");
-            if (err != noError) {
-                return err;
-            }
+            executeCached(update_time_entry_);
             if (model->DeletedAt()) {
                 changes->push_back(ModelChange(
                     model->ModelName(),
@@ -2130,112 +2479,10 @@ error Database::saveModel(
             }
         } else {
             logger.debug("Inserting time entry ", model->String(), " in thread ", Poco::Thread::currentTid());
-            if (model->ID()) {
-                *session_ <<
-                          "insert into time_entries(id, uid, description, "
-                          "wid, guid, pid, tid, billable, "
-                          "duronly, ui_modified_at, "
-                          "start, stop, duration, "
-                          "tags, created_with, deleted_at, updated_at, "
-                          "project_guid, validation_error, "
-                          "previous_pid, previous_project_guid, previous_tid, previous_billable, previous_start, previous_stop, previous_duration, previous_description, previous_created_with, previous_tags"
-                          ") values ("
-                          ":id, :uid, :description, :wid, "
-                          ":guid, :pid, :tid, :billable, "
-                          ":duronly, :ui_modified_at, "
-                          ":start, :stop, :duration, "
-                          ":tags, :created_with, :deleted_at, :updated_at, "
-                          ":project_guid, :validation_error, "
-                          ":previous_pid, :previous_project_guid, :previous_tid, :previous_billable, :previous_start, :previous_stop, :previous_duration, :previous_description, :previous_created_with, :previous_tags "
-                          ")",
-                          useRef(model->ID()),
-                          useRef(model->UID()),
-                          useRef(model->Description()),
-                          useRef(model->WID()),
-                          useRef(model->GUID()),
-                          useRef(model->PID()),
-                          useRef(model->TID()),
-                          useRef(model->Billable()),
-                          useRef(model->DurOnly()),
-                          useRef(model->UIModifiedAt()),
-                          useRef(model->StartTime()),
-                          useRef(model->StopTime()),
-                          useRef(model->DurationInSeconds()),
-                          bind(model->Tags()),
-                          useRef(model->CreatedWith()),
-                          useRef(model->DeletedAt()),
-                          useRef(model->UpdatedAt()),
-                          useRef(model->ProjectGUID()),
-                          useRef(model->ValidationError()),
-                          useRef(model->PID.GetPrevious()),
-                          useRef(model->ProjectGUID.GetPrevious()),
-                          useRef(model->TID.GetPrevious()),
-                          useRef(model->Billable.GetPrevious()),
-                          useRef(model->StartTime.GetPrevious()),
-                          useRef(model->StopTime.GetPrevious()),
-                          useRef(model->DurationInSeconds.GetPrevious()),
-                          useRef(model->Description.GetPrevious()),
-                          useRef(model->CreatedWith.GetPrevious()),
-                          bind(TimeEntry::TagsVectorToString(model->TagNames.GetPrevious())),
-                          now;
-            } else {
-                *session_ <<
-                          "insert into time_entries(uid, description, wid, "
-                          "guid, pid, tid, billable, "
-                          "duronly, ui_modified_at, "
-                          "start, stop, duration, "
-                          "tags, created_with, deleted_at, updated_at, "
-                          "project_guid, validation_error, "
-                          "previous_pid, previous_project_guid, previous_tid, previous_billable, previous_start, previous_stop, previous_duration, previous_description, previous_created_with, previous_tags"
-                          ") values ("
-                          ":uid, :description, :wid, "
-                          ":guid, :pid, :tid, :billable, "
-                          ":duronly, :ui_modified_at, "
-                          ":start, :stop, :duration, "
-                          ":tags, :created_with, :deleted_at, :updated_at, "
-                          ":project_guid, :validation_error, "
-                          ":previous_pid, :previous_project_guid, :previous_tid, :previous_billable, :previous_start, :previous_stop, :previous_duration, :previous_description, :previous_created_with, :previous_tags "
-                          ")",
-                          useRef(model->UID()),
-                          useRef(model->Description()),
-                          useRef(model->WID()),
-                          useRef(model->GUID()),
-                          useRef(model->PID()),
-                          useRef(model->TID()),
-                          useRef(model->Billable()),
-                          useRef(model->DurOnly()),
-                          useRef(model->UIModifiedAt()),
-                          useRef(model->StartTime()),
-                          useRef(model->StopTime()),
-                          useRef(model->DurationInSeconds()),
-                          bind(model->Tags()),
-                          useRef(model->CreatedWith()),
-                          useRef(model->DeletedAt()),
-                          useRef(model->UpdatedAt()),
-                          useRef(model->ProjectGUID()),
-                          useRef(model->ValidationError()),
-                          useRef(model->PID.GetPrevious()),
-                          useRef(model->ProjectGUID.GetPrevious()),
-                          useRef(model->TID.GetPrevious()),
-                          useRef(model->Billable.GetPrevious()),
-                          useRef(model->StartTime.GetPrevious()),
-                          useRef(model->StopTime.GetPrevious()),
-                          useRef(model->DurationInSeconds.GetPrevious()),
-                          useRef(model->Description.GetPrevious()),
-                          useRef(model->CreatedWith.GetPrevious()),
-                          bind(TimeEntry::TagsVectorToString(model->TagNames.GetPrevious())),
-                          now;
-            }
-            error err = last_error("saveTimeEntry");
-            if (err != noError) {
-                return err;
-            }
+
+            executeCached(insert_time_entry_);
             Poco::Int64 local_id(0);
-            *session_ <<
-                      "select last_insert_rowid()",
-                      into(local_id),
-                      now;
-            err = last_error("saveTimeEntry");
+            error err = lastInsertRowID("saveTimeEntry", &local_id);
             if (err != noError) {
                 return err;
             }
@@ -2278,12 +2525,13 @@ error Database::saveModel(
 
         const int kMaxTimelineStringSize = 300;
 
-        if (model->Filename().length() > kMaxTimelineStringSize) {
+        if (model->Filename().str().length() > kMaxTimelineStringSize) {
             model->SetFilename(
-                model->Filename().substr(0, kMaxTimelineStringSize));
+                model->Filename().str().substr(0, kMaxTimelineStringSize));
         }
-        if (model->Title().length() > kMaxTimelineStringSize) {
-            model->SetTitle(model->Title().substr(0, kMaxTimelineStringSize));
+        if (model->Title().str().length() > kMaxTimelineStringSize) {
+            model->SetTitle(
+                model->Title().str().substr(0, kMaxTimelineStringSize));
         }
 
         if (!model->UID()) {
@@ -2296,40 +2544,14 @@ error Database::saveModel(
             return error("Cannot save timeline event without end time");
         }
 
-        Poco::Int64 start_time(model->Start());
-        Poco::Int64 end_time(model->EndTime());
+        prepareStatements();
+        timeline_event_row_.Fill(*model);
 
         if (model->LocalID()) {
             logger.trace("Updating timeline event ", model->String(), " in thread ", Poco::Thread::currentTid());
 
-            *session_ <<
-                      "update timeline_events set "
-                      " guid = :guid, "
-                      " title = :title, "
-                      " filename = :filename, "
-                      " uid = :uid, "
-                      " start_time = :start_time, "
-                      " end_time = :end_time, "
-                      " idle = :idle, "
-                      " uploaded = :uploaded, "
-                      " chunked = :chunked "
-                      "where local_id = :local_id",
-                      useRef(model->GUID()),
-                      useRef(model->Title()),
-                      useRef(model->Filename()),
-                      useRef(model->UID()),
-                      useRef(start_time),
-                      useRef(end_time),
-                      useRef(model->Idle()),
-                      useRef(model->Uploaded()),
-                      useRef(model->Chunked()),
-                      useRef(model->LocalID()),
-                      now;
+            executeCached(update_timeline_event_);
 
-            error err = last_error("update timeline event");
-            if (err != noError) {
-                return err;
-            }
             if (model->DeletedAt()) {
                 changes->push_back(ModelChange(
                     model->ModelName(),
@@ -2346,48 +2568,10 @@ error Database::saveModel(
         } else {
             logger.trace("Inserting timeline event ", model->String(), " in thread ", Poco::Thread::currentTid());
 
-            *session_ <<
-                      "insert into timeline_events("
-                      " guid, "
-                      " title, "
-                      " filename, "
-                      " uid, "
-                      " start_time, "
-                      " end_time, "
-                      " idle, "
-                      " uploaded, "
-                      " chunked "
-                      ") values ("
-                      " :guid, "
-                      " :title, "
-                      " :filename, "
-                      " :uid, "
-                      " :start_time, "
-                      " :end_time, "
-                      " :idle, "
-                      " :uploaded, "
-                      " :chunked "
-                      ")",
-                      useRef(model->GUID()),
-                      useRef(model->Title()),
-                      useRef(model->Filename()),
-                      useRef(model->UID()),
-                      useRef(start_time),
-                      useRef(end_time),
-                      useRef(model->Idle()),
-                      useRef(model->Uploaded()),
-                      useRef(model->Chunked()),
-                      now;
-            error err = last_error("insert timeline event");
-            if (err != noError) {
-                return err;
-            }
+            executeCached(insert_timeline_event_);
             Poco::Int64 local_id(0);
-            *session_ <<
-                      "select last_insert_rowid()",
-                      into(local_id),
-                      now;
-            err = last_error("select last inserted timeline event ID");
+            error err = lastInsertRowID(
+                "select last inserted timeline event ID", &local_id);
             if (err != noError) {
                 return err;
             }
@@ -3180,7 +3364,8 @@ error Database::SaveUser(
                           "offline_data = :offline_data, "
                           "default_pid = :default_pid, "
                           "default_tid = :default_tid, "
-                          "collapse_entries = :collapse_entries "
+                          "collapse_entries = :collapse_entries, "
+                          "full_synced_at = :full_synced_at "
                           "where local_id = :local_id",
                           useRef(user->DefaultWID()),
                           useRef(user->Since()),
@@ -3194,6 +3379,7 @@ error Database::SaveUser(
                           useRef(user->DefaultPID()),
                           useRef(user->DefaultTID()),
                           useRef(user->CollapseEntries()),
+                          useRef(user->FullSyncedAt()),
                           useRef(user->LocalID()),
                           now;
                 error err = last_error("SaveUser");
@@ -3210,13 +3396,13 @@ error Database::SaveUser(
                           "id, default_wid, since, fullname, email, "
                           "record_timeline, "
                           "timeofday_format, duration_format, offline_data, "
-                          "default_pid, default_tid"
+                          "default_pid, default_tid, full_synced_at"
                           ") values("
                           ":id, :default_wid, :since, :fullname, "
                           ":email, "
                           ":record_timeline, "
                           ":timeofday_format, :duration_format, :offline_data, "
-                          ":default_pid, :default_tid"
+                          ":default_pid, :default_tid, :full_synced_at"
                           ")",
                           useRef(user->ID()),
                           useRef(user->DefaultWID()),
@@ -3229,6 +3415,7 @@ error Database::SaveUser(
                           useRef(user->OfflineData()),
                           useRef(user->DefaultPID()),
                           useRef(user->DefaultTID()),
+                          useRef(user->FullSyncedAt()),
                           now;
                 error err = last_error("SaveUser");
                 if (err != noError) {
@@ -3268,10 +3455,11 @@ error Database::SaveUser(
     if (with_related_data) {
         // Workspaces
         std::vector<ModelChange> workspace_changes;
-        error err = saveRelatedModels(user->ID(),
-                                      "workspaces",
-                                      &user->related.Workspaces,
-                                      &workspace_changes);
+        error err = saveDirtyRelatedModels(user->ID(),
+                                           "workspaces",
+                                           user->related,
+                                           &user->related.Workspaces,
+                                           &workspace_changes);
         if (err != noError) {
             session_->rollback();
             return err;
@@ -3289,10 +3477,11 @@ error Database::SaveUser(
 
         // Clients
         std::vector<ModelChange> client_changes;
-        err = saveRelatedModels(user->ID(),
-                                "clients",
-                                &user->related.Clients,
-                                &client_changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "clients",
+                                     user->related,
+                                     &user->related.Clients,
+                                     &client_changes);
         if (err != noError) {
             session_->rollback();
             return err;
@@ -3310,10 +3499,11 @@ error Database::SaveUser(
 
         // Projects
         std::vector<ModelChange> project_changes;
-        err = saveRelatedModels(user->ID(),
-                                "projects",
-                                &user->related.Projects,
-                                &project_changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "projects",
+                                     user->related,
+                                     &user->related.Projects,
+                                     &project_changes);
         if (err != noError) {
             session_->rollback();
             return err;
@@ -3331,10 +3521,11 @@ error Database::SaveUser(
 
         // Tasks
         std::vector<ModelChange> task_changes;
-        err = saveRelatedModels(user->ID(),
-                                "tasks",
-                                &user->related.Tasks,
-                                &task_changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "tasks",
+                                     user->related,
+                                     &user->related.Tasks,
+                                     &task_changes);
         if (err != noError) {
             session_->rollback();
             return err;
@@ -3351,20 +3542,22 @@ error Database::SaveUser(
         }
 
         // Tags
-        err = saveRelatedModels(user->ID(),
-                                "tags",
-                                &user->related.Tags,
-                                changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "tags",
+                                     user->related,
+                                     &user->related.Tags,
+                                     changes);
         if (err != noError) {
             session_->rollback();
             return err;
         }
 
         // Time entries
-        err = saveRelatedModels(user->ID(),
-                                "time_entries",
-                                &user->related.TimeEntries,
-                                changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "time_entries",
+                                     user->related,
+                                     &user->related.TimeEntries,
+                                     changes);
         if (err != noError) {
             session_->rollback();
             return err;
@@ -3381,10 +3574,11 @@ error Database::SaveUser(
         }
 
         // Timeline events
-        err = saveRelatedModels(user->ID(),
-                                "timeline_events",
-                                &user->related.TimelineEvents,
-                                changes);
+        err = saveDirtyRelatedModels(user->ID(),
+                                     "timeline_events",
+                                     user->related,
+                                     &user->related.TimelineEvents,
+                                     changes);
         if (err != noError) {
             session_->rollback();
             return err;
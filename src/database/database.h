@@ -9,11 +9,14 @@
 #include "sqlite3.h" // NOLINT
 #endif
 
+#include <functional>
+#include <map>
 #include <string>
 #include <vector>
 
 #include <Poco/Data/SQLite/Connector.h>
 
+#include "database/rows.h"
 #include "model_change.h"
 #include "model/timeline_event.h"
 #include "types.h"
@@ -39,6 +42,7 @@ class TimeEntry;
 class User;
 class Workspace;
 class OnboardingState;
+class RelatedData;
 
 class TOGGL_INTERNAL_EXPORT Database {
  public:
@@ -63,6 +67,49 @@ class TOGGL_INTERNAL_EXPORT Database {
 
     error LoadCurrentUser(User *user);
 
+    // Loads the current user with what the first screen needs only:
+    // the time entries started since recent_since, the running one,
+    // and no timeline events. LoadDeferredUserData reads the rest.
+    error LoadCurrentUserStaged(
+        User *user,
+        const Poco::Int64 recent_since);
+
+    // Reads the time entries started before recent_since and the
+    // timeline events on a read-only connection of its own. In WAL
+    // mode it doesn't hold up the main connection, so it can run in
+    // the background while the app starts. With hot_since, entries
+    // started before it are left for LoadTimeEntryPage, except for
+    // the ones not pushed yet. Gives up between batches of rows
+    // once cancelled returns true.
+    error LoadDeferredUserData(
+        const Poco::UInt64 &UID,
+        const Poco::Int64 recent_since,
+        const Poco::Int64 hot_since,
+        std::vector<TimeEntry *> *time_entries,
+        std::vector<TimelineEvent *> *timeline_events,
+        const std::function<bool()> &cancelled);
+
+    // Time entries started in [from, to)
+    error LoadTimeEntryPage(
+        const Poco::UInt64 &UID,
+        const Poco::Int64 from,
+        const Poco::Int64 to,
+        std::vector<TimeEntry *> *list);
+
+    // Starts of the time entries with a server ID that were
+    // started before the time, by the ID
+    error TimeEntryStartsBefore(
+        const Poco::UInt64 &UID,
+        const Poco::Int64 before,
+        std::map<Poco::UInt64, Poco::Int64> *starts);
+
+    // Start of the latest time entry started before the time
+    error LatestTimeEntryStartBefore(
+        const Poco::UInt64 &UID,
+        const Poco::Int64 before,
+        Poco::Int64 *start,
+        bool *found);
+
     error LoadSettings(Settings *settings);
 
     error LoadWindowSettings(
@@ -230,6 +277,39 @@ class TOGGL_INTERNAL_EXPORT Database {
     error SaveUser(User *user, bool with_related_data,
                    std::vector<ModelChange> *changes);
 
+    // Deletes the synced time entries and timeline events that are no
+    // longer kept. Call it before the user is loaded, the rows back
+    // models in memory otherwise.
+    error PurgeOldSyncedData();
+
+    // The statements run on startup, when time entries are paged in
+    // and when old data is purged, as they're prepared. For tests
+    // that check they use the indexes.
+    static std::vector<std::string> HotStatements();
+
+    // Freed pages can only be given back in steps with incremental
+    // auto vacuum
+    error IncrementalVacuumEnabled(bool *enabled);
+
+    // Switching to incremental auto vacuum takes one full VACUUM,
+    // which can't be split up. It runs on a connection of its own, so
+    // it doesn't hold up this one's lock; switched tells whether it
+    // had to be done.
+    static error SwitchToIncrementalVacuum(
+        const std::string &db_path,
+        bool *switched);
+
+    std::string DBPath() const {
+        return db_path_;
+    }
+
+    // Gives freed pages back to the file system, in steps short enough
+    // not to hold up other queries. Returns once the budget is used up;
+    // finished is set when there's nothing left to do.
+    error Maintain(
+        const Poco::Timespan &budget,
+        bool *finished);
+
     error LoadTimeEntriesForUpload(User *user);
 
     error CurrentAPIToken(
@@ -265,8 +345,6 @@ class TOGGL_INTERNAL_EXPORT Database {
     error SetOnboardingState(const Poco::UInt64 &UID, OnboardingState *state);
     
  private:
-    error vacuum();
-
     error initialize_tables();
 
     error ensureMigrationTable();
@@ -290,7 +368,21 @@ class TOGGL_INTERNAL_EXPORT Database {
     error journalMode(std::string *);
     error setJournalMode(const std::string &);
 
-    error loadUsersRelatedData(User *user);
+    // Reads a PRAGMA with a single integer value
+    error pragma(const std::string &name, Poco::Int64 *value);
+    error walCheckpoint();
+
+    // With recent_since set, loads the first screen data only
+    error loadCurrentUser(
+        User *user,
+        const Poco::Int64 recent_since);
+    error loadUserByID(
+        const Poco::UInt64 &UID,
+        User *user,
+        const Poco::Int64 recent_since);
+    error loadUsersRelatedData(
+        User *user,
+        const Poco::Int64 recent_since);
 
     error loadWorkspaces(
         const Poco::UInt64 &UID,
@@ -316,17 +408,37 @@ class TOGGL_INTERNAL_EXPORT Database {
         const Poco::UInt64 &UID,
         std::vector<AutotrackerRule *> *list);
 
+    // Selects the time entries of the user matching the range
+    // condition, if any, latest first
+    static std::string timeEntriesSQL(const std::string &range);
+
+    // Deletes at most :max_rows synced rows that stopped before :stop
+    static std::string deleteSyncedByDateSQL(const std::string &table_name);
+
+    // Time entries matching the range condition, if any, with its
+    // parameters bound to the bounds in order
     error loadTimeEntries(
+        Poco::Data::Session *session,
         const Poco::UInt64 &UID,
-        std::vector<TimeEntry *> *list);
+        const std::string &range,
+        const std::vector<Poco::Int64> &bounds,
+        std::vector<TimeEntry *> *list,
+        const std::function<bool()> &cancelled = nullptr);
 
     error loadTimelineEvents(
+        Poco::Data::Session *session,
         const Poco::UInt64 &UID,
-        std::vector<TimelineEvent *> *list);
-
-    error loadTimeEntriesFromSQLStatement(
+        std::vector<TimelineEvent *> *list,
+        const std::function<bool()> &cancelled = nullptr);
+
+    // Extracts the result of the select into typed rows, a batch at
+    // a time, and appends a model loaded from each row to the list.
+    // Stops with an error if cancelled returns true between batches.
+    template <class Row, class Model>
+    error loadRows(
         Poco::Data::Statement *select,
-        std::vector<TimeEntry *> *list);
+        std::vector<Model *> *list,
+        const std::function<bool()> &cancelled = nullptr);
 
     template <typename T>
     error saveRelatedModels(
@@ -335,12 +447,34 @@ class TOGGL_INTERNAL_EXPORT Database {
         std::vector<T *> *list,
         std::vector<ModelChange> *changes);
 
+    // Saves only the models the related data has seen getting dirty
+    template <typename T>
+    error saveDirtyRelatedModels(
+        const Poco::UInt64 UID,
+        const std::string &table_name,
+        const RelatedData &related,
+        std::vector<T *> *list,
+        std::vector<ModelChange> *changes);
+
+    template <typename T>
+    error saveModels(
+        const Poco::UInt64 UID,
+        const std::string &table_name,
+        const std::vector<T *> &models,
+        std::vector<T *> *list,
+        std::vector<ModelChange> *changes);
+
+    // Delete at most max_rows at a time, deleted tells how many were
     error deleteAllFromTableByDate(
         const std::string &table_name,
-        const Poco::Timestamp &time);
+        const Poco::Timestamp &time,
+        const Poco::Int64 max_rows,
+        Poco::Int64 *deleted);
 
     error deleteAllSyncedTimelineEventsByDate(
-        const Poco::Timestamp &time);
+        const Poco::Timestamp &time,
+        const Poco::Int64 max_rows,
+        Poco::Int64 *deleted);
 
     error deleteAllFromTableByUID(
         const std::string &table_name,
@@ -378,6 +512,17 @@ class TOGGL_INTERNAL_EXPORT Database {
         TimelineEvent *model,
         std::vector<ModelChange> *changes);
 
+    // Time entries and timeline events are saved way more often than
+    // anything else, so their statements are compiled only once.
+    // The statements are bound to the rows, fill a row and execute.
+    void prepareStatements();
+    void clearStatements();
+    void executeCached(Poco::Data::Statement *statement);
+
+    error lastInsertRowID(
+        const std::string &was_doing,
+        Poco::Int64 *local_id);
+
     error saveDesktopID();
     error saveAnalyticsClientID();
 
@@ -393,9 +538,21 @@ class TOGGL_INTERNAL_EXPORT Database {
 
     Logger logger { "database" };
 
+    std::string db_path_;
+
     Poco::Mutex session_m_;
     Poco::Data::Session *session_;
 
+    TimeEntryRow time_entry_row_;
+    TimelineEventRow timeline_event_row_;
+    Poco::Int64 last_insert_rowid_;
+
+    Poco::Data::Statement *insert_time_entry_;
+    Poco::Data::Statement *update_time_entry_;
+    Poco::Data::Statement *insert_timeline_event_;
+    Poco::Data::Statement *update_timeline_event_;
+    Poco::Data::Statement *select_last_insert_rowid_;
+
     std::string desktop_id_;
     std::string analytics_client_id_;
 };
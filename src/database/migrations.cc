@@ -543,6 +543,23 @@ error Migrations::migrateTimeline() {
         return err;
     }
 
+    // Loading the user's events and deleting uploaded ones by date
+    err = db_->Migrate(
+        "timeline_events.uid_start_time",
+        "CREATE INDEX id_timeline_events_uid_start_time "
+        "   ON timeline_events (uid, start_time); ");
+    if (err != noError) {
+        return err;
+    }
+
+    err = db_->Migrate(
+        "timeline_events.uploaded_end_time",
+        "CREATE INDEX id_timeline_events_uploaded_end_time "
+        "   ON timeline_events (uploaded, end_time); ");
+    if (err != noError) {
+        return err;
+    }
+
     return noError;
 }
 
@@ -685,6 +702,14 @@ error Migrations::migrateUsers() {
         return err;
     }
 
+    err = db_->Migrate(
+        "users.full_synced_at",
+        "alter table users"
+        " add column full_synced_at integer not null default 0;");
+    if (err != noError) {
+        return err;
+    }
+
     // TODO when modifying the structure of this table, drop the store_start_and_stop_time,
     // it's been removed from the class altogether -- martin
 
@@ -875,6 +900,23 @@ error Migrations::migrateTimeEntries() {
         return err;
     }
 
+    err = db_->Migrate(
+        "time_entries.uid_start",
+        "CREATE INDEX id_time_entries_uid_start "
+        "   ON time_entries (uid, start); ");
+    if (err != noError) {
+        return err;
+    }
+
+    // Covers the clean up of synced time entries by date
+    err = db_->Migrate(
+        "time_entries.stop_id",
+        "CREATE INDEX id_time_entries_stop_id "
+        "   ON time_entries (stop, id); ");
+    if (err != noError) {
+        return err;
+    }
+
     return noError;
 }
 
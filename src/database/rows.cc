@@ -0,0 +1,122 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "database/rows.h"
+
+#include "model/project.h"
+#include "model/time_entry.h"
+#include "model/timeline_event.h"
+
+namespace toggl {
+
+void TimeEntryRow::Fill(const TimeEntry &model) {
+    id = model.ID();
+    uid = model.UID();
+    description = model.Description();
+    wid = model.WID();
+    guid = model.GUID();
+    pid = model.PID();
+    tid = model.TID();
+    billable = model.Billable();
+    duronly = model.DurOnly();
+    ui_modified_at = model.UIModifiedAt();
+    start = model.StartTime();
+    stop = model.StopTime();
+    duration = model.DurationInSeconds();
+    tags = model.Tags();
+    created_with = model.CreatedWith();
+    deleted_at = model.DeletedAt();
+    updated_at = model.UpdatedAt();
+    project_guid = model.ProjectGUID();
+    validation_error = model.ValidationError();
+    previous_pid = model.PID.GetPrevious();
+    previous_project_guid = model.ProjectGUID.GetPrevious();
+    previous_tid = model.TID.GetPrevious();
+    previous_billable = model.Billable.GetPrevious();
+    previous_start = model.StartTime.GetPrevious();
+    previous_stop = model.StopTime.GetPrevious();
+    previous_duration = model.DurationInSeconds.GetPrevious();
+    previous_description = model.Description.GetPrevious();
+    previous_created_with = model.CreatedWith.GetPrevious();
+    previous_tags =
+        TimeEntry::TagsVectorToString(model.TagNames.GetPrevious());
+    local_id = model.LocalID();
+}
+
+void TimeEntryRow::Load(TimeEntry *model) const {
+    // "Current" values - the ones that are actually displayed in the UI
+    model->SetLocalID(local_id);
+    model->SetID(id);
+    model->SetUID(uid);
+    model->Description.SetCurrent(description);
+    model->SetWID(wid);
+    model->SetGUID(guid);
+    model->PID.SetCurrent(pid);
+    model->TID.SetCurrent(tid);
+    model->Billable.SetCurrent(billable);
+    model->SetDurOnly(duronly);
+    model->SetUIModifiedAt(ui_modified_at);
+    model->StartTime.SetCurrent(start);
+    model->StopTime.SetCurrent(stop);
+    model->DurationInSeconds.SetCurrent(duration);
+    model->TagNames.SetCurrent(TimeEntry::TagsStringToVector(tags));
+    model->CreatedWith.SetCurrent(created_with);
+    model->SetDeletedAt(deleted_at);
+    model->SetUpdatedAt(updated_at);
+    model->ProjectGUID.SetCurrent(project_guid);
+    model->SetValidationError(validation_error);
+
+    // "Previous" values - used to track what the user has changed between server sync cycles
+    model->PID.SetPrevious(previous_pid);
+    model->ProjectGUID.SetPrevious(previous_project_guid);
+    model->TID.SetPrevious(previous_tid);
+    model->Billable.SetPrevious(previous_billable);
+    model->StartTime.SetPrevious(previous_start);
+    model->StopTime.SetPrevious(previous_stop);
+    model->DurationInSeconds.SetPrevious(previous_duration);
+    model->Description.SetPrevious(previous_description);
+    model->CreatedWith.SetPrevious(previous_created_with);
+    model->TagNames.SetPrevious(TimeEntry::TagsStringToVector(previous_tags));
+}
+
+void TimelineEventRow::Fill(const TimelineEvent &model) {
+    guid = model.GUID();
+    title = model.Title().str();
+    filename = model.Filename().str();
+    uid = model.UID();
+    start_time = model.Start();
+    end_time = model.EndTime();
+    idle = model.Idle();
+    uploaded = model.Uploaded();
+    chunked = model.Chunked();
+    local_id = model.LocalID();
+}
+
+void TimelineEventRow::Load(TimelineEvent *model) const {
+    model->SetLocalID(local_id);
+    model->SetTitle(title);
+    model->SetFilename(filename);
+    model->SetStartTime(start_time);
+    model->SetEndTime(end_time);
+    model->SetIdle(idle);
+    model->SetUploaded(uploaded);
+    model->SetChunked(chunked);
+    model->SetGUID(guid);
+    model->SetUID(uid);
+}
+
+void ProjectRow::Load(Project *model) const {
+    model->SetLocalID(local_id);
+    model->SetID(id);
+    model->SetUID(uid);
+    model->SetName(name);
+    model->SetGUID(guid);
+    model->SetWID(wid);
+    model->SetColor(color);
+    model->SetCID(cid);
+    model->SetActive(active);
+    model->SetBillable(billable);
+    model->SetClientGUID(client_guid);
+    model->SetClientName(client_name);
+}
+
+}  // namespace toggl
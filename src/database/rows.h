@@ -0,0 +1,279 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_ROWS_H_
+#define SRC_ROWS_H_
+
+#include <string>
+
+#include <Poco/Data/TypeHandler.h>
+
+#include "types.h"
+
+namespace toggl {
+
+class Project;
+class TimeEntry;
+class TimelineEvent;
+
+/**
+ * Typed table rows. The loaders extract a query result into a vector
+ * of rows with the TypeHandlers below and fill the models from them,
+ * so no column goes through a RecordSet and Poco::Dynamic::Var. The
+ * members are in the order of the columns the loaders select, NULL
+ * columns are left at their defaults.
+ */
+struct TimeEntryRow {
+    void Fill(const TimeEntry &model);
+    void Load(TimeEntry *model) const;
+
+    Poco::UInt64 id { 0 };
+    Poco::UInt64 uid { 0 };
+    std::string description;
+    Poco::UInt64 wid { 0 };
+    std::string guid;
+    Poco::UInt64 pid { 0 };
+    Poco::UInt64 tid { 0 };
+    bool billable { false };
+    bool duronly { false };
+    Poco::Int64 ui_modified_at { 0 };
+    Poco::Int64 start { 0 };
+    Poco::Int64 stop { 0 };
+    Poco::Int64 duration { 0 };
+    std::string tags;
+    std::string created_with;
+    Poco::Int64 deleted_at { 0 };
+    Poco::Int64 updated_at { 0 };
+    std::string project_guid;
+    std::string validation_error;
+    Poco::UInt64 previous_pid { 0 };
+    std::string previous_project_guid;
+    Poco::UInt64 previous_tid { 0 };
+    bool previous_billable { false };
+    Poco::Int64 previous_start { 0 };
+    Poco::Int64 previous_stop { 0 };
+    Poco::Int64 previous_duration { 0 };
+    std::string previous_description;
+    std::string previous_created_with;
+    std::string previous_tags;
+    Poco::Int64 local_id { 0 };
+};
+
+struct TimelineEventRow {
+    void Fill(const TimelineEvent &model);
+    void Load(TimelineEvent *model) const;
+
+    std::string guid;
+    std::string title;
+    std::string filename;
+    Poco::UInt64 uid { 0 };
+    Poco::Int64 start_time { 0 };
+    Poco::Int64 end_time { 0 };
+    bool idle { false };
+    bool uploaded { false };
+    bool chunked { false };
+    Poco::Int64 local_id { 0 };
+};
+
+struct ProjectRow {
+    void Load(Project *model) const;
+
+    Poco::Int64 local_id { 0 };
+    Poco::UInt64 id { 0 };
+    Poco::UInt64 uid { 0 };
+    std::string name;
+    std::string guid;
+    Poco::UInt64 wid { 0 };
+    std::string color;
+    Poco::UInt64 cid { 0 };
+    bool active { false };
+    bool billable { false };
+    std::string client_guid;
+    std::string client_name;
+};
+
+}  // namespace toggl
+
+namespace Poco {
+namespace Data {
+
+// Extraction only, the rows are bound to statements member by member
+
+template <>
+class TypeHandler<toggl::TimeEntryRow> {
+ public:
+    static std::size_t size() {
+        return 30;
+    }
+
+    // local_id, id, uid, description, wid, guid, pid, tid, billable,
+    // duronly, ui_modified_at, start, stop, duration, tags,
+    // created_with, deleted_at, updated_at, project_guid,
+    // validation_error and the previous_ columns
+    static void extract(
+        std::size_t pos,
+        toggl::TimeEntryRow &r,
+        const toggl::TimeEntryRow &d,
+        AbstractExtractor::Ptr ext) {
+        TypeHandler<Poco::Int64>::extract(pos++, r.local_id, d.local_id, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.id, d.id, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.uid, d.uid, ext);
+        TypeHandler<std::string>::extract(pos++, r.description, d.description, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.wid, d.wid, ext);
+        TypeHandler<std::string>::extract(pos++, r.guid, d.guid, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.pid, d.pid, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.tid, d.tid, ext);
+        TypeHandler<bool>::extract(pos++, r.billable, d.billable, ext);
+        TypeHandler<bool>::extract(pos++, r.duronly, d.duronly, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.ui_modified_at, d.ui_modified_at, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.start, d.start, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.stop, d.stop, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.duration, d.duration, ext);
+        TypeHandler<std::string>::extract(pos++, r.tags, d.tags, ext);
+        TypeHandler<std::string>::extract(pos++, r.created_with, d.created_with, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.deleted_at, d.deleted_at, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.updated_at, d.updated_at, ext);
+        TypeHandler<std::string>::extract(pos++, r.project_guid, d.project_guid, ext);
+        TypeHandler<std::string>::extract(pos++, r.validation_error, d.validation_error, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.previous_pid, d.previous_pid, ext);
+        TypeHandler<std::string>::extract(pos++, r.previous_project_guid, d.previous_project_guid, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.previous_tid, d.previous_tid, ext);
+        TypeHandler<bool>::extract(pos++, r.previous_billable, d.previous_billable, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.previous_start, d.previous_start, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.previous_stop, d.previous_stop, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.previous_duration, d.previous_duration, ext);
+        TypeHandler<std::string>::extract(pos++, r.previous_description, d.previous_description, ext);
+        TypeHandler<std::string>::extract(pos++, r.previous_created_with, d.previous_created_with, ext);
+        TypeHandler<std::string>::extract(pos++, r.previous_tags, d.previous_tags, ext);
+    }
+
+    static void prepare(
+        std::size_t pos,
+        const toggl::TimeEntryRow &r,
+        AbstractPreparator::Ptr prep) {
+        TypeHandler<Poco::Int64>::prepare(pos++, r.local_id, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.id, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.uid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.description, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.wid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.guid, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.pid, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.tid, prep);
+        TypeHandler<bool>::prepare(pos++, r.billable, prep);
+        TypeHandler<bool>::prepare(pos++, r.duronly, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.ui_modified_at, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.start, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.stop, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.duration, prep);
+        TypeHandler<std::string>::prepare(pos++, r.tags, prep);
+        TypeHandler<std::string>::prepare(pos++, r.created_with, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.deleted_at, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.updated_at, prep);
+        TypeHandler<std::string>::prepare(pos++, r.project_guid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.validation_error, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.previous_pid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.previous_project_guid, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.previous_tid, prep);
+        TypeHandler<bool>::prepare(pos++, r.previous_billable, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.previous_start, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.previous_stop, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.previous_duration, prep);
+        TypeHandler<std::string>::prepare(pos++, r.previous_description, prep);
+        TypeHandler<std::string>::prepare(pos++, r.previous_created_with, prep);
+        TypeHandler<std::string>::prepare(pos++, r.previous_tags, prep);
+    }
+};
+
+template <>
+class TypeHandler<toggl::TimelineEventRow> {
+ public:
+    static std::size_t size() {
+        return 10;
+    }
+
+    // local_id, title, filename, start_time, end_time,
+    // idle, uploaded, chunked, guid, uid
+    static void extract(
+        std::size_t pos,
+        toggl::TimelineEventRow &r,
+        const toggl::TimelineEventRow &d,
+        AbstractExtractor::Ptr ext) {
+        TypeHandler<Poco::Int64>::extract(pos++, r.local_id, d.local_id, ext);
+        TypeHandler<std::string>::extract(pos++, r.title, d.title, ext);
+        TypeHandler<std::string>::extract(pos++, r.filename, d.filename, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.start_time, d.start_time, ext);
+        TypeHandler<Poco::Int64>::extract(pos++, r.end_time, d.end_time, ext);
+        TypeHandler<bool>::extract(pos++, r.idle, d.idle, ext);
+        TypeHandler<bool>::extract(pos++, r.uploaded, d.uploaded, ext);
+        TypeHandler<bool>::extract(pos++, r.chunked, d.chunked, ext);
+        TypeHandler<std::string>::extract(pos++, r.guid, d.guid, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.uid, d.uid, ext);
+    }
+
+    static void prepare(
+        std::size_t pos,
+        const toggl::TimelineEventRow &r,
+        AbstractPreparator::Ptr prep) {
+        TypeHandler<Poco::Int64>::prepare(pos++, r.local_id, prep);
+        TypeHandler<std::string>::prepare(pos++, r.title, prep);
+        TypeHandler<std::string>::prepare(pos++, r.filename, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.start_time, prep);
+        TypeHandler<Poco::Int64>::prepare(pos++, r.end_time, prep);
+        TypeHandler<bool>::prepare(pos++, r.idle, prep);
+        TypeHandler<bool>::prepare(pos++, r.uploaded, prep);
+        TypeHandler<bool>::prepare(pos++, r.chunked, prep);
+        TypeHandler<std::string>::prepare(pos++, r.guid, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.uid, prep);
+    }
+};
+
+template <>
+class TypeHandler<toggl::ProjectRow> {
+ public:
+    static std::size_t size() {
+        return 12;
+    }
+
+    // local_id, id, uid, name, guid, wid, color, cid,
+    // active, billable, client_guid, client_name
+    static void extract(
+        std::size_t pos,
+        toggl::ProjectRow &r,
+        const toggl::ProjectRow &d,
+        AbstractExtractor::Ptr ext) {
+        TypeHandler<Poco::Int64>::extract(pos++, r.local_id, d.local_id, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.id, d.id, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.uid, d.uid, ext);
+        TypeHandler<std::string>::extract(pos++, r.name, d.name, ext);
+        TypeHandler<std::string>::extract(pos++, r.guid, d.guid, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.wid, d.wid, ext);
+        TypeHandler<std::string>::extract(pos++, r.color, d.color, ext);
+        TypeHandler<Poco::UInt64>::extract(pos++, r.cid, d.cid, ext);
+        TypeHandler<bool>::extract(pos++, r.active, d.active, ext);
+        TypeHandler<bool>::extract(pos++, r.billable, d.billable, ext);
+        TypeHandler<std::string>::extract(pos++, r.client_guid, d.client_guid, ext);
+        TypeHandler<std::string>::extract(pos++, r.client_name, d.client_name, ext);
+    }
+
+    static void prepare(
+        std::size_t pos,
+        const toggl::ProjectRow &r,
+        AbstractPreparator::Ptr prep) {
+        TypeHandler<Poco::Int64>::prepare(pos++, r.local_id, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.id, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.uid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.name, prep);
+        TypeHandler<std::string>::prepare(pos++, r.guid, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.wid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.color, prep);
+        TypeHandler<Poco::UInt64>::prepare(pos++, r.cid, prep);
+        TypeHandler<bool>::prepare(pos++, r.active, prep);
+        TypeHandler<bool>::prepare(pos++, r.billable, prep);
+        TypeHandler<std::string>::prepare(pos++, r.client_guid, prep);
+        TypeHandler<std::string>::prepare(pos++, r.client_name, prep);
+    }
+};
+
+}  // namespace Data
+}  // namespace Poco
+
+#endif  // SRC_ROWS_H_
@@ -11,4 +11,13 @@ int getFocusedWindowInfo(
     std::string *filename,
     bool *idle);
 
+// Blocks until the focused window or its title may have changed,
+// the timeout passes or interruptFocusChangeWait() is called.
+// Returns false right away when the platform can't report focus
+// changes, the caller has to poll getFocusedWindowInfo then.
+bool waitForFocusChange(const int timeout_millis);
+
+// Makes a pending waitForFocusChange() return
+void interruptFocusChangeWait();
+
 #endif  // SRC_GET_FOCUSED_WINDOW_H_
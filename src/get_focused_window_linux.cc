@@ -11,11 +11,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
+#include <poll.h>
+#include <time.h>
 
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 
 #include <cstring>
+#include <map>
 #include <string>
 #include <typeinfo>
 
@@ -29,12 +32,13 @@
   __eintr_result__;\
 })
 
-static const char kNetActiveWindow[] = "_NET_ACTIVE_WINDOW";
 static const int kMaxPropertyValueLen = 4096;
 
+// Process names are read from /proc only for windows not seen before
+static const size_t kMaxCachedProcessNames = 256;
+
 static char *get_property(Display *disp, Window win, Atom xa_prop_type,
-                          const char *prop_name, unsigned long *size) { // NOLINT
-    Atom xa_prop_name;
+                          Atom xa_prop_name, unsigned long *size) { // NOLINT
     Atom xa_ret_type;
     int ret_format;
     unsigned long ret_nitems; // NOLINT
@@ -43,8 +47,6 @@ static char *get_property(Display *disp, Window win, Atom xa_prop_type,
     unsigned char *ret_prop;
     char *ret;
 
-    xa_prop_name = XInternAtom(disp, prop_name, False);
-
     // kMaxPropertyValueLen / 4 explanation (XGetWindowProperty manpage):
     // long_length = Specifies the length in 32-bit multiples of the data
     // to be retrieved.
@@ -86,87 +88,342 @@ static char *get_property(Display *disp, Window win, Atom xa_prop_type,
     return ret;
 }
 
-int getFocusedWindowInfo(
-    std::string *title,
-    std::string *filename,
-    bool *idle) {
-    *title = "";
-    *filename = "";
-    *idle = false;
+static std::string read_process_name(const unsigned long pid) { // NOLINT
+    std::string result("");
+    char buf[256];
+    snprintf(buf, sizeof(buf), "/proc/%lu/stat", pid);
+    const int fd = open(buf, O_RDONLY);
+    if (fd >= 0) {
+        const ssize_t len =
+            HANDLE_EINTR(read(fd, buf, sizeof(buf) - 1));
+        HANDLE_EINTR(close(fd));
+        if (len > 0) {
+            buf[len] = 0;
+            // The start of the file looks like:
+            //   <pid> (<name>) R <parent pid>
+            unsigned tmp_pid, tmp_ppid;
+            char *process_name = nullptr;
+            if (sscanf(buf, "%u (%m[^)]) %*c %u", // NOLINT
+                       &tmp_pid, &process_name, &tmp_ppid) == 3) {
+                result = std::string(process_name);
+                free(process_name);
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * Windows vanish at any time, requests about them must not be fatal.
+ * The Xlib error handler is process wide, so errors are only ignored
+ * while the tracker talks to the X server, and only the ones of its
+ * own connection. Errors of other connections go to the handler that
+ * was installed before.
+ */
+class IgnoreXErrors {
+ public:
+    explicit IgnoreXErrors(Display *display) {
+        display_ = display;
+        previous_ = XSetErrorHandler(handle);
+    }
+
+    ~IgnoreXErrors() {
+        XErrorHandler current = XSetErrorHandler(previous_);
+        // Keep a handler somebody else installed in the meantime
+        if (current != handle) {
+            XSetErrorHandler(current);
+        }
+    }
+
+ private:
+    static int handle(Display *display, XErrorEvent *event) {
+        if (event->display == display_ || !previous_) {
+            return 0;
+        }
+        return previous_(display, event);
+    }
+
+    static Display *display_;
+    static XErrorHandler previous_;
+};
+
+Display *IgnoreXErrors::display_ = nullptr;
+XErrorHandler IgnoreXErrors::previous_ = nullptr;
+
+/**
+ * Keeps one connection to the X server for the whole session.
+ * When the window manager maintains _NET_ACTIVE_WINDOW, the root
+ * window and the focused window are watched for property changes,
+ * so focus and title changes are reported as they happen.
+ */
+class FocusTracker {
+ public:
+    static FocusTracker &Instance() {
+        static FocusTracker instance;
+        return instance;
+    }
+
+    int Read(std::string *title, std::string *filename);
+    bool Wait(const int timeout_millis);
+    void Interrupt();
+
+ private:
+    FocusTracker();
+    ~FocusTracker();
+
+    bool connect();
+    void watch(const Window window);
+    bool relevant(const XEvent &event) const;
+
+    Display *display_;
+    bool events_supported_;
+
+    Atom net_active_window_;
+    Atom net_wm_name_;
+    Atom net_wm_pid_;
+    Atom utf8_string_;
+
+    // Focused window watched for title changes
+    Window watched_;
+
+    struct Process {
+        Window window;
+        std::string name;
+    };
+    std::map<unsigned long, Process> processes_; // NOLINT
+
+    // Wakes up Wait()
+    int interrupt_[2];
+};
+
+FocusTracker::FocusTracker()
+    : display_(nullptr)
+, events_supported_(false)
+, net_active_window_(None)
+, net_wm_name_(None)
+, net_wm_pid_(None)
+, utf8_string_(None)
+, watched_(None) {
+    if (pipe2(interrupt_, O_NONBLOCK | O_CLOEXEC) != 0) {
+        interrupt_[0] = interrupt_[1] = -1;
+    }
+}
+
+FocusTracker::~FocusTracker() {
+    if (display_) {
+        IgnoreXErrors ignore(display_);
+        XCloseDisplay(display_);
+    }
+    if (interrupt_[0] >= 0) {
+        HANDLE_EINTR(close(interrupt_[0]));
+        HANDLE_EINTR(close(interrupt_[1]));
+    }
+}
+
+bool FocusTracker::connect() {
+    if (display_) {
+        return true;
+    }
+
+    display_ = XOpenDisplay(nullptr);
+    if (!display_) {
+        return false;
+    }
+    IgnoreXErrors ignore(display_);
+
+    net_active_window_ = XInternAtom(display_, "_NET_ACTIVE_WINDOW", False);
+    net_wm_name_ = XInternAtom(display_, "_NET_WM_NAME", False);
+    net_wm_pid_ = XInternAtom(display_, "_NET_WM_PID", False);
+    utf8_string_ = XInternAtom(display_, "UTF8_STRING", False);
+
+    // Changes can only be watched if the window manager
+    // keeps the active window property up to date
+    Window root = DefaultRootWindow(display_);
+    unsigned long size = 0; // NOLINT
+    Atom *supported = reinterpret_cast<Atom *>(get_property(
+        display_, root, XA_ATOM,
+        XInternAtom(display_, "_NET_SUPPORTED", False), &size));
+    if (supported) {
+        for (size_t i = 0; i < size / sizeof(Atom); i++) {
+            if (supported[i] == net_active_window_) {
+                events_supported_ = true;
+                break;
+            }
+        }
+        free(supported);
+    }
+    if (events_supported_) {
+        XSelectInput(display_, root, PropertyChangeMask);
+    }
+    return true;
+}
 
-    Display *display = XOpenDisplay(nullptr);
-    if (!display) {
+void FocusTracker::watch(const Window window) {
+    if (!events_supported_ || window == watched_) {
+        return;
+    }
+    if (watched_) {
+        XSelectInput(display_, watched_, NoEventMask);
+    }
+    if (window) {
+        XSelectInput(display_, window, PropertyChangeMask);
+    }
+    watched_ = window;
+}
+
+bool FocusTracker::relevant(const XEvent &event) const {
+    if (event.type != PropertyNotify) {
+        return false;
+    }
+    if (event.xproperty.window == DefaultRootWindow(display_)) {
+        return event.xproperty.atom == net_active_window_;
+    }
+    return event.xproperty.window == watched_
+           && (event.xproperty.atom == net_wm_name_
+               || event.xproperty.atom == XA_WM_NAME);
+}
+
+int FocusTracker::Read(std::string *title, std::string *filename) {
+    if (!connect()) {
         return 1;
     }
+    IgnoreXErrors ignore(display_);
 
     // get active window
-    unsigned long size = 0; // NOLINT
     Window active_window = 0;
     char *prop = get_property(
-        display,
-        DefaultRootWindow(display),
+        display_,
+        DefaultRootWindow(display_),
         XA_WINDOW,
-        kNetActiveWindow,
-        &size);
+        net_active_window_,
+        nullptr);
     if (prop) {
         active_window = *(reinterpret_cast<Window *>(prop));
     }
     free(prop);
 
+    watch(active_window);
+
+    if (!active_window) {
+        return 0;
+    }
+
     // get title of active window
-    if (active_window) {
-        char *net_wm_name = get_property(
-            display,
-            active_window,
-            XInternAtom(display, "UTF8_STRING", false),
-            "_NET_WM_NAME",
-            nullptr);
-        if (net_wm_name) {
-            *title = std::string(net_wm_name);
-        } else {
-            char *wm_name = get_property(display, active_window,
-                                         XA_STRING, "WM_NAME", nullptr);
-            if (wm_name) {
-                *title = std::string(wm_name);
-            }
-            free(wm_name);
+    char *net_wm_name = get_property(
+        display_,
+        active_window,
+        utf8_string_,
+        net_wm_name_,
+        nullptr);
+    if (net_wm_name) {
+        *title = std::string(net_wm_name);
+    } else {
+        char *wm_name = get_property(display_, active_window,
+                                     XA_STRING, XA_WM_NAME, nullptr);
+        if (wm_name) {
+            *title = std::string(wm_name);
         }
-        free(net_wm_name);
+        free(wm_name);
     }
+    free(net_wm_name);
 
     // get pid of active window
-    unsigned long *pid = nullptr;
-    if (active_window) {
-        pid = reinterpret_cast<unsigned long*>(get_property(display, active_window,
-                                               XA_CARDINAL, "_NET_WM_PID", nullptr));
-        if (pid) {
-            // get process name by pid
-            char buf[256];
-            snprintf(buf, sizeof(buf), "/proc/%lu/stat", *pid);
-            const int fd = open(buf, O_RDONLY);
-            if (fd >= 0) {
-                const ssize_t len =
-                    HANDLE_EINTR(read(fd, buf, sizeof(buf) - 1));
-                HANDLE_EINTR(close(fd));
-                if (len > 0) {
-                    buf[len] = 0;
-                    // The start of the file looks like:
-                    //   <pid> (<name>) R <parent pid>
-                    unsigned tmp_pid, tmp_ppid;
-                    char *process_name = nullptr;
-                    if (sscanf(buf, "%u (%m[^)]) %*c %u", // NOLINT
-                               &tmp_pid, &process_name, &tmp_ppid) == 3) {
-                        *filename = std::string(process_name);
-                        free(process_name);
-                    }
-                }
+    unsigned long *pid = reinterpret_cast<unsigned long*>(get_property( // NOLINT
+        display_, active_window, XA_CARDINAL, net_wm_pid_, nullptr));
+    if (pid) {
+        // Looked up again for another window, the PID may have been reused
+        auto it = processes_.find(*pid);
+        if (it == processes_.end() || it->second.window != active_window) {
+            if (processes_.size() >= kMaxCachedProcessNames) {
+                processes_.clear();
             }
+            Process &process = processes_[*pid];
+            process.window = active_window;
+            process.name = read_process_name(*pid);
+            it = processes_.find(*pid);
         }
-        free(pid);
+        *filename = it->second.name;
     }
-
-    // Must close display, else max window client count is reached quickly
-    XCloseDisplay(display);
+    free(pid);
 
     return 0;
 }
+
+bool FocusTracker::Wait(const int timeout_millis) {
+    if (!display_ || !events_supported_) {
+        return false;
+    }
+    // Errors of earlier requests are read along with the events
+    IgnoreXErrors ignore(display_);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_millis / 1000;
+    deadline.tv_nsec += (timeout_millis % 1000) * 1000000L;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+
+    while (true) {
+        // Other windows and root properties change all the time,
+        // only wake up for the ones the timeline is made of
+        bool changed = false;
+        while (XPending(display_)) {
+            XEvent event;
+            XNextEvent(display_, &event);
+            changed = changed || relevant(event);
+        }
+        if (changed) {
+            return true;
+        }
+
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long left = (deadline.tv_sec - now.tv_sec) * 1000 // NOLINT
+                    + (deadline.tv_nsec - now.tv_nsec) / 1000000L;
+        if (left <= 0) {
+            return true;
+        }
+
+        struct pollfd fds[2];
+        fds[0].fd = ConnectionNumber(display_);
+        fds[0].events = POLLIN;
+        fds[1].fd = interrupt_[0];
+        fds[1].events = POLLIN;
+        const int count = interrupt_[0] >= 0 ? 2 : 1;
+        if (poll(fds, count, static_cast<int>(left)) < 0 && errno != EINTR) {
+            return false;
+        }
+        if (count > 1 && (fds[1].revents & POLLIN)) {
+            char buf[16];
+            while (read(interrupt_[0], buf, sizeof(buf)) > 0) {}
+            return true;
+        }
+    }
+}
+
+void FocusTracker::Interrupt() {
+    if (interrupt_[1] >= 0) {
+        HANDLE_EINTR(write(interrupt_[1], "x", 1));
+    }
+}
+
+int getFocusedWindowInfo(
+    std::string *title,
+    std::string *filename,
+    bool *idle) {
+    *title = "";
+    *filename = "";
+    *idle = false;
+
+    return FocusTracker::Instance().Read(title, filename);
+}
+
+bool waitForFocusChange(const int timeout_millis) {
+    return FocusTracker::Instance().Wait(timeout_millis);
+}
+
+void interruptFocusChangeWait() {
+    FocusTracker::Instance().Interrupt();
+}
@@ -81,3 +81,10 @@ int getFocusedWindowInfo(
 
     return 0;
 }
+
+bool waitForFocusChange(const int timeout_millis) {
+    return false;
+}
+
+void interruptFocusChangeWait() {
+}
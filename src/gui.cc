@@ -3,8 +3,12 @@
 
 #include "gui.h"
 
+#include <algorithm>
 #include <cstdlib>
+#include <limits>
+#include <map>
 #include <sstream>
+#include <unordered_map>
 
 #include "model/client.h"
 #include "const.h"
@@ -14,6 +18,7 @@
 #include "related_data.h"
 #include "model/task.h"
 #include "model/time_entry.h"
+#include "timeline_event_index.h"
 #include "model/user.h"
 #include "model/workspace.h"
 
@@ -23,8 +28,148 @@ namespace toggl {
 
 namespace view {
 
-bool TimeEntry::operator == (const TimeEntry&) const {
-    return false;
+bool TimeEntry::operator == (const TimeEntry& other) const {
+    return ID == other.ID
+           && DurationInSeconds == other.DurationInSeconds
+           && Description == other.Description
+           && ProjectAndTaskLabel == other.ProjectAndTaskLabel
+           && TaskLabel == other.TaskLabel
+           && ProjectLabel == other.ProjectLabel
+           && ClientLabel == other.ClientLabel
+           && WID == other.WID
+           && PID == other.PID
+           && TID == other.TID
+           && Duration == other.Duration
+           && Color == other.Color
+           && GUID == other.GUID
+           && Billable == other.Billable
+           && Tags == other.Tags
+           && Started == other.Started
+           && Ended == other.Ended
+           && StartTimeString == other.StartTimeString
+           && EndTimeString == other.EndTimeString
+           && UpdatedAt == other.UpdatedAt
+           && DurOnly == other.DurOnly
+           && DateHeader == other.DateHeader
+           && DateDuration == other.DateDuration
+           && IsHeader == other.IsHeader
+           && CanAddProjects == other.CanAddProjects
+           && CanSeeBillable == other.CanSeeBillable
+           && DefaultWID == other.DefaultWID
+           && WorkspaceName == other.WorkspaceName
+           && Unsynced == other.Unsynced
+           && Error == other.Error
+           && Locked == other.Locked
+           && Group == other.Group
+           && GroupOpen == other.GroupOpen
+           && GroupName == other.GroupName
+           && GroupDuration == other.GroupDuration
+           && GroupItemCount == other.GroupItemCount
+           && RoundedStart == other.RoundedStart
+           && RoundedEnd == other.RoundedEnd;
+}
+
+std::string TimeEntry::ListKey() const {
+    if (Group) {
+        return "group:" + GroupName;
+    }
+    return GUID;
+}
+
+namespace {
+
+const size_t kNoRow = std::numeric_limits<size_t>::max();
+
+// Marks the longest strictly increasing run of values, skipping kNoRow,
+// in O(N log N)
+std::vector<bool> longestIncreasing(const std::vector<size_t> &values) {
+    std::vector<size_t> tails;
+    std::vector<size_t> parent(values.size(), kNoRow);
+    for (size_t i = 0; i < values.size(); i++) {
+        if (kNoRow == values[i]) {
+            continue;
+        }
+        auto pos = std::lower_bound(
+            tails.begin(), tails.end(), values[i],
+        [&values](const size_t tail, const size_t value) {
+            return values[tail] < value;
+        });
+        if (pos != tails.begin()) {
+            parent[i] = *(pos - 1);
+        }
+        if (pos == tails.end()) {
+            tails.push_back(i);
+        } else {
+            *pos = i;
+        }
+    }
+
+    std::vector<bool> result(values.size(), false);
+    for (size_t i = tails.empty() ? kNoRow : tails.back();
+            i != kNoRow;
+            i = parent[i]) {
+        result[i] = true;
+    }
+    return result;
+}
+
+}  // namespace
+
+std::vector<TimeEntryListChange> TimeEntryListChange::Diff(
+    const std::vector<TimeEntry> &previous,
+    const std::vector<TimeEntry> &next) {
+
+    std::vector<TimeEntryListChange> result;
+
+    std::unordered_map<std::string, size_t> next_rows;
+    next_rows.reserve(next.size());
+    for (size_t i = 0; i < next.size(); i++) {
+        next_rows.emplace(next[i].ListKey(), i);
+    }
+
+    // Where each previous row is in the next list, if it's there
+    std::vector<size_t> targets(previous.size(), kNoRow);
+    std::vector<bool> claimed(next.size(), false);
+    for (size_t i = 0; i < previous.size(); i++) {
+        auto it = next_rows.find(previous[i].ListKey());
+        if (it != next_rows.end() && !claimed[it->second]) {
+            targets[i] = it->second;
+            claimed[it->second] = true;
+        }
+    }
+
+    // Rows in the longest run that keeps its order stay in place,
+    // the other rows are removed and inserted where they belong
+    std::vector<bool> stays = longestIncreasing(targets);
+
+    // Remove from the back, so the indexes stay valid
+    std::vector<size_t> sources(next.size(), kNoRow);
+    for (size_t i = previous.size(); i > 0; i--) {
+        if (stays[i - 1]) {
+            sources[targets[i - 1]] = i - 1;
+            continue;
+        }
+        // Removed rows are only identified, not rendered
+        TimeEntry removed;
+        removed.GUID = previous[i - 1].GUID;
+        removed.Group = previous[i - 1].Group;
+        removed.GroupName = previous[i - 1].GroupName;
+        result.push_back(
+            TimeEntryListChange(kTimeEntryListChangeRemove, i - 1, removed));
+    }
+
+    // Rows that stay are in the next order already
+    for (size_t i = 0; i < next.size(); i++) {
+        if (kNoRow == sources[i]) {
+            result.push_back(
+                TimeEntryListChange(kTimeEntryListChangeInsert, i, next[i]));
+        } else if (previous[sources[i]] != next[i]) {
+            result.push_back(
+                TimeEntryListChange(kTimeEntryListChangeUpdate, i, next[i]));
+        }
+    }
+
+    return result;
 }
 
 void TimeEntry::Fill(toggl::TimeEntry * const model) {
@@ -144,6 +289,11 @@ void GUI::DisplayLogin(const bool open, const uint64_t user_id) {
 
     on_display_login_(open, user_id);
 
+    // UI clears the time entry list on logout
+    if (open || !user_id) {
+        resetTimeEntryList = true;
+    }
+
     lastDisplayLoginOpen = open;
     lastDisplayLoginUserID = user_id;
 }
@@ -218,7 +368,8 @@ error GUI::findMissingCallbacks() {
     if (!on_display_reminder_) {
         return error("!on_display_reminder_");
     }
-    if (!on_display_time_entry_list_) {
+    if (!on_display_time_entry_list_
+            && !on_display_time_entry_list_changes_) {
         return error("!on_display_time_entry_list_");
     }
     if (!on_display_time_entry_autocomplete_) {
@@ -407,6 +558,7 @@ void GUI::DisplayTimeEntryList(const bool open,
     auto renderList = std::vector<view::TimeEntry>();
     stopwatch.start();
     {
+        Poco::Mutex::ScopedLock lock(time_entry_list_m_);
         if (this->isFirstLaunch) {
             this->isFirstLaunch = false;
 
@@ -425,28 +577,85 @@ void GUI::DisplayTimeEntryList(const bool open,
         logger.debug("DisplayTimeEntryList open=", open, ", has items=", renderList.size());
     }
 
-    // Render
-    TogglTimeEntryView *first = nullptr;
-    for (unsigned int i = 0; i < renderList.size(); i++) {
-        view::TimeEntry te = renderList.at(i);
-        TogglTimeEntryView *item = time_entry_view_item_init(te);
-        item->Next = first;
-        if (first && compare_string(item->DateHeader, first->DateHeader) != 0) {
+    if (on_display_time_entry_list_changes_) {
+        displayTimeEntryListChanges(open, renderList, show_load_more_button);
+    } else {
+        // Render
+        TogglTimeEntryView *first = nullptr;
+        for (unsigned int i = 0; i < renderList.size(); i++) {
+            view::TimeEntry te = renderList.at(i);
+            TogglTimeEntryView *item = time_entry_view_item_init(te);
+            item->Next = first;
+            if (first && compare_string(item->DateHeader, first->DateHeader) != 0) {
+                first->IsHeader = true;
+            }
+            first = item;
+        }
+
+        if (first) {
             first->IsHeader = true;
         }
-        first = item;
+
+        on_display_time_entry_list_(open, first, show_load_more_button);
+
+        time_entry_view_list_clear(first);
     }
 
-    if (first) {
-        first->IsHeader = true;
+    stopwatch.stop();
+    logger.debug("DisplayTimeEntryList done in ", stopwatch.elapsed() / 1000, " ms");
+}
+
+void GUI::displayTimeEntryListChanges(
+    const bool open,
+    const std::vector<view::TimeEntry> &list,
+    const bool show_load_more_button) {
+
+    // Newest first, date header on the first entry of each date
+    std::vector<view::TimeEntry> rendered(list.rbegin(), list.rend());
+    for (size_t i = 0; i < rendered.size(); i++) {
+        rendered[i].IsHeader = !i
+                               || rendered[i].DateHeader != rendered[i - 1].DateHeader;
     }
 
-    on_display_time_entry_list_(open, first, show_load_more_button);
+    Poco::Mutex::ScopedLock lock(time_entry_list_m_);
 
-    time_entry_view_list_clear(first);
+    bool reset = resetTimeEntryList;
+    if (reset) {
+        lastTimeEntryList.clear();
+    }
 
-    stopwatch.stop();
-    logger.debug("DisplayTimeEntryList done in ", stopwatch.elapsed() / 1000, " ms");
+    std::vector<view::TimeEntryListChange> changes =
+        view::TimeEntryListChange::Diff(lastTimeEntryList, rendered);
+
+    if (!open && !reset && changes.empty()
+            && show_load_more_button == lastShowLoadMoreButton) {
+        return;
+    }
+
+    TogglTimeEntryListChangeView *first = nullptr;
+    TogglTimeEntryListChangeView *last = nullptr;
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        TogglTimeEntryListChangeView *item =
+            time_entry_list_change_view_item_init(*it);
+        if (last) {
+            last->Next = item;
+        } else {
+            first = item;
+        }
+        last = item;
+    }
+
+    logger.debug("DisplayTimeEntryList changes=", changes.size(),
+                 ", reset=", reset);
+
+    on_display_time_entry_list_changes_(
+        open, reset, first, show_load_more_button);
+
+    time_entry_list_change_view_list_clear(first);
+
+    lastTimeEntryList.swap(rendered);
+    lastShowLoadMoreButton = show_load_more_button;
+    resetTimeEntryList = false;
 }
 
 void GUI::DisplayTimeline(const bool open,
@@ -482,6 +691,14 @@ void GUI::DisplayTimeline(const bool open,
         }
     }
 
+    // Group the events by chunk once, instead of for every chunk
+    std::map<time_t, std::vector<const TimelineEvent *> > chunks;
+    for (std::vector<const TimelineEvent*>::const_iterator it = list.begin();
+            it != list.end(); it++) {
+        chunks[TimelineEventIndex::ChunkStart((*it)->Start())].push_back(*it);
+    }
+    const std::vector<const TimelineEvent *> no_events;
+
     // Get activity
     while (datetime.year() == TimelineDateAt().year()
             && datetime.month() == TimelineDateAt().month()
@@ -496,34 +713,26 @@ void GUI::DisplayTimeline(const bool open,
         // Attach matching events to chunk
         TogglTimelineEventView *first_event = nullptr;
         TogglTimelineEventView *ev = nullptr;
-        for (std::vector<const TimelineEvent*>::const_iterator it = list.begin();
-                it != list.end(); it++) {
+        auto chunk = chunks.find(epoch_time);
+        const std::vector<const TimelineEvent *> &chunk_events =
+            chunk != chunks.end() ? chunk->second : no_events;
+        for (std::vector<const TimelineEvent*>::const_iterator it = chunk_events.begin();
+                it != chunk_events.end(); it++) {
             const TimelineEvent *event = *it;
 
-            // Calculate the start time of the chunk
-            // that fits this timeline event
-            time_t chunk_start_time =
-                (event->Start() / kTimelineChunkSeconds)
-                * kTimelineChunkSeconds;
-
-            if (epoch_time != chunk_start_time) {
-                // Skip event if does not match chunk
-                continue;
-            }
-
             // Grouping the items to parent-event and sub-events
 
             bool app_present = false;
             bool item_present = false;
             TogglTimelineEventView *event_app = first_event;
             while (event_app) {
-                if (compare_string(event_app->Filename, to_char_t(event->Filename())) == 0) {
+                if (compare_string(event_app->Filename, to_char_t(event->Filename().str())) == 0) {
                     timeline_event_view_update_duration(event_app, event_app->Duration + event->Duration());
                     app_present = true;
                     item_present = false;
                     ev = reinterpret_cast<TogglTimelineEventView *>(event_app->Event);
                     while (ev) {
-                        if (compare_string(ev->Title, to_char_t(event->Title())) == 0) {
+                        if (compare_string(ev->Title, to_char_t(event->Title().str())) == 0) {
                             timeline_event_view_update_duration(ev, ev->Duration + event->Duration());
                             item_present = true;
                         }
@@ -18,6 +18,7 @@
 #include "onboarding_service.h"
 
 #include <Poco/LocalDateTime.h>
+#include <Poco/Mutex.h>
 
 namespace toggl {
 
@@ -49,6 +50,7 @@ class TOGGL_INTERNAL_EXPORT TimeEntry {
     , DurOnly(false)
     , DateHeader("")
     , DateDuration("")
+    , IsHeader(false)
     , CanAddProjects(false)
     , CanSeeBillable(false)
     , DefaultWID(0)
@@ -88,6 +90,7 @@ class TOGGL_INTERNAL_EXPORT TimeEntry {
     // In case it's a header
     std::string DateHeader;
     std::string DateDuration;
+    bool IsHeader;
     // Additional fields; only when in time entry editor
     bool CanAddProjects;
     bool CanSeeBillable;
@@ -113,6 +116,39 @@ class TOGGL_INTERNAL_EXPORT TimeEntry {
     void Fill(toggl::TimeEntry * const model);
 
     bool operator == (const TimeEntry& other) const;
+    bool operator != (const TimeEntry& other) const {
+        return !(*this == other);
+    }
+
+    // Identity of the row in the time entry list. Group headers carry
+    // the GUID of their latest entry, so they are keyed by group name.
+    std::string ListKey() const;
+};
+
+// Single step of turning one rendered time entry list into another
+class TOGGL_INTERNAL_EXPORT TimeEntryListChange {
+ public:
+    TimeEntryListChange(
+        const int64_t type,
+        const uint64_t index,
+        const TimeEntry &item)
+        : Type(type)
+    , Index(index)
+    , Item(item) {}
+
+    // kTimeEntryListChangeInsert, Update or Remove
+    int64_t Type;
+    // Position after all the preceding changes are applied
+    uint64_t Index;
+    // Removals carry only the GUID, Group and GroupName
+    TimeEntry Item;
+
+    // Changes turning the previous list into the next one: removals
+    // first, then inserts and updates by ascending index.
+    // Moved rows are removed and inserted again.
+    static std::vector<TimeEntryListChange> Diff(
+        const std::vector<TimeEntry> &previous,
+        const std::vector<TimeEntry> &next);
 };
 
 class TOGGL_INTERNAL_EXPORT Autocomplete {
@@ -390,6 +426,7 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
     , on_display_countries_(nullptr)
     , on_continue_sign_in(nullptr)
     , on_display_timeline_ui(nullptr)
+    , on_display_time_entry_list_changes_(nullptr)
     , lastSyncState(-1)
     , lastUnsyncedItemsCount(-1)
     , lastDisplayLoginOpen(false)
@@ -397,6 +434,8 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
     , lastOnlineState(-1)
     , lastErr(noError)
     , isFirstLaunch(true)
+    , resetTimeEntryList(true)
+    , lastShowLoadMoreButton(false)
     , time_entry_editor_guid_("")
     , timeline_date_at_(Poco::LocalDateTime()) {}
 
@@ -578,6 +617,10 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
         on_display_time_entry_list_ = cb;
     }
 
+    void OnDisplayTimeEntryListChanges(TogglDisplayTimeEntryListChanges cb) {
+        on_display_time_entry_list_changes_ = cb;
+    }
+
     void OnDisplayTimeline(TogglDisplayTimeline cb) {
         on_display_timeline_ = cb;
     }
@@ -677,7 +720,9 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
     }
 
     void resetFirstLaunch() {
+        Poco::Mutex::ScopedLock lock(time_entry_list_m_);
         isFirstLaunch = true;
+        resetTimeEntryList = true;
     }
 
     const Poco::LocalDateTime &TimelineDateAt() {
@@ -712,6 +757,11 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
  private:
     error findMissingCallbacks();
 
+    void displayTimeEntryListChanges(
+        const bool open,
+        const std::vector<view::TimeEntry> &list,
+        const bool show_load_more_button);
+
     TogglDisplayApp on_display_app_;
     TogglDisplayError on_display_error_;
     TogglDisplayOverlay on_display_overlay_;
@@ -748,6 +798,7 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
     TogglContinueSignIn on_continue_sign_in;
     TogglDisplayLoginSSO on_display_login_sso;
     TogglDisplayTimelineUI on_display_timeline_ui;
+    TogglDisplayTimeEntryListChanges on_display_time_entry_list_changes_;
 
     // Cached views
     Poco::Int64 lastSyncState;
@@ -757,6 +808,13 @@ class TOGGL_INTERNAL_EXPORT GUI : public SyncStateMonitor {
     Poco::Int64 lastOnlineState;
     error lastErr;
     bool isFirstLaunch;
+    // Time entry list as last sent to the changes callback. Renders
+    // come from several threads, so diffing against it and sending
+    // the changes is done with the lock held.
+    Poco::Mutex time_entry_list_m_;
+    std::vector<view::TimeEntry> lastTimeEntryList;
+    bool resetTimeEntryList;
+    bool lastShowLoadMoreButton;
 
     // UI state
     std::string time_entry_editor_guid_;
@@ -4,16 +4,22 @@
 
 #include <json/json.h>
 
+#include <algorithm>
+#include <atomic>
+#include <limits>
 #include <string>
 #include <sstream>
 #include <memory>
+#include <thread>
 
+#include "error.h"
 #include "util/formatter.h"
 #include "netconf.h"
 #include "urls.h"
 #include "toggl_api.h"
 
 #include <Poco/DeflatingStream.h>
+#include <Poco/DigestStream.h>
 #include <Poco/Environment.h>
 #include <Poco/Exception.h>
 #include <Poco/FileStream.h>
@@ -32,8 +38,10 @@
 #include <Poco/Net/PrivateKeyPassphraseHandler.h>
 #include <Poco/Net/SecureStreamSocket.h>
 #include <Poco/Net/Session.h>
+#include <Poco/Net/Socket.h>
 #include <Poco/Net/SSLManager.h>
 #include <Poco/NumberParser.h>
+#include <Poco/SHA1Engine.h>
 #include <Poco/StreamCopier.h>
 #include <Poco/TextEncoding.h>
 #include <Poco/UTF8Encoding.h>
@@ -70,14 +78,98 @@ void HTTPClient::resetPocoContext() {
         Poco::Net::Context::CLIENT_USE, "", "",
         HTTPClient::Config.CACertPath(),
         verification_mode, 9, true, "ALL");
+    // Lets new connections resume the TLS sessions of earlier ones
+    _context->enableSessionCache(true);
     Poco::Net::SSLManager::instance().initializeClient(
         nullptr, acceptCertHandler, _context);
     context = _context;
+
+    // Sessions of the old context must not be reused
+    sessions_.Clear();
+}
+
+bool HTTPSessionPool::usable(const Idle &idle) {
+    // Poco would reconnect after the keep-alive timeout anyway,
+    // and servers close idle connections on their own schedule
+    if (!idle.session->connected()
+            || idle.since.isElapsed(
+                idle.session->getKeepAliveTimeout().totalMicroseconds())) {
+        return false;
+    }
+    // An idle connection is readable only when the server has closed it
+    // or sent something unexpected, neither leaves it usable
+    return !idle.session->socket().poll(
+        Poco::Timespan(0),
+        Poco::Net::Socket::SELECT_READ | Poco::Net::Socket::SELECT_ERROR);
+}
+
+HTTPSessionPool::SessionPtr HTTPSessionPool::Acquire(const std::string &key) {
+    Poco::Mutex::ScopedLock lock(m_);
+
+    auto it = idle_.find(key);
+    if (it == idle_.end()) {
+        return nullptr;
+    }
+    // Most recently released first, it's the least likely to be closed
+    while (!it->second.empty()) {
+        Idle idle = it->second.back();
+        it->second.pop_back();
+        try {
+            if (usable(idle)) {
+                return idle.session;
+            }
+        } catch(const Poco::Exception &) {
+            // Broken socket, drop the session
+        }
+    }
+    return nullptr;
+}
+
+void HTTPSessionPool::Release(const std::string &key, SessionPtr session) {
+    poco_check_ptr(session);
+
+    Poco::Net::Session::Ptr tls;
+    Poco::Net::HTTPSClientSession *secure =
+        dynamic_cast<Poco::Net::HTTPSClientSession *>(session.get());
+    if (secure) {
+        tls = secure->sslSession();
+    }
+
+    Poco::Mutex::ScopedLock lock(m_);
+
+    if (!tls.isNull()) {
+        tls_[key] = tls;
+    }
+
+    std::vector<Idle> &idle = idle_[key];
+    if (idle.size() >= kHTTPSessionPoolSize) {
+        // The oldest one is the first to time out
+        idle.erase(idle.begin());
+    }
+    idle.push_back({ session, Poco::Timestamp() });
+}
+
+Poco::Net::Session::Ptr HTTPSessionPool::TLSSession(const std::string &key) {
+    Poco::Mutex::ScopedLock lock(m_);
+
+    auto it = tls_.find(key);
+    if (it == tls_.end()) {
+        return nullptr;
+    }
+    return it->second;
+}
+
+void HTTPSessionPool::Clear() {
+    Poco::Mutex::ScopedLock lock(m_);
+
+    idle_.clear();
+    tls_.clear();
 }
 
 void ServerStatus::startStatusCheck() {
-    logger().debug("startStatusCheck fast_retry=", fast_retry_);
+    logger().debug("startStatusCheck fast_retry=", fast_retry_.load());
 
+    Poco::Mutex::ScopedLock lock(checker_m_);
     if (checker_.isRunning()) {
         return;
     }
@@ -85,6 +177,7 @@ void ServerStatus::startStatusCheck() {
 }
 
 void ServerStatus::stopStatusCheck(const std::string &reason) {
+    Poco::Mutex::ScopedLock lock(checker_m_);
     if (!checker_.isRunning() || checker_.isStopped()) {
         return;
     }
@@ -145,7 +238,9 @@ void ServerStatus::runActivity() {
             continue;
         }
 
-        stopStatusCheck("No error from backend");
+        // Not stopStatusCheck, the checker can't wait for itself
+        logger().debug("Status check done, no error from backend");
+        return;
     }
 }
 
@@ -153,6 +248,7 @@ error ServerStatus::Status() {
     if (gone_) {
         return kEndpointGoneError;
     }
+    Poco::Mutex::ScopedLock lock(checker_m_);
     if (checker_.isRunning() && !checker_.isStopped()) {
         return kBackendIsDownError;
     }
@@ -174,7 +270,9 @@ void ServerStatus::UpdateStatus(const Poco::Int64 code) {
 }
 
 HTTPClientConfig HTTPClient::Config;
+HTTPSessionPool HTTPClient::sessions_;
 std::map<std::string, Poco::Timestamp> HTTPClient::banned_until_;
+Poco::Mutex HTTPClient::banned_until_m_;
 
 Logger HTTPClient::logger() const {
     return { "HTTPClient" };
@@ -264,6 +362,65 @@ HTTPResponse HTTPClient::Put(
     return request(req);
 }
 
+HTTPResponse HTTPClient::Send(
+    HTTPRequest req) const {
+    return request(req);
+}
+
+void HTTPClient::SendAll(
+    const std::vector<HTTPRequest> &requests,
+    const Sender &send,
+    const size_t concurrency,
+    std::vector<HTTPResponse> *responses,
+    std::vector<bool> *sent) {
+
+    poco_check_ptr(responses);
+    poco_check_ptr(sent);
+
+    responses->assign(requests.size(), HTTPResponse());
+    // Not vector<bool>, as the workers set elements concurrently
+    std::vector<char> done(requests.size(), false);
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> offline(false);
+    auto worker = [&]() {
+        while (!offline) {
+            size_t i = next++;
+            if (i >= requests.size()) {
+                return;
+            }
+            HTTPResponse resp;
+            // Exceptions must not escape a worker thread
+            try {
+                resp = send(requests[i]);
+            } catch(const std::exception& ex) {
+                resp.err = ex.what();
+            }
+            // Backend being down counts as a networking error too
+            if (IsNetworkingError(resp.err)) {
+                offline = true;
+            }
+            (*responses)[i] = resp;
+            done[i] = true;
+        }
+    };
+
+    size_t threads = std::min(concurrency, requests.size());
+    if (threads <= 1) {
+        worker();
+    } else {
+        std::vector<std::thread> workers;
+        for (size_t i = 0; i < threads; i++) {
+            workers.push_back(std::thread(worker));
+        }
+        for (auto it = workers.begin(); it != workers.end(); ++it) {
+            it->join();
+        }
+    }
+
+    sent->assign(done.begin(), done.end());
+}
+
 HTTPResponse HTTPClient::request(
     HTTPRequest req) const {
     HTTPResponse resp = makeHttpRequest(req);
@@ -296,14 +453,17 @@ HTTPResponse HTTPClient::makeHttpRequest(
         return resp;
     }
 
-    std::map<std::string, Poco::Timestamp>::const_iterator cit =
-        banned_until_.find(req.host);
-    if (cit != banned_until_.end()) {
-        if (cit->second >= Poco::Timestamp()) {
-            logger().warning(
-                "Cannot connect, because we made too many requests");
-            resp.err = kCannotConnectError;
-            return resp;
+    {
+        Poco::Mutex::ScopedLock lock(banned_until_m_);
+        std::map<std::string, Poco::Timestamp>::const_iterator cit =
+            banned_until_.find(req.host);
+        if (cit != banned_until_.end()) {
+            if (cit->second >= Poco::Timestamp()) {
+                logger().warning(
+                    "Cannot connect, because we made too many requests");
+                resp.err = kCannotConnectError;
+                return resp;
+            }
         }
     }
 
@@ -327,18 +487,6 @@ HTTPResponse HTTPClient::makeHttpRequest(
     try {
         Poco::URI uri(req.host);
 
-        std::shared_ptr<Poco::Net::HTTPClientSession> session;
-        if (uri.getScheme() == "http") {
-            session = std::make_shared<Poco::Net::HTTPClientSession>(uri.getHost(), uri.getPort());
-        }
-        else {
-            session = std::make_shared<Poco::Net::HTTPSClientSession>(uri.getHost(), uri.getPort(), context);
-        }
-
-        session->setKeepAlive(true);
-        session->setTimeout(
-            Poco::Timespan(req.timeout_seconds * Poco::Timespan::SECONDS));
-
         logger().debug("Sending request to ", req.host, req.relative_url, " ..");
 
         std::string encoded_url("");
@@ -351,12 +499,51 @@ HTTPResponse HTTPClient::makeHttpRequest(
             encoded_url = url.getPathAndQuery();
         }
 
-        error err = Netconf::ConfigureProxy(req.host + encoded_url, session.get());
+        // Proxy settings can change between requests, so they're resolved
+        // on a blank session and are a part of the pool key
+        Poco::Net::HTTPClientSession proxy_session;
+        error err = Netconf::ConfigureProxy(req.host + encoded_url, &proxy_session);
         if (err != noError) {
             resp.err = error("Error while configuring proxy: " + err);
             logger().error(resp.err);
             return resp;
         }
+        const Poco::Net::HTTPClientSession::ProxyConfig &proxy =
+            proxy_session.getProxyConfig();
+
+        // Only a digest of the proxy credentials, the key
+        // shouldn't keep the password around in plain text
+        Poco::SHA1Engine sha1;
+        Poco::DigestOutputStream credentials(sha1);
+        credentials << proxy.username << ":" << proxy.password;
+        credentials.flush();
+
+        std::stringstream pool_key;
+        pool_key << uri.getScheme() << "://" << uri.getHost()
+                 << ":" << uri.getPort() << " " << proxy.host
+                 << ":" << proxy.port << " "
+                 << Poco::DigestEngine::digestToHex(sha1.digest());
+
+        HTTPSessionPool::SessionPtr session;
+        if (HTTPClient::Config.PoolSessions) {
+            session = sessions_.Acquire(pool_key.str());
+        }
+        if (session) {
+            logger().debug("Reusing connection to ", req.host);
+        } else if (uri.getScheme() == "http") {
+            session = std::make_shared<Poco::Net::HTTPClientSession>(uri.getHost(), uri.getPort());
+        } else {
+            session = std::make_shared<Poco::Net::HTTPSClientSession>(
+                uri.getHost(), uri.getPort(), context,
+                sessions_.TLSSession(pool_key.str()));
+        }
+        if (!session->connected()) {
+            session->setProxyConfig(proxy);
+        }
+
+        session->setKeepAlive(true);
+        session->setTimeout(
+            Poco::Timespan(req.timeout_seconds * Poco::Timespan::SECONDS));
 
         Poco::Net::HTTPRequest poco_req(req.method,
                                         encoded_url,
@@ -370,7 +557,7 @@ HTTPResponse HTTPClient::makeHttpRequest(
         }
 
         // FIXME: should get content type as parameter instead
-        if (req.payload.size()) {
+        if (req.payload.size() || req.payload_writer) {
             poco_req.setContentType(kContentTypeApplicationJSON);
         }
         poco_req.set("User-Agent", HTTPClient::Config.UserAgent());
@@ -389,24 +576,28 @@ HTTPResponse HTTPClient::makeHttpRequest(
         poco_req.set("X-Toggl-Client", "desktop");
 
         if (!req.form) {
-            std::istringstream requestStream(req.payload);
-
-            Poco::DeflatingInputStream gzipRequest(
-                requestStream,
-                Poco::DeflatingStreamBuf::STREAM_GZIP);
-            Poco::DeflatingStreamBuf *pBuff = gzipRequest.rdbuf();
-
-            Poco::Int64 size =
-                pBuff->pubseekoff(0, std::ios::end, std::ios::in);
-            pBuff->pubseekpos(0, std::ios::in);
-
-            if (req.method != Poco::Net::HTTPRequest::HTTP_GET) {
-                poco_req.setContentLength(size);
+            const bool has_body =
+                req.method != Poco::Net::HTTPRequest::HTTP_GET;
+            if (has_body) {
                 poco_req.set("Content-Encoding", "gzip");
                 poco_req.setChunkedTransferEncoding(true);
             }
 
-            session->sendRequest(poco_req) << pBuff << std::flush;
+            std::ostream &send = session->sendRequest(poco_req);
+            if (has_body) {
+                // Compressed while it's sent, chunked encoding
+                // doesn't need the size to be known up front
+                Poco::DeflatingOutputStream gzip(
+                    send,
+                    Poco::DeflatingStreamBuf::STREAM_GZIP);
+                if (req.payload_writer) {
+                    req.payload_writer(gzip);
+                } else {
+                    gzip << req.payload;
+                }
+                gzip.close();
+            }
+            send.flush();
         } else {
             req.form->prepareSubmit(poco_req);
             std::ostream& send = session->sendRequest(poco_req);
@@ -461,6 +652,21 @@ HTTPResponse HTTPClient::makeHttpRequest(
             Poco::URI::decode(response.get("Location"), decoded_url);
             resp.body = decoded_url;
 
+            // Read the body as it arrives
+        } else if (req.body_reader
+                   && resp.status_code >= 200 && resp.status_code < 300) {
+            if (response.has("Content-Encoding") &&
+                    "gzip" == response.get("Content-Encoding")) {
+                Poco::InflatingInputStream inflater(is, Poco::InflatingStreamBuf::STREAM_GZIP);
+                resp.err = req.body_reader(inflater);
+            } else {
+                resp.err = req.body_reader(is);
+            }
+            if (resp.err != noError) {
+                logger().error(resp.err);
+                return resp;
+            }
+
             // Inflate, if gzip was sent
         } else if (response.has("Content-Encoding") &&
                    "gzip" == response.get("Content-Encoding")) {
@@ -479,9 +685,19 @@ HTTPResponse HTTPClient::makeHttpRequest(
 
         logger().trace(resp.body);
 
+        // The connection can only be reused once the response is consumed
+        is.ignore(std::numeric_limits<std::streamsize>::max());
+        if (HTTPClient::Config.PoolSessions
+                && response.getKeepAlive() && !is.bad()) {
+            sessions_.Release(pool_key.str(), session);
+        }
+
         if (429 == resp.status_code) {
             Poco::Timestamp ts = Poco::Timestamp() + (60 * kOneSecondInMicros);
-            banned_until_[req.host] = ts;
+            {
+                Poco::Mutex::ScopedLock lock(banned_until_m_);
+                banned_until_[req.host] = ts;
+            }
 
             logger().debug("Server indicated we're making too many requests to host ", req.host,
                            ". So we cannot make new requests until ", Formatter::Format8601(ts));
@@ -536,6 +752,31 @@ Logger TogglClient::logger() const {
 
 HTTPResponse TogglClient::request(
     HTTPRequest req) const {
+    return statusCheckedRequest(req, true);
+}
+
+void TogglClient::SendAllReportingOnce(
+    const std::vector<HTTPRequest> &requests,
+    const size_t concurrency,
+    std::vector<HTTPResponse> *responses,
+    std::vector<bool> *sent) const {
+
+    if (monitor_) {
+        monitor_->DisplaySyncState(kSyncStateWork);
+    }
+
+    SendAll(requests, [this](const HTTPRequest &req) {
+        return statusCheckedRequest(req, false);
+    }, concurrency, responses, sent);
+
+    if (monitor_) {
+        monitor_->DisplaySyncState(kSyncStateIdle);
+    }
+}
+
+HTTPResponse TogglClient::statusCheckedRequest(
+    HTTPRequest req,
+    const bool report_sync_state) const {
 
     error err = TogglStatus.Status();
     if (err != noError) {
@@ -545,13 +786,13 @@ HTTPResponse TogglClient::request(
         return resp;
     }
 
-    if (monitor_) {
+    if (report_sync_state && monitor_) {
         monitor_->DisplaySyncState(kSyncStateWork);
     }
 
     HTTPResponse resp = HTTPClient::request(req);
 
-    if (monitor_) {
+    if (report_sync_state && monitor_) {
         monitor_->DisplaySyncState(kSyncStateIdle);
     }
 
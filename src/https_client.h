@@ -3,7 +3,11 @@
 #ifndef SRC_HTTPS_CLIENT_H_
 #define SRC_HTTPS_CLIENT_H_
 
+#include <atomic>
+#include <functional>
+#include <istream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -14,8 +18,11 @@
 #include "util/logger.h"
 
 #include <Poco/Activity.h>
+#include <Poco/Mutex.h>
 #include <Poco/Timestamp.h>
 #include <Poco/Net/Context.h>
+#include <Poco/Net/HTTPClientSession.h>
+#include <Poco/Net/Session.h>
 #include <Poco/URI.h>
 
 namespace Poco {
@@ -48,9 +55,12 @@ class TOGGL_INTERNAL_EXPORT ServerStatus {
     void runActivity();
 
  private:
-    bool gone_;
+    // Requests update the status from several threads at a time
+    std::atomic<bool> gone_;
     Poco::Activity<ServerStatus> checker_;
-    bool fast_retry_;
+    std::atomic<bool> fast_retry_;
+    // Held while the checker is started, stopped or looked at
+    Poco::Mutex checker_m_;
 
     void setGone(const bool value);
     bool gone();
@@ -70,6 +80,7 @@ class TOGGL_INTERNAL_EXPORT HTTPClientConfig {
     , UseProxy(false)
     , ProxySettings(Proxy())
     , AutodetectProxy(true)
+    , PoolSessions(true)
     , ignoreCert(false)
     , caCertPath("") {}
     ~HTTPClientConfig() {}
@@ -79,6 +90,8 @@ class TOGGL_INTERNAL_EXPORT HTTPClientConfig {
     bool UseProxy;
     toggl::Proxy ProxySettings;
     bool AutodetectProxy;
+    // Reuse keep-alive connections between requests
+    bool PoolSessions;
 
     std::string UserAgent() const {
         std::stringstream ss;
@@ -127,6 +140,14 @@ class TOGGL_INTERNAL_EXPORT HTTPRequest {
     Poco::Net::HTMLForm *form;
     Poco::URI::QueryParameters *query;
     Poco::Int64 timeout_seconds;
+
+    // When set, a successful response body is passed to it while
+    // it's being received, instead of being collected into body
+    std::function<error(std::istream &)> body_reader;
+
+    // When set, writes the payload straight into the compressed
+    // request stream, instead of it being built as a string first
+    std::function<void(std::ostream &)> payload_writer;
 };
 
 class TOGGL_INTERNAL_EXPORT HTTPResponse {
@@ -142,6 +163,38 @@ class TOGGL_INTERNAL_EXPORT HTTPResponse {
     Poco::Int64 status_code;
 };
 
+// Keeps idle keep-alive sessions per server, so that following requests
+// skip the TCP handshake, and remembers the last TLS session negotiated
+// with each server, so that new connections can resume it.
+class TOGGL_INTERNAL_EXPORT HTTPSessionPool {
+ public:
+    typedef std::shared_ptr<Poco::Net::HTTPClientSession> SessionPtr;
+
+    HTTPSessionPool() {}
+
+    // Returns an idle session that is still connected, or null
+    SessionPtr Acquire(const std::string &key);
+
+    // Takes back a session whose last response was read to the end
+    void Release(const std::string &key, SessionPtr session);
+
+    Poco::Net::Session::Ptr TLSSession(const std::string &key);
+
+    void Clear();
+
+ private:
+    struct Idle {
+        SessionPtr session;
+        Poco::Timestamp since;
+    };
+
+    static bool usable(const Idle &idle);
+
+    Poco::Mutex m_;
+    std::map<std::string, std::vector<Idle> > idle_;
+    std::map<std::string, Poco::Net::Session::Ptr> tls_;
+};
+
 class TOGGL_INTERNAL_EXPORT HTTPClient {
  public:
     HTTPClient() {}
@@ -159,6 +212,23 @@ class TOGGL_INTERNAL_EXPORT HTTPClient {
     HTTPResponse Put(
         HTTPRequest req) const;
 
+    // Uses the method set in the request
+    HTTPResponse Send(
+        HTTPRequest req) const;
+
+    typedef std::function<HTTPResponse(const HTTPRequest &)> Sender;
+
+    // Sends the requests on up to concurrency threads at a time, with
+    // the responses in request order. After a request fails with a
+    // networking error or the backend is down no new ones are started,
+    // sent tells which were.
+    static void SendAll(
+        const std::vector<HTTPRequest> &requests,
+        const Sender &send,
+        const size_t concurrency,
+        std::vector<HTTPResponse> *responses,
+        std::vector<bool> *sent);
+
     static HTTPClientConfig Config;
 
     void SetCACertPath(std::string path);
@@ -177,6 +247,9 @@ class TOGGL_INTERNAL_EXPORT HTTPClient {
 
     // We only make requests if this timestamp lies in the past.
     static std::map<std::string, Poco::Timestamp> banned_until_;
+    static Poco::Mutex banned_until_m_;
+
+    static HTTPSessionPool sessions_;
 
     error accountLockingError(int remainingLogins) const;
 
@@ -221,12 +294,24 @@ class TOGGL_INTERNAL_EXPORT TogglClient : public HTTPClient {
     HTTPResponse silentPut(
         HTTPRequest req) const;
 
+    // Like HTTPClient::SendAll, but the sync state is reported once
+    // from the calling thread instead of from every worker.
+    void SendAllReportingOnce(
+        const std::vector<HTTPRequest> &requests,
+        const size_t concurrency,
+        std::vector<HTTPResponse> *responses,
+        std::vector<bool> *sent) const;
+
  protected:
     virtual HTTPResponse request(HTTPRequest req) const override;
     virtual Logger logger() const override;
 
  private:
     TogglClient() {};
+
+    HTTPResponse statusCheckedRequest(
+        HTTPRequest req,
+        const bool report_sync_state) const;
     SyncStateMonitor *monitor_;
 };
 
@@ -144,9 +144,27 @@ BaseModel::BaseModel(const BaseModel &o)
 {
 }
 
+void BaseModel::Unindex() {
+    if (key_observer_) {
+        key_observer_->Remove(this);
+    }
+}
+
+void BaseModel::SetLocalID(Poco::Int64 value) {
+    Poco::Int64 previous = LocalID();
+    if (LocalID.Set(value) && key_observer_) {
+        key_observer_->LocalIDChanged(this, previous);
+    }
+}
+
 void BaseModel::SetID(Poco::UInt64 value) {
-    if (ID.Set(value))
+    Poco::UInt64 previous = ID();
+    if (ID.Set(value)) {
         SetDirty();
+        if (key_observer_) {
+            key_observer_->IDChanged(this, previous);
+        }
+    }
 }
 
 void BaseModel::SetUIModifiedAt(Poco::Int64 value) {
@@ -155,8 +173,13 @@ void BaseModel::SetUIModifiedAt(Poco::Int64 value) {
 }
 
 void BaseModel::SetGUID(const std::string &value) {
-    if (GUID.Set(value))
+    guid previous = GUID();
+    if (GUID.Set(value)) {
         SetDirty();
+        if (key_observer_) {
+            key_observer_->GUIDChanged(this, previous);
+        }
+    }
 }
 
 void BaseModel::SetUID(Poco::UInt64 value) {
@@ -165,7 +188,9 @@ void BaseModel::SetUID(Poco::UInt64 value) {
 }
 
 void BaseModel::SetDirty() {
-    Dirty.Set(true);
+    if (Dirty.Set(true) && key_observer_) {
+        key_observer_->Dirtied(this);
+    }
 }
 
 void BaseModel::ClearDirty() {
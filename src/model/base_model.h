@@ -20,6 +20,22 @@
 
 namespace toggl {
 
+class BaseModel;
+
+// Lookup index a model is registered in (see RelatedData).
+// It gets notified whenever one of the lookup keys of the model changes
+// and whenever the model becomes dirty.
+class TOGGL_INTERNAL_EXPORT ModelKeyObserver {
+ public:
+    virtual ~ModelKeyObserver() {}
+
+    virtual void LocalIDChanged(BaseModel *model, Poco::Int64 previous) = 0;
+    virtual void IDChanged(BaseModel *model, Poco::UInt64 previous) = 0;
+    virtual void GUIDChanged(BaseModel *model, const guid &previous) = 0;
+    virtual void Dirtied(BaseModel *model) = 0;
+    virtual void Remove(BaseModel *model) = 0;
+};
+
 class TOGGL_INTERNAL_EXPORT BaseModel {
  public:
     BaseModel() {}
@@ -48,9 +64,7 @@ class TOGGL_INTERNAL_EXPORT BaseModel {
     // attempt to push failed somewhere.
     Property<bool> Unsynced { false };
 
-    void SetLocalID(Poco::Int64 value) {
-        LocalID.Set(value);
-    }
+    void SetLocalID(Poco::Int64 value);
     void SetID(Poco::UInt64 value);
     void SetUIModifiedAt(Poco::Int64 value);
     void SetUIModified() {
@@ -115,6 +129,15 @@ class TOGGL_INTERNAL_EXPORT BaseModel {
 
     void Delete();
 
+    ModelKeyObserver *KeyObserver() const {
+        return key_observer_;
+    }
+    void SetKeyObserver(ModelKeyObserver *observer) {
+        key_observer_ = observer;
+    }
+    // Drop the model from the lookup index it's registered in
+    void Unindex();
+
     // Convert model JSON into batch update format.
     error BatchUpdateJSON(Json::Value *result) const;
 
@@ -126,6 +149,8 @@ class TOGGL_INTERNAL_EXPORT BaseModel {
  private:
     std::string batchUpdateRelativeURL() const;
     std::string batchUpdateMethod() const;
+
+    ModelKeyObserver *key_observer_ { nullptr };
 };
 
 }  // namespace toggl
@@ -29,6 +29,10 @@ std::string TimelineEvent::ModelURL() const {
 }
 
 void TimelineEvent::SetTitle(const std::string &value) {
+    SetTitle(InternedString(value));
+}
+
+void TimelineEvent::SetTitle(const InternedString &value) {
     if (Title.Set(value))
         SetDirty();
 }
@@ -53,6 +57,10 @@ void TimelineEvent::SetIdle(bool value) {
 }
 
 void TimelineEvent::SetFilename(const std::string &value) {
+    SetFilename(InternedString(value));
+}
+
+void TimelineEvent::SetFilename(const InternedString &value) {
     if (Filename.Set(value))
         SetDirty();
 }
@@ -70,8 +78,8 @@ void TimelineEvent::SetUploaded(bool value) {
 Json::Value TimelineEvent::SaveToJSON(int) const {
     Json::Value n;
     n["guid"] = GUID();
-    n["filename"] = Filename();
-    n["title"] = Title();
+    n["filename"] = Filename().str();
+    n["title"] = Title().str();
     n["start_time"] = Json::Int64(Start());
     n["end_time"] = Json::Int64(EndTime());
     n["created_with"] = "timeline";
@@ -10,6 +10,7 @@
 
 #include "model/base_model.h"
 #include "util/formatter.h"
+#include "util/string_pool.h"
 
 namespace toggl {
 
@@ -21,8 +22,9 @@ class TOGGL_INTERNAL_EXPORT TimelineEvent : public BaseModel, public TimedEvent
     TimelineEvent &operator=(const TimelineEvent &o) = delete;
     virtual ~TimelineEvent() {}
 
-    Property<std::string> Title { "" };
-    Property<std::string> Filename { "" };
+    // Interned, the same few apps and windows repeat all day
+    Property<InternedString> Title;
+    Property<InternedString> Filename;
     Property<Poco::Int64> StartTime { 0 };
     Property<Poco::Int64> EndTime { 0 };
     Property<Poco::Int64> DurationInSeconds { 0 };
@@ -31,7 +33,9 @@ class TOGGL_INTERNAL_EXPORT TimelineEvent : public BaseModel, public TimedEvent
     Property<bool> Uploaded { false };
 
     void SetTitle(const std::string &value);
+    void SetTitle(const InternedString &value);
     void SetFilename(const std::string &value);
+    void SetFilename(const InternedString &value);
     void SetStartTime(Poco::Int64 value);
     void SetEndTime(Poco::Int64 value);
     void SetIdle(bool value);
@@ -15,7 +15,9 @@
 #include "model/task.h"
 #include "model/time_entry.h"
 #include "model/timeline_event.h"
+#include "timeline_event_index.h"
 #include "urls.h"
+#include "util/json_stream.h"
 #include "onboarding_service.h"
 #include "model/alpha_features.h";
 
@@ -127,6 +129,8 @@ Project *User::CreateProject(
 }
 
 void User::AddProjectToList(Project *p) {
+    related.Index(p);
+
     bool WIDMatch = false;
     bool CIDMatch = false;
 
@@ -187,6 +191,8 @@ Client *User::CreateClient(
 }
 
 void User::AddClientToList(Client *c) {
+    related.Index(c);
+
     bool foundMatch = false;
 
     // We should push the project to correct alphabetical position
@@ -434,6 +440,11 @@ void User::SetSince(Poco::Int64 value) {
         SetDirty();
 }
 
+void User::SetFullSyncedAt(Poco::Int64 value) {
+    if (FullSyncedAt.Set(value))
+        SetDirty();
+}
+
 void User::SetDefaultWID(Poco::UInt64 value) {
     if (DefaultWID.Set(value))
         SetDirty();
@@ -536,6 +547,10 @@ bool User::HasValidSinceDate() const {
     return true;
 }
 
+bool User::FullSyncDue() const {
+    return FullSyncedAt() < time(nullptr) - kFullSyncIntervalSeconds;
+}
+
 std::string User::String() const {
     std::stringstream ss;
     ss  << "ID=" << ID()
@@ -543,6 +558,7 @@ std::string User::String() const {
         << " default_wid=" << DefaultWID()
         << " api_token=" << APIToken()
         << " since=" << Since()
+        << " full_synced_at=" << FullSyncedAt()
         << " record_timeline=" << RecordTimeline();
     return ss.str();
 }
@@ -579,7 +595,7 @@ void User::RemoveTaskFromRelatedModels(Poco::UInt64 tid) {
 }
 
 void User::loadUserTagFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive) {
 
     // alive can be 0, dont assert/check it
@@ -606,6 +622,7 @@ void User::loadUserTagFromJSON(
     if (!model) {
         model = new Tag();
         related.Tags.push_back(model);
+        related.Index(model);
     }
     if (alive) {
         alive->insert(id);
@@ -615,7 +632,7 @@ void User::loadUserTagFromJSON(
 }
 
 void User::loadUserTaskFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive) {
 
     // alive can be 0, dont assert/check it
@@ -640,6 +657,7 @@ void User::loadUserTaskFromJSON(
     if (!model) {
         model = new Task();
         related.Tasks.push_back(model);
+        related.Index(model);
     }
 
     if (alive) {
@@ -667,6 +685,10 @@ error User::LoadUserUpdateFromJSONString(
     return noError;
 }
 
+void User::LoadUserUpdateFromJSON(const Json::Value &update) {
+    loadUserUpdateFromJSON(update);
+}
+
 void User::loadUserUpdateFromJSON(
     Json::Value node) {
 
@@ -696,7 +718,7 @@ void User::loadUserUpdateFromJSON(
 }
 
 void User::loadUserWorkspaceFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive) {
 
     // alive can be 0, dont assert/check it
@@ -720,6 +742,7 @@ void User::loadUserWorkspaceFromJSON(
     if (!model) {
         model = new Workspace();
         related.Workspaces.push_back(model);
+        related.Index(model);
     }
     if (alive) {
         alive->insert(id);
@@ -732,18 +755,110 @@ error User::LoadUserAndRelatedDataFromJSONString(const std::string &json,
     bool including_related_data,
     bool syncServer) {
 
+    std::istringstream is(json);
+    return LoadUserAndRelatedDataFromJSONStream(
+        is, including_related_data, syncServer);
+}
+
+error User::LoadUserAndRelatedDataFromJSONStream(std::istream &is,
+    bool including_related_data,
+    bool syncServer,
+    const LoadGuard &guard) {
+
+    auto locked = [&guard](const std::function<void()> &step) {
+        if (!guard) {
+            step();
+            return true;
+        }
+        return guard(step);
+    };
+
+    // Models can't be given an owner before the user ID is known,
+    // so for a new user they're kept until the user has been read.
+    // For a known user they're applied as they arrive, before the
+    // user fields left for the end of the document. That's safe:
+    // the model loaders only read the user ID, which is fixed by the
+    // API token, and since is advanced only after every model was
+    // applied, so a broken stream never skips changes on the next pull.
+    bool known_user(false);
+    if (!locked([&] { known_user = ID() != 0; })) {
+        return error("cannot load user data when logged out");
+    }
+
+    std::map<std::string, std::set<Poco::UInt64> > alive;
+    std::vector<std::pair<std::string, Json::Value> > deferred;
+    error err = noError;
+
+    const std::vector<std::string> &keys = relatedDataKeys();
+    JsonStreamSplitter splitter(
+        std::set<std::string>(keys.begin(), keys.end()),
+    [&](const std::string &key, const std::string &element) {
+        Json::Value data;
+        Json::Reader reader;
+        if (!reader.parse(element, data)) {
+            err = error("Failed to parse " + key + " in user data");
+            return false;
+        }
+        if (!known_user) {
+            deferred.push_back(std::make_pair(key, data));
+            return true;
+        }
+        bool loaded = locked([&] {
+            loadRelatedModelFromJSON(key, data, &alive[key], syncServer);
+        });
+        if (!loaded) {
+            err = error("cannot load user data when logged out");
+            return false;
+        }
+        return true;
+    });
+
+    std::string json;
+    error read_err = splitter.Read(is, &json);
+    if (err != noError) {
+        return err;
+    }
+    if (read_err != noError) {
+        return error("Failed to LoadUserAndRelatedDataFromJSONStream: "
+                     + read_err);
+    }
+
     if (json.empty()) {
         Logger("json").warning("cannot load empty JSON");
         return noError;
     }
 
+    // What's left is the user, preferences and empty model arrays
     Json::Value root;
     Json::Reader reader;
     if (!reader.parse(json, root)) {
-        return error("Failed to LoadUserAndRelatedDataFromJSONString");
+        return error("Failed to LoadUserAndRelatedDataFromJSONStream");
     }
 
-    LoadUserAndRelatedDataFromJSON(root, including_related_data, syncServer);
+    auto finish = [&] {
+        if (LoadUserAndRelatedDataFromJSON(root, false, syncServer)
+                != noError) {
+            return;
+        }
+        for (auto it = deferred.begin(); it != deferred.end(); ++it) {
+            loadRelatedModelFromJSON(
+                it->first, it->second, &alive[it->first], syncServer);
+        }
+        // Projects may have arrived before their clients
+        for (auto it = related.Projects.begin();
+                it != related.Projects.end(); ++it) {
+            Client *c = related.clientByProject(*it);
+            if (c) {
+                (*it)->SetClientName(c->Name());
+            }
+        }
+        if (including_related_data) {
+            deleteRelatedZombies(alive);
+        }
+    };
+    if (!locked(finish)) {
+        return error("cannot load user data when logged out");
+    }
     return noError;
 }
 
@@ -795,7 +910,7 @@ error User::LoadTimeEntriesFromJSONString(const std::string & json) {
     return noError;
 }
 
-void User::LoadUserAndRelatedDataFromJSON(
+error User::LoadUserAndRelatedDataFromJSON(
     const Json::Value &root,
     bool including_related_data,
     bool syncServer) {
@@ -819,6 +934,7 @@ void User::LoadUserAndRelatedDataFromJSON(
     if (err == noError) {
         loadRelatedDataFromJSON(data, including_related_data, syncServer);
     }
+    return err;
 }
 
 error User::loadUserFromJSON(const Json::Value &data) {
@@ -840,112 +956,86 @@ error User::loadUserFromJSON(const Json::Value &data) {
     return noError;
 }
 
+const std::vector<std::string> &User::relatedDataKeys() {
+    static const std::vector<std::string> keys {
+        "workspaces",
+        "clients",
+        "projects",
+        "tasks",
+        "tags",
+        "time_entries"
+    };
+    return keys;
+}
+
+void User::loadRelatedModelFromJSON(
+    const std::string &key,
+    const Json::Value &data,
+    std::set<Poco::UInt64> *alive,
+    bool syncServer) {
+    if ("workspaces" == key) {
+        loadUserWorkspaceFromJSON(data, alive);
+    } else if ("clients" == key) {
+        loadUserClientFromSyncJSON(data, alive, syncServer);
+    } else if ("projects" == key) {
+        loadUserProjectFromSyncJSON(data, alive, syncServer);
+    } else if ("tasks" == key) {
+        loadUserTaskFromJSON(data, alive);
+    } else if ("tags" == key) {
+        loadUserTagFromJSON(data, alive);
+    } else if ("time_entries" == key) {
+        loadUserTimeEntryFromJSON(data, alive, syncServer);
+    }
+}
+
+void User::deleteRelatedZombies(
+    const std::map<std::string, std::set<Poco::UInt64> > &alive) {
+    // Missing lists mean there are no models of that kind left
+    const std::set<Poco::UInt64> none;
+    auto aliveOf = [&](const std::string &key)
+    -> const std::set<Poco::UInt64> & {
+        auto it = alive.find(key);
+        return it == alive.end() ? none : it->second;
+    };
+    deleteZombies(related.Workspaces, aliveOf("workspaces"));
+    deleteZombies(related.Clients, aliveOf("clients"));
+    deleteZombies(related.Projects, aliveOf("projects"));
+    deleteZombies(related.Tasks, aliveOf("tasks"));
+    deleteZombies(related.Tags, aliveOf("tags"));
+    deleteZombies(related.TimeEntries, aliveOf("time_entries"));
+
+    // Local data matches the server now, pulls can be incremental again
+    SetFullSyncedAt(time(nullptr));
+}
+
 error User::loadRelatedDataFromJSON(
     const Json::Value &data,
     bool including_related_data,
     bool syncServer) {
 
-    {
-        std::set<Poco::UInt64> alive;
-
-        if (data.isMember("workspaces")) {
-            Json::Value list = data["workspaces"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserWorkspaceFromJSON(list[i], &alive);
-            }
-        }
-
-        if (including_related_data) {
-            deleteZombies(related.Workspaces, alive);
-        }
-    }
-
-    {
-        std::set<Poco::UInt64> alive;
-
-        if (data.isMember("clients")) {
-            Json::Value list = data["clients"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserClientFromSyncJSON(list[i], &alive, syncServer);
-            }
-        }
-
-        if (including_related_data) {
-            deleteZombies(related.Clients, alive);
-        }
-    }
-
-    {
-        std::set<Poco::UInt64> alive;
+    std::map<std::string, std::set<Poco::UInt64> > alive;
 
-        if (data.isMember("projects")) {
-            Json::Value list = data["projects"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserProjectFromSyncJSON(list[i], &alive, syncServer);
-            }
-        }
-
-        if (including_related_data) {
-            deleteZombies(related.Projects, alive);
-        }
-    }
-
-    {
-        std::set<Poco::UInt64> alive;
-
-        if (data.isMember("tasks")) {
-            Json::Value list = data["tasks"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserTaskFromJSON(list[i], &alive);
-            }
-        }
-
-        if (including_related_data) {
-            deleteZombies(related.Tasks, alive);
-        }
-    }
-
-    {
-        std::set<Poco::UInt64> alive;
-
-        if (data.isMember("tags")) {
-            Json::Value list = data["tags"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserTagFromJSON(list[i], &alive);
-            }
+    const std::vector<std::string> &keys = relatedDataKeys();
+    for (auto key = keys.begin(); key != keys.end(); ++key) {
+        if (!data.isMember(*key)) {
+            continue;
         }
-
-        if (including_related_data) {
-            deleteZombies(related.Tags, alive);
+        const Json::Value &list = data[*key];
+        std::set<Poco::UInt64> *key_alive = &alive[*key];
+        for (unsigned int i = 0; i < list.size(); i++) {
+            loadRelatedModelFromJSON(*key, list[i], key_alive, syncServer);
         }
     }
 
-    {
-        std::set<Poco::UInt64> alive;
-
-        if (data.isMember("time_entries")) {
-            Json::Value list = data["time_entries"];
-
-            for (unsigned int i = 0; i < list.size(); i++) {
-                loadUserTimeEntryFromJSON(list[i], &alive, syncServer);
-            }
-        }
-
-        if (including_related_data) {
-            deleteZombies(related.TimeEntries, alive);
-        }
+    if (including_related_data) {
+        deleteRelatedZombies(alive);
     }
 
     return noError;
 }
 
 void User::loadUserClientFromSyncJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive,
     bool syncServer) {
     bool addNew = false;
@@ -984,7 +1074,7 @@ void User::loadUserClientFromSyncJSON(
 }
 
 void User::loadUserClientFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive,
     bool syncServer) {
 
@@ -1011,6 +1101,7 @@ void User::loadUserClientFromJSON(
     if (!model) {
         model = new Client();
         related.Clients.push_back(model);
+        related.Index(model);
     }
     if (alive) {
         alive->insert(id);
@@ -1020,7 +1111,7 @@ void User::loadUserClientFromJSON(
 }
 
 void User::loadUserProjectFromSyncJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive,
     bool syncServer) {
     bool addNew = false;
@@ -1071,7 +1162,7 @@ void User::loadUserProjectFromSyncJSON(
 }
 
 void User::loadUserProjectFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive,
     bool syncServer) {
 
@@ -1099,6 +1190,7 @@ void User::loadUserProjectFromJSON(
     if (!model) {
         model = new Project();
         related.Projects.push_back(model);
+        related.Index(model);
     }
     if (alive) {
         alive->insert(id);
@@ -1108,7 +1200,7 @@ void User::loadUserProjectFromJSON(
 }
 
 void User::loadUserTimeEntryFromJSON(
-    Json::Value data,
+    const Json::Value &data,
     std::set<Poco::UInt64> *alive,
     bool syncServer) {
 
@@ -1123,7 +1215,8 @@ void User::loadUserTimeEntryFromJSON(
     TimeEntry* model;
     {
         Poco::Mutex::ScopedLock lock(loadTimeEntries_m_);
-        model = related.TimeEntryByID(id);
+        // Older entries may only be in the database
+        model = related.PageInTimeEntryByID(id);
 
         if (!model) {
             model = related.TimeEntryByGUID(data["guid"].asString());
@@ -1383,99 +1476,50 @@ void User::MarkTimelineBatchAsUploaded(
 }
 
 void User::CompressTimeline() {
-    // Group events by app name into chunks
-    std::map<std::string, TimelineEvent *> compressed;
-
     // Older events will be deleted
     Poco::Int64 minimum_time = time(nullptr) - kTimelineSecondsToKeep;
 
-    // Find the chunk start time of current time.
-    // then process only events that are older that this chunk start time.
-    // Else we will have no full chunks to compress.
-    Poco::Int64 chunk_up_to =
-        (time(nullptr) / kTimelineChunkSeconds) * kTimelineChunkSeconds;
-
-
     time_t start = time(nullptr);
 
-    logger().debug("CompressTimeline ",
-                   " user_id=", ID(),
-                   " chunk_up_to=", chunk_up_to,
-                   " number of events=", related.TimelineEvents.size());
+    std::vector<TimelineEvent *> too_old;
+    related.TimelineEventsBetween(0, minimum_time, &too_old);
+    for (std::vector<TimelineEvent *>::const_iterator i = too_old.begin();
+            i != too_old.end();
+            ++i) {
+        if (!(*i)->DeletedAt()) {
+            (*i)->Delete();
+        }
+    }
 
-    for (std::vector<TimelineEvent *>::iterator i =
-        related.TimelineEvents.begin();
-            i != related.TimelineEvents.end();
+    // Recorded events are merged into their chunk right away,
+    // this only picks up the ones stored by an older version
+    std::vector<TimelineEvent *> uncompressed =
+        related.UncompressedTimelineEvents();
+    size_t merged = 0;
+    for (std::vector<TimelineEvent *>::const_iterator i = uncompressed.begin();
+            i != uncompressed.end();
             ++i) {
         TimelineEvent *event = *i;
 
         poco_check_ptr(event);
 
-        // Delete too old timeline events
-        if (event->Start() < minimum_time) {
-            event->Delete();
-        }
-
-        // Events that do not fit into chunk yet, ignore
-        if (event->Start() >= chunk_up_to) {
-            continue;
-        }
-
         // Ignore deleted events
         if (event->DeletedAt()) {
             continue;
         }
 
-        // Ignore chunked and already uploaded stuff
-        if (event->Chunked() || event->Uploaded()) {
-            continue;
-        }
-
-        // Calculate the start time of the chunk
-        // that fits this timeline event
-        time_t chunk_start_time =
-            (event->Start() / kTimelineChunkSeconds)
-            * kTimelineChunkSeconds;
-
-        // Build dictionary key so that the chunk can be accessed later
-        std::stringstream ss;
-        ss << event->Filename();
-        ss << "::";
-        ss << event->Title();
-        ss << "::";
-        ss << event->Idle();
-        ss << "::";
-        ss << chunk_start_time;
-        std::string key = ss.str();
-
-        // Calculate positive value of timeline event duration
-        time_t duration = event->Duration();
-        if (duration < 0) {
-            duration = 0;
-        }
-
-        poco_assert(!event->Uploaded());
-        poco_assert(!event->Chunked());
-
-        TimelineEvent *chunk = nullptr;
-        if (compressed.find(key) == compressed.end()) {
-            // If chunk is not created yet,
-            // turn the timeline event into chunk
-            chunk = event;
-            chunk->SetEndTime(chunk->Start() + duration);
-            chunk->SetChunked(true);
-        } else {
-            // If chunk already exists, add duration
-            // to that junk and delete the original event
-            chunk = compressed[key];
-            chunk->SetEndTime(chunk->EndTime() + duration);
+        // If chunk already exists, the original event is not needed
+        if (related.CompressTimelineEvent(event)) {
             event->Delete();
+            merged++;
         }
-        compressed[key] = chunk;
     }
 
-    logger().debug("CompressTimeline done in ", (time(nullptr) - start), " seconds, ",
-                   related.TimelineEvents.size(), " compressed into ", compressed.size(), " chunks");
+    logger().debug("CompressTimeline done in ", (time(nullptr) - start), " seconds,",
+                   " user_id=", ID(),
+                   " deleted=", too_old.size(),
+                   " compressed=", uncompressed.size(),
+                   " merged=", merged);
 }
 
 std::vector<const TimelineEvent*> User::CompressedTimelineForUI(const Poco::LocalDateTime *date) const {
@@ -1487,10 +1531,27 @@ std::vector<const TimelineEvent*> User::CompressedTimelineForUpload(const Poco::
 }
 
 std::vector<const TimelineEvent*> User::CompressedTimeline(const Poco::LocalDateTime *date, bool is_for_upload) const {
+    std::vector<TimelineEvent *> events;
+    if (date) {
+        // Only the events that started on the required local date
+        Poco::LocalDateTime midnight(date->year(), date->month(), date->day());
+        Poco::LocalDateTime next_day = midnight + Poco::Timespan(1, 12, 0, 0, 0);
+        Poco::LocalDateTime next_midnight(
+            next_day.year(), next_day.month(), next_day.day());
+        related.TimelineEventsBetween(
+            midnight.utc().timestamp().epochTime(),
+            next_midnight.utc().timestamp().epochTime(),
+            &events);
+    } else {
+        events = related.TimelineEvents;
+    }
+
+    Poco::Int64 chunk_up_to = TimelineEventIndex::ChunkStart(time(nullptr));
+
     std::vector<const TimelineEvent*> list;
-    for (std::vector<TimelineEvent *>::const_iterator i =
-        related.TimelineEvents.begin();
-            i != related.TimelineEvents.end();
+    list.reserve(events.size());
+    for (std::vector<TimelineEvent *>::const_iterator i = events.begin();
+            i != events.end();
             ++i) {
         const TimelineEvent *event = *i;
         poco_check_ptr(event);
@@ -1504,17 +1565,11 @@ std::vector<const TimelineEvent*> User::CompressedTimeline(const Poco::LocalDate
             continue;
         }
 
-        if (date) {
-            // Check if timeline event occured on the
-            // required date:
-            Poco::LocalDateTime event_date(
-                Poco::Timestamp::fromEpochTime(event->Start()));
-            if (event_date.year() != date->year() ||
-                    event_date.month() != date->month() ||
-                    event_date.day() != date->day()) {
-                continue;
-            }
+        // Events are still merged into the current chunk
+        if (is_for_upload && event->Start() >= chunk_up_to) {
+            continue;
         }
+
         // Make a copy of the timeline event
         list.push_back(event);
     }
@@ -3,6 +3,8 @@
 #ifndef SRC_USER_H_
 #define SRC_USER_H_
 
+#include <functional>
+#include <istream>
 #include <map>
 #include <set>
 #include <string>
@@ -41,6 +43,8 @@ class TOGGL_INTERNAL_EXPORT User : public BaseModel {
     Property<Poco::UInt64> DefaultTID { 0 };
     // Unix timestamp of the user data; returned from API
     Property<Poco::Int64> Since { 0 };
+    // Unix timestamp of the last pull that included all user data
+    Property<Poco::Int64> FullSyncedAt { 0 };
     Property<bool> RecordTimeline { false };
 
     Property<bool> HasLoadedMore { false };
@@ -59,12 +63,15 @@ class TOGGL_INTERNAL_EXPORT User : public BaseModel {
     void SetDefaultTID(Poco::UInt64 value);
     // Unix timestamp of the user data; returned from API
     void SetSince(Poco::Int64 value);
+    void SetFullSyncedAt(Poco::Int64 value);
     void SetRecordTimeline(bool value);
     void ConfirmLoadedMore();
     void SetCollapseEntries(bool value);
 
     // Derived data and modifiers
     bool HasValidSinceDate() const;
+    // True when the next pull should fetch all data to remove zombies
+    bool FullSyncDue() const;
 
     error EnableOfflineLogin(
         const std::string &password);
@@ -141,10 +148,24 @@ class TOGGL_INTERNAL_EXPORT User : public BaseModel {
 
     error LoadUserUpdateFromJSONString(const std::string &json);
 
+    // Applies an already parsed update
+    void LoadUserUpdateFromJSON(const Json::Value &update);
+
     error LoadUserAndRelatedDataFromJSONString(const std::string &json,
         bool including_related_data, bool syncServer);
 
-    void LoadUserAndRelatedDataFromJSON(const Json::Value &root,
+    // Runs one loading step with the lock the caller needs, false
+    // when loading should stop, eg. because the user has logged out
+    typedef std::function<bool(const std::function<void()> &step)> LoadGuard;
+
+    // Loads the related models while the JSON is being read. Models
+    // are applied one by one as they arrive once the user ID is known,
+    // so the whole response is never kept in memory.
+    error LoadUserAndRelatedDataFromJSONStream(std::istream &is,
+        bool including_related_data, bool syncServer,
+        const LoadGuard &guard = nullptr);
+
+    error LoadUserAndRelatedDataFromJSON(const Json::Value &root,
         bool including_related_data,
         bool syncServer);
 
@@ -215,7 +236,7 @@ class TOGGL_INTERNAL_EXPORT User : public BaseModel {
 
  private:
     void loadUserTagFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr);
 
     error loadUserFromJSON(
@@ -225,39 +246,51 @@ class TOGGL_INTERNAL_EXPORT User : public BaseModel {
         bool including_related_data,
         bool syncServer);
 
+    // Model arrays of the user data JSON, in loading order
+    static const std::vector<std::string> &relatedDataKeys();
+
+    void loadRelatedModelFromJSON(
+        const std::string &key,
+        const Json::Value &data,
+        std::set<Poco::UInt64> *alive,
+        bool syncServer);
+
+    void deleteRelatedZombies(
+        const std::map<std::string, std::set<Poco::UInt64> > &alive);
+
     void loadUserUpdateFromJSON(
         Json::Value list);
 
     void loadUserProjectFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr,
         bool syncServer = false);
 
     void loadUserProjectFromSyncJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr,
         bool syncServer = false);
 
     void loadUserWorkspaceFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr);
 
     void loadUserClientFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr,
         bool syncServer = false);
 
     void loadUserClientFromSyncJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr,
         bool syncServer = false);
 
     void loadUserTaskFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr);
 
     void loadUserTimeEntryFromJSON(
-        Json::Value data,
+        const Json::Value &data,
         std::set<Poco::UInt64> *alive = nullptr,
         bool syncServer = false);
 
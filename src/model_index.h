@@ -0,0 +1,230 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_MODEL_INDEX_H_
+#define SRC_MODEL_INDEX_H_
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "model/base_model.h"
+#include "types.h"
+
+#include <Poco/Types.h>
+
+namespace toggl {
+
+/**
+ * Hash index of the models of one type, by ID, GUID and local ID.
+ * Registered models report their key changes back to the index,
+ * so lookups stay O(1) no matter where the keys are modified.
+ * Keys may collide (e.g. a duplicate that is about to be deleted),
+ * so every key maps to all models currently carrying it.
+ * Empty keys (0, "") are never indexed.
+ *
+ * The index also collects the models that got dirty, so saving
+ * does not need to walk through all of them.
+ */
+template <typename T>
+class ModelIndex : public ModelKeyObserver {
+ public:
+    ModelIndex() {}
+    ModelIndex(const ModelIndex &o) = delete;
+    ModelIndex &operator=(const ModelIndex &o) = delete;
+    ~ModelIndex() {
+        Clear();
+    }
+
+    void Insert(T *model) {
+        if (model->KeyObserver() == this) {
+            return;
+        }
+        model->Unindex();
+        model->SetKeyObserver(this);
+        models_.insert(model);
+        add(&by_local_id_, model->LocalID(), model);
+        add(&by_id_, model->ID(), model);
+        add(&by_guid_, model->GUID(), model);
+        if (model->NeedsToBeSaved() || model->IsMarkedAsDeletedOnServer()) {
+            markDirty(model);
+        }
+        inserted(model);
+    }
+
+    void Rebuild(const std::vector<T *> &list) {
+        Clear();
+        for (auto model : list) {
+            Insert(model);
+        }
+    }
+
+    // Detaches all models, does not delete them
+    void Clear() {
+        cleared();
+        for (auto model : models_) {
+            model->SetKeyObserver(nullptr);
+        }
+        models_.clear();
+        by_local_id_.clear();
+        by_id_.clear();
+        by_guid_.clear();
+        dirty_.clear();
+        dirty_set_.clear();
+        dirty_removed_ = false;
+    }
+
+    size_t Size() const {
+        return models_.size();
+    }
+
+    // Models that may need to be saved, in the order they got dirty
+    const std::vector<T *> &Dirty() {
+        compactDirty();
+        return dirty_;
+    }
+
+    // Forget the models that don't need to be saved anymore
+    void PruneDirty() {
+        compactDirty();
+        std::vector<T *> dirty;
+        for (auto model : dirty_) {
+            if (model->NeedsToBeSaved()
+                    || model->IsMarkedAsDeletedOnServer()) {
+                dirty.push_back(model);
+            } else {
+                dirty_set_.erase(model);
+            }
+        }
+        dirty_.swap(dirty);
+    }
+
+    T *ByLocalID(Poco::Int64 local_id) const {
+        return find(by_local_id_, local_id);
+    }
+    T *ByID(Poco::UInt64 id) const {
+        return find(by_id_, id);
+    }
+    T *ByGUID(const guid &GUID) const {
+        return find(by_guid_, GUID);
+    }
+
+    // Override ModelKeyObserver
+    void LocalIDChanged(BaseModel *model, Poco::Int64 previous) override {
+        T *m = static_cast<T *>(model);
+        remove(&by_local_id_, previous, m);
+        add(&by_local_id_, m->LocalID(), m);
+    }
+    void IDChanged(BaseModel *model, Poco::UInt64 previous) override {
+        T *m = static_cast<T *>(model);
+        remove(&by_id_, previous, m);
+        add(&by_id_, m->ID(), m);
+    }
+    void GUIDChanged(BaseModel *model, const guid &previous) override {
+        T *m = static_cast<T *>(model);
+        remove(&by_guid_, previous, m);
+        add(&by_guid_, m->GUID(), m);
+    }
+    void Dirtied(BaseModel *model) override {
+        markDirty(static_cast<T *>(model));
+    }
+    void Remove(BaseModel *model) override {
+        T *m = static_cast<T *>(model);
+        remove(&by_local_id_, m->LocalID(), m);
+        remove(&by_id_, m->ID(), m);
+        remove(&by_guid_, m->GUID(), m);
+        m->SetKeyObserver(nullptr);
+        models_.erase(m);
+        if (dirty_set_.erase(m)) {
+            // Dropped from the list lazily, removals come in bulk
+            dirty_removed_ = true;
+        }
+        removed(m);
+    }
+
+ protected:
+    // For indexes that keep more about the models than their keys
+    virtual void inserted(T *model) {}
+    virtual void removed(T *model) {}
+    virtual void cleared() {}
+
+ private:
+    template <typename K>
+    using Map = std::unordered_multimap<K, T *>;
+
+    static bool empty(Poco::Int64 key) {
+        return !key;
+    }
+    static bool empty(Poco::UInt64 key) {
+        return !key;
+    }
+    static bool empty(const guid &key) {
+        return key.empty();
+    }
+
+    template <typename K>
+    static void add(Map<K> *map, const K &key, T *model) {
+        if (!empty(key)) {
+            map->emplace(key, model);
+        }
+    }
+
+    template <typename K>
+    static void remove(Map<K> *map, const K &key, T *model) {
+        if (empty(key)) {
+            return;
+        }
+        auto range = map->equal_range(key);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == model) {
+                map->erase(it);
+                return;
+            }
+        }
+    }
+
+    void markDirty(T *model) {
+        if (dirty_set_.insert(model).second) {
+            dirty_.push_back(model);
+        }
+    }
+
+    void compactDirty() {
+        if (!dirty_removed_) {
+            return;
+        }
+        std::unordered_set<T *> seen;
+        std::vector<T *> dirty;
+        for (auto model : dirty_) {
+            if (dirty_set_.count(model) && seen.insert(model).second) {
+                dirty.push_back(model);
+            }
+        }
+        dirty_.swap(dirty);
+        dirty_removed_ = false;
+    }
+
+    template <typename K>
+    static T *find(const Map<K> &map, const K &key) {
+        if (empty(key)) {
+            return nullptr;
+        }
+        auto it = map.find(key);
+        if (it == map.end()) {
+            return nullptr;
+        }
+        return it->second;
+    }
+
+    Map<Poco::Int64> by_local_id_;
+    Map<Poco::UInt64> by_id_;
+    Map<guid> by_guid_;
+    std::unordered_set<T *> models_;
+    std::vector<T *> dirty_;
+    std::unordered_set<T *> dirty_set_;
+    bool dirty_removed_ { false };
+};
+
+}  // namespace toggl
+
+#endif  // SRC_MODEL_INDEX_H_
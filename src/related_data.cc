@@ -5,11 +5,13 @@
 #include <algorithm>
 #include <sstream>
 
+#include <Poco/Bugcheck.h>
 #include <Poco/UTF8String.h>
 
 #include "model/autotracker.h"
 #include "util/formatter.h"
 #include "model/client.h"
+#include "const.h"
 #include "gui.h"
 #include "model/project.h"
 #include "model/tag.h"
@@ -36,9 +38,35 @@ void RelatedData::forEachTimeEntries(std::function<void(TimeEntry *)> f) {
 void RelatedData::pushBackTimeEntry(TimeEntry *timeEntry) {
     Poco::Mutex::ScopedLock lock(timeEntries_m_);
     TimeEntries.push_back(timeEntry);
+    time_entry_index_.Insert(timeEntry);
 }
 
+RelatedData::RelatedData()
+    : time_entry_hot_since_(0)
+, time_entry_older_since_(0)
+, time_entry_starts_read_(false) {}
+
+RelatedData::~RelatedData() {}
+
 void RelatedData::Clear() {
+    workspace_index_.Clear();
+    client_index_.Clear();
+    project_index_.Clear();
+    task_index_.Clear();
+    tag_index_.Clear();
+    time_entry_index_.Clear();
+    timeline_event_index_.Clear();
+
+    {
+        Poco::Mutex::ScopedLock lock(autocomplete_m_);
+        invalidateTimeEntryAutocompletes();
+        project_autocomplete_.Invalidate();
+    }
+    {
+        Poco::Mutex::ScopedLock lock(autotracker_m_);
+        autotracker_matcher_.Invalidate();
+    }
+
     clearList(&Workspaces);
     clearList(&Clients);
     clearList(&Projects);
@@ -47,6 +75,21 @@ void RelatedData::Clear() {
     clearList(&TimeEntries);
     clearList(&AutotrackerRules);
     clearList(&TimelineEvents);
+
+    time_entry_pages_.clear();
+    time_entry_older_since_ = time_entry_hot_since_;
+    time_entry_starts_.clear();
+    time_entry_starts_read_ = false;
+}
+
+void RelatedData::RebuildIndexes() {
+    workspace_index_.Rebuild(Workspaces);
+    client_index_.Rebuild(Clients);
+    project_index_.Rebuild(Projects);
+    task_index_.Rebuild(Tasks);
+    tag_index_.Rebuild(Tags);
+    time_entry_index_.Rebuild(TimeEntries);
+    timeline_event_index_.Rebuild(TimelineEvents);
 }
 
 error RelatedData::DeleteAutotrackerRule(const Poco::Int64 local_id) {
@@ -62,23 +105,27 @@ error RelatedData::DeleteAutotrackerRule(const Poco::Int64 local_id) {
         if (rule->LocalID() == local_id) {
             rule->MarkAsDeletedOnServer();
             rule->Delete();
+            AutotrackerRulesChanged();
             break;
         }
     }
     return noError;
 }
 
+void RelatedData::AutotrackerRulesChanged() {
+    Poco::Mutex::ScopedLock lock(autotracker_m_);
+    autotracker_matcher_.Invalidate();
+}
+
 AutotrackerRule *RelatedData::FindAutotrackerRule(
     const TimelineEvent &event) const {
-    for (std::vector<AutotrackerRule *>::const_iterator it =
-        AutotrackerRules.begin();
-            it != AutotrackerRules.end(); ++it) {
-        AutotrackerRule *rule = *it;
-        if (rule->Matches(event)) {
-            return rule;
-        }
+    Poco::Mutex::ScopedLock lock(autotracker_m_);
+    if (!autotracker_matcher_.Built(AutotrackerRules)) {
+        autotracker_matcher_.Build(AutotrackerRules);
     }
-    return nullptr;
+    return autotracker_matcher_.Find(
+        Poco::UTF8::toLower(event.Filename()),
+        Poco::UTF8::toLower(event.Title()));
 }
 
 bool RelatedData::HasMatchingAutotrackerRule(
@@ -201,90 +248,148 @@ void RelatedData::timeEntryAutocompleteItems(
     std::set<std::string> *unique_names,
     std::map<Poco::UInt64, std::string> *ws_names,
     std::vector<view::Autocomplete> *list,
-    std::map<std::string, std::vector<view::Autocomplete> > *items) const {
+    std::map<std::string, std::vector<view::Autocomplete> > *items,
+    TimeEntryAutocompleteSources *sources) const {
 
     poco_check_ptr(list);
+    poco_check_ptr(ws_names);
 
+    if (sources) {
+        sources->ws_names = *ws_names;
+        sources->texts.clear();
+        sources->ranks.clear();
+    }
+
+    typedef std::pair<TimeEntryAutocompleteRank, view::Autocomplete> Ranked;
+    std::map<std::string, Ranked> latest;
     for (std::vector<TimeEntry *>::const_iterator it =
         TimeEntries.begin();
             it != TimeEntries.end(); ++it) {
         TimeEntry *te = *it;
 
-        if (te->DeletedAt() || te->IsMarkedAsDeletedOnServer()
-                || te->Description().empty()) {
+        view::Autocomplete autocomplete_item;
+        if (!timeEntryAutocompleteItem(te, *ws_names, &autocomplete_item)) {
             continue;
         }
 
-        Task *t = nullptr;
-        if (te->TID()) {
-            t = TaskByID(te->TID());
+        const std::string text = autocomplete_item.Text;
+        const TimeEntryAutocompleteRank rank(te->StartTime(), te->GUID());
+        if (sources) {
+            if (!te->GUID().empty()) {
+                sources->texts[te->GUID()] =
+                    std::make_pair(text, te->StartTime());
+            }
+            sources->ranks[text].insert(rank);
         }
 
-        Project *p = nullptr;
-        if (t && t->PID()) {
-            p = ProjectByID(t->PID());
-        } else if (te->PID()) {
-            p = ProjectByID(te->PID());
+        auto found = latest.find(text);
+        if (found == latest.end()) {
+            latest.insert(std::make_pair(
+                text, Ranked(rank, std::move(autocomplete_item))));
+        } else if (found->second.first < rank) {
+            found->second = Ranked(rank, std::move(autocomplete_item));
         }
+    }
 
-        if (p && !p->Active()) {
+    std::vector<const Ranked *> ordered;
+    ordered.reserve(latest.size());
+    for (auto it = latest.begin(); it != latest.end(); ++it) {
+        ordered.push_back(&it->second);
+    }
+    std::sort(ordered.begin(), ordered.end(),
+    [](const Ranked *a, const Ranked *b) {
+        return b->first < a->first;
+    });
+
+    for (auto it = ordered.begin(); it != ordered.end(); ++it) {
+        const view::Autocomplete &autocomplete_item = (*it)->second;
+        const std::string &text = autocomplete_item.Text;
+        if (unique_names->find(text) != unique_names->end()) {
             continue;
         }
+        unique_names->insert(text);
 
-        std::string project_task_label =
-            Formatter::JoinTaskName(t, p);
+        if (items && !autocomplete_item.WorkspaceName.empty()) {
+            (*items)[autocomplete_item.WorkspaceName].push_back(autocomplete_item);
+        } else {
+            list->push_back(autocomplete_item);
+        }
+    }
 
-        std::string description = te->Description();
+    if (sources) {
+        sources->stale = false;
+    }
+}
 
-        std::stringstream search_parts;
-        search_parts << te->Description();
-        if (!project_task_label.empty()) {
-            search_parts << " - " << project_task_label;
-        }
+bool RelatedData::timeEntryAutocompleteItem(
+    TimeEntry *te,
+    const std::map<Poco::UInt64, std::string> &ws_names,
+    view::Autocomplete *autocomplete_item) const {
 
-        std::string text = search_parts.str();
-        if (text.empty()) {
-            continue;
-        }
+    if (te->DeletedAt() || te->IsMarkedAsDeletedOnServer()
+            || te->Description().empty()) {
+        return false;
+    }
 
-        if (unique_names->find(text) != unique_names->end()) {
-            continue;
-        }
-        unique_names->insert(text);
+    Task *t = nullptr;
+    if (te->TID()) {
+        t = TaskByID(te->TID());
+    }
 
-        view::Autocomplete autocomplete_item;
-        autocomplete_item.Text = text;
-        autocomplete_item.Description = description;
-        autocomplete_item.ProjectAndTaskLabel = project_task_label;
-        if (p) {
-            autocomplete_item.ProjectColor = p->ColorCode();
-            autocomplete_item.ProjectID = p->ID();
-            autocomplete_item.ProjectGUID = p->GUID();
-            autocomplete_item.ProjectLabel = p->Name();
-            if (p->CID()) {
-                autocomplete_item.ClientLabel = p->ClientName();
-                autocomplete_item.ClientID = p->CID();
-            }
-        }
+    Project *p = nullptr;
+    if (t && t->PID()) {
+        p = ProjectByID(t->PID());
+    } else if (te->PID()) {
+        p = ProjectByID(te->PID());
+    }
 
-        if (t) {
-            autocomplete_item.TaskID = t->ID();
-            autocomplete_item.TaskLabel = t->Name();
-        }
-        autocomplete_item.WorkspaceID = te->WID();
-        if (ws_names) {
-            autocomplete_item.WorkspaceName = (*ws_names)[te->WID()];
-        }
-        autocomplete_item.Tags = te->Tags();
-        autocomplete_item.Type = kAutocompleteItemTE;
-        autocomplete_item.Billable = te->Billable();
+    if (p && !p->Active()) {
+        return false;
+    }
 
-        if (items && !autocomplete_item.WorkspaceName.empty()) {
-            (*items)[autocomplete_item.WorkspaceName].push_back(autocomplete_item);
-        } else {
-            list->push_back(autocomplete_item);
+    std::string project_task_label =
+        Formatter::JoinTaskName(t, p);
+
+    std::string description = te->Description();
+
+    std::stringstream search_parts;
+    search_parts << te->Description();
+    if (!project_task_label.empty()) {
+        search_parts << " - " << project_task_label;
+    }
+
+    std::string text = search_parts.str();
+    if (text.empty()) {
+        return false;
+    }
+
+    autocomplete_item->Text = text;
+    autocomplete_item->Description = description;
+    autocomplete_item->ProjectAndTaskLabel = project_task_label;
+    if (p) {
+        autocomplete_item->ProjectColor = p->ColorCode();
+        autocomplete_item->ProjectID = p->ID();
+        autocomplete_item->ProjectGUID = p->GUID();
+        autocomplete_item->ProjectLabel = p->Name();
+        if (p->CID()) {
+            autocomplete_item->ClientLabel = p->ClientName();
+            autocomplete_item->ClientID = p->CID();
         }
     }
+
+    if (t) {
+        autocomplete_item->TaskID = t->ID();
+        autocomplete_item->TaskLabel = t->Name();
+    }
+    autocomplete_item->WorkspaceID = te->WID();
+    auto ws = ws_names.find(te->WID());
+    if (ws != ws_names.end()) {
+        autocomplete_item->WorkspaceName = ws->second;
+    }
+    autocomplete_item->Tags = te->Tags();
+    autocomplete_item->Type = kAutocompleteItemTE;
+    autocomplete_item->Billable = te->Billable();
+    return true;
 }
 
 // Add tasks, in format:
@@ -443,16 +548,252 @@ void RelatedData::projectAutocompleteItems(
 }
 
 void RelatedData::TimeEntryAutocompleteItems(
+    std::vector<view::Autocomplete> *result) const {
+    poco_check_ptr(result);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    autocompleteIndex(kAutocompleteListTimeEntry)->Items(result);
+}
+
+void RelatedData::MinitimerAutocompleteItems(
+    std::vector<view::Autocomplete> *result) const {
+    poco_check_ptr(result);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    autocompleteIndex(kAutocompleteListMiniTimer)->Items(result);
+}
+
+void RelatedData::ProjectAutocompleteItems(
+    std::vector<view::Autocomplete> *result) const {
+    poco_check_ptr(result);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    autocompleteIndex(kAutocompleteListProject)->Items(result);
+}
+
+std::shared_ptr<const std::vector<view::Autocomplete> >
+RelatedData::SharedAutocompleteItems(const Poco::Int64 list) const {
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    AutocompleteIndex *index = autocompleteIndex(list);
+    if (!index) {
+        return std::make_shared<const std::vector<view::Autocomplete> >();
+    }
+    return index->SharedItems();
+}
+
+void RelatedData::AutocompleteQuery(
+    const Poco::Int64 list,
+    const std::string &query,
+    const size_t limit,
+    std::vector<view::Autocomplete> *result) const {
+    poco_check_ptr(result);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    AutocompleteIndex *index = autocompleteIndex(list);
+    if (index) {
+        index->Query(query, limit, result);
+    }
+}
+
+void RelatedData::ApplyAutocompleteChanges(
+    const std::vector<ModelChange> &changes) {
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        const std::string type = it->ModelType();
+        if (kModelWorkspace == type
+                || kModelClient == type
+                || kModelProject == type
+                || kModelTask == type) {
+            invalidateTimeEntryAutocompletes();
+            project_autocomplete_.Invalidate();
+            return;
+        }
+    }
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        if (kModelTimeEntry == it->ModelType()) {
+            applyTimeEntryAutocompleteChange(it->GUID());
+        }
+    }
+}
+
+void RelatedData::invalidateTimeEntryAutocompletes() {
+    time_entry_autocomplete_.Invalidate();
+    minitimer_autocomplete_.Invalidate();
+    time_entry_autocomplete_sources_.stale = true;
+}
+
+void RelatedData::applyTimeEntryAutocompleteChange(const guid GUID) {
+    TimeEntryAutocompleteSources &sources = time_entry_autocomplete_sources_;
+    // Lists built from stale sources are stale as well
+    if (sources.stale) {
+        return;
+    }
+    if (GUID.empty()) {
+        invalidateTimeEntryAutocompletes();
+        return;
+    }
+
+    view::Autocomplete item;
+    TimeEntry *te = TimeEntryByGUID(GUID);
+    const bool listed = te && timeEntryAutocompleteItem(
+        te, sources.ws_names, &item);
+
+    bool was_listed(false);
+    std::string previous_text("");
+    auto previous = sources.texts.find(GUID);
+    if (previous != sources.texts.end()) {
+        was_listed = true;
+        previous_text = previous->second.first;
+        auto ranks = sources.ranks.find(previous_text);
+        if (ranks != sources.ranks.end()) {
+            auto rank = ranks->second.find(
+                TimeEntryAutocompleteRank(previous->second.second, GUID));
+            if (rank != ranks->second.end()) {
+                ranks->second.erase(rank);
+            }
+            if (ranks->second.empty()) {
+                sources.ranks.erase(ranks);
+            }
+        }
+        sources.texts.erase(previous);
+    }
+
+    if (listed) {
+        sources.texts[GUID] = std::make_pair(item.Text, te->StartTime());
+        sources.ranks[item.Text].insert(
+            TimeEntryAutocompleteRank(te->StartTime(), GUID));
+    }
+
+    if (was_listed && (!listed || previous_text != item.Text)) {
+        refreshTimeEntryAutocomplete(previous_text);
+    }
+    if (listed) {
+        refreshTimeEntryAutocomplete(item.Text);
+    }
+}
+
+void RelatedData::refreshTimeEntryAutocomplete(const std::string &text) {
+    TimeEntryAutocompleteSources &sources = time_entry_autocomplete_sources_;
+    auto ranks = sources.ranks.find(text);
+    if (ranks == sources.ranks.end()) {
+        removeTimeEntryAutocomplete(&time_entry_autocomplete_, text);
+        removeTimeEntryAutocomplete(&minitimer_autocomplete_, text);
+        return;
+    }
+
+    const TimeEntryAutocompleteRank latest = *ranks->second.rbegin();
+    TimeEntry *te = nullptr;
+    if (!latest.second.empty()) {
+        te = TimeEntryByGUID(latest.second);
+    }
+    view::Autocomplete item;
+    if (!te || !timeEntryAutocompleteItem(te, sources.ws_names, &item)) {
+        // Only a full build finds time entries without a GUID
+        invalidateTimeEntryAutocompletes();
+        return;
+    }
+    putTimeEntryAutocomplete(&time_entry_autocomplete_, latest, item);
+    putTimeEntryAutocomplete(&minitimer_autocomplete_, latest, item);
+}
+
+void RelatedData::putTimeEntryAutocomplete(
+    AutocompleteIndex *index,
+    const TimeEntryAutocompleteRank &rank,
+    const view::Autocomplete &item) const {
+    if (index->Stale()) {
+        return;
+    }
+
+    const view::Autocomplete *existing = index->Find(item.Text);
+    if (existing) {
+        if (kAutocompleteItemTE != existing->Type) {
+            // A time entry takes the place of a task or project
+            // with the same text, which the full build sorts out
+            index->Invalidate();
+            return;
+        }
+        // Its rank may have changed, and with it the place
+        index->Remove(item.Text);
+    }
+
+    // Time entries come first in their workspace group, latest first.
+    // The groups are sorted by name and follow the ones without
+    // a workspace.
+    const std::map<std::string, std::multiset<TimeEntryAutocompleteRank> >
+    &ranks = time_entry_autocomplete_sources_.ranks;
+    const std::string &group = item.WorkspaceName;
+    index->Insert(index->PartitionPoint(
+    [&](const view::Autocomplete &other) {
+        if (other.WorkspaceName != group) {
+            return !group.empty()
+                   && (other.WorkspaceName.empty()
+                       || other.WorkspaceName < group);
+        }
+        if (kAutocompleteItemTE != other.Type) {
+            return false;
+        }
+        auto other_ranks = ranks.find(other.Text);
+        return other_ranks != ranks.end()
+               && rank < *other_ranks->second.rbegin();
+    }), item);
+}
+
+void RelatedData::removeTimeEntryAutocomplete(
+    AutocompleteIndex *index,
+    const std::string &text) {
+    if (index->Stale()) {
+        return;
+    }
+    const view::Autocomplete *existing = index->Find(text);
+    if (existing && kAutocompleteItemTE == existing->Type) {
+        index->Remove(text);
+    }
+}
+
+AutocompleteIndex *RelatedData::autocompleteIndex(
+    const Poco::Int64 list) const {
+    AutocompleteIndex *index = nullptr;
+    std::vector<view::Autocomplete> items;
+    switch (list) {
+    case kAutocompleteListTimeEntry:
+        index = &time_entry_autocomplete_;
+        if (index->Stale()) {
+            timeEntryAutocompleteList(&items);
+        }
+        break;
+    case kAutocompleteListMiniTimer:
+        index = &minitimer_autocomplete_;
+        if (index->Stale()) {
+            minitimerAutocompleteList(&items);
+        }
+        break;
+    case kAutocompleteListProject:
+        index = &project_autocomplete_;
+        if (index->Stale()) {
+            projectAutocompleteList(&items);
+        }
+        break;
+    default:
+        return nullptr;
+    }
+    if (index->Stale()) {
+        index->Build(&items);
+    }
+    return index;
+}
+
+void RelatedData::timeEntryAutocompleteList(
     std::vector<view::Autocomplete> *result) const {
     std::set<std::string> unique_names;
     std::map<Poco::UInt64, std::string> ws_names;
     std::map<std::string, std::vector<view::Autocomplete> > items;
     workspaceAutocompleteItems(&unique_names, &ws_names, result);
-    timeEntryAutocompleteItems(&unique_names, &ws_names, result, &items);
+    timeEntryAutocompleteItems(&unique_names, &ws_names, result, &items,
+                               timeEntryAutocompleteSources());
     mergeGroupedAutocompleteItems(result, &items);
 }
 
-void RelatedData::MinitimerAutocompleteItems(
+void RelatedData::minitimerAutocompleteList(
     std::vector<view::Autocomplete> *result) const {
     std::set<std::string> unique_names;
     std::map<Poco::UInt64, std::string> ws_names;
@@ -460,7 +801,8 @@ void RelatedData::MinitimerAutocompleteItems(
     std::map<Poco::UInt64, std::vector<view::Autocomplete> > task_items;
 
     workspaceAutocompleteItems(&unique_names, &ws_names, result);
-    timeEntryAutocompleteItems(&unique_names, &ws_names, result, &items);
+    timeEntryAutocompleteItems(&unique_names, &ws_names, result, &items,
+                               timeEntryAutocompleteSources());
     taskAutocompleteItems(&unique_names, &ws_names, result, &task_items);
     projectAutocompleteItems(&unique_names, &ws_names, result, &items, &task_items);
 
@@ -488,7 +830,7 @@ void RelatedData::mergeGroupedAutocompleteItems(
 }
 
 
-void RelatedData::ProjectAutocompleteItems(
+void RelatedData::projectAutocompleteList(
     std::vector<view::Autocomplete> *result) const {
     std::set<std::string> unique_names;
     std::map<Poco::UInt64, std::string> ws_names;
@@ -639,102 +981,326 @@ Client *RelatedData::clientByProject(Project *p) const {
     return c;
 }
 
+template <class T>
+ModelIndex<T> *RelatedData::checkedIndex(std::vector<T *> const *list) const {
+    ModelIndex<T> *result = index<T>();
+    poco_assert_dbg(result->Size() == list->size());
+    return result;
+}
+
+template <class T>
+std::vector<T *> RelatedData::DirtyModels(std::vector<T *> const *list) const {
+    return checkedIndex(list)->Dirty();
+}
+
+template <class T>
+void RelatedData::PruneDirtyModels(std::vector<T *> const *list) const {
+    checkedIndex(list)->PruneDirty();
+}
+
+template std::vector<Workspace *> RelatedData::DirtyModels(std::vector<Workspace *> const *) const;
+template std::vector<Client *> RelatedData::DirtyModels(std::vector<Client *> const *) const;
+template std::vector<Project *> RelatedData::DirtyModels(std::vector<Project *> const *) const;
+template std::vector<Task *> RelatedData::DirtyModels(std::vector<Task *> const *) const;
+template std::vector<Tag *> RelatedData::DirtyModels(std::vector<Tag *> const *) const;
+template std::vector<TimeEntry *> RelatedData::DirtyModels(std::vector<TimeEntry *> const *) const;
+template std::vector<TimelineEvent *> RelatedData::DirtyModels(std::vector<TimelineEvent *> const *) const;
+
+template void RelatedData::PruneDirtyModels(std::vector<Workspace *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<Client *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<Project *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<Task *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<Tag *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<TimeEntry *> const *) const;
+template void RelatedData::PruneDirtyModels(std::vector<TimelineEvent *> const *) const;
+
+template<>
+ModelIndex<Workspace> *RelatedData::index<Workspace>() const {
+    return &workspace_index_;
+}
+
+template<>
+ModelIndex<Client> *RelatedData::index<Client>() const {
+    return &client_index_;
+}
+
+template<>
+ModelIndex<Project> *RelatedData::index<Project>() const {
+    return &project_index_;
+}
+
+template<>
+ModelIndex<Task> *RelatedData::index<Task>() const {
+    return &task_index_;
+}
+
+template<>
+ModelIndex<Tag> *RelatedData::index<Tag>() const {
+    return &tag_index_;
+}
+
+template<>
+ModelIndex<TimeEntry> *RelatedData::index<TimeEntry>() const {
+    return &time_entry_index_;
+}
+
+template<>
+ModelIndex<TimelineEvent> *RelatedData::index<TimelineEvent>() const {
+    return &timeline_event_index_;
+}
+
 Task *RelatedData::TaskByID(const Poco::UInt64 id) const {
-    return modelByID<Task>(id, &Tasks);
+    return checkedIndex(&Tasks)->ByID(id);
 }
 
 Client *RelatedData::ClientByID(const Poco::UInt64 id) const {
-    return modelByID(id, &Clients);
+    return checkedIndex(&Clients)->ByID(id);
 }
 
 Project *RelatedData::ProjectByID(const Poco::UInt64 id) const {
-    return modelByID(id, &Projects);
+    return checkedIndex(&Projects)->ByID(id);
 }
 
 Tag *RelatedData::TagByID(const Poco::UInt64 id) const {
-    return modelByID(id, &Tags);
+    return checkedIndex(&Tags)->ByID(id);
 }
 
 Workspace *RelatedData::WorkspaceByID(const Poco::UInt64 id) const {
-    return modelByID(id, &Workspaces);
+    return checkedIndex(&Workspaces)->ByID(id);
 }
 
 TimeEntry *RelatedData::TimeEntryByID(const Poco::UInt64 id) const {
-    return modelByID(id, &TimeEntries);
+    return checkedIndex(&TimeEntries)->ByID(id);
 }
 
 TimeEntry *RelatedData::TimeEntryByGUID(const guid GUID) const {
-    return modelByGUID(GUID, &TimeEntries);
+    return checkedIndex(&TimeEntries)->ByGUID(GUID);
 }
 
 TimelineEvent *RelatedData::TimelineEventByGUID(const guid GUID) const {
-    return modelByGUID(GUID, &TimelineEvents);
+    return checkedIndex(&TimelineEvents)->ByGUID(GUID);
 }
 
-Tag *RelatedData::TagByGUID(const guid GUID) const {
-    return modelByGUID(GUID, &Tags);
+const TimelineEventIndex::Buckets &RelatedData::TimelineChunks() const {
+    checkedIndex(&TimelineEvents);
+    return timeline_event_index_.Chunks();
 }
 
-Project *RelatedData::ProjectByGUID(const guid GUID) const {
-    return modelByGUID(GUID, &Projects);
+void RelatedData::TimelineEventsBetween(
+    const Poco::Int64 from,
+    const Poco::Int64 to,
+    std::vector<TimelineEvent *> *result) const {
+    checkedIndex(&TimelineEvents);
+    timeline_event_index_.Between(from, to, result);
 }
 
-Client *RelatedData::ClientByGUID(const guid GUID) const {
-    return modelByGUID(GUID, &Clients);
+TimelineEvent *RelatedData::CompressTimelineEvent(TimelineEvent *event) {
+    checkedIndex(&TimelineEvents);
+    return timeline_event_index_.Compress(event);
 }
 
-template <typename T>
-T *modelByGUID(const guid GUID, std::vector<T *> const *list) {
-    if (GUID.empty()) {
-        return nullptr;
+std::vector<TimelineEvent *> RelatedData::UncompressedTimelineEvents() const {
+    checkedIndex(&TimelineEvents);
+    return timeline_event_index_.Uncompressed();
+}
+
+void RelatedData::CloseTimelineChunks(
+    const std::vector<const TimelineEvent *> &chunks) {
+    checkedIndex(&TimelineEvents);
+    for (auto chunk : chunks) {
+        timeline_event_index_.Close(chunk);
     }
-    typedef typename std::vector<T *>::const_iterator iterator;
-    for (iterator it = list->begin(); it != list->end(); ++it) {
-        T *model = *it;
-        if (model->GUID() == GUID) {
-            return model;
+}
+
+template <class T>
+void RelatedData::addDeferred(
+    std::vector<T *> *from,
+    std::vector<T *> *to) {
+    ModelIndex<T> *idx = checkedIndex(to);
+    for (auto model : *from) {
+        // Saved after the first load, so it's read twice
+        if (idx->ByLocalID(model->LocalID())) {
+            delete model;
+            continue;
         }
+        to->push_back(model);
+        idx->Insert(model);
     }
-    return nullptr;
+    from->clear();
 }
 
-template<typename T>
-T *modelByID(const Poco::UInt64 id, std::vector<T *> const *list) {
-    if (!id) {
-        return nullptr;
+void RelatedData::AddDeferred(
+    std::vector<TimeEntry *> *time_entries,
+    std::vector<TimelineEvent *> *timeline_events) {
+    poco_check_ptr(time_entries);
+    poco_check_ptr(timeline_events);
+
+    addDeferred(time_entries, &TimeEntries);
+    addDeferred(timeline_events, &TimelineEvents);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    invalidateTimeEntryAutocompletes();
+}
+
+void RelatedData::SetTimeEntryReaders(
+    const Poco::Int64 hot_since,
+    const TimeEntryReaders &readers) {
+    time_entry_readers_ = readers;
+    time_entry_hot_since_ = hot_since;
+    time_entry_older_since_ = hot_since;
+    time_entry_pages_.clear();
+    time_entry_starts_.clear();
+    time_entry_starts_read_ = false;
+}
+
+Poco::Int64 RelatedData::TimeEntryPageStart(const Poco::Int64 time) {
+    const Poco::Int64 span = kTimeEntryPageDays * 86400;
+    Poco::Int64 page = time / span;
+    if (time < 0 && time % span) {
+        page--;
+    }
+    return page * span;
+}
+
+error RelatedData::PageInTimeEntries(const Poco::Int64 time) {
+    if (!time_entry_readers_.Page || time >= time_entry_hot_since_) {
+        return noError;
+    }
+
+    const Poco::Int64 page = TimeEntryPageStart(time);
+    auto it = std::find(
+        time_entry_pages_.begin(), time_entry_pages_.end(), page);
+    if (it != time_entry_pages_.end()) {
+        time_entry_pages_.splice(
+            time_entry_pages_.begin(), time_entry_pages_, it);
+        return noError;
+    }
+
+    std::vector<TimeEntry *> list;
+    error err = time_entry_readers_.Page(
+        page, page + kTimeEntryPageDays * 86400, &list);
+    if (err != noError) {
+        clearList(&list);
+        return err;
+    }
+    {
+        Poco::Mutex::ScopedLock lock(timeEntries_m_);
+        addDeferred(&list, &TimeEntries);
+    }
+    time_entry_pages_.push_front(page);
+
+    Poco::Mutex::ScopedLock lock(autocomplete_m_);
+    invalidateTimeEntryAutocompletes();
+    return noError;
+}
+
+error RelatedData::PageInOlderTimeEntries(bool *loaded) {
+    poco_check_ptr(loaded);
+
+    *loaded = false;
+    if (!time_entry_readers_.StartBefore) {
+        return noError;
+    }
+
+    Poco::Int64 start(0);
+    error err = time_entry_readers_.StartBefore(
+        time_entry_older_since_, &start, loaded);
+    if (err != noError || !*loaded) {
+        return err;
+    }
+    err = PageInTimeEntries(start);
+    if (err != noError) {
+        *loaded = false;
+        return err;
+    }
+    time_entry_older_since_ = TimeEntryPageStart(start);
+    return noError;
+}
+
+TimeEntry *RelatedData::PageInTimeEntryByID(const Poco::UInt64 id) {
+    TimeEntry *te = TimeEntryByID(id);
+    if (te || !time_entry_readers_.StartsBefore) {
+        return te;
     }
-    typedef typename std::vector<T *>::const_iterator iterator;
-    for (iterator it = list->begin(); it != list->end(); ++it) {
-        T *model = *it;
-        if (model->ID() == id) {
-            return model;
+
+    if (!time_entry_starts_read_) {
+        if (time_entry_readers_.StartsBefore(
+                    time_entry_hot_since_, &time_entry_starts_) != noError) {
+            time_entry_starts_.clear();
+            return nullptr;
         }
+        time_entry_starts_read_ = true;
+    }
+
+    auto it = time_entry_starts_.find(id);
+    if (it == time_entry_starts_.end()
+            || PageInTimeEntries(it->second) != noError) {
+        return nullptr;
+    }
+    return TimeEntryByID(id);
+}
+
+size_t RelatedData::EvictTimeEntryPages() {
+    size_t evicted = 0;
+    while (time_entry_pages_.size() > kTimeEntryResidentPages) {
+        const Poco::Int64 from = time_entry_pages_.back();
+        const Poco::Int64 to = std::min(
+            from + kTimeEntryPageDays * 86400, time_entry_hot_since_);
+        time_entry_pages_.pop_back();
+
+        Poco::Mutex::ScopedLock lock(timeEntries_m_);
+        checkedIndex(&TimeEntries);
+        auto end = std::remove_if(
+            TimeEntries.begin(), TimeEntries.end(),
+        [&](TimeEntry *te) {
+            if (te->StartTime() < from || te->StartTime() >= to
+                    || te->NeedsToBeSaved() || te->NeedsPush()
+                    || te->IsTracking()) {
+                return false;
+            }
+            if (time_entry_starts_read_ && te->ID()) {
+                time_entry_starts_[te->ID()] = te->StartTime();
+            }
+            te->Unindex();
+            delete te;
+            evicted++;
+            return true;
+        });
+        TimeEntries.erase(end, TimeEntries.end());
+    }
+
+    if (evicted) {
+        Poco::Mutex::ScopedLock lock(autocomplete_m_);
+        invalidateTimeEntryAutocompletes();
     }
-    return nullptr;
+    return evicted;
+}
+
+Tag *RelatedData::TagByGUID(const guid GUID) const {
+    return checkedIndex(&Tags)->ByGUID(GUID);
+}
+
+Project *RelatedData::ProjectByGUID(const guid GUID) const {
+    return checkedIndex(&Projects)->ByGUID(GUID);
+}
+
+Client *RelatedData::ClientByGUID(const guid GUID) const {
+    return checkedIndex(&Clients)->ByGUID(GUID);
 }
 
 template<>
 TimeEntry *toggl::RelatedData::ModelByLocalID<TimeEntry>(Poco::Int64 id) {
-    auto it = std::find_if(TimeEntries.begin(), TimeEntries.end(), [id](auto &item){ return item->LocalID() == id; });
-    if (it != TimeEntries.end())
-        return *it;
-    return nullptr;
+    return checkedIndex(&TimeEntries)->ByLocalID(id);
 }
 
 template<>
 Project *toggl::RelatedData::ModelByLocalID<Project>(Poco::Int64 id) {
-    auto it = std::find_if(Projects.begin(), Projects.end(), [id](auto &item){ return item->LocalID() == id; });
-    if (it != Projects.end())
-        return *it;
-    return nullptr;
+    return checkedIndex(&Projects)->ByLocalID(id);
 }
 
 template<>
 Client *toggl::RelatedData::ModelByLocalID<Client>(Poco::Int64 id) {
-    auto it = std::find_if(Clients.begin(), Clients.end(), [id](auto &item){ return item->LocalID() == id; });
-    if (it != Clients.end())
-        return *it;
-    return nullptr;
+    return checkedIndex(&Clients)->ByLocalID(id);
 }
 
 }   // namespace toggl
@@ -3,13 +3,20 @@
 #ifndef SRC_RELATED_DATA_H_
 #define SRC_RELATED_DATA_H_
 
+#include <list>
+#include <memory>
 #include <vector>
 #include <set>
 #include <string>
 #include <map>
 #include <functional>
 
+#include "autocomplete_index.h"
+#include "autotracker_matcher.h"
 #include "model/timeline_event.h"
+#include "model_change.h"
+#include "model_index.h"
+#include "timeline_event_index.h"
 #include "types.h"
 
 #include <Poco/Mutex.h>
@@ -29,14 +36,11 @@ namespace view {
 class TimeEntry;
 };
 
-template<typename T>
-T *modelByID(const Poco::UInt64 id, std::vector<T *> const *list);
-
-template <typename T>
-T *modelByGUID(const guid GUID, std::vector<T *> const *list);
-
 class TOGGL_INTERNAL_EXPORT RelatedData {
  public:
+    RelatedData();
+    ~RelatedData();
+
     std::vector<Workspace *> Workspaces;
     std::vector<Client *> Clients;
     std::vector<Project *> Projects;
@@ -48,6 +52,73 @@ class TOGGL_INTERNAL_EXPORT RelatedData {
 
     void Clear();
 
+    // Models added to the lists above need to be registered in the
+    // lookup indexes, models removed from them need to be dropped
+    // with BaseModel::Unindex
+    template <class T> void Index(T *model);
+    void RebuildIndexes();
+
+    // Appends and indexes the models read in the background after
+    // the first screen was loaded. Ones already in memory are deleted.
+    void AddDeferred(
+        std::vector<TimeEntry *> *time_entries,
+        std::vector<TimelineEvent *> *timeline_events);
+
+    // Reads the time entries that aren't kept in memory
+    struct TimeEntryReaders {
+        // Time entries started in [from, to)
+        std::function<error(const Poco::Int64 from,
+                            const Poco::Int64 to,
+                            std::vector<TimeEntry *> *list)> Page;
+        // Starts of the time entries started before the time, by ID
+        std::function<error(const Poco::Int64 before,
+                            std::map<Poco::UInt64, Poco::Int64> *starts)>
+        StartsBefore;
+        // Start of the latest time entry started before the time
+        std::function<error(const Poco::Int64 before,
+                            Poco::Int64 *start,
+                            bool *found)> StartBefore;
+    };
+
+    // Time entries started since hot_since are all in memory, older
+    // ones are paged in with the readers. Without them all are loaded.
+    void SetTimeEntryReaders(
+        const Poco::Int64 hot_since,
+        const TimeEntryReaders &readers);
+
+    // Start of the page of kTimeEntryPageDays the time is in
+    static Poco::Int64 TimeEntryPageStart(const Poco::Int64 time);
+
+    // Makes sure the time entries of the page the time is in
+    // are in memory and marks the page as recently used
+    error PageInTimeEntries(const Poco::Int64 time);
+
+    // Pages in the time entries before the oldest paged in so far,
+    // loaded is false when there are none left in the database
+    error PageInOlderTimeEntries(bool *loaded);
+
+    // Like TimeEntryByID, but pages the time entry in if needed.
+    // The starts of the older time entries are read once, so
+    // a sync doesn't query the database for every ID.
+    TimeEntry *PageInTimeEntryByID(const Poco::UInt64 id);
+
+    // Number of pages paged in
+    size_t TimeEntryPageCount() const {
+        return time_entry_pages_.size();
+    }
+
+    // Drops the time entries of the least recently used pages past
+    // kTimeEntryResidentPages, except ones with unsaved changes or
+    // tracking. Returns how many were deleted from memory.
+    size_t EvictTimeEntryPages();
+
+    // Models of the list that may need to be saved, as collected
+    // by the index. Prune once they are saved.
+    template <class T> std::vector<T *> DirtyModels(
+        std::vector<T *> const *list) const;
+    template <class T> void PruneDirtyModels(
+        std::vector<T *> const *list) const;
+
     Task *TaskByID(const Poco::UInt64 id) const;
     Client *ClientByID(const Poco::UInt64 id) const;
     Project *ProjectByID(const Poco::UInt64 id) const;
@@ -78,6 +149,25 @@ class TOGGL_INTERNAL_EXPORT RelatedData {
     // Collect visible timeline events
     std::vector<TimelineEvent *> VisibleTimelineEvents() const;
 
+    // Timeline events by the chunk they start in
+    const TimelineEventIndex::Buckets &TimelineChunks() const;
+
+    // Timeline events that started in [from, to)
+    void TimelineEventsBetween(
+        const Poco::Int64 from,
+        const Poco::Int64 to,
+        std::vector<TimelineEvent *> *result) const;
+
+    // Merges a recorded timeline event into the chunk of the same
+    // window, returns that chunk or nullptr if the event became one
+    TimelineEvent *CompressTimelineEvent(TimelineEvent *event);
+
+    // Timeline events loaded before they were compressed
+    std::vector<TimelineEvent *> UncompressedTimelineEvents() const;
+
+    // Stops merging into the chunks, e.g. while they're uploaded
+    void CloseTimelineChunks(const std::vector<const TimelineEvent *> &chunks);
+
     // Collect visible time entries
     std::vector<TimeEntry *> VisibleTimeEntries() const;
 
@@ -88,10 +178,33 @@ class TOGGL_INTERNAL_EXPORT RelatedData {
 
     error DeleteAutotrackerRule(const Poco::Int64 local_id);
 
+    // Call after adding a rule, so FindAutotrackerRule rebuilds its
+    // matcher even if the new rule got the address of a freed one
+    void AutotrackerRulesChanged();
+
     void TimeEntryAutocompleteItems(std::vector<view::Autocomplete> *) const;
     void MinitimerAutocompleteItems(std::vector<view::Autocomplete> *) const;
     void ProjectAutocompleteItems(std::vector<view::Autocomplete> *) const;
 
+    // An autocomplete list (kAutocompleteListTimeEntry, MiniTimer or
+    // Project) that stays valid without the user lock, shared until
+    // the list changes
+    std::shared_ptr<const std::vector<view::Autocomplete> >
+    SharedAutocompleteItems(const Poco::Int64 list) const;
+
+    // Up to limit items of an autocomplete list (kAutocompleteListTimeEntry,
+    // MiniTimer or Project) matching the query, best matches first
+    void AutocompleteQuery(
+        const Poco::Int64 list,
+        const std::string &query,
+        const size_t limit,
+        std::vector<view::Autocomplete> *result) const;
+
+    // Autocomplete lists are built once. Saved time entries are
+    // applied to them, other saved models they are made of make
+    // them be built again.
+    void ApplyAutocompleteChanges(const std::vector<ModelChange> &changes);
+
     void ProjectLabelAndColorCode(
         TimeEntry * const te,
         view::TimeEntry *view) const;
@@ -107,11 +220,112 @@ class TOGGL_INTERNAL_EXPORT RelatedData {
  private:
     Poco::Mutex timeEntries_m_;
 
+    mutable ModelIndex<Workspace> workspace_index_;
+    mutable ModelIndex<Client> client_index_;
+    mutable ModelIndex<Project> project_index_;
+    mutable ModelIndex<Task> task_index_;
+    mutable ModelIndex<Tag> tag_index_;
+    mutable ModelIndex<TimeEntry> time_entry_index_;
+    mutable TimelineEventIndex timeline_event_index_;
+
+    template <class T> ModelIndex<T> *index() const;
+
+    TimeEntryReaders time_entry_readers_;
+    Poco::Int64 time_entry_hot_since_;
+    // Start of the oldest page paged in by PageInOlderTimeEntries
+    Poco::Int64 time_entry_older_since_;
+    // Paged in pages, most recently used first
+    std::list<Poco::Int64> time_entry_pages_;
+    // Starts of the time entries older than the hot window by ID,
+    // read on the first lookup and kept up to date on eviction
+    std::map<Poco::UInt64, Poco::Int64> time_entry_starts_;
+    bool time_entry_starts_read_;
+
+    // Builds the autocomplete list first if it's stale
+    AutocompleteIndex *autocompleteIndex(const Poco::Int64 list) const;
+
+    mutable Poco::Mutex autocomplete_m_;
+    mutable AutocompleteIndex time_entry_autocomplete_;
+    mutable AutocompleteIndex minitimer_autocomplete_;
+    mutable AutocompleteIndex project_autocomplete_;
+
+    // Time entries with the same text are listed once. The one with
+    // the latest start (and GUID, if they start together) gives the
+    // item its details and its place in the workspace group, latest
+    // first, both when the lists are built and when they're updated.
+    typedef std::pair<Poco::Int64, guid> TimeEntryAutocompleteRank;
+
+    // What the time entry lists were built from, so a saved time
+    // entry can be applied to them without building them again
+    struct TimeEntryAutocompleteSources {
+        TimeEntryAutocompleteSources()
+            : stale(true) {}
+
+        bool stale;
+        std::map<Poco::UInt64, std::string> ws_names;
+        // Text and start of every listed time entry, by GUID
+        std::map<guid, std::pair<std::string, Poco::Int64> > texts;
+        // Ranks of the listed time entries with the text
+        std::map<std::string,
+            std::multiset<TimeEntryAutocompleteRank> > ranks;
+    };
+    mutable TimeEntryAutocompleteSources time_entry_autocomplete_sources_;
+
+    // The sources to fill while building a time entry list,
+    // nullptr if they are up to date
+    TimeEntryAutocompleteSources *timeEntryAutocompleteSources() const {
+        if (!time_entry_autocomplete_sources_.stale) {
+            return nullptr;
+        }
+        return &time_entry_autocomplete_sources_;
+    }
+
+    // These expect autocomplete_m_ to be locked
+    void invalidateTimeEntryAutocompletes();
+    void applyTimeEntryAutocompleteChange(const guid GUID);
+    void refreshTimeEntryAutocomplete(const std::string &text);
+    void putTimeEntryAutocomplete(
+        AutocompleteIndex *index,
+        const TimeEntryAutocompleteRank &rank,
+        const view::Autocomplete &item) const;
+    static void removeTimeEntryAutocomplete(
+        AutocompleteIndex *index,
+        const std::string &text);
+
+    // Compiled from the rules when the list has changed
+    mutable Poco::Mutex autotracker_m_;
+    mutable AutotrackerMatcher autotracker_matcher_;
+
+    void timeEntryAutocompleteList(
+        std::vector<view::Autocomplete> *result) const;
+    void minitimerAutocompleteList(
+        std::vector<view::Autocomplete> *result) const;
+    void projectAutocompleteList(
+        std::vector<view::Autocomplete> *result) const;
+
+    // Returns the index of the list. Every model added to or removed
+    // from the list must go through Index or Unindex. Debug builds
+    // check that they did, release builds don't pay for it on
+    // every lookup.
+    template <class T> ModelIndex<T> *checkedIndex(
+        std::vector<T *> const *list) const;
+
+    template <class T> void addDeferred(
+        std::vector<T *> *from,
+        std::vector<T *> *to);
+
     void timeEntryAutocompleteItems(
         std::set<std::string> *unique_names,
         std::map<Poco::UInt64, std::string> *ws_names,
         std::vector<view::Autocomplete> *list,
-        std::map<std::string, std::vector<view::Autocomplete> > *items) const;
+        std::map<std::string, std::vector<view::Autocomplete> > *items,
+        TimeEntryAutocompleteSources *sources) const;
+
+    // false when the time entry has no autocomplete item
+    bool timeEntryAutocompleteItem(
+        TimeEntry *te,
+        const std::map<Poco::UInt64, std::string> &ws_names,
+        view::Autocomplete *item) const;
 
     void taskAutocompleteItems(std::set<std::string> *unique_names,
                                std::map<Poco::UInt64, std::string> *ws_names,
@@ -143,6 +357,19 @@ template<> TimeEntry *RelatedData::ModelByLocalID<TimeEntry>(Poco::Int64 id);
 template<> Project *RelatedData::ModelByLocalID<Project>(Poco::Int64 id);
 template<> Client *RelatedData::ModelByLocalID<Client>(Poco::Int64 id);
 
+template<> ModelIndex<Workspace> *RelatedData::index<Workspace>() const;
+template<> ModelIndex<Client> *RelatedData::index<Client>() const;
+template<> ModelIndex<Project> *RelatedData::index<Project>() const;
+template<> ModelIndex<Task> *RelatedData::index<Task>() const;
+template<> ModelIndex<Tag> *RelatedData::index<Tag>() const;
+template<> ModelIndex<TimeEntry> *RelatedData::index<TimeEntry>() const;
+template<> ModelIndex<TimelineEvent> *RelatedData::index<TimelineEvent>() const;
+
+template <class T>
+void RelatedData::Index(T *model) {
+    index<T>()->Insert(model);
+}
+
 template<typename T>
 void clearList(std::vector<T *> *list);
 
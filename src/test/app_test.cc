@@ -2,12 +2,21 @@
 
 #include "gtest/gtest.h"
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>  // NOLINT
+#include <limits>
+#include <thread>
 
+#include "autocomplete_index.h"
+#include "autotracker_matcher.h"
 #include "model/autotracker.h"
 #include "model/client.h"
 #include "const.h"
 #include "database/database.h"
+#include "get_focused_window.h"
+#include "gui.h"
+#include "https_client.h"
 #include "util/formatter.h"
 #include "model/project.h"
 #include "proxy.h"
@@ -16,17 +25,35 @@
 #include "model/task.h"
 #include "model/time_entry.h"
 #include "model/timeline_event.h"
+#include "timeline_event_index.h"
+#include "time_entry_list_model.h"
 #include "timeline_uploader.h"
+#include "toggl_api_private.h"
+#include "urls.h"
 #include "model/user.h"
+#include "user_snapshot.h"
 #include "model/workspace.h"
+#include "util/json_stream.h"
+#include "util/string_pool.h"
 #include "color_convert.h"
 
 #include "test_data.h"
 
+#include "Poco/Data/RecordSet.h"
+#include "Poco/Data/Session.h"
 #include "Poco/File.h"
 #include "Poco/FileStream.h"
+#include "Poco/InflatingStream.h"
 #include "Poco/Logger.h"
 #include "Poco/LocalDateTime.h"
+#include "Poco/Net/HTTPRequestHandler.h"
+#include "Poco/Net/HTTPRequestHandlerFactory.h"
+#include "Poco/Net/HTTPServer.h"
+#include "Poco/Net/HTTPServerRequest.h"
+#include "Poco/Net/HTTPServerResponse.h"
+#include "Poco/Net/ServerSocket.h"
+#include "Poco/Stopwatch.h"
+#include "Poco/Thread.h"
 #include <Poco/SimpleFileChannel.h>
 #include <Poco/FormattingChannel.h>
 #include <Poco/PatternFormatter.h>
@@ -131,6 +158,91 @@ TEST(Project, ResolveOnlyAdminsCanChangeProjectVisibility) {
     ASSERT_TRUE(p.Private());
 }
 
+TEST(JsonStreamSplitter, SplitsModelArraysWhileReading) {
+    std::string json(
+        "{\"since\": 10, \"data\": {\"id\": 1, \"name\": \"a [\\\"b\\\"]\","
+        " \"clients\": [{\"id\": 2, \"tags\": [\"x\", \"]\"]}, {\"id\": 3}],"
+        " \"other\": [{\"id\": 4}]}, \"tags\": [{\"id\": 5}]}");
+
+    std::vector<std::string> elements;
+    std::set<std::string> keys { "clients", "tags" };
+    JsonStreamSplitter splitter(keys,
+    [&](const std::string &key, const std::string &element) {
+        elements.push_back(key + " " + element);
+        return true;
+    });
+
+    // Feed a byte at a time, like a slow network would
+    for (size_t i = 0; i < json.size(); i++) {
+        ASSERT_EQ(noError, splitter.Feed(json.data() + i, 1));
+    }
+    std::string rest;
+    ASSERT_EQ(noError, splitter.Finish(&rest));
+
+    ASSERT_EQ(3, elements.size());
+    ASSERT_EQ("clients {\"id\": 2, \"tags\": [\"x\", \"]\"]}", elements[0]);
+    ASSERT_EQ("clients {\"id\": 3}", elements[1]);
+    ASSERT_EQ("tags {\"id\": 5}", elements[2]);
+
+    Json::Value root;
+    ASSERT_TRUE(Json::Reader().parse(rest, root));
+    ASSERT_EQ(0, root["data"]["clients"].size());
+    ASSERT_EQ(1, root["data"]["other"].size());
+    ASSERT_EQ("a [\"b\"]", root["data"]["name"].asString());
+
+    JsonStreamSplitter broken(keys,
+    [](const std::string &, const std::string &) {
+        return true;
+    });
+    std::string truncated("{\"clients\": [{\"id\": 2}");
+    ASSERT_EQ(noError, broken.Feed(truncated.data(), truncated.size()));
+    ASSERT_NE(noError, broken.Finish(&rest));
+}
+
+TEST(User, LoadsRelatedDataFromStream) {
+    User loaded;
+    ASSERT_EQ(noError,
+              loaded.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    // A user that's already known gets the models applied as they
+    // arrive, each step going through the guard
+    User user;
+    user.SetID(loaded.ID());
+    size_t steps(0);
+    std::istringstream is(loadTestData());
+    ASSERT_EQ(noError, user.LoadUserAndRelatedDataFromJSONStream(
+        is, true, false, [&](const std::function<void()> &step) {
+            steps++;
+            step();
+            return true;
+        }));
+
+    ASSERT_EQ(loaded.related.Workspaces.size(), user.related.Workspaces.size());
+    ASSERT_EQ(loaded.related.Clients.size(), user.related.Clients.size());
+    ASSERT_EQ(loaded.related.Projects.size(), user.related.Projects.size());
+    ASSERT_EQ(loaded.related.Tasks.size(), user.related.Tasks.size());
+    ASSERT_EQ(loaded.related.Tags.size(), user.related.Tags.size());
+    ASSERT_EQ(loaded.related.TimeEntries.size(), user.related.TimeEntries.size());
+    ASSERT_GT(steps, user.related.TimeEntries.size());
+    ASSERT_EQ(loaded.APIToken(), user.APIToken());
+
+    for (auto it = user.related.Projects.begin();
+            it != user.related.Projects.end(); ++it) {
+        Project *p = loaded.related.ProjectByID((*it)->ID());
+        ASSERT_TRUE(p);
+        ASSERT_EQ(p->ClientName(), (*it)->ClientName());
+    }
+
+    // A guard that refuses stops the loading
+    User stopped;
+    stopped.SetID(loaded.ID());
+    std::istringstream again(loadTestData());
+    ASSERT_NE(noError, stopped.LoadUserAndRelatedDataFromJSONStream(
+        again, true, false, [](const std::function<void()> &) {
+            return false;
+        }));
+}
+
 TEST(User, CreateCompressedTimelineBatchForUpload) {
     testing::Database db;
 
@@ -153,6 +265,7 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     good->SetFilename("Notepad.exe");
     good->SetTitle("untitled");
     user.related.TimelineEvents.push_back(good);
+    user.related.Index(good);
 
     Poco::UInt64 good2_duration_seconds(20);
 
@@ -165,6 +278,7 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     good2->SetFilename("Notepad.exe");
     good2->SetTitle("untitled");
     user.related.TimelineEvents.push_back(good2);
+    user.related.Index(good2);
 
     // Another event that happened at least 15 minutes ago,
     // but has already been uploaded to Toggl backend.
@@ -176,6 +290,7 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     uploaded->SetTitle("untitled");
     uploaded->SetUploaded(true);
     user.related.TimelineEvents.push_back(uploaded);
+    user.related.Index(uploaded);
 
     // This event happened less than 15 minutes ago,
     // so it must not be uploaded
@@ -186,6 +301,7 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     too_fresh->SetFilename("Notepad.exe");
     too_fresh->SetTitle("notes");
     user.related.TimelineEvents.push_back(too_fresh);
+    user.related.Index(too_fresh);
 
     // This event happened more than 7 days ago,
     // so it must not be uploaded, just deleted
@@ -196,6 +312,7 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     too_old->SetFilename("Notepad.exe");
     too_old->SetTitle("diary");
     user.related.TimelineEvents.push_back(too_old);
+    user.related.Index(too_old);
 
     db.instance()->SaveUser(&user, true, &changes);
 
@@ -256,6 +373,95 @@ TEST(User, CreateCompressedTimelineBatchForUpload) {
     ASSERT_EQ(std::size_t(0), left_for_upload.size());
 }
 
+TEST(User, CompressedTimelineForUIReadsOneDay) {
+    User user;
+
+    Poco::LocalDateTime now;
+    Poco::LocalDateTime midnight(now.year(), now.month(), now.day());
+    Poco::Int64 day_start = midnight.utc().timestamp().epochTime();
+
+    const Poco::Int64 starts[] = {
+        day_start - 3600,       // yesterday
+        day_start,              // first chunk of the day
+        day_start + 50,         // same chunk
+        day_start + 3600 * 12,  // noon
+        day_start + 3600 * 48   // day after tomorrow
+    };
+    std::vector<TimelineEvent *> events;
+    for (auto start : starts) {
+        TimelineEvent *event = new TimelineEvent();
+        event->SetStartTime(start);
+        event->SetEndTime(start + 10);
+        event->SetFilename("Notepad.exe");
+        user.related.TimelineEvents.push_back(event);
+        user.related.Index(event);
+        events.push_back(event);
+    }
+    events[3]->Delete();
+
+    std::vector<const TimelineEvent *> timeline =
+        user.CompressedTimelineForUI(&midnight);
+    ASSERT_EQ(size_t(2), timeline.size());
+    ASSERT_EQ(events[1], timeline[0]);
+    ASSERT_EQ(events[2], timeline[1]);
+
+    const TimelineEventIndex::Buckets &chunks = user.related.TimelineChunks();
+    ASSERT_EQ(size_t(4), chunks.size());
+    ASSERT_EQ(size_t(2), chunks.at(day_start).size());
+
+    // Purged events leave their chunk
+    events[1]->Unindex();
+    events[2]->Unindex();
+    ASSERT_EQ(size_t(3), chunks.size());
+    ASSERT_FALSE(chunks.count(day_start));
+}
+
+TEST(User, CompressesTimelineEventsAsTheyAreRecorded) {
+    User user;
+
+    // A complete chunk, so its events can be uploaded
+    Poco::Int64 chunk_start =
+        TimelineEventIndex::ChunkStart(time(nullptr)) - kTimelineChunkSeconds;
+
+    auto record = [&](const Poco::Int64 start, const std::string &title) {
+        TimelineEvent *event = new TimelineEvent();
+        event->SetStartTime(start);
+        event->SetEndTime(start + 30);
+        event->SetFilename("Notepad.exe");
+        event->SetTitle(title);
+        TimelineEvent *chunk = user.related.CompressTimelineEvent(event);
+        if (chunk) {
+            delete event;
+            return chunk;
+        }
+        user.related.TimelineEvents.push_back(event);
+        user.related.Index(event);
+        return event;
+    };
+
+    TimelineEvent *first = record(chunk_start + 10, "untitled");
+    ASSERT_TRUE(first->Chunked());
+    ASSERT_EQ(first, record(chunk_start + 100, "untitled"));
+    ASSERT_EQ(Poco::Int64(60), first->Duration());
+
+    TimelineEvent *other = record(chunk_start + 200, "notes");
+    ASSERT_NE(first, other);
+    ASSERT_NE(first, record(chunk_start + kTimelineChunkSeconds, "untitled"));
+    ASSERT_EQ(size_t(3), user.related.TimelineEvents.size());
+
+    // Events of the current chunk are not uploaded yet
+    std::vector<const TimelineEvent *> batch =
+        user.CompressedTimelineForUpload();
+    ASSERT_EQ(size_t(2), batch.size());
+
+    // Chunks being uploaded are not merged into
+    user.related.CloseTimelineChunks(batch);
+    TimelineEvent *late = record(chunk_start + 300, "untitled");
+    ASSERT_NE(first, late);
+    ASSERT_EQ(Poco::Int64(60), first->Duration());
+    ASSERT_EQ(late, record(chunk_start + 400, "untitled"));
+}
+
 TEST(Database, Trim) {
     testing::Database db;
     std::string text(" jäääär ");
@@ -265,6 +471,107 @@ TEST(Database, Trim) {
     ASSERT_EQ(std::string("jäääär"), result);
 }
 
+TEST(Database, MaintainsInSteps) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    // Enough old synced rows to free whole pages
+    for (int i = 0; i < 1000; i++) {
+        TimeEntry *te = new TimeEntry();
+        te->SetID(500000000 + i);
+        te->SetUID(user.ID());
+        te->SetWID(user.DefaultWID());
+        te->SetDescription(std::string(200, 'x'), false);
+        te->SetStartTime(1400000000 + i * 3600, false);
+        te->SetDurationInSeconds(1800, false);
+        user.related.pushBackTimeEntry(te);
+    }
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+
+    Poco::UInt64 count(0);
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "select count(*) from time_entries", &count));
+    ASSERT_LT(Poco::UInt64(1000), count);
+
+    bool enabled(true);
+    ASSERT_EQ(noError, db.instance()->IncrementalVacuumEnabled(&enabled));
+    ASSERT_FALSE(enabled);
+
+    // The full vacuum runs once, on a connection of its own,
+    // while the database stays open
+    bool switched(false);
+    ASSERT_EQ(noError, Database::SwitchToIncrementalVacuum(
+        db.instance()->DBPath(), &switched));
+    ASSERT_TRUE(switched);
+    ASSERT_EQ(noError, Database::SwitchToIncrementalVacuum(
+        db.instance()->DBPath(), &switched));
+    ASSERT_FALSE(switched);
+
+    ASSERT_EQ(noError, db.instance()->IncrementalVacuumEnabled(&enabled));
+    ASSERT_TRUE(enabled);
+
+    // The test data is years old, so all of it is gone
+    ASSERT_EQ(noError, db.instance()->PurgeOldSyncedData());
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "select count(*) from time_entries", &count));
+    ASSERT_EQ(Poco::UInt64(0), count);
+
+    Poco::UInt64 free_pages(0);
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "PRAGMA freelist_count", &free_pages));
+    ASSERT_LT(Poco::UInt64(0), free_pages);
+
+    // Without a budget it stops after the first step
+    bool finished(true);
+    ASSERT_EQ(noError, db.instance()->Maintain(Poco::Timespan(0), &finished));
+    ASSERT_FALSE(finished);
+
+    ASSERT_EQ(noError, db.instance()->Maintain(
+        Poco::Timespan(60 * Poco::Timespan::SECONDS), &finished));
+    ASSERT_TRUE(finished);
+
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "PRAGMA freelist_count", &free_pages));
+    ASSERT_EQ(Poco::UInt64(0), free_pages);
+}
+
+TEST(Database, KeepsSyncedTimeEntriesForRetentionDays) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    const Poco::Int64 now = Poco::Timestamp().epochTime();
+    TimeEntry *kept = new TimeEntry();
+    kept->SetID(600000001);
+    kept->SetUID(user.ID());
+    kept->SetWID(user.DefaultWID());
+    kept->SetStartTime(now - (kTimeEntryRetentionDays - 1) * 86400, false);
+    kept->SetStopTime(kept->StartTime() + 1800, false);
+    user.related.pushBackTimeEntry(kept);
+    TimeEntry *purged = new TimeEntry();
+    purged->SetID(600000002);
+    purged->SetUID(user.ID());
+    purged->SetWID(user.DefaultWID());
+    purged->SetStartTime(now - (kTimeEntryRetentionDays + 1) * 86400, false);
+    purged->SetStopTime(purged->StartTime() + 1800, false);
+    user.related.pushBackTimeEntry(purged);
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+
+    ASSERT_EQ(noError, db.instance()->PurgeOldSyncedData());
+    Poco::UInt64 count(0);
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "select count(*) from time_entries where id = 600000001", &count));
+    ASSERT_EQ(Poco::UInt64(1), count);
+    ASSERT_EQ(noError, db.instance()->UInt(
+        "select count(*) from time_entries where id = 600000002", &count));
+    ASSERT_EQ(Poco::UInt64(0), count);
+}
+
 TEST(Database, SaveAndLoadCurrentAPIToken) {
     testing::Database db;
     std::string api_token("");
@@ -327,6 +634,34 @@ TEST(User, Since) {
     ASSERT_TRUE(u.HasValidSinceDate());
 }
 
+TEST(User, SchedulesFullSync) {
+    testing::Database db;
+
+    User user;
+    ASSERT_TRUE(user.FullSyncDue());
+
+    // Loading all data removes zombies, so it counts as a full sync
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    ASSERT_FALSE(user.FullSyncDue());
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+
+    User loaded;
+    ASSERT_EQ(noError, db.instance()->LoadUserByID(user.ID(), &loaded));
+    ASSERT_EQ(user.FullSyncedAt(), loaded.FullSyncedAt());
+    ASSERT_FALSE(loaded.FullSyncDue());
+
+    loaded.SetFullSyncedAt(time(nullptr) - kFullSyncIntervalSeconds - 1);
+    ASSERT_TRUE(loaded.FullSyncDue());
+
+    // A partial load doesn't reset the schedule
+    ASSERT_EQ(noError,
+              loaded.LoadUserAndRelatedDataFromJSONString(loadTestData(), false, false));
+    ASSERT_TRUE(loaded.FullSyncDue());
+}
+
 TEST(User, UpdatesTimeEntryFromJSON) {
     User user;
     ASSERT_EQ(noError,
@@ -360,6 +695,823 @@ TEST(User, DeletesZombies) {
     ASSERT_TRUE(te->IsMarkedAsDeletedOnServer());
 }
 
+TEST(User, FindsRelatedModelsAfterKeyChanges) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    TimeEntry *te = user.related.TimeEntryByID(89818605);
+    ASSERT_TRUE(te);
+    ASSERT_EQ(te, user.related.TimeEntryByGUID(te->GUID()));
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_TRUE(te->LocalID());
+    ASSERT_EQ(te, user.related.ModelByLocalID<TimeEntry>(te->LocalID()));
+
+    ASSERT_TRUE(user.SetModelID<TimeEntry>(89818606, te));
+    ASSERT_FALSE(user.related.TimeEntryByID(89818605));
+    ASSERT_EQ(te, user.related.TimeEntryByID(89818606));
+
+    te->SetGUID("07fba193-91c4-0ec8-2345-820df0548123");
+    ASSERT_EQ(te, user.related.TimeEntryByGUID("07fba193-91c4-0ec8-2345-820df0548123"));
+
+    Project *p = user.CreateProject(
+        user.related.Workspaces[0]->ID(), 0, "", "", "Indexed", false, "", false);
+    p->EnsureGUID();
+    ASSERT_EQ(p, user.related.ProjectByGUID(p->GUID()));
+
+    // Models pushed to the lists have to be registered
+    TimelineEvent *event = new TimelineEvent();
+    event->EnsureGUID();
+    event->SetStartTime(time(0) - 10);
+    event->SetEndTime(time(0));
+    user.related.TimelineEvents.push_back(event);
+#ifdef _DEBUG
+    ASSERT_THROW(user.related.TimelineEventByGUID(event->GUID()),
+                 Poco::AssertionViolationException);
+#else
+    ASSERT_FALSE(user.related.TimelineEventByGUID(event->GUID()));
+#endif
+    user.related.Index(event);
+    ASSERT_EQ(event, user.related.TimelineEventByGUID(event->GUID()));
+
+    // Indexing a model again leaves it registered once
+    user.related.Index(event);
+    ASSERT_EQ(event, user.related.TimelineEventByGUID(event->GUID()));
+    ASSERT_EQ(size_t(1), user.related.DirtyModels(
+        &user.related.TimelineEvents).size());
+
+    te->MarkAsDeletedOnServer();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_FALSE(user.related.TimeEntryByID(89818606));
+}
+
+// The list as Context::updateUI built it before TimeEntryListModel:
+// every visible time entry sorted and filled again on each render
+static void renderTimeEntryListFromScratch(
+    User *user,
+    std::map<std::string, bool_t> entry_groups,
+    std::vector<view::TimeEntry> *time_entry_views) {
+    std::vector<TimeEntry *> time_entries =
+        user->related.VisibleTimeEntries();
+    std::sort(time_entries.begin(), time_entries.end(), CompareByStart);
+
+    std::map<std::string, Poco::Int64> date_durations;
+    std::map<std::string, Poco::Int64> group_durations;
+    std::map<std::string, Poco::UInt64> group_header_id;
+    std::map<std::string, std::vector<Poco::UInt64> > group_items;
+
+    for (unsigned int i = 0; i < time_entries.size(); i++) {
+        TimeEntry *te = time_entries[i];
+        std::string date_header =
+            toggl::Formatter::FormatDateHeader(te->StartTime());
+        date_durations[date_header] += Formatter::AbsDuration(te->Duration());
+        if (te->Duration() < 0) {
+            continue;
+        }
+        if (user->CollapseEntries()) {
+            std::string group_name = te->GroupHash();
+            group_header_id[group_name] = i;
+            group_durations[group_name] += Formatter::AbsDuration(te->Duration());
+            group_items[group_name].push_back(i);
+        }
+    }
+
+    for (unsigned int i = 0; i < time_entries.size(); i++) {
+        TimeEntry *te = time_entries[i];
+        if (te->Duration() < 0) {
+            continue;
+        }
+
+        view::TimeEntry view;
+        view.Fill(te);
+
+        if (user->CollapseEntries()) {
+            if (group_items[view.GroupName].size() > 1) {
+                if (group_header_id[view.GroupName] == i) {
+                    if (entry_groups[view.GroupName]) {
+                        for (unsigned int j = 0; j < group_items[view.GroupName].size(); j++) {
+                            TimeEntry *group_entry =
+                                time_entries[group_items[view.GroupName][j]];
+                            view::TimeEntry group_entry_view;
+                            group_entry_view.Fill(group_entry);
+                            group_entry_view.GroupOpen = entry_groups[view.GroupName];
+                            user->related.ProjectLabelAndColorCode(
+                                group_entry, &group_entry_view);
+                            group_entry_view.Locked = false;
+                            group_entry_view.Duration = toggl::Formatter::FormatDuration(
+                                group_entry_view.DurationInSeconds,
+                                Formatter::DurationFormat);
+                            group_entry_view.DateDuration =
+                                Formatter::FormatDurationForDateHeader(
+                                    date_durations[group_entry_view.DateHeader]);
+                            time_entry_views->push_back(group_entry_view);
+                        }
+                    }
+
+                    view::TimeEntry group_view;
+                    group_view.Fill(te);
+                    user->related.ProjectLabelAndColorCode(te, &group_view);
+                    group_view.Group = true;
+                    group_view.GroupOpen = entry_groups[group_view.GroupName];
+                    group_view.DurationInSeconds = group_durations[view.GroupName];
+                    group_view.Duration = Formatter::FormatDuration(
+                        group_durations[view.GroupName],
+                        Formatter::DurationFormat);
+                    group_view.DateDuration =
+                        Formatter::FormatDurationForDateHeader(
+                            date_durations[view.DateHeader]);
+                    group_view.GroupItemCount = group_items[group_view.GroupName].size();
+                    time_entry_views->push_back(group_view);
+                }
+                continue;
+            }
+            view.GroupItemCount = 1;
+        }
+        user->related.ProjectLabelAndColorCode(te, &view);
+        view.Locked = false;
+        view.GroupOpen = false;
+        view.Duration = toggl::Formatter::FormatDuration(
+            view.DurationInSeconds,
+            Formatter::DurationFormat);
+        view.DateDuration =
+            Formatter::FormatDurationForDateHeader(
+                date_durations[view.DateHeader]);
+        time_entry_views->push_back(view);
+    }
+}
+
+static void assertSameTimeEntryList(
+    TimeEntryListModel *incremental,
+    User *user,
+    const std::map<std::string, bool_t> &entry_groups) {
+    std::vector<view::TimeEntry> actual;
+    incremental->Update(user, [](TimeEntry *) {
+        return false;
+    });
+    incremental->Render(entry_groups, &actual);
+
+    std::vector<view::TimeEntry> expected;
+    renderTimeEntryListFromScratch(user, entry_groups, &expected);
+
+    ASSERT_EQ(expected.size(), actual.size());
+    for (size_t i = 0; i < expected.size(); i++) {
+        ASSERT_EQ(expected[i].GUID, actual[i].GUID);
+        ASSERT_EQ(expected[i].Description, actual[i].Description);
+        ASSERT_EQ(expected[i].ProjectAndTaskLabel, actual[i].ProjectAndTaskLabel);
+        ASSERT_EQ(expected[i].Group, actual[i].Group);
+        ASSERT_EQ(expected[i].GroupName, actual[i].GroupName);
+        ASSERT_EQ(expected[i].GroupOpen, actual[i].GroupOpen);
+        ASSERT_EQ(expected[i].GroupItemCount, actual[i].GroupItemCount);
+        ASSERT_EQ(expected[i].DurationInSeconds, actual[i].DurationInSeconds);
+        ASSERT_EQ(expected[i].Duration, actual[i].Duration);
+        ASSERT_EQ(expected[i].DateHeader, actual[i].DateHeader);
+        ASSERT_EQ(expected[i].DateDuration, actual[i].DateDuration);
+    }
+}
+
+static view::Autocomplete autocompleteItem(const std::string &text) {
+    view::Autocomplete item;
+    item.Text = text;
+    item.Description = text;
+    item.Type = kAutocompleteItemTE;
+    return item;
+}
+
+TEST(AutocompleteIndex, RanksWordStartsFirst) {
+    std::vector<view::Autocomplete> items;
+    items.push_back(autocompleteItem("Write report"));
+    items.push_back(autocompleteItem("Review code"));
+    items.push_back(autocompleteItem("Coffee break"));
+    items.push_back(autocompleteItem("Rework reports"));
+    items.push_back(autocompleteItem("Prepare slides"));
+
+    AutocompleteIndex index;
+    ASSERT_TRUE(index.Stale());
+    index.Build(&items);
+    ASSERT_FALSE(index.Stale());
+    ASSERT_EQ(size_t(5), index.Size());
+
+    std::vector<view::Autocomplete> result;
+    index.Query("re", 0, &result);
+    ASSERT_EQ(size_t(3), result.size());
+    ASSERT_EQ("Review code", result[0].Text);
+    ASSERT_EQ("Rework reports", result[1].Text);
+    ASSERT_EQ("Write report", result[2].Text);
+
+    // Longer words match anywhere, ranked after word starts
+    result.clear();
+    index.Query("REPOR", 0, &result);
+    ASSERT_EQ(size_t(2), result.size());
+    ASSERT_EQ("Write report", result[0].Text);
+
+    result.clear();
+    index.Query("epa", 0, &result);
+    ASSERT_EQ(size_t(1), result.size());
+    ASSERT_EQ("Prepare slides", result[0].Text);
+
+    result.clear();
+    index.Query("rev co", 0, &result);
+    ASSERT_EQ(size_t(1), result.size());
+    ASSERT_EQ("Review code", result[0].Text);
+
+    result.clear();
+    index.Query("re", 1, &result);
+    ASSERT_EQ(size_t(1), result.size());
+
+    result.clear();
+    index.Query("", 2, &result);
+    ASSERT_EQ(size_t(2), result.size());
+    ASSERT_EQ("Write report", result[0].Text);
+
+    result.clear();
+    index.Query("xyz", 0, &result);
+    ASSERT_TRUE(result.empty());
+}
+
+TEST(AutocompleteIndex, UpdatesSingleItems) {
+    std::vector<view::Autocomplete> items;
+    items.push_back(autocompleteItem("Write report"));
+    items.push_back(autocompleteItem("Review code"));
+
+    AutocompleteIndex index;
+    index.Build(&items);
+
+    index.Insert(1, autocompleteItem("Release notes"));
+    ASSERT_EQ(size_t(3), index.Size());
+    ASSERT_EQ("Release notes", index.Item(1).Text);
+
+    view::Autocomplete replaced = autocompleteItem("Review code");
+    replaced.Tags = "review";
+    ASSERT_TRUE(index.Replace(replaced));
+    ASSERT_EQ("review", index.Item(2).Tags);
+    ASSERT_FALSE(index.Replace(autocompleteItem("Coffee break")));
+
+    std::vector<view::Autocomplete> result;
+    index.Query("re", 0, &result);
+    ASSERT_EQ(size_t(3), result.size());
+    ASSERT_EQ("review", result[1].Tags);
+
+    // Equal matches keep their order in the list,
+    // not the order the items were added in
+    index.Insert(0, autocompleteItem("Retro"));
+    result.clear();
+    index.Query("re", 0, &result);
+    ASSERT_EQ("Retro", result[0].Text);
+    ASSERT_EQ(size_t(1), index.PartitionPoint(
+    [](const view::Autocomplete &item) {
+        return "Retro" == item.Text;
+    }));
+    ASSERT_TRUE(index.Remove("Retro"));
+
+    ASSERT_TRUE(index.Remove("Write report"));
+    ASSERT_FALSE(index.Remove("Write report"));
+    ASSERT_FALSE(index.Find("Write report"));
+    ASSERT_EQ(size_t(2), index.Size());
+
+    result.clear();
+    index.Query("wri", 0, &result);
+    ASSERT_TRUE(result.empty());
+
+    // Removed items are dropped from the index once they pile up
+    for (int i = 0; i < 200; i++) {
+        std::stringstream ss;
+        ss << "Ticket " << i;
+        index.Insert(index.Size(), autocompleteItem(ss.str()));
+        ASSERT_TRUE(index.Remove(ss.str()));
+    }
+    ASSERT_EQ(size_t(2), index.Size());
+    result.clear();
+    index.Query("tic", 0, &result);
+    ASSERT_TRUE(result.empty());
+    result.clear();
+    index.Query("", 0, &result);
+    ASSERT_EQ(size_t(2), result.size());
+    ASSERT_EQ("Release notes", result[0].Text);
+}
+
+TEST(AutocompleteIndex, QueriesLargeListQuickly) {
+    const char *words[] = {
+        "design", "review", "meeting", "support", "planning",
+        "report", "backend", "mobile", "release", "research"
+    };
+    std::vector<view::Autocomplete> items;
+    for (int i = 0; i < 50000; i++) {
+        std::stringstream ss;
+        ss << words[i % 10] << " " << words[(i / 10) % 10]
+           << " ticket " << i;
+        items.push_back(autocompleteItem(ss.str()));
+    }
+
+    AutocompleteIndex index;
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    index.Build(&items);
+    stopwatch.stop();
+    std::cout << "50000 autocomplete items indexed in "
+              << stopwatch.elapsed() / 1000 << " ms" << std::endl;
+
+    std::vector<view::Autocomplete> result;
+    stopwatch.restart();
+    index.Query("rel mob 4", 10, &result);
+    stopwatch.stop();
+    std::cout << "Top 10 of 50000 autocomplete items in "
+              << stopwatch.elapsed() << " us" << std::endl;
+
+    // Words may match in any order
+    ASSERT_EQ(size_t(10), result.size());
+    ASSERT_EQ("release mobile ticket 478", result[0].Text);
+    ASSERT_EQ("mobile release ticket 487", result[1].Text);
+    for (auto it = result.begin(); it != result.end(); ++it) {
+        ASSERT_NE(std::string::npos, it->Text.find(" ticket 4"));
+    }
+}
+
+TEST(RelatedData, KeepsAutocompleteItemsUntilModelsChange) {
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    std::vector<view::Autocomplete> before;
+    user.related.TimeEntryAutocompleteItems(&before);
+    ASSERT_FALSE(before.empty());
+
+    TimeEntry *te = user.related.TimeEntries[0];
+    te->SetDescription("Changed autocomplete description", true);
+
+    std::vector<view::Autocomplete> cached;
+    user.related.TimeEntryAutocompleteItems(&cached);
+    ASSERT_EQ(before.size(), cached.size());
+
+    std::vector<ModelChange> changes;
+    changes.push_back(ModelChange(
+        te->ModelName(), kChangeTypeUpdate, te->ID(), te->GUID()));
+    user.related.ApplyAutocompleteChanges(changes);
+
+    std::vector<view::Autocomplete> result;
+    user.related.AutocompleteQuery(
+        kAutocompleteListTimeEntry, "changed autoc", 5, &result);
+    ASSERT_EQ(size_t(1), result.size());
+    ASSERT_EQ("Changed autocomplete description", result[0].Description);
+
+    // A saved time entry is applied to the lists, which end up
+    // with the same items a full build gives
+    std::vector<view::Autocomplete> applied;
+    user.related.MinitimerAutocompleteItems(&applied);
+    applied.clear();
+
+    TimeEntry *added = new TimeEntry();
+    added->SetGUID("07fba193-91c4-0ec8-2345-820df0548123");
+    added->SetWID(te->WID());
+    added->SetPID(te->PID(), true);
+    added->SetDescription("Added autocomplete description", true);
+    user.related.pushBackTimeEntry(added);
+    te->SetDeletedAt(time(nullptr));
+
+    changes.clear();
+    changes.push_back(ModelChange(
+        te->ModelName(), kChangeTypeDelete, te->ID(), te->GUID()));
+    changes.push_back(ModelChange(
+        added->ModelName(), kChangeTypeInsert, 0, added->GUID()));
+    user.related.ApplyAutocompleteChanges(changes);
+    user.related.MinitimerAutocompleteItems(&applied);
+
+    changes.clear();
+    changes.push_back(ModelChange(kModelProject, kChangeTypeUpdate, 0, ""));
+    user.related.ApplyAutocompleteChanges(changes);
+
+    std::vector<view::Autocomplete> built;
+    user.related.MinitimerAutocompleteItems(&built);
+
+    std::multiset<std::string> applied_texts;
+    for (auto it = applied.begin(); it != applied.end(); ++it) {
+        applied_texts.insert(it->Text + "/" + it->WorkspaceName);
+    }
+    std::multiset<std::string> built_texts;
+    for (auto it = built.begin(); it != built.end(); ++it) {
+        built_texts.insert(it->Text + "/" + it->WorkspaceName);
+    }
+    ASSERT_EQ(built_texts, applied_texts);
+
+    result.clear();
+    user.related.AutocompleteQuery(
+        kAutocompleteListMiniTimer, "added autoc", 5, &result);
+    ASSERT_EQ(size_t(1), result.size());
+    result.clear();
+    user.related.AutocompleteQuery(
+        kAutocompleteListTimeEntry, "changed autoc", 5, &result);
+    ASSERT_TRUE(result.empty());
+}
+
+static std::vector<std::string> autocompleteStrings(
+    const std::vector<view::Autocomplete> &items) {
+    std::vector<std::string> result;
+    for (auto it = items.begin(); it != items.end(); ++it) {
+        result.push_back(it->String());
+    }
+    return result;
+}
+
+TEST(RelatedData, AppliesAutocompleteChangesLikeAFullBuild) {
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    Project *project = nullptr;
+    for (auto p : user.related.Projects) {
+        if (p->Active()) {
+            project = p;
+            break;
+        }
+    }
+    ASSERT_TRUE(project);
+
+    // Built once, the changes below are applied to the lists
+    std::vector<view::Autocomplete> items;
+    user.related.TimeEntryAutocompleteItems(&items);
+    user.related.MinitimerAutocompleteItems(&items);
+
+    auto apply = [&](TimeEntry *te, const std::string &type) {
+        std::vector<ModelChange> changes;
+        changes.push_back(ModelChange(
+            te->ModelName(), type, te->ID(), te->GUID()));
+        user.related.ApplyAutocompleteChanges(changes);
+    };
+
+    const Poco::Int64 now = time(nullptr);
+    const char *descriptions[] = {
+        "Standup", "Standup", "Planning", "Retro", "Standup"
+    };
+    std::vector<TimeEntry *> entries;
+    for (int i = 0; i < 5; i++) {
+        TimeEntry *te = new TimeEntry();
+        te->EnsureGUID();
+        te->SetUID(user.ID());
+        te->SetWID(project->WID());
+        te->SetDescription(descriptions[i], true);
+        te->SetTags(std::to_string(i), true);
+        te->SetStartTime(now - (i + 1) * 3600, true);
+        te->SetStopTime(te->StartTime() + 600, true);
+        if (i % 2) {
+            te->SetPID(project->ID(), true);
+        }
+        user.related.pushBackTimeEntry(te);
+        entries.push_back(te);
+        apply(te, kChangeTypeInsert);
+    }
+
+    // Same text as an older entry, which keeps giving the details
+    entries[3]->SetDescription("Standup", true);
+    apply(entries[3], kChangeTypeUpdate);
+    // Starting later makes an entry the one that gives them
+    entries[4]->SetStartTime(now, true);
+    apply(entries[4], kChangeTypeUpdate);
+    entries[0]->SetDeletedAt(now);
+    apply(entries[0], kChangeTypeDelete);
+    entries[2]->SetPID(project->ID(), true);
+    apply(entries[2], kChangeTypeUpdate);
+    entries[1]->SetStartTime(now - 86400 * 400, true);
+    apply(entries[1], kChangeTypeUpdate);
+    TimeEntry *loaded = user.related.TimeEntries[0];
+    loaded->SetDescription("Planning", true);
+    apply(loaded, kChangeTypeUpdate);
+
+    std::vector<view::Autocomplete> applied_entries;
+    user.related.TimeEntryAutocompleteItems(&applied_entries);
+    std::vector<view::Autocomplete> applied_minitimer;
+    user.related.MinitimerAutocompleteItems(&applied_minitimer);
+    std::vector<view::Autocomplete> applied_query;
+    user.related.AutocompleteQuery(
+        kAutocompleteListMiniTimer, "standup", 5, &applied_query);
+    ASSERT_FALSE(applied_query.empty());
+    ASSERT_EQ("4", applied_query[0].Tags);
+
+    std::vector<ModelChange> changes;
+    changes.push_back(ModelChange(kModelProject, kChangeTypeUpdate, 0, ""));
+    user.related.ApplyAutocompleteChanges(changes);
+
+    std::vector<view::Autocomplete> built_entries;
+    user.related.TimeEntryAutocompleteItems(&built_entries);
+    std::vector<view::Autocomplete> built_minitimer;
+    user.related.MinitimerAutocompleteItems(&built_minitimer);
+    std::vector<view::Autocomplete> built_query;
+    user.related.AutocompleteQuery(
+        kAutocompleteListMiniTimer, "standup", 5, &built_query);
+
+    ASSERT_EQ(autocompleteStrings(built_entries),
+              autocompleteStrings(applied_entries));
+    ASSERT_EQ(autocompleteStrings(built_minitimer),
+              autocompleteStrings(applied_minitimer));
+    ASSERT_EQ(autocompleteStrings(built_query),
+              autocompleteStrings(applied_query));
+}
+
+static TimeEntry *snapshotTimeEntry(
+    User *user,
+    const std::string &guid,
+    const Poco::Int64 start,
+    const Poco::Int64 duration) {
+    TimeEntry *te = new TimeEntry();
+    te->SetGUID(guid);
+    te->SetStartTime(start, false);
+    te->SetDurationInSeconds(duration, false);
+    user->related.pushBackTimeEntry(te);
+    return te;
+}
+
+static void expectSameSnapshot(
+    const UserSnapshot &expected,
+    const UserSnapshot &actual) {
+    ASSERT_EQ(expected.UserID, actual.UserID);
+    ASSERT_EQ(expected.RunningGUID, actual.RunningGUID);
+    ASSERT_EQ(expected.RunningDuration, actual.RunningDuration);
+    ASSERT_EQ(expected.DayStart, actual.DayStart);
+    ASSERT_EQ(expected.DayStoppedDuration, actual.DayStoppedDuration);
+    ASSERT_EQ(expected.DayDurations, actual.DayDurations);
+}
+
+TEST(UserSnapshot, UpdatesLikeFill) {
+    User user;
+    user.SetID(10471231);
+
+    Poco::LocalDateTime noon(2020, 6, 15, 12, 0, 0);
+    const Poco::Int64 midday = noon.utc().timestamp().epochTime();
+
+    TimeEntry *morning = snapshotTimeEntry(
+        &user, "snapshot-1", midday - 3 * 3600, 1800);
+    TimeEntry *edited = snapshotTimeEntry(
+        &user, "snapshot-2", midday - 2 * 3600, 600);
+    snapshotTimeEntry(&user, "snapshot-3", midday - 86400, 3600);
+    TimeEntry *running = snapshotTimeEntry(
+        &user, "snapshot-4", midday, -midday);
+
+    UserSnapshot previous;
+    previous.Fill(&user, 1);
+    ASSERT_EQ("snapshot-4", previous.RunningGUID);
+    ASSERT_EQ(2400, previous.DayStoppedDuration);
+
+    std::vector<ModelChange> changes;
+    UserSnapshot filled;
+    UserSnapshot updated;
+
+    edited->SetDurationInSeconds(1200, false);
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeUpdate, 0, edited->GUID()));
+    updated.Update(&user, previous, changes, 2);
+    filled.Fill(&user, 2);
+    expectSameSnapshot(filled, updated);
+    ASSERT_EQ(3000, updated.DayStoppedDuration);
+
+    // Stopping the running entry and starting another one
+    previous = updated;
+    running->SetDurationInSeconds(900, false);
+    TimeEntry *next = snapshotTimeEntry(
+        &user, "snapshot-5", midday + 1000, -(midday + 1000));
+    changes.clear();
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeUpdate, 0, running->GUID()));
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeInsert, 0, next->GUID()));
+    updated = UserSnapshot();
+    updated.Update(&user, previous, changes, 3);
+    filled = UserSnapshot();
+    filled.Fill(&user, 3);
+    expectSameSnapshot(filled, updated);
+    ASSERT_EQ("snapshot-5", updated.RunningGUID);
+    ASSERT_EQ(3900, updated.DayStoppedDuration);
+
+    previous = updated;
+    morning->SetDeletedAt(time(nullptr));
+    changes.clear();
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeDelete, 0, morning->GUID()));
+    updated = UserSnapshot();
+    updated.Update(&user, previous, changes, 4);
+    filled = UserSnapshot();
+    filled.Fill(&user, 4);
+    expectSameSnapshot(filled, updated);
+    ASSERT_EQ(2100, updated.DayStoppedDuration);
+
+    // Nothing tracks once the running entry is stopped
+    previous = updated;
+    next->SetDurationInSeconds(60, false);
+    changes.clear();
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeUpdate, 0, next->GUID()));
+    updated = UserSnapshot();
+    updated.Update(&user, previous, changes, 5);
+    ASSERT_FALSE(updated.Tracking());
+}
+
+TEST(TimeEntryListModel, AppliesChangesLikeFullRebuild) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    user.SetCollapseEntries(true);
+
+    std::map<std::string, bool_t> entry_groups;
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+
+    TimeEntryListModel list;
+    list.ApplyChanges(changes);
+    assertSameTimeEntryList(&list, &user, entry_groups);
+    size_t count = list.Size();
+
+    TimeEntry *first =
+        user.Start("Grouped", "1 hour", 0, 0, "", "", 0, 0, true);
+    TimeEntry *second =
+        user.Start("Grouped", "2 hours", 0, 0, "", "", 0, 0, true);
+    user.Start("Running", "", 0, 0, "", "", 0, 0, true);
+    changes.clear();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    list.ApplyChanges(changes);
+    assertSameTimeEntryList(&list, &user, entry_groups);
+    ASSERT_EQ(count + 3, list.Size());
+
+    entry_groups[first->GroupHash()] = true;
+    assertSameTimeEntryList(&list, &user, entry_groups);
+
+    std::vector<view::TimeEntry> views;
+    list.Render(entry_groups, &views);
+    ASSERT_EQ(count + 3, views.size());
+    ASSERT_TRUE(views.back().Group);
+    ASSERT_EQ(2, views.back().GroupItemCount);
+    ASSERT_EQ(3 * 3600, views.back().DurationInSeconds);
+
+    second->SetDurationInSeconds(600, true);
+    first->SetDeletedAt(time(nullptr));
+    changes.clear();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    list.ApplyChanges(changes);
+    assertSameTimeEntryList(&list, &user, entry_groups);
+    ASSERT_EQ(count + 2, list.Size());
+
+    // Moved to another group and day
+    second->SetDescription("Regrouped", true);
+    second->SetStartTime(second->StartTime() - 86400, true);
+    changes.clear();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    list.ApplyChanges(changes);
+
+    // Rendering doesn't read the time entries, the
+    // changes only show once they're applied by Update
+    views.clear();
+    list.Render(entry_groups, &views);
+    for (auto it = views.begin(); it != views.end(); ++it) {
+        ASSERT_NE("Regrouped", it->Description);
+    }
+    assertSameTimeEntryList(&list, &user, entry_groups);
+}
+
+TEST(TimeEntryListChange, DiffTurnsPreviousListIntoNext) {
+    auto row = [](const std::string &guid, const std::string &duration) {
+        view::TimeEntry te;
+        te.GUID = guid;
+        te.Duration = duration;
+        return te;
+    };
+    view::TimeEntry group = row("b", "3:00");
+    group.Group = true;
+    group.GroupName = "Grouped";
+
+    std::vector<view::TimeEntry> previous {
+        row("a", "1:00"), row("b", "2:00"), group, row("c", "1:00")
+    };
+    std::vector<view::TimeEntry> next {
+        row("c", "1:30"), row("a", "1:00"), row("d", "0:10"), group
+    };
+
+    std::vector<view::TimeEntryListChange> changes =
+        view::TimeEntryListChange::Diff(previous, next);
+
+    std::vector<view::TimeEntry> applied(previous);
+    size_t updates(0);
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        ASSERT_LE(it->Index, applied.size());
+        if (kTimeEntryListChangeRemove == it->Type) {
+            ASSERT_EQ(applied[it->Index].ListKey(), it->Item.ListKey());
+            // Removals only identify the row
+            ASSERT_TRUE(it->Item.Duration.empty());
+            applied.erase(applied.begin() + it->Index);
+        } else if (kTimeEntryListChangeInsert == it->Type) {
+            applied.insert(applied.begin() + it->Index, it->Item);
+        } else {
+            ASSERT_EQ(applied[it->Index].ListKey(), it->Item.ListKey());
+            applied[it->Index] = it->Item;
+            updates++;
+        }
+    }
+    ASSERT_TRUE(next == applied);
+    ASSERT_EQ(size_t(0), updates);
+
+    // Unchanged list needs no changes
+    ASSERT_TRUE(view::TimeEntryListChange::Diff(next, next).empty());
+
+    next[1].Duration = "1:01";
+    changes = view::TimeEntryListChange::Diff(applied, next);
+    ASSERT_EQ(size_t(1), changes.size());
+    ASSERT_EQ(kTimeEntryListChangeUpdate, changes[0].Type);
+    ASSERT_EQ(uint64_t(1), changes[0].Index);
+
+    // A row moved across a long list is one removal and one insert
+    std::vector<view::TimeEntry> long_list;
+    for (int i = 0; i < 1000; i++) {
+        long_list.push_back(row(std::to_string(i), "1:00"));
+    }
+    std::vector<view::TimeEntry> moved(long_list);
+    std::rotate(moved.begin(), moved.end() - 1, moved.end());
+    changes = view::TimeEntryListChange::Diff(long_list, moved);
+    ASSERT_EQ(size_t(2), changes.size());
+    ASSERT_EQ(kTimeEntryListChangeRemove, changes[0].Type);
+    ASSERT_EQ(uint64_t(999), changes[0].Index);
+    ASSERT_EQ(kTimeEntryListChangeInsert, changes[1].Type);
+    ASSERT_EQ(uint64_t(0), changes[1].Index);
+}
+
+namespace testing {
+namespace listchanges {
+
+// Time entry list as the UI builds it from the changes
+std::vector<std::string> rows;
+bool applied(true);
+
+void onChanges(
+    const bool_t open,
+    const bool_t reset,
+    TogglTimeEntryListChangeView *first,
+    const bool_t show_load_more_button) {
+    if (reset) {
+        rows.clear();
+    }
+    for (TogglTimeEntryListChangeView *it = first; it;
+            it = reinterpret_cast<TogglTimeEntryListChangeView *>(it->Next)) {
+        std::string guid = to_string(it->Item->GUID);
+        if (kTimeEntryListChangeInsert == it->Type && it->Index <= rows.size()) {
+            rows.insert(rows.begin() + it->Index, guid);
+        } else if (it->Index < rows.size() && rows[it->Index] == guid) {
+            if (kTimeEntryListChangeRemove == it->Type) {
+                rows.erase(rows.begin() + it->Index);
+            }
+        } else {
+            applied = false;
+        }
+    }
+}
+
+}  // namespace listchanges
+}  // namespace testing
+
+TEST(TimeEntryListChange, ConcurrentRendersSendChangesInOrder) {
+    auto list = [](const int thread, const int round) {
+        std::vector<view::TimeEntry> result;
+        for (int i = 0; i < 20; i++) {
+            if ((i + round) % 3 == 0) {
+                continue;
+            }
+            view::TimeEntry te;
+            te.GUID = std::to_string((i + thread * round) % 30);
+            te.Started = time(nullptr);
+            te.Duration = std::to_string(round);
+            result.push_back(te);
+        }
+        return result;
+    };
+
+    GUI gui;
+    gui.OnDisplayTimeEntryListChanges(testing::listchanges::onChanges);
+    testing::listchanges::rows.clear();
+    testing::listchanges::applied = true;
+
+    std::vector<std::thread> threads;
+    for (int thread = 1; thread <= 2; thread++) {
+        threads.push_back(std::thread([&gui, &list, thread] {
+            for (int round = 0; round < 200; round++) {
+                gui.DisplayTimeEntryList(false, list(thread, round), false);
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    ASSERT_TRUE(testing::listchanges::applied);
+
+    // Whatever order they ran in, the next changes apply on top
+    std::vector<view::TimeEntry> last = list(3, 7);
+    gui.DisplayTimeEntryList(false, last, false);
+    ASSERT_TRUE(testing::listchanges::applied);
+    ASSERT_EQ(last.size(), testing::listchanges::rows.size());
+    for (size_t i = 0; i < last.size(); i++) {
+        ASSERT_EQ(last[last.size() - 1 - i].GUID,
+                  testing::listchanges::rows[i]);
+    }
+}
+
 TEST(Database, LoadUserByEmail) {
     testing::Database db;
 
@@ -503,6 +1655,45 @@ TEST(Database, SavesModelsAndKnowsToUpdateWithSameUserInstance) {
     }
 }
 
+TEST(Database, SavesOnlyDirtyModels) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_FALSE(changes.empty());
+
+    changes.clear();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_TRUE(changes.empty());
+
+    TimeEntry *te = user.related.TimeEntries[0];
+    te->SetDescription("Updated through the cached statement", true);
+
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_EQ(size_t(1), changes.size());
+    ASSERT_EQ(te->GUID(), changes[0].GUID());
+    ASSERT_EQ(kChangeTypeUpdate, changes[0].ChangeType());
+
+    changes.clear();
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_TRUE(changes.empty());
+
+    User user2;
+    ASSERT_EQ(noError, db.instance()->LoadUserByID(user.ID(), &user2));
+    TimeEntry *loaded = user2.related.TimeEntryByGUID(te->GUID());
+    ASSERT_TRUE(loaded);
+    ASSERT_EQ("Updated through the cached statement", loaded->Description());
+    ASSERT_EQ(te->ID(), loaded->ID());
+    ASSERT_EQ(te->Start(), loaded->Start());
+    ASSERT_EQ(te->Tags(), loaded->Tags());
+    ASSERT_EQ(user.related.TimeEntries.size(),
+              user2.related.TimeEntries.size());
+}
+
 TEST(Database,
      SavesModelsAndKnowsToUpdateWithSeparateUserInstances) {
     testing::Database db;
@@ -659,6 +1850,328 @@ TEST(User, TestDeletionSteps) {
     }
 }
 
+TEST(Database, LoadsUserInStages) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    // A month of history, a few entries and window changes a day
+    const Poco::Int64 now = time(nullptr);
+    const int kDays = 30;
+    for (int day = 0; day < kDays; day++) {
+        const Poco::Int64 start = now - (day + 1) * 86400;
+        for (int i = 0; i < 6; i++) {
+            TimeEntry *te = new TimeEntry();
+            te->SetUID(user.ID());
+            te->SetWID(user.DefaultWID());
+            te->SetDescription("Task", false);
+            te->SetStartTime(start + i * 3600, false);
+            te->SetDurationInSeconds(1800, false);
+            user.related.TimeEntries.push_back(te);
+            user.related.Index(te);
+        }
+        for (int i = 0; i < 5; i++) {
+            TimelineEvent *event = new TimelineEvent();
+            event->SetUID(user.ID());
+            event->SetStartTime(start + i * 60);
+            event->SetEndTime(start + i * 60 + 59);
+            event->SetFilename("firefox");
+            event->SetTitle("Inbox - Mail");
+            user.related.TimelineEvents.push_back(event);
+            user.related.Index(event);
+        }
+    }
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_EQ(noError, db.instance()->SetCurrentAPIToken("abc123", user.ID()));
+
+    User full;
+    ASSERT_EQ(noError, db.instance()->LoadCurrentUser(&full));
+
+    const Poco::Int64 recent_since =
+        now - kStartupRecentTimeEntryDays * 86400;
+    User staged;
+    ASSERT_EQ(noError,
+              db.instance()->LoadCurrentUserStaged(&staged, recent_since));
+
+    ASSERT_EQ(full.ID(), staged.ID());
+    ASSERT_EQ(full.related.Projects.size(), staged.related.Projects.size());
+    ASSERT_TRUE(staged.related.TimelineEvents.empty());
+    ASSERT_LT(staged.related.TimeEntries.size(),
+              full.related.TimeEntries.size());
+    for (auto te : staged.related.TimeEntries) {
+        ASSERT_TRUE(te->Start() >= recent_since || te->IsTracking());
+    }
+
+    // A cancelled load gives up before reading anything
+    std::vector<TimeEntry *> time_entries;
+    std::vector<TimelineEvent *> timeline_events;
+    ASSERT_NE(noError, db.instance()->LoadDeferredUserData(
+        staged.ID(), recent_since, 0, &time_entries, &timeline_events,
+    [] {
+        return true;
+    }));
+    ASSERT_TRUE(time_entries.empty());
+    ASSERT_TRUE(timeline_events.empty());
+
+    ASSERT_EQ(noError, db.instance()->LoadDeferredUserData(
+        staged.ID(), recent_since, 0, &time_entries, &timeline_events,
+        nullptr));
+    staged.related.AddDeferred(&time_entries, &timeline_events);
+    ASSERT_TRUE(time_entries.empty());
+
+    ASSERT_EQ(full.related.TimeEntries.size(),
+              staged.related.TimeEntries.size());
+    ASSERT_EQ(full.related.TimelineEvents.size(),
+              staged.related.TimelineEvents.size());
+    ASSERT_TRUE(staged.related.TimeEntryByID(89818605));
+
+    // Models that are in memory already are not added twice
+    ASSERT_EQ(noError, db.instance()->LoadDeferredUserData(
+        staged.ID(), recent_since, 0, &time_entries, &timeline_events,
+        nullptr));
+    staged.related.AddDeferred(&time_entries, &timeline_events);
+    ASSERT_EQ(full.related.TimeEntries.size(),
+              staged.related.TimeEntries.size());
+    ASSERT_EQ(full.related.TimelineEvents.size(),
+              staged.related.TimelineEvents.size());
+}
+
+TEST(Database, PagesInOlderTimeEntries) {
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    // A year of synced history, two entries a day
+    const Poco::Int64 now = time(nullptr);
+    const Poco::UInt64 kFirstID = 2000000000;
+    for (int day = 0; day < 365; day++) {
+        for (int i = 0; i < 2; i++) {
+            TimeEntry *te = new TimeEntry();
+            te->SetID(kFirstID + day * 2 + i);
+            te->SetUID(user.ID());
+            te->SetWID(user.DefaultWID());
+            te->SetDescription("Task", false);
+            te->SetStartTime(now - (day + 1) * 86400 + i * 3600, false);
+            te->SetDurationInSeconds(1800, false);
+            user.related.TimeEntries.push_back(te);
+            user.related.Index(te);
+        }
+    }
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_EQ(noError, db.instance()->SetCurrentAPIToken("abc123", user.ID()));
+
+    const Poco::Int64 recent_since =
+        now - kStartupRecentTimeEntryDays * 86400;
+    const Poco::Int64 hot_since = now - kTimeEntryHotWindowDays * 86400;
+    User staged;
+    ASSERT_EQ(noError,
+              db.instance()->LoadCurrentUserStaged(&staged, recent_since));
+    std::vector<TimeEntry *> time_entries;
+    std::vector<TimelineEvent *> timeline_events;
+    ASSERT_EQ(noError, db.instance()->LoadDeferredUserData(
+        staged.ID(), recent_since, hot_since,
+        &time_entries, &timeline_events, nullptr));
+    staged.related.AddDeferred(&time_entries, &timeline_events);
+
+    // Only the hot window of the history is in memory
+    for (auto te : staged.related.TimeEntries) {
+        if (te->ID() >= kFirstID) {
+            ASSERT_GE(te->StartTime(), hot_since);
+        }
+    }
+    ASSERT_FALSE(staged.related.TimeEntryByID(kFirstID + 200 * 2));
+
+    const Poco::UInt64 uid = staged.ID();
+    Database *database = db.instance();
+    RelatedData::TimeEntryReaders readers;
+    readers.Page = [database, uid](
+                       const Poco::Int64 from,
+                       const Poco::Int64 to,
+    std::vector<TimeEntry *> *list) {
+        return database->LoadTimeEntryPage(uid, from, to, list);
+    };
+    int start_reads(0);
+    readers.StartsBefore = [database, uid, &start_reads](
+                               const Poco::Int64 before,
+    std::map<Poco::UInt64, Poco::Int64> *starts) {
+        start_reads++;
+        return database->TimeEntryStartsBefore(uid, before, starts);
+    };
+    readers.StartBefore = [database, uid](
+                              const Poco::Int64 before,
+                              Poco::Int64 *start,
+    bool *found) {
+        return database->LatestTimeEntryStartBefore(uid, before, start, found);
+    };
+    staged.related.SetTimeEntryReaders(hot_since, readers);
+
+    // A page holds the entries of kTimeEntryPageDays
+    const Poco::Int64 page =
+        RelatedData::TimeEntryPageStart(now - 100 * 86400);
+    size_t resident = staged.related.TimeEntries.size();
+    ASSERT_EQ(noError, staged.related.PageInTimeEntries(page));
+    ASSERT_EQ(resident + kTimeEntryPageDays * 2,
+              staged.related.TimeEntries.size());
+    ASSERT_EQ(noError, staged.related.PageInTimeEntries(page + 3600));
+    ASSERT_EQ(resident + kTimeEntryPageDays * 2,
+              staged.related.TimeEntries.size());
+
+    // Sync finds older entries by their ID
+    TimeEntry *old = staged.related.PageInTimeEntryByID(kFirstID + 200 * 2);
+    ASSERT_TRUE(old);
+    ASSERT_EQ(kFirstID + 200 * 2, old->ID());
+    old->SetDescription("Edited", true);
+    ASSERT_FALSE(staged.related.PageInTimeEntryByID(kFirstID - 1));
+    ASSERT_TRUE(staged.related.PageInTimeEntryByID(kFirstID + 250 * 2));
+    // The starts are read once for all the IDs
+    ASSERT_EQ(1, start_reads);
+
+    // Scrolling back reads a page at a time until none are left
+    bool loaded(true);
+    size_t pages(0);
+    while (loaded) {
+        ASSERT_EQ(noError, staged.related.PageInOlderTimeEntries(&loaded));
+        if (loaded) {
+            pages++;
+        }
+    }
+    ASSERT_GT(pages, size_t(300 / kTimeEntryPageDays));
+
+    // Least recently used pages are dropped, unsaved changes are kept
+    ASSERT_EQ(noError, staged.related.PageInTimeEntries(page));
+    ASSERT_GT(staged.related.EvictTimeEntryPages(), size_t(0));
+    size_t older(0);
+    for (auto te : staged.related.TimeEntries) {
+        if (te->ID() >= kFirstID && te->StartTime() < hot_since) {
+            older++;
+        }
+    }
+    ASSERT_LE(older, size_t(kTimeEntryResidentPages * kTimeEntryPageDays * 2 + 1));
+    ASSERT_EQ(old, staged.related.TimeEntryByID(kFirstID + 200 * 2));
+    ASSERT_TRUE(staged.related.TimeEntryByID(kFirstID + 99 * 2));
+    ASSERT_EQ(size_t(0), staged.related.EvictTimeEntryPages());
+
+    // Evicted entries are found again without another read
+    ASSERT_FALSE(staged.related.TimeEntryByID(kFirstID + 150 * 2));
+    TimeEntry *evicted =
+        staged.related.PageInTimeEntryByID(kFirstID + 150 * 2);
+    ASSERT_TRUE(evicted);
+    ASSERT_EQ(kFirstID + 150 * 2, evicted->ID());
+    ASSERT_EQ(1, start_reads);
+}
+
+TEST(Database, HotQueriesUseIndexes) {
+    using Poco::Data::Keywords::useRef;
+
+    testing::Database db;
+
+    // Planned as they're prepared, with a value for each parameter
+    const std::vector<std::string> statements =
+        toggl::Database::HotStatements();
+    ASSERT_FALSE(statements.empty());
+
+    Poco::Data::Session session("SQLite", "test.db");
+    for (const auto &sql : statements) {
+        std::vector<Poco::Int64> values(
+            std::count(sql.begin(), sql.end(), ':'), 1);
+        Poco::Data::Statement explain(session);
+        explain << "EXPLAIN QUERY PLAN " + sql;
+        for (const Poco::Int64 &value : values) {
+            explain.addBind(useRef(value));
+        }
+        explain.execute();
+        Poco::Data::RecordSet rs(explain);
+        ASSERT_GT(rs.rowCount(), size_t(0)) << sql;
+        for (size_t row = 0; row < rs.rowCount(); row++) {
+            // The last column describes the step
+            std::string detail =
+                rs.value(rs.columnCount() - 1, row).convert<std::string>();
+            ASSERT_NE(0, detail.find("SCAN ")) << sql << ": " << detail;
+        }
+    }
+}
+
+TEST(Database, LoadsTimeEntriesThroughTypedRows) {
+    using Poco::Data::Keywords::bind;
+    using Poco::Data::Keywords::now;
+
+    testing::Database db;
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.instance()->SaveUser(&user, true, &changes));
+    ASSERT_EQ(noError, db.instance()->SetCurrentAPIToken("abc123", user.ID()));
+
+    // Read back the same as they were saved
+    User loaded;
+    ASSERT_EQ(noError, db.instance()->LoadCurrentUser(&loaded));
+    ASSERT_EQ(user.related.TimeEntries.size(),
+              loaded.related.TimeEntries.size());
+    for (auto saved : user.related.TimeEntries) {
+        TimeEntry *te = loaded.related.TimeEntryByGUID(saved->GUID());
+        ASSERT_TRUE(te);
+        ASSERT_EQ(saved->String(), te->String());
+        ASSERT_EQ(saved->ProjectGUID(), te->ProjectGUID());
+        ASSERT_EQ(saved->TagNames(), te->TagNames());
+        ASSERT_EQ(saved->ValidationError(), te->ValidationError());
+        ASSERT_FALSE(te->Dirty());
+    }
+
+    // Columns left NULL, as in rows written by older versions
+    const Poco::UInt64 uid = user.ID();
+    Poco::Data::Session session("SQLite", "test.db");
+    session <<
+            "INSERT INTO time_entries(uid, description, wid, guid, pid, "
+            "billable, duronly, start, stop, duration, tags, created_with, "
+            "previous_start, previous_stop, previous_duration, "
+            "previous_description, previous_tags) "
+            "VALUES (:uid, 'Entry 42', :wid, 'guid-42', 123, "
+            "0, 0, 1500151200, 1500153000, 1800, 'a|b', 'test', "
+            "1500151200, 1500153000, 1800, 'Entry 42', 'a|b')",
+            bind(uid), bind(user.DefaultWID()), now;
+
+    std::vector<TimeEntry *> typed;
+    std::vector<TimelineEvent *> timeline_events;
+    ASSERT_EQ(noError, db.instance()->LoadDeferredUserData(
+        uid, std::numeric_limits<Poco::Int64>::max(), 0,
+        &typed, &timeline_events, nullptr));
+
+    TimeEntry *te = nullptr;
+    for (auto it : typed) {
+        if ("guid-42" == it->GUID()) {
+            te = it;
+        }
+    }
+    ASSERT_TRUE(te);
+    ASSERT_EQ("Entry 42", te->Description());
+    ASSERT_EQ(Poco::UInt64(0), te->ID());
+    ASSERT_EQ(Poco::UInt64(123), te->PID());
+    ASSERT_EQ(Poco::UInt64(0), te->TID());
+    ASSERT_FALSE(te->Billable());
+    ASSERT_EQ(Poco::Int64(1500151200), te->StartTime());
+    ASSERT_EQ(Poco::Int64(1800), te->DurationInSeconds());
+    ASSERT_EQ("a|b", te->Tags());
+    ASSERT_EQ("test", te->CreatedWith());
+    ASSERT_EQ("", te->ProjectGUID());
+    ASSERT_EQ("Entry 42", te->Description.GetPrevious());
+    ASSERT_EQ(TimeEntry::TagsStringToVector("a|b"), te->TagNames.GetPrevious());
+    ASSERT_FALSE(te->Dirty());
+
+    for (auto it : typed) {
+        delete it;
+    }
+}
+
 TEST(Database, SavesModels) {
     User user;
     ASSERT_EQ(noError,
@@ -1249,6 +2762,308 @@ TEST(TimeEntry, SetDurationOnRunningTimeEntryWithDurOnlySetting) {
     ASSERT_LT(te->StartTime(), te->StopTime());
 }
 
+TEST(HTTPClient, SendAllKeepsOrderAndBoundsConcurrency) {
+    std::vector<HTTPRequest> requests(40);
+    for (size_t i = 0; i < requests.size(); i++) {
+        requests[i].relative_url = std::to_string(i);
+    }
+
+    std::atomic<int> in_flight(0);
+    std::atomic<int> most_in_flight(0);
+    auto send = [&](const HTTPRequest &req) {
+        int now = ++in_flight;
+        int most = most_in_flight;
+        while (now > most && !most_in_flight.compare_exchange_weak(most, now)) {
+        }
+        Poco::Thread::sleep(5);
+        --in_flight;
+        HTTPResponse resp;
+        resp.body = req.relative_url;
+        return resp;
+    };
+
+    std::vector<HTTPResponse> responses;
+    std::vector<bool> sent;
+    HTTPClient::SendAll(requests, send, 4, &responses, &sent);
+
+    ASSERT_EQ(requests.size(), responses.size());
+    for (size_t i = 0; i < requests.size(); i++) {
+        ASSERT_TRUE(sent[i]);
+        ASSERT_EQ(std::to_string(i), responses[i].body);
+    }
+    ASSERT_LE(most_in_flight, 4);
+    ASSERT_GT(most_in_flight, 1);
+
+    // No new requests are started once the network is gone
+    std::atomic<int> calls(0);
+    HTTPClient::SendAll(requests, [&](const HTTPRequest &req) {
+        calls++;
+        HTTPResponse resp;
+        if ("3" == req.relative_url) {
+            resp.err = kCannotConnectError;
+        }
+        return resp;
+    }, 1, &responses, &sent);
+
+    ASSERT_EQ(4, calls);
+    ASSERT_TRUE(sent[3]);
+    ASSERT_FALSE(sent[4]);
+    ASSERT_EQ(kCannotConnectError, responses[3].err);
+
+    // Nor once the backend is down
+    calls = 0;
+    HTTPClient::SendAll(requests, [&](const HTTPRequest &req) {
+        calls++;
+        HTTPResponse resp;
+        if ("5" == req.relative_url) {
+            resp.status_code = 503;
+            resp.err = kBackendIsDownError;
+        }
+        return resp;
+    }, 1, &responses, &sent);
+
+    ASSERT_EQ(6, calls);
+    ASSERT_TRUE(sent[5]);
+    ASSERT_FALSE(sent[6]);
+}
+
+TEST(ServerStatus, UpdatesFromSeveralThreads) {
+    ServerStatus status;
+
+    std::vector<std::thread> threads;
+    for (Poco::Int64 code : { 503, 200 }) {
+        threads.push_back(std::thread([&status, code] {
+            for (int i = 0; i < 5; i++) {
+                status.UpdateStatus(code);
+                status.Status();
+            }
+        }));
+    }
+    for (auto &thread : threads) {
+        thread.join();
+    }
+
+    // The last status wins, whatever ran before
+    status.UpdateStatus(200);
+    ASSERT_EQ(noError, status.Status());
+    status.UpdateStatus(502);
+    ASSERT_EQ(kBackendIsDownError, status.Status());
+    status.UpdateStatus(200);
+    ASSERT_EQ(noError, status.Status());
+    status.UpdateStatus(410);
+    ASSERT_EQ(kEndpointGoneError, status.Status());
+}
+
+namespace {
+
+class PingRequestHandler : public Poco::Net::HTTPRequestHandler {
+ public:
+    void handleRequest(
+        Poco::Net::HTTPServerRequest &request,
+        Poco::Net::HTTPServerResponse &response) override {
+        std::string body("{}");
+        if (request.getMethod() == Poco::Net::HTTPRequest::HTTP_POST) {
+            // Echoes the payload back, inflated
+            Poco::InflatingInputStream inflater(
+                request.stream(), Poco::InflatingStreamBuf::STREAM_GZIP);
+            body.assign(std::istreambuf_iterator<char>(inflater),
+                        std::istreambuf_iterator<char>());
+        }
+        response.setContentType(kContentTypeApplicationJSON);
+        response.setContentLength(body.size());
+        response.send() << body;
+    }
+};
+
+class PingRequestHandlerFactory
+    : public Poco::Net::HTTPRequestHandlerFactory {
+ public:
+    Poco::Net::HTTPRequestHandler *createRequestHandler(
+        const Poco::Net::HTTPServerRequest &request) override {
+        return new PingRequestHandler();
+    }
+};
+
+}  // namespace
+
+TEST(HTTPClient, ReusesPooledConnections) {
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServerParams::Ptr params =
+        new Poco::Net::HTTPServerParams();
+    params->setKeepAlive(true);
+    params->setMaxKeepAliveRequests(0);
+    Poco::Net::HTTPServer server(
+        new PingRequestHandlerFactory(), socket, params);
+    server.start();
+
+    const HTTPClientConfig config = HTTPClient::Config;
+    HTTPClient::Config.AutodetectProxy = false;
+    HTTPClient::Config.UseProxy = false;
+    HTTPClient::Config.SetCACertPath("cacert.pem");
+    urls::SetRequestsAllowed(true);
+
+    HTTPRequest req;
+    req.method = Poco::Net::HTTPRequest::HTTP_GET;
+    req.host = "http://127.0.0.1:" + std::to_string(socket.address().port());
+    req.relative_url = "/ping";
+
+    const int kRequests = 20;
+    HTTPClient client;
+    int connections[2];
+    for (int pooled = 0; pooled < 2; pooled++) {
+        HTTPClient::Config.PoolSessions = pooled != 0;
+        const int before = server.totalConnections();
+        for (int i = 0; i < kRequests; i++) {
+            HTTPResponse resp = client.Get(req);
+            EXPECT_EQ(noError, resp.err);
+            EXPECT_EQ("{}", resp.body);
+        }
+        connections[pooled] = server.totalConnections() - before;
+    }
+
+    urls::SetRequestsAllowed(false);
+    HTTPClient::Config = config;
+    server.stop();
+
+    // Every pooled request after the first reuses its connection
+    ASSERT_EQ(kRequests, connections[0]);
+    ASSERT_EQ(1, connections[1]);
+}
+
+TEST(HTTPClient, StreamsCompressedPayload) {
+    Poco::Net::ServerSocket socket(Poco::Net::SocketAddress("127.0.0.1", 0));
+    Poco::Net::HTTPServer server(
+        new PingRequestHandlerFactory(), socket,
+        new Poco::Net::HTTPServerParams());
+    server.start();
+
+    const HTTPClientConfig config = HTTPClient::Config;
+    HTTPClient::Config.AutodetectProxy = false;
+    HTTPClient::Config.UseProxy = false;
+    HTTPClient::Config.SetCACertPath("cacert.pem");
+    urls::SetRequestsAllowed(true);
+
+    std::vector<TimelineEvent *> owned;
+    std::vector<const TimelineEvent *> events;
+    for (int i = 0; i < 3; i++) {
+        TimelineEvent *event = new TimelineEvent();
+        event->SetGUID("guid-" + std::to_string(i));
+        event->SetStartTime(1000 + i * 60);
+        event->SetEndTime(1030 + i * 60);
+        event->SetFilename("Notepad.exe");
+        event->SetTitle("Untitled \"" + std::to_string(i) + "\"");
+        owned.push_back(event);
+        events.push_back(event);
+    }
+
+    HTTPRequest req;
+    req.host = "http://127.0.0.1:" + std::to_string(socket.address().port());
+    req.relative_url = "/api/v8/timeline";
+    req.payload_writer = [&events](std::ostream &out) {
+        writeTimelineJSON(events, "desktop", &out);
+    };
+
+    // Twice, the second time over the pooled connection
+    HTTPClient client;
+    HTTPResponse first = client.Post(req);
+    HTTPResponse second = client.Post(req);
+
+    urls::SetRequestsAllowed(false);
+    HTTPClient::Config = config;
+    server.stop();
+    for (auto event : owned) {
+        delete event;
+    }
+
+    ASSERT_EQ(noError, first.err);
+    ASSERT_EQ(noError, second.err);
+    ASSERT_EQ(first.body, second.body);
+
+    Json::Value root = jsonStringToValue(first.body);
+    ASSERT_EQ(Json::ArrayIndex(3), root.size());
+    ASSERT_EQ("guid-2", root[2]["guid"].asString());
+    ASSERT_EQ("Untitled \"2\"", root[2]["title"].asString());
+    ASSERT_EQ("desktop", root[0]["desktop_id"].asString());
+    // Compact, no whitespace between the elements
+    ASSERT_EQ(std::string::npos, first.body.find('\n'));
+}
+
+namespace {
+
+class EmptyTimelineDatasource : public TimelineDatasource {
+ public:
+    EmptyTimelineDatasource()
+        : batches(0) {}
+
+    error StartAutotrackerEvent(const TimelineEvent &event) override {
+        return noError;
+    }
+    error StartTimelineEvent(TimelineEvent *event) override {
+        return noError;
+    }
+    error CreateCompressedTimelineBatchForUpload(
+        TimelineBatch *batch) override {
+        batches++;
+        return noError;
+    }
+    error MarkTimelineBatchAsUploaded(
+        const std::vector<const TimelineEvent*> &events) override {
+        return noError;
+    }
+
+    std::atomic<int> batches;
+};
+
+}  // namespace
+
+TEST(FocusedWindow, InterruptWakesFocusChangeWait) {
+    std::string title("");
+    std::string filename("");
+    bool idle(false);
+    const bool connected = !getFocusedWindowInfo(&title, &filename, &idle);
+
+    std::atomic<bool> interrupted(false);
+    std::thread interrupter([&interrupted]() {
+        Poco::Thread::sleep(200);
+        interrupted = true;
+        interruptFocusChangeWait();
+    });
+
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    const bool waited = waitForFocusChange(30000);
+    stopwatch.stop();
+    interrupter.join();
+
+    // Without a display, or one whose window manager doesn't report
+    // focus changes, it returns right away and the caller polls
+    if (!connected || !waited) {
+        ASSERT_FALSE(waited);
+        ASSERT_GT(200000, stopwatch.elapsed());
+        return;
+    }
+
+    // Woken up long before the timeout
+    ASSERT_TRUE(interrupted);
+    ASSERT_GT(10 * kOneSecondInMicros, stopwatch.elapsed());
+}
+
+TEST(TimelineUploader, ShutsDownWithoutWaitingForTheInterval) {
+    EmptyTimelineDatasource datasource;
+    TimelineUploader uploader(&datasource);
+
+    // Let the first upload round pass, so the uploader is waiting
+    while (!datasource.batches) {
+        Poco::Thread::sleep(1);
+    }
+
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    ASSERT_EQ(noError, uploader.Shutdown());
+    ASSERT_LT(stopwatch.elapsed(), 1000000);
+    ASSERT_EQ(1, datasource.batches);
+}
+
 TEST(Formatter, CollectErrors) {
     {
         std::vector<error> errors;
@@ -1500,6 +3315,41 @@ TEST(JSON, LoginToken) {
     ASSERT_EQ("foobar", token);
 }
 
+TEST(TimelineEvent, SharesInternedTitlesAndFilenames) {
+    const size_t kEvents = 400;
+    const size_t kApps = 4;
+    const size_t kWindows = 40;
+
+    const size_t pooled_before = StringPool::Instance().Size();
+
+    std::vector<TimelineEvent *> events;
+    for (size_t i = 0; i < kEvents; i++) {
+        std::stringstream filename;
+        filename << "/Applications/Editor " << (i % kApps)
+                 << ".app/Contents/MacOS/Editor";
+        std::stringstream title;
+        title << "Chapter " << (i % kWindows)
+              << ".md - Notes - Editor (Working Tree)";
+
+        // As loaded from the database: current and previous values
+        TimelineEvent *event = new TimelineEvent();
+        event->SetFilename(filename.str());
+        event->SetTitle(title.str());
+        event->ClearDirty();
+        events.push_back(event);
+    }
+
+    ASSERT_EQ(events[0]->Title().id(), events[kWindows]->Title().id());
+    ASSERT_EQ(events[0]->Filename().id(), events[kApps]->Filename().id());
+    ASSERT_NE(events[0]->Title().id(), events[1]->Title().id());
+    ASSERT_EQ(kApps + kWindows, StringPool::Instance().Size() - pooled_before);
+
+    for (auto event : events) {
+        delete event;
+    }
+    ASSERT_EQ(pooled_before, StringPool::Instance().Size());
+}
+
 TEST(JSON, ConvertTimelineToJSON) {
     const std::string desktop_id("12345");
 
@@ -1760,6 +3610,108 @@ TEST(AutotrackerRule, Matches) {
     ASSERT_FALSE(a.Matches(ev));
 }
 
+TEST(AutotrackerMatcher, FindsFirstMatchingRule) {
+    std::vector<std::string> terms = { "hers", "his", "she", "he", "jõud" };
+    std::vector<AutotrackerRule *> rules;
+    for (auto term : terms) {
+        AutotrackerRule *rule = new AutotrackerRule();
+        rule->SetTerm(term);
+        rules.push_back(rule);
+    }
+
+    AutotrackerMatcher matcher;
+    ASSERT_FALSE(matcher.Built(rules));
+    matcher.Build(rules);
+    ASSERT_TRUE(matcher.Built(rules));
+
+    // Earlier rules win, wherever in the text they are
+    ASSERT_EQ(rules[0], matcher.Find("", "ushers"));
+    ASSERT_EQ(rules[2], matcher.Find("she", "he"));
+    ASSERT_EQ(rules[1], matcher.Find("this", "he"));
+    ASSERT_EQ(rules[3], matcher.Find("", "the"));
+    ASSERT_EQ(rules[4], matcher.Find("", "päev jõudis"));
+    ASSERT_EQ(nullptr, matcher.Find("sh", "e"));
+
+    // An empty term matches anything
+    rules[2]->SetTerm("");
+    matcher.Build(rules);
+    ASSERT_EQ(rules[0], matcher.Find("", "hers"));
+    ASSERT_EQ(rules[2], matcher.Find("", ""));
+
+    for (auto rule : rules) {
+        delete rule;
+    }
+}
+
+TEST(RelatedData, FindsAutotrackerRuleInOnePass) {
+    RelatedData related;
+
+    const size_t kRules = 100;
+    for (size_t i = 0; i < kRules; i++) {
+        std::stringstream term;
+        term << "project-" << i << "-";
+        AutotrackerRule *rule = new AutotrackerRule();
+        rule->SetTerm(term.str());
+        rule->SetPID(i + 1);
+        related.AutotrackerRules.push_back(rule);
+    }
+
+    std::vector<TimelineEvent *> events;
+    for (size_t i = 0; i < 40; i++) {
+        std::stringstream title;
+        if (i % 4) {
+            title << "Inbox (" << i << ") - someone@example.com - Mail";
+        } else {
+            title << "Project-" << (i * 7) << "-Report.docx - Word";
+        }
+        TimelineEvent *event = new TimelineEvent();
+        event->SetFilename(i % 2 ? "firefox" : "WINWORD.EXE");
+        event->SetTitle(title.str());
+        events.push_back(event);
+    }
+
+    // Same result as checking the rules one by one
+    std::vector<AutotrackerRule *> expected;
+    for (auto event : events) {
+        AutotrackerRule *found = nullptr;
+        for (auto rule : related.AutotrackerRules) {
+            if (rule->Matches(*event)) {
+                found = rule;
+                break;
+            }
+        }
+        expected.push_back(found);
+    }
+
+    std::vector<AutotrackerRule *> found;
+    for (auto event : events) {
+        found.push_back(related.FindAutotrackerRule(*event));
+    }
+
+    ASSERT_EQ(expected, found);
+    ASSERT_EQ(related.AutotrackerRules[0], found[0]);
+    ASSERT_EQ(nullptr, found[1]);
+
+    // New rules are picked up
+    AutotrackerRule *rule = new AutotrackerRule();
+    rule->SetTerm("inbox");
+    related.AutotrackerRules.push_back(rule);
+    related.AutotrackerRulesChanged();
+    ASSERT_EQ(rule, related.FindAutotrackerRule(*events[1]));
+
+    // Even when the list looks the same, as when a deleted
+    // rule's memory is reused by the next one added
+    rule->SetTerm("mail");
+    related.AutotrackerRulesChanged();
+    ASSERT_EQ(rule, related.FindAutotrackerRule(*events[1]));
+    ASSERT_EQ(related.AutotrackerRules[0],
+              related.FindAutotrackerRule(*events[0]));
+
+    for (auto event : events) {
+        delete event;
+    }
+}
+
 TEST(Settings, IsSame) {
     Settings s1;
     Settings s2;
@@ -0,0 +1,467 @@
+// Copyright 2014 Toggl Desktop developers.
+
+// Timings and memory estimates of the hot paths, kept out of the
+// unit test suites. Run by hand; every benchmark still asserts
+// that the measured work produced the expected result.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <iostream>  // NOLINT
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "const.h"
+#include "database/database.h"
+#include "database/rows.h"
+#include "model/autotracker.h"
+#include "model/time_entry.h"
+#include "model/timeline_event.h"
+#include "model/user.h"
+#include "related_data.h"
+#include "user_snapshot.h"
+#include "util/string_pool.h"
+
+#include "test_data.h"
+
+#include "Poco/Data/RecordSet.h"
+#include "Poco/Data/Session.h"
+#include "Poco/File.h"
+#include "Poco/Stopwatch.h"
+
+namespace toggl {
+
+TEST(Benchmark, InternedTimelineTitlesAndFilenames) {
+    // Nine days of 8 hours, a focus change every 30 seconds,
+    // spread over 40 apps and 400 windows
+    const size_t kEvents = 9 * 8 * 120;
+    const size_t kApps = 40;
+    const size_t kWindows = 400;
+
+    auto footprint = [](const std::string &s) {
+        size_t heap = s.capacity() > std::string().capacity()
+                      ? s.capacity() + 1 : 0;
+        return sizeof(std::string) + heap;
+    };
+
+    const size_t pooled_before = StringPool::Instance().Size();
+
+    std::vector<TimelineEvent *> events;
+    size_t copied = 0;
+    for (size_t i = 0; i < kEvents; i++) {
+        std::stringstream filename;
+        filename << "/Applications/Editor " << (i % kApps)
+                 << ".app/Contents/MacOS/Editor";
+        std::stringstream title;
+        title << "Chapter " << (i % kWindows)
+              << ".md - Notes - Editor (Working Tree)";
+
+        // As loaded from the database: current and previous values
+        TimelineEvent *event = new TimelineEvent();
+        event->SetFilename(filename.str());
+        event->SetTitle(title.str());
+        event->ClearDirty();
+        events.push_back(event);
+
+        copied += 2 * (footprint(filename.str()) + footprint(title.str()));
+    }
+
+    ASSERT_EQ(events[0]->Title().id(), events[kWindows]->Title().id());
+    ASSERT_EQ(events[0]->Filename().id(), events[kApps]->Filename().id());
+    ASSERT_NE(events[0]->Title().id(), events[1]->Title().id());
+
+    const size_t pooled = StringPool::Instance().Size() - pooled_before;
+    ASSERT_EQ(kApps + kWindows, pooled);
+
+    // Pooled copy, its shared pointer control block and map entry
+    size_t interned = kEvents * 4 * sizeof(InternedString)
+                      + StringPool::Instance().Length()
+                      + pooled * (sizeof(std::string) + 1
+                                  + sizeof(std::string_view)
+                                  + sizeof(std::weak_ptr<const std::string>)
+                                  + 6 * sizeof(void *));
+
+    std::cout << kEvents << " timeline events keep ~" << copied / 1024
+              << " KiB of titles and filenames as copies, ~"
+              << interned / 1024 << " KiB interned" << std::endl;
+    ASSERT_LT(interned * 3, copied);
+
+    for (auto event : events) {
+        delete event;
+    }
+    ASSERT_EQ(pooled_before, StringPool::Instance().Size());
+}
+
+TEST(Benchmark, FindAutotrackerRule) {
+    RelatedData related;
+
+    const size_t kRules = 1000;
+    for (size_t i = 0; i < kRules; i++) {
+        std::stringstream term;
+        term << "project-" << i << "-";
+        AutotrackerRule *rule = new AutotrackerRule();
+        rule->SetTerm(term.str());
+        rule->SetPID(i + 1);
+        related.AutotrackerRules.push_back(rule);
+    }
+
+    std::vector<TimelineEvent *> events;
+    for (size_t i = 0; i < 200; i++) {
+        std::stringstream title;
+        if (i % 4) {
+            title << "Inbox (" << i << ") - someone@example.com - Mail";
+        } else {
+            title << "Project-" << (i * 7) << "-Report.docx - Word";
+        }
+        TimelineEvent *event = new TimelineEvent();
+        event->SetFilename(i % 2 ? "firefox" : "WINWORD.EXE");
+        event->SetTitle(title.str());
+        events.push_back(event);
+    }
+
+    const int kRounds = 10;
+    std::vector<AutotrackerRule *> expected;
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    for (int round = 0; round < kRounds; round++) {
+        expected.clear();
+        for (auto event : events) {
+            AutotrackerRule *found = nullptr;
+            for (auto rule : related.AutotrackerRules) {
+                if (rule->Matches(*event)) {
+                    found = rule;
+                    break;
+                }
+            }
+            expected.push_back(found);
+        }
+    }
+    Poco::Timestamp::TimeDiff rule_by_rule = stopwatch.elapsed();
+
+    std::vector<AutotrackerRule *> found;
+    stopwatch.restart();
+    for (int round = 0; round < kRounds; round++) {
+        found.clear();
+        for (auto event : events) {
+            found.push_back(related.FindAutotrackerRule(*event));
+        }
+    }
+    Poco::Timestamp::TimeDiff compiled = stopwatch.elapsed();
+
+    ASSERT_EQ(expected, found);
+
+    std::cout << kRounds * events.size() << " window changes against "
+              << kRules << " autotracker rules took "
+              << rule_by_rule / 1000 << " ms rule by rule, "
+              << compiled / 1000 << " ms compiled" << std::endl;
+
+    for (auto event : events) {
+        delete event;
+    }
+}
+
+TEST(Benchmark, LoadUserInStages) {
+    Poco::File f("benchmark.db");
+    if (f.exists()) {
+        f.remove(false);
+    }
+    Database db("benchmark.db");
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+
+    // A year of history, a few entries and many window changes a day
+    const Poco::Int64 now = time(nullptr);
+    const int kDays = 365;
+    for (int day = 0; day < kDays; day++) {
+        const Poco::Int64 start = now - (day + 1) * 86400;
+        for (int i = 0; i < 6; i++) {
+            TimeEntry *te = new TimeEntry();
+            te->SetUID(user.ID());
+            te->SetWID(user.DefaultWID());
+            te->SetDescription("Task", false);
+            te->SetStartTime(start + i * 3600, false);
+            te->SetDurationInSeconds(1800, false);
+            user.related.TimeEntries.push_back(te);
+            user.related.Index(te);
+        }
+        for (int i = 0; i < 30; i++) {
+            TimelineEvent *event = new TimelineEvent();
+            event->SetUID(user.ID());
+            event->SetStartTime(start + i * 60);
+            event->SetEndTime(start + i * 60 + 59);
+            event->SetFilename("firefox");
+            event->SetTitle("Inbox - Mail");
+            user.related.TimelineEvents.push_back(event);
+            user.related.Index(event);
+        }
+    }
+
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.SaveUser(&user, true, &changes));
+    ASSERT_EQ(noError, db.SetCurrentAPIToken("abc123", user.ID()));
+
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    User full;
+    ASSERT_EQ(noError, db.LoadCurrentUser(&full));
+    Poco::Timestamp::TimeDiff all_at_once = stopwatch.elapsed();
+
+    const Poco::Int64 recent_since =
+        now - kStartupRecentTimeEntryDays * 86400;
+    stopwatch.restart();
+    User staged;
+    ASSERT_EQ(noError,
+              db.LoadCurrentUserStaged(&staged, recent_since));
+    Poco::Timestamp::TimeDiff first_screen = stopwatch.elapsed();
+
+    ASSERT_EQ(full.ID(), staged.ID());
+    ASSERT_EQ(full.related.Projects.size(), staged.related.Projects.size());
+    ASSERT_TRUE(staged.related.TimelineEvents.empty());
+    ASSERT_LT(staged.related.TimeEntries.size(),
+              full.related.TimeEntries.size());
+    for (auto te : staged.related.TimeEntries) {
+        ASSERT_TRUE(te->Start() >= recent_since || te->IsTracking());
+    }
+
+    std::vector<TimeEntry *> time_entries;
+    std::vector<TimelineEvent *> timeline_events;
+    stopwatch.restart();
+    ASSERT_EQ(noError, db.LoadDeferredUserData(
+        staged.ID(), recent_since, 0, &time_entries, &timeline_events,
+        nullptr));
+    Poco::Timestamp::TimeDiff rest = stopwatch.elapsed();
+    staged.related.AddDeferred(&time_entries, &timeline_events);
+    ASSERT_TRUE(time_entries.empty());
+
+    ASSERT_EQ(full.related.TimeEntries.size(),
+              staged.related.TimeEntries.size());
+    ASSERT_EQ(full.related.TimelineEvents.size(),
+              staged.related.TimelineEvents.size());
+    ASSERT_TRUE(staged.related.TimeEntryByID(89818605));
+
+    std::cout << "Loading " << full.related.TimeEntries.size()
+              << " time entries and " << full.related.TimelineEvents.size()
+              << " timeline events took " << all_at_once / 1000
+              << " ms, the first screen " << first_screen / 1000
+              << " ms and the rest " << rest / 1000 << " ms" << std::endl;
+}
+
+TEST(Benchmark, DecodeTimeEntryRows) {
+    using Poco::Data::Keywords::bind;
+    using Poco::Data::Keywords::now;
+
+    Poco::File f("benchmark.db");
+    if (f.exists()) {
+        f.remove(false);
+    }
+    Database db("benchmark.db");
+
+    User user;
+    ASSERT_EQ(noError,
+              user.LoadUserAndRelatedDataFromJSONString(loadTestData(), true, false));
+    std::vector<ModelChange> changes;
+    ASSERT_EQ(noError, db.SaveUser(&user, true, &changes));
+
+    // Written in one statement, saving this many models takes a while
+    const Poco::UInt64 uid = user.ID();
+    const int kRows = 50000;
+    Poco::Data::Session session("SQLite", "benchmark.db");
+    session <<
+            "WITH RECURSIVE n(i) AS "
+            "(SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < :rows) "
+            "INSERT INTO time_entries(uid, description, wid, guid, pid, "
+            "billable, duronly, start, stop, duration, tags, created_with, "
+            "previous_start, previous_stop, previous_duration, "
+            "previous_description, previous_tags) "
+            "SELECT :uid, 'Entry ' || i, :wid, 'guid-' || i, 123, "
+            "i % 2, 0, 1500000000 + i * 3600, 1500000000 + i * 3600 + 1800, "
+            "1800, 'a|b', 'test', 1500000000 + i * 3600, "
+            "1500000000 + i * 3600 + 1800, 1800, 'Entry ' || i, 'a|b' "
+            "FROM n",
+            bind(kRows), bind(uid), bind(user.DefaultWID()), now;
+
+    const std::string sql(
+        "SELECT local_id, id, uid, description, wid, guid, pid, "
+        "tid, billable, duronly, ui_modified_at, start, stop, "
+        "duration, tags, created_with, deleted_at, updated_at, "
+        "project_guid, validation_error, "
+        "previous_pid, previous_project_guid, previous_tid, "
+        "previous_billable, previous_start, previous_stop, "
+        "previous_duration, previous_description, "
+        "previous_created_with, previous_tags "
+        "FROM time_entries WHERE uid = :uid AND duration >= 0");
+
+    // Every cell through a RecordSet and Poco::Dynamic::Var, the
+    // way the other tables are still loaded
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    std::vector<TimeEntry *> boxed;
+    {
+        Poco::Data::Statement select(session);
+        select << sql, bind(uid);
+        Poco::Data::RecordSet rs(select);
+        auto i64 = [&rs](const size_t col) {
+            return rs[col].isEmpty() ? 0 : rs[col].convert<Poco::Int64>();
+        };
+        auto str = [&rs](const size_t col) {
+            return rs[col].isEmpty() ? "" : rs[col].convert<std::string>();
+        };
+        while (!select.done()) {
+            select.execute();
+            for (bool more = rs.moveFirst(); more; more = rs.moveNext()) {
+                TimeEntryRow r;
+                r.local_id = i64(0);
+                r.id = i64(1);
+                r.uid = i64(2);
+                r.description = str(3);
+                r.wid = i64(4);
+                r.guid = str(5);
+                r.pid = i64(6);
+                r.tid = i64(7);
+                r.billable = i64(8);
+                r.duronly = i64(9);
+                r.ui_modified_at = i64(10);
+                r.start = i64(11);
+                r.stop = i64(12);
+                r.duration = i64(13);
+                r.tags = str(14);
+                r.created_with = str(15);
+                r.deleted_at = i64(16);
+                r.updated_at = i64(17);
+                r.project_guid = str(18);
+                r.validation_error = str(19);
+                r.previous_pid = i64(20);
+                r.previous_project_guid = str(21);
+                r.previous_tid = i64(22);
+                r.previous_billable = i64(23);
+                r.previous_start = i64(24);
+                r.previous_stop = i64(25);
+                r.previous_duration = i64(26);
+                r.previous_description = str(27);
+                r.previous_created_with = str(28);
+                r.previous_tags = str(29);
+                TimeEntry *te = new TimeEntry();
+                r.Load(te);
+                te->ClearDirty();
+                boxed.push_back(te);
+            }
+        }
+    }
+    Poco::Timestamp::TimeDiff before = stopwatch.elapsed();
+
+    std::vector<TimeEntry *> typed;
+    std::vector<TimelineEvent *> timeline_events;
+    stopwatch.restart();
+    ASSERT_EQ(noError, db.LoadDeferredUserData(
+        uid, std::numeric_limits<Poco::Int64>::max(), 0,
+        &typed, &timeline_events, nullptr));
+    Poco::Timestamp::TimeDiff after = stopwatch.elapsed();
+
+    ASSERT_EQ(boxed.size(), typed.size());
+    ASSERT_GE(typed.size(), size_t(kRows));
+
+    std::cout << "Decoding " << typed.size() << " time entries: "
+              << boxed.size() * 1000000 / std::max(before, Poco::Timestamp::TimeDiff(1))
+              << " rows/s through Dynamic::Var, "
+              << typed.size() * 1000000 / std::max(after, Poco::Timestamp::TimeDiff(1))
+              << " rows/s through typed rows" << std::endl;
+
+    for (auto it : boxed) {
+        delete it;
+    }
+    for (auto it : typed) {
+        delete it;
+    }
+}
+
+
+TEST(Benchmark, UserSnapshot) {
+    // 5000 stopped entries over 1000 days, one running today
+    User user;
+    user.SetID(10471231);
+    const Poco::Int64 now = time(nullptr);
+    std::vector<TimeEntry *> stopped;
+    for (int i = 0; i < 5000; i++) {
+        std::stringstream guid;
+        guid << "benchmark-" << i;
+        TimeEntry *te = new TimeEntry();
+        te->SetGUID(guid.str());
+        te->SetStartTime(now - (i / 5) * 86400 - (i % 5 + 1) * 3600, false);
+        te->SetDurationInSeconds(1800, false);
+        user.related.pushBackTimeEntry(te);
+        stopped.push_back(te);
+    }
+    TimeEntry *running = new TimeEntry();
+    running->SetGUID("benchmark-running");
+    running->SetStartTime(now, false);
+    running->SetDurationInSeconds(-now, false);
+    user.related.pushBackTimeEntry(running);
+
+    const int kRounds = 1000;
+
+    // What the UI tick did under the user lock before snapshots,
+    // it formats a date per entry so fewer rounds will do
+    const int kLockedRounds = 20;
+    Poco::Stopwatch stopwatch;
+    stopwatch.start();
+    Poco::Int64 locked = 0;
+    for (int i = 0; i < kLockedRounds; i++) {
+        locked = user.related.TotalDurationForDate(running);
+    }
+    Poco::Timestamp::TimeDiff total_for_date = stopwatch.elapsed();
+
+    std::shared_ptr<const UserSnapshot> published =
+        std::make_shared<UserSnapshot>();
+    stopwatch.restart();
+    for (int i = 0; i < kRounds; i++) {
+        std::shared_ptr<UserSnapshot> snapshot =
+            std::make_shared<UserSnapshot>();
+        snapshot->Fill(&user, i);
+        std::atomic_store(&published,
+                          std::shared_ptr<const UserSnapshot>(snapshot));
+    }
+    Poco::Timestamp::TimeDiff fill = stopwatch.elapsed();
+
+    // Saving one of today's entries
+    TimeEntry *edited = stopped.front();
+    std::vector<ModelChange> changes;
+    changes.push_back(ModelChange(
+        kModelTimeEntry, kChangeTypeUpdate, 0, edited->GUID()));
+    stopwatch.restart();
+    for (int i = 0; i < kRounds; i++) {
+        edited->SetDurationInSeconds(1800 + i % 2, false);
+        std::shared_ptr<UserSnapshot> snapshot =
+            std::make_shared<UserSnapshot>();
+        snapshot->Update(&user, *std::atomic_load(&published), changes, i);
+        std::atomic_store(&published,
+                          std::shared_ptr<const UserSnapshot>(snapshot));
+    }
+    Poco::Timestamp::TimeDiff update = stopwatch.elapsed();
+
+    Poco::Int64 read = 0;
+    stopwatch.restart();
+    for (int i = 0; i < kRounds; i++) {
+        read = std::atomic_load(&published)->RunningDayDuration();
+    }
+    Poco::Timestamp::TimeDiff snapshot_read = stopwatch.elapsed();
+
+    UserSnapshot filled;
+    filled.Fill(&user, 0);
+    ASSERT_EQ(filled.DayStoppedDuration,
+              std::atomic_load(&published)->DayStoppedDuration);
+    ASSERT_EQ(filled.RunningDayDuration(), read);
+    ASSERT_LT(0, locked);
+
+    std::cout << "Per call with 5000 time entries: TotalDurationForDate "
+              << total_for_date / kLockedRounds << " us, snapshot Fill "
+              << fill / kRounds << " us, snapshot Update "
+              << update / kRounds << " us, snapshot read "
+              << snapshot_read * 1000 / kRounds << " ns" << std::endl;
+}
+
+}  // namespace toggl
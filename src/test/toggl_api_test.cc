@@ -5,12 +5,15 @@
 #include "gtest/gtest.h"
 
 #include "toggl_api_test.h"
+#include "context.h"
 #include "https_client.h"
 #include "proxy.h"
 #include "model/settings.h"
 #include "model/time_entry.h"
+#include "util/formatter.h"
 #include "toggl_api.h"
 #include "toggl_api_private.h"
+#include "websocket_client.h"
 
 #include "test_data.h"
 
@@ -1349,6 +1352,218 @@ TEST(toggl_api, toggl_start) {
     ASSERT_FALSE(testing::testresult::timer_state.GUID().empty());
 }
 
+TEST(toggl_api, batched_push_saves_once_per_response) {
+    for (int count : { 10, 200 }) {
+        testing::App app;
+        std::string json = loadTestData();
+        ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+
+        for (int i = 0; i < count; i++) {
+            char_t *guid = toggl_start(app.ctx(), STR("offline"), STR(""), 0, 0, 0, 0, false, 0, 0);
+            ASSERT_TRUE(guid);
+            free(guid);
+        }
+
+        // Acknowledge every pushed item like the sync server would
+        Poco::UInt64 next_id(1000000);
+        size_t pushed(0);
+        auto server = [&](const HTTPRequest &req) {
+            Json::Value request;
+            Json::Reader().parse(req.payload, request);
+            Json::Value response;
+            for (auto item : request["time_entries"]) {
+                Json::Value result;
+                result["meta"] = item["meta"];
+                result["meta"]["id"] = Json::UInt64(next_id++);
+                result["payload"]["success"] = true;
+                response["time_entries"].append(result);
+                pushed++;
+            }
+            HTTPResponse resp;
+            resp.body = Json::FastWriter().write(response);
+            resp.status_code = 200;
+            return resp;
+        };
+
+        Context *ctx = ::app(app.ctx());
+        Poco::UInt64 saves_before = ctx->SaveCount();
+        bool had_something_to_push(false);
+
+        ASSERT_EQ(noError, ctx->PushBatchedChanges(server, &had_something_to_push));
+
+        ASSERT_TRUE(had_something_to_push);
+        ASSERT_EQ(size_t(count), pushed);
+        ASSERT_EQ(Poco::UInt64(1), ctx->SaveCount() - saves_before);
+    }
+}
+
+namespace testing {
+
+// Hands frames to the context like a connected client, counting parses
+class CountingWebSocketClient : public WebSocketClient {
+ public:
+    explicit CountingWebSocketClient(Context *ctx)
+        : parses(0) {
+        ctx_ = ctx;
+        on_websocket_message_ = on_websocket_message;
+    }
+
+    std::string Receive(const std::string &json) {
+        return handleMessage(json);
+    }
+
+    int parses;
+
+ protected:
+    std::string parseWebSocketMessageType(
+        const std::string &json,
+        Json::Value *root) override {
+        parses++;
+        return WebSocketClient::parseWebSocketMessageType(json, root);
+    }
+};
+
+}  // namespace testing
+
+TEST(toggl_api, websocket_updates_apply_and_save_once) {
+    testing::App app;
+    std::string json = loadTestData();
+    ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+
+    Context *ctx = ::app(app.ctx());
+    Poco::UInt64 saves_before = ctx->SaveCount();
+    Poco::UInt64 batches_before = ctx->UpdateBatchCount();
+
+    // The same running entry sent over and over, like a burst of edits
+    const int count = 20;
+    const Poco::Int64 start = time(0) - 3600;
+    testing::CountingWebSocketClient client(ctx);
+    for (int i = 0; i < count; i++) {
+        Json::Value update;
+        update["action"] = "UPDATE";
+        update["model"] = "time_entry";
+        update["data"]["id"] = Json::UInt64(987654321);
+        update["data"]["wid"] = Json::UInt64(123456789);
+        update["data"]["start"] = Formatter::Format8601(start);
+        update["data"]["duration"] = Json::Int64(-start);
+        update["data"]["description"] = "update " + std::to_string(i);
+        ASSERT_EQ("data", client.Receive(Json::FastWriter().write(update)));
+    }
+
+    // Each frame is parsed by the client only, the context
+    // queues the parsed messages as they are
+    ASSERT_EQ(count, client.parses);
+
+    // The burst is applied once the coalescing delay has passed
+    for (int i = 0; i < 100 && ctx->UpdateBatchCount() == batches_before;
+            i++) {
+        Poco::Thread::sleep(50);
+    }
+    Poco::Thread::sleep(2 * kWebSocketUpdateCoalesceMillis);
+
+    ASSERT_EQ(Poco::UInt64(1), ctx->UpdateBatchCount() - batches_before);
+    ASSERT_EQ(Poco::UInt64(1), ctx->SaveCount() - saves_before);
+
+    TimeEntry *te = ctx->RunningTimeEntry();
+    ASSERT_TRUE(te);
+    ASSERT_EQ(Poco::UInt64(987654321), te->ID());
+    ASSERT_EQ("update " + std::to_string(count - 1), te->Description());
+}
+
+TEST(toggl_api, snapshot_follows_running_entry) {
+    testing::App app;
+    std::string json = loadTestData();
+    ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+
+    Context *ctx = ::app(app.ctx());
+    std::shared_ptr<const UserSnapshot> before = ctx->Snapshot();
+    ASSERT_TRUE(before->UserID);
+
+    char_t *guid = toggl_start(app.ctx(), STR("test"), STR(""), 0, 0, 0, 0, false, 0, 0);
+    ASSERT_TRUE(guid);
+    std::string running = to_string(guid);
+    free(guid);
+
+    std::shared_ptr<const UserSnapshot> tracking = ctx->Snapshot();
+    ASSERT_GT(tracking->Version, before->Version);
+    ASSERT_TRUE(tracking->Tracking());
+    ASSERT_EQ(running, tracking->RunningGUID);
+    ASSERT_GE(tracking->RunningDayDuration(), tracking->DayStoppedDuration);
+
+    ASSERT_TRUE(toggl_stop(app.ctx(), false));
+
+    // Published snapshots are never changed in place
+    ASSERT_FALSE(ctx->Snapshot()->Tracking());
+    ASSERT_TRUE(tracking->Tracking());
+    ASSERT_EQ(running, tracking->RunningGUID);
+}
+
+namespace testing {
+
+// A focus change on a window of its own, so it's never merged
+TimelineEvent *focusChange(const int i) {
+    TimelineEvent *event = new TimelineEvent();
+    event->SetStartTime(time(0) - 600 + i);
+    event->SetEndTime(event->Start() + 1);
+    event->SetFilename("app.exe");
+    event->SetTitle("window " + std::to_string(i));
+    return event;
+}
+
+}  // namespace testing
+
+TEST(toggl_api, timeline_events_flush_by_count) {
+    testing::App app;
+    std::string json = loadTestData();
+    ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+    ASSERT_TRUE(toggl_timeline_toggle_recording(app.ctx(), true));
+    toggl_timeline_set_flush_seconds(app.ctx(), 3600);
+
+    Context *ctx = ::app(app.ctx());
+    for (int i = 0; i < kTimelineFlushBatchSize - 1; i++) {
+        ASSERT_EQ(noError, ctx->StartTimelineEvent(testing::focusChange(i)));
+    }
+    ASSERT_EQ(Poco::UInt64(kTimelineFlushBatchSize - 1),
+              ctx->UnsavedTimelineEvents());
+
+    ASSERT_EQ(noError, ctx->StartTimelineEvent(
+        testing::focusChange(kTimelineFlushBatchSize)));
+    ASSERT_EQ(Poco::UInt64(0), ctx->UnsavedTimelineEvents());
+}
+
+TEST(toggl_api, timeline_events_flush_by_timer) {
+    testing::App app;
+    std::string json = loadTestData();
+    ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+    ASSERT_TRUE(toggl_timeline_toggle_recording(app.ctx(), true));
+    toggl_timeline_set_flush_seconds(app.ctx(), 1);
+
+    Context *ctx = ::app(app.ctx());
+    ASSERT_EQ(noError, ctx->StartTimelineEvent(testing::focusChange(0)));
+    ASSERT_EQ(noError, ctx->StartTimelineEvent(testing::focusChange(1)));
+    ASSERT_EQ(Poco::UInt64(2), ctx->UnsavedTimelineEvents());
+
+    for (int i = 0; i < 100 && ctx->UnsavedTimelineEvents(); i++) {
+        Poco::Thread::sleep(50);
+    }
+    ASSERT_EQ(Poco::UInt64(0), ctx->UnsavedTimelineEvents());
+}
+
+TEST(toggl_api, timeline_events_flush_on_shutdown) {
+    testing::App app;
+    std::string json = loadTestData();
+    ASSERT_TRUE(testing_set_logged_in_user(app.ctx(), json.c_str()));
+    ASSERT_TRUE(toggl_timeline_toggle_recording(app.ctx(), true));
+    toggl_timeline_set_flush_seconds(app.ctx(), 3600);
+
+    Context *ctx = ::app(app.ctx());
+    ASSERT_EQ(noError, ctx->StartTimelineEvent(testing::focusChange(0)));
+    ASSERT_EQ(Poco::UInt64(1), ctx->UnsavedTimelineEvents());
+
+    ctx->Shutdown();
+    ASSERT_EQ(Poco::UInt64(0), ctx->UnsavedTimelineEvents());
+}
+
 TEST(toggl_api, concurrency) {
     testing::App app;
     std::string json = loadTestData();
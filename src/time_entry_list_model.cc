@@ -0,0 +1,300 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "time_entry_list_model.h"
+
+#include <Poco/LocalDateTime.h>
+
+#include "const.h"
+#include "model/time_entry.h"
+#include "model/user.h"
+#include "util/formatter.h"
+
+namespace toggl {
+
+TimeEntryListModel::TimeEntryListModel()
+    : user_(nullptr)
+, stale_(true)
+, today_(0)
+, collapse_(false) {}
+
+void TimeEntryListModel::ApplyChanges(
+    const std::vector<ModelChange> &changes) {
+    Poco::Mutex::ScopedLock lock(m_);
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        const std::string type = it->ModelType();
+        if (kModelTimeEntry == type) {
+            if (it->GUID().empty()) {
+                stale_ = true;
+            } else {
+                pending_.insert(it->GUID());
+            }
+        } else if (kModelWorkspace == type
+                   || kModelClient == type
+                   || kModelProject == type
+                   || kModelTask == type
+                   || kModelTag == type) {
+            // Labels, colors, group hashes and time locks
+            // of any entry may depend on these
+            stale_ = true;
+        }
+    }
+}
+
+void TimeEntryListModel::Reset() {
+    Poco::Mutex::ScopedLock lock(m_);
+    reset();
+}
+
+void TimeEntryListModel::reset() {
+    user_ = nullptr;
+    stale_ = true;
+    pending_.clear();
+    rows_.clear();
+    order_.clear();
+    running_.clear();
+    date_durations_.clear();
+    running_durations_.clear();
+    groups_.clear();
+}
+
+void TimeEntryListModel::Update(
+    User *user,
+    const std::function<bool(TimeEntry *)> &is_locked) {
+
+    poco_check_ptr(user);
+
+    Poco::Mutex::ScopedLock lock(m_);
+
+    if (needsRebuild(user)) {
+        rebuild(user, is_locked);
+    } else {
+        for (auto it = pending_.begin(); it != pending_.end(); ++it) {
+            refresh(user, *it, is_locked);
+        }
+        pending_.clear();
+    }
+
+    // Sync state is not tracked by the model changes
+    for (auto it = rows_.begin(); it != rows_.end(); ++it) {
+        Row &row = it->second;
+        row.view.Unsynced = row.te->Unsynced();
+        if (row.view.Error != row.te->ValidationError()) {
+            row.view.Error = row.te->ValidationError();
+        }
+    }
+
+    // Running entries are not listed, but count into the date totals
+    running_durations_.clear();
+    for (auto it = running_.begin(); it != running_.end(); ++it) {
+        const Row &row = rows_.at(*it);
+        running_durations_[row.date_header] +=
+            Formatter::AbsDuration(row.te->Duration());
+    }
+
+    collapse_ = user->CollapseEntries();
+}
+
+void TimeEntryListModel::Render(
+    const std::map<std::string, bool_t> &entry_groups,
+    std::vector<view::TimeEntry> *result) const {
+
+    poco_check_ptr(result);
+
+    Poco::Mutex::ScopedLock lock(m_);
+
+    std::map<std::string, std::string> date_durations;
+    auto dateDuration = [&](const std::string &date_header) {
+        auto cached = date_durations.find(date_header);
+        if (cached != date_durations.end()) {
+            return cached->second;
+        }
+        Poco::Int64 total(0);
+        auto finished = date_durations_.find(date_header);
+        if (finished != date_durations_.end()) {
+            total += finished->second;
+        }
+        auto running = running_durations_.find(date_header);
+        if (running != running_durations_.end()) {
+            total += running->second;
+        }
+        std::string formatted =
+            Formatter::FormatDurationForDateHeader(total);
+        date_durations[date_header] = formatted;
+        return formatted;
+    };
+    auto rowView = [&](const Row &row) {
+        view::TimeEntry view = row.view;
+        view.DateDuration = dateDuration(row.date_header);
+        return view;
+    };
+
+    const bool collapse = collapse_;
+
+    result->reserve(order_.size());
+    for (auto it = order_.begin(); it != order_.end(); ++it) {
+        const Row &row = rows_.at(it->second);
+
+        if (collapse) {
+            const Group &group = groups_.at(row.group);
+            if (group.members.size() > 1) {
+                // Group is rendered in place of its latest entry
+                if (*group.members.rbegin() != *it) {
+                    continue;
+                }
+
+                auto open_it = entry_groups.find(row.group);
+                bool_t open = open_it != entry_groups.end()
+                              && open_it->second;
+                if (open) {
+                    for (auto member = group.members.begin();
+                            member != group.members.end(); ++member) {
+                        view::TimeEntry member_view =
+                            rowView(rows_.at(member->second));
+                        member_view.GroupOpen = open;
+                        result->push_back(member_view);
+                    }
+                }
+
+                view::TimeEntry group_view = rowView(row);
+                group_view.Locked = false;
+                group_view.Group = true;
+                group_view.GroupOpen = open;
+                group_view.DurationInSeconds = group.duration;
+                group_view.Duration =
+                    Formatter::FormatDuration(
+                        group.duration,
+                        Formatter::DurationFormat);
+                group_view.GroupItemCount = group.members.size();
+                result->push_back(group_view);
+                continue;
+            }
+        }
+
+        view::TimeEntry view = rowView(row);
+        if (collapse) {
+            view.GroupItemCount = 1;
+        }
+        result->push_back(view);
+    }
+}
+
+bool TimeEntryListModel::needsRebuild(User *user) const {
+    return stale_
+           || user != user_
+           // Date headers and group hashes are relative to today
+           || today() != today_
+           || Formatter::DurationFormat != duration_format_
+           || Formatter::TimeOfDayFormat != time_of_day_format_;
+}
+
+void TimeEntryListModel::rebuild(
+    User *user,
+    const std::function<bool(TimeEntry *)> &is_locked) {
+
+    reset();
+
+    user_ = user;
+    stale_ = false;
+    today_ = today();
+    duration_format_ = Formatter::DurationFormat;
+    time_of_day_format_ = Formatter::TimeOfDayFormat;
+
+    const std::vector<TimeEntry *> &list = user->related.TimeEntries;
+    rows_.reserve(list.size());
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if (isVisible(*it)) {
+            insert(user, *it, is_locked);
+        }
+    }
+}
+
+void TimeEntryListModel::refresh(
+    User *user,
+    const guid &GUID,
+    const std::function<bool(TimeEntry *)> &is_locked) {
+    erase(GUID);
+
+    TimeEntry *te = user->related.TimeEntryByGUID(GUID);
+    if (te && isVisible(te)) {
+        insert(user, te, is_locked);
+    }
+}
+
+void TimeEntryListModel::insert(
+    User *user,
+    TimeEntry *te,
+    const std::function<bool(TimeEntry *)> &is_locked) {
+
+    if (rows_.find(te->GUID()) != rows_.end()) {
+        // Duplicate GUID, keep the first one like the lookups do
+        return;
+    }
+
+    Row row;
+    row.te = te;
+    row.key = SortKey(te->Start(), te->GUID());
+    row.date_header = Formatter::FormatDateHeader(te->StartTime());
+    row.running = te->Duration() < 0;
+
+    if (row.running) {
+        running_.insert(te->GUID());
+        rows_[te->GUID()] = row;
+        return;
+    }
+
+    row.group = te->GroupHash();
+    row.duration = Formatter::AbsDuration(te->Duration());
+
+    row.view.Fill(te);
+    user->related.ProjectLabelAndColorCode(te, &row.view);
+    row.view.Locked = is_locked(te);
+    row.view.GroupOpen = false;
+    row.view.Duration = Formatter::FormatDuration(
+        row.view.DurationInSeconds,
+        Formatter::DurationFormat);
+
+    order_.insert(row.key);
+    date_durations_[row.date_header] += row.duration;
+    Group &group = groups_[row.group];
+    group.duration += row.duration;
+    group.members.insert(row.key);
+
+    rows_[te->GUID()] = row;
+}
+
+void TimeEntryListModel::erase(const guid &GUID) {
+    auto it = rows_.find(GUID);
+    if (it == rows_.end()) {
+        return;
+    }
+    const Row &row = it->second;
+
+    if (row.running) {
+        running_.erase(GUID);
+    } else {
+        order_.erase(row.key);
+        date_durations_[row.date_header] -= row.duration;
+
+        auto group = groups_.find(row.group);
+        if (group != groups_.end()) {
+            group->second.duration -= row.duration;
+            group->second.members.erase(row.key);
+            if (group->second.members.empty()) {
+                groups_.erase(group);
+            }
+        }
+    }
+
+    rows_.erase(it);
+}
+
+bool TimeEntryListModel::isVisible(TimeEntry *te) {
+    return !te->GUID().empty() && !(te->DeletedAt() > 0);
+}
+
+int TimeEntryListModel::today() {
+    Poco::LocalDateTime now;
+    return now.year() * 10000 + now.month() * 100 + now.day();
+}
+
+}  // namespace toggl
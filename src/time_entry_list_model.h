@@ -0,0 +1,129 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_TIME_ENTRY_LIST_MODEL_H_
+#define SRC_TIME_ENTRY_LIST_MODEL_H_
+
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gui.h"
+#include "model_change.h"
+#include "types.h"
+
+#include <Poco/Mutex.h>
+#include <Poco/Types.h>
+
+namespace toggl {
+
+class TimeEntry;
+class User;
+
+/**
+ * Sorted, grouped and summed time entry list, as displayed by the
+ * time entry list view. Instead of re-sorting and re-filling every
+ * entry on each render, the model is kept up to date from the
+ * ModelChange list produced by Database::SaveUser, so a single edit
+ * costs O(log N). Falls back to a full rebuild when a change can't be
+ * applied incrementally (related models, day rollover, user switch,
+ * duration or time format change).
+ *
+ * Only Update reads the time entries, so the views are rendered
+ * without the user lock. The model guards itself for that.
+ */
+class TOGGL_INTERNAL_EXPORT TimeEntryListModel {
+ public:
+    TimeEntryListModel();
+    TimeEntryListModel(const TimeEntryListModel &o) = delete;
+    TimeEntryListModel &operator=(const TimeEntryListModel &o) = delete;
+
+    // Must be called with all changes saved to the database,
+    // under the same lock that guards the user.
+    void ApplyChanges(const std::vector<ModelChange> &changes);
+
+    // Drops everything, the next Render rebuilds the list from scratch
+    void Reset();
+
+    // Applies the saved changes and reads what they don't carry,
+    // call under the lock that guards the user
+    void Update(
+        User *user,
+        const std::function<bool(TimeEntry *)> &is_locked);
+
+    // The list as of the last Update, doesn't touch the time entries
+    void Render(
+        const std::map<std::string, bool_t> &entry_groups,
+        std::vector<view::TimeEntry> *result) const;
+
+    // Visible entries, including the running one
+    size_t Size() const {
+        Poco::Mutex::ScopedLock lock(m_);
+        return rows_.size();
+    }
+
+ private:
+    typedef std::pair<Poco::Int64, guid> SortKey;
+
+    struct Row {
+        TimeEntry *te { nullptr };
+        SortKey key;
+        std::string date_header;
+        std::string group;
+        Poco::Int64 duration { 0 };
+        bool running { false };
+        view::TimeEntry view;
+    };
+
+    struct Group {
+        Poco::Int64 duration { 0 };
+        std::set<SortKey> members;
+    };
+
+    void reset();
+    bool needsRebuild(User *user) const;
+    void rebuild(
+        User *user,
+        const std::function<bool(TimeEntry *)> &is_locked);
+    void refresh(
+        User *user,
+        const guid &GUID,
+        const std::function<bool(TimeEntry *)> &is_locked);
+    void insert(
+        User *user,
+        TimeEntry *te,
+        const std::function<bool(TimeEntry *)> &is_locked);
+    void erase(const guid &GUID);
+
+    static bool isVisible(TimeEntry *te);
+    static int today();
+
+    mutable Poco::Mutex m_;
+
+    User *user_;
+    bool stale_;
+    int today_;
+    std::string duration_format_;
+    std::string time_of_day_format_;
+
+    // Time entries saved since the last render
+    std::set<guid> pending_;
+
+    std::unordered_map<guid, Row> rows_;
+    // Finished entries only, ascending by start time
+    std::set<SortKey> order_;
+    std::set<guid> running_;
+    // Totals of finished entries, running ones are added on render
+    std::map<std::string, Poco::Int64> date_durations_;
+    // Of the running entries as of the last Update, by date
+    std::map<std::string, Poco::Int64> running_durations_;
+    bool collapse_;
+    std::unordered_map<std::string, Group> groups_;
+};
+
+}  // namespace toggl
+
+#endif  // SRC_TIME_ENTRY_LIST_MODEL_H_
@@ -0,0 +1,177 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "timeline_event_index.h"
+
+#include <algorithm>
+#include <functional>
+#include <string>
+
+#include "const.h"
+
+#include <Poco/Bugcheck.h>
+
+namespace toggl {
+
+namespace {
+
+void hashCombine(size_t *seed, const size_t value) {
+    *seed ^= value + 0x9e3779b9 + (*seed << 6) + (*seed >> 2);
+}
+
+}  // namespace
+
+Poco::Int64 TimelineEventIndex::ChunkStart(const Poco::Int64 time) {
+    return (time / kTimelineChunkSeconds) * kTimelineChunkSeconds;
+}
+
+size_t TimelineEventIndex::chunkKey(const TimelineEvent &event) {
+    size_t key = std::hash<Poco::Int64>()(ChunkStart(event.Start()));
+    // Equal interned strings share their address
+    hashCombine(&key, std::hash<const void *>()(event.Filename().id()));
+    hashCombine(&key, std::hash<const void *>()(event.Title().id()));
+    hashCombine(&key, event.Idle());
+    return key;
+}
+
+bool TimelineEventIndex::sameChunk(
+    const TimelineEvent &a,
+    const TimelineEvent &b) {
+    return ChunkStart(a.Start()) == ChunkStart(b.Start())
+           && a.Idle() == b.Idle()
+           && a.Filename() == b.Filename()
+           && a.Title() == b.Title();
+}
+
+bool TimelineEventIndex::isOpen(const TimelineEvent &chunk) {
+    return chunk.Chunked() && !chunk.Uploaded() && !chunk.DeletedAt();
+}
+
+void TimelineEventIndex::Between(
+    const Poco::Int64 from,
+    const Poco::Int64 to,
+    std::vector<TimelineEvent *> *result) const {
+
+    poco_check_ptr(result);
+
+    for (auto it = buckets_.lower_bound(ChunkStart(from));
+            it != buckets_.end() && it->first < to;
+            ++it) {
+        for (auto event : it->second) {
+            // Chunks at the edges may be only partially in range
+            if (event->Start() >= from && event->Start() < to) {
+                result->push_back(event);
+            }
+        }
+    }
+}
+
+TimelineEvent *TimelineEventIndex::Compress(TimelineEvent *event) {
+    poco_check_ptr(event);
+
+    uncompressed_.erase(event);
+
+    // Calculate positive value of timeline event duration
+    Poco::Int64 duration = std::max(event->Duration(), Poco::Int64(0));
+
+    const size_t key = chunkKey(*event);
+    auto range = open_.equal_range(key);
+    for (auto it = range.first; it != range.second; ) {
+        TimelineEvent *chunk = it->second;
+        if (!isOpen(*chunk)) {
+            // Uploaded or deleted since, forget it
+            it = open_.erase(it);
+            continue;
+        }
+        if (chunk != event && sameChunk(*chunk, *event)) {
+            chunk->SetEndTime(chunk->EndTime() + duration);
+            return chunk;
+        }
+        ++it;
+    }
+
+    event->SetEndTime(event->Start() + duration);
+    event->SetChunked(true);
+    // Events that are not indexed yet are picked up when inserted
+    if (event->KeyObserver() == this) {
+        open_.insert(std::make_pair(key, event));
+    }
+    return nullptr;
+}
+
+void TimelineEventIndex::Close(const TimelineEvent *chunk) {
+    poco_check_ptr(chunk);
+
+    close(chunk, chunkKey(*chunk));
+}
+
+std::vector<TimelineEvent *> TimelineEventIndex::Uncompressed() const {
+    std::vector<TimelineEvent *> result(
+        uncompressed_.begin(), uncompressed_.end());
+    std::sort(result.begin(), result.end(),
+    [](const TimelineEvent *a, const TimelineEvent *b) {
+        return a->Start() < b->Start()
+               || (a->Start() == b->Start() && a->LocalID() < b->LocalID());
+    });
+    return result;
+}
+
+void TimelineEventIndex::close(const TimelineEvent *chunk, const size_t key) {
+    auto range = open_.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == chunk) {
+            open_.erase(it);
+            return;
+        }
+    }
+}
+
+void TimelineEventIndex::inserted(TimelineEvent *model) {
+    buckets_[ChunkStart(model->Start())].push_back(model);
+    if (isOpen(*model)) {
+        open_.insert(std::make_pair(chunkKey(*model), model));
+    } else if (!model->Chunked() && !model->Uploaded() && !model->DeletedAt()) {
+        uncompressed_.insert(model);
+    }
+}
+
+void TimelineEventIndex::removed(TimelineEvent *model) {
+    uncompressed_.erase(model);
+    if (model->Chunked()) {
+        close(model, chunkKey(*model));
+    }
+    if (erase(buckets_.find(ChunkStart(model->Start())), model)) {
+        return;
+    }
+    // Start time was changed after the event was indexed
+    for (auto it = buckets_.begin(); it != buckets_.end(); ++it) {
+        if (erase(it, model)) {
+            return;
+        }
+    }
+}
+
+void TimelineEventIndex::cleared() {
+    buckets_.clear();
+    open_.clear();
+    uncompressed_.clear();
+}
+
+bool TimelineEventIndex::erase(
+    Buckets::iterator bucket,
+    TimelineEvent *model) {
+    if (bucket == buckets_.end()) {
+        return false;
+    }
+    std::vector<TimelineEvent *> &events = bucket->second;
+    auto it = std::find(events.begin(), events.end(), model);
+    if (it == events.end()) {
+        return false;
+    }
+    events.erase(it);
+    if (events.empty()) {
+        buckets_.erase(bucket);
+    }
+    return true;
+}
+
+}  // namespace toggl
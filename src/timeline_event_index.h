@@ -0,0 +1,83 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_TIMELINE_EVENT_INDEX_H_
+#define SRC_TIMELINE_EVENT_INDEX_H_
+
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "model/timeline_event.h"
+#include "model_index.h"
+#include "types.h"
+
+#include <Poco/Types.h>
+
+namespace toggl {
+
+/**
+ * Model index of timeline events that also keeps them in buckets
+ * by the timeline chunk (kTimelineChunkSeconds) they start in, so
+ * a day or the chunks up to some time can be read without walking
+ * through the whole list. Events are bucketed by their start time
+ * when they are inserted, it is not expected to change later.
+ *
+ * Events are compressed as they are recorded: an event is merged
+ * into the open chunk of the same app, title and idle state in its
+ * 15 minutes, found by a hash of those, or becomes that chunk.
+ */
+class TOGGL_INTERNAL_EXPORT TimelineEventIndex
+    : public ModelIndex<TimelineEvent> {
+ public:
+    typedef std::map<Poco::Int64, std::vector<TimelineEvent *> > Buckets;
+
+    static Poco::Int64 ChunkStart(const Poco::Int64 time);
+
+    // Events by chunk start time, in the order they were inserted
+    const Buckets &Chunks() const {
+        return buckets_;
+    }
+
+    // Appends the events that started in [from, to), ordered by chunk
+    void Between(
+        const Poco::Int64 from,
+        const Poco::Int64 to,
+        std::vector<TimelineEvent *> *result) const;
+
+    // Returns the chunk the event was merged into, or nullptr
+    // if the event was turned into a chunk itself
+    TimelineEvent *Compress(TimelineEvent *event);
+
+    // Nothing more is merged into the chunk, e.g. while it's uploaded
+    void Close(const TimelineEvent *chunk);
+
+    // Indexed events that were never compressed, oldest first
+    std::vector<TimelineEvent *> Uncompressed() const;
+
+ protected:
+    void inserted(TimelineEvent *model) override;
+    void removed(TimelineEvent *model) override;
+    void cleared() override;
+
+ private:
+    typedef std::unordered_multimap<size_t, TimelineEvent *> OpenChunks;
+
+    static size_t chunkKey(const TimelineEvent &event);
+    static bool sameChunk(const TimelineEvent &a, const TimelineEvent &b);
+    static bool isOpen(const TimelineEvent &chunk);
+
+    bool erase(Buckets::iterator bucket, TimelineEvent *model);
+    void close(const TimelineEvent *chunk, const size_t key);
+
+    Buckets buckets_;
+
+    // Chunks new events can be merged into
+    OpenChunks open_;
+
+    std::unordered_set<TimelineEvent *> uncompressed_;
+};
+
+}  // namespace toggl
+
+#endif  // SRC_TIMELINE_EVENT_INDEX_H_
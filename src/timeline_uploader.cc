@@ -2,6 +2,7 @@
 
 #include "timeline_uploader.h"
 
+#include <algorithm>
 #include <sstream>
 #include <string>
 
@@ -9,8 +10,8 @@
 #include "https_client.h"
 #include "urls.h"
 
+#include <Poco/Bugcheck.h>
 #include <Poco/Foundation.h>
-#include <Poco/Thread.h>
 #include <Poco/Util/Application.h>
 
 #include <json/json.h>  // NOLINT
@@ -22,13 +23,7 @@ Logger TimelineUploader::logger() const {
 }
 
 void TimelineUploader::sleep() {
-    // Sleep in increments for faster shutdown.
-    for (unsigned int i = 0; i < current_upload_interval_seconds_*4; i++) {
-        if (uploading_.isStopped()) {
-            return;
-        }
-        Poco::Thread::sleep(250);
-    }
+    wakeup_.tryWait(current_upload_interval_seconds_ * 1000);
 }
 
 void TimelineUploader::upload_loop_activity() {
@@ -59,59 +54,92 @@ error TimelineUploader::process() {
         return noError;
     }
 
-    if (uploading_.isStopped()) {
-        return noError;
-    }
+    // After a long time offline the batch can be large, it's sent
+    // in parts and every part is marked as uploaded once it's taken,
+    // so a failure only leaves the rest to be retried
+    const std::vector<const TimelineEvent*> &events = batch.Events();
+    for (size_t offset = 0; offset < events.size();
+            offset += kTimelineUploadMaxEvents) {
+        if (uploading_.isStopped()) {
+            return noError;
+        }
 
-    err = upload(&batch);
-    if (err != noError) {
-        backoff();
-        return err;
-    }
+        std::vector<const TimelineEvent*> part(
+            events.begin() + offset,
+            events.begin() + std::min(events.size(),
+                                      offset + kTimelineUploadMaxEvents));
+
+        err = upload(&batch, part);
+        if (err != noError) {
+            backoff();
+            return err;
+        }
 
-    logger().debug("Sync of ", batch.Events().size(), " event(s) was successful.");
+        logger().debug("Sync of ", part.size(), " event(s) was successful.");
+
+        err = timeline_datasource_->MarkTimelineBatchAsUploaded(part);
+        if (err != noError) {
+            return err;
+        }
+    }
 
     reset_backoff();
 
-    return timeline_datasource_->MarkTimelineBatchAsUploaded(batch.Events());
+    return noError;
 }
 
-error TimelineUploader::upload(TimelineBatch *batch) {
-    logger().debug("Uploading ", batch->Events().size(), " event(s) of user ", batch->UserID());
+error TimelineUploader::upload(
+    TimelineBatch *batch,
+    const std::vector<const TimelineEvent*> &events) {
+    logger().debug("Uploading ", events.size(), " event(s) of user ", batch->UserID());
 
-    std::string json = convertTimelineToJSON(
-        batch->Events(),
-        batch->DesktopID());
-    logger().trace(json);
+    const std::string desktop_id = batch->DesktopID();
 
     // Not implemented in v9 as of 12.05.2017
     HTTPRequest req;
     req.host = urls::TimelineUpload();
     req.relative_url = "/api/v8/timeline";
-    req.payload = json;
+    req.payload_writer = [&events, &desktop_id](std::ostream &out) {
+        writeTimelineJSON(events, desktop_id, &out);
+    };
     req.basic_auth_username = batch->APIToken();
     req.basic_auth_password = "api_token";
 
     return TogglClient::GetInstance().silentPost(req).err;
 }
 
-std::string convertTimelineToJSON(
+void writeTimelineJSON(
     const std::vector<const TimelineEvent*> &timeline_events,
-    const std::string &desktop_id) {
+    const std::string &desktop_id,
+    std::ostream *out) {
 
-    Json::Value root;
+    poco_check_ptr(out);
 
+    Json::FastWriter writer;
+    writer.omitEndingLineFeed();
+
+    // Event by event, the whole array is never kept in memory
+    *out << "[";
     for (std::vector<const TimelineEvent*>::const_iterator i = timeline_events.begin();
             i != timeline_events.end();
             ++i) {
         const TimelineEvent *event = *i;
         Json::Value n = event->SaveToJSON();
         n["desktop_id"] = desktop_id;
-        root.append(n);
+        if (i != timeline_events.begin()) {
+            *out << ",";
+        }
+        *out << writer.write(n);
     }
+    *out << "]";
+}
 
-    Json::StyledWriter writer;
-    return writer.write(root);
+std::string convertTimelineToJSON(
+    const std::vector<const TimelineEvent*> &timeline_events,
+    const std::string &desktop_id) {
+    std::stringstream ss;
+    writeTimelineJSON(timeline_events, desktop_id, &ss);
+    return ss.str();
 }
 
 void TimelineUploader::backoff() {
@@ -146,6 +174,7 @@ error TimelineUploader::Shutdown() {
     try {
         if (uploading_.isRunning()) {
             uploading_.stop();
+            wakeup_.set();
             uploading_.wait();
         }
     } catch(const Poco::Exception& exc) {
@@ -3,6 +3,7 @@
 #ifndef SRC_TIMELINE_UPLOADER_H_
 #define SRC_TIMELINE_UPLOADER_H_
 
+#include <ostream>
 #include <string>
 #include <vector>
 
@@ -12,9 +13,16 @@
 #include "util/logger.h"
 
 #include <Poco/Activity.h>
+#include <Poco/Event.h>
 
 namespace toggl {
 
+// Writes the events as a compact JSON array
+void writeTimelineJSON(
+    const std::vector<const TimelineEvent*> &timeline_events,
+    const std::string &desktop_id,
+    std::ostream *out);
+
 std::string convertTimelineToJSON(
     const std::vector<const TimelineEvent*> &timeline_events,
     const std::string &desktop_id);
@@ -41,7 +49,10 @@ class TOGGL_INTERNAL_EXPORT TimelineUploader {
  private:
     error start();
 
-    error upload(TimelineBatch *batch);
+    // Uploads one request worth of the events of the batch
+    error upload(
+        TimelineBatch *batch,
+        const std::vector<const TimelineEvent*> &events);
 
     // How many seconds to wait before send next batch of timeline
     // events to backend.
@@ -56,6 +67,9 @@ class TOGGL_INTERNAL_EXPORT TimelineUploader {
 
     TimelineDatasource *timeline_datasource_;
 
+    // Set on shutdown to cut the wait for the next upload short
+    Poco::Event wakeup_;
+
     // An Activity is a possibly long running void/no arguments
     // member function running in its own thread.
     Poco::Activity<TimelineUploader> uploading_;
@@ -970,6 +970,12 @@ bool_t toggl_timeline_is_recording_enabled(
     return app(context)->IsTimelineRecordingEnabled();
 }
 
+void toggl_timeline_set_flush_seconds(
+    void *context,
+    const uint64_t flush_seconds) {
+    app(context)->SetTimelineFlushSeconds(flush_seconds);
+}
+
 bool_t toggl_can_see_billable(
     void *context,
     const int64_t workspaceID) {
@@ -1292,6 +1298,12 @@ void toggl_on_time_entry_list(
     app(context)->UI()->OnDisplayTimeEntryList(cb);
 }
 
+void toggl_on_time_entry_list_changes(
+    void *context,
+    TogglDisplayTimeEntryListChanges cb) {
+    app(context)->UI()->OnDisplayTimeEntryListChanges(cb);
+}
+
 void toggl_on_timeline(
     void *context,
     TogglDisplayTimeline cb) {
@@ -1316,6 +1328,29 @@ void toggl_on_project_autocomplete(
     app(context)->UI()->OnDisplayProjectAutocomplete(cb);
 }
 
+TogglAutocompleteView *toggl_autocomplete_query(
+    void *context,
+    const int64_t list,
+    const char_t *query,
+    const uint64_t limit) {
+    std::vector<toggl::view::Autocomplete> items;
+    toggl::error err = app(context)->AutocompleteQuery(
+        list,
+        query ? to_string(query) : "",
+        static_cast<size_t>(limit),
+        &items);
+    if (err != toggl::noError) {
+        logger().error(err);
+        return nullptr;
+    }
+    return autocomplete_list_init(&items);
+}
+
+void toggl_autocomplete_list_clear(
+    TogglAutocompleteView *first) {
+    autocomplete_list_clear(first);
+}
+
 void toggl_on_time_entry_editor(
     void *context,
     TogglDisplayTimeEntryEditor cb) {
@@ -42,6 +42,14 @@ extern "C" {
 
 #define kPromotionJoinBetaChannel 1
 
+#define kAutocompleteListTimeEntry 0
+#define kAutocompleteListMiniTimer 1
+#define kAutocompleteListProject 2
+
+#define kTimeEntryListChangeInsert 0
+#define kTimeEntryListChangeUpdate 1
+#define kTimeEntryListChangeRemove 2
+
 // Models
 
     typedef struct {
@@ -94,6 +102,18 @@ extern "C" {
         void *Next;
     } TogglTimeEntryView;
 
+    typedef struct {
+        // kTimeEntryListChangeInsert, Update or Remove
+        int64_t Type;
+        // Row position, after all the previous changes are applied
+        uint64_t Index;
+        // New row contents. For removals only GUID, Group
+        // and GroupName are set.
+        TogglTimeEntryView *Item;
+        // Next in list
+        void *Next;
+    } TogglTimeEntryListChangeView;
+
     typedef struct {
         char_t *Title;
         char_t *Filename;
@@ -308,6 +328,15 @@ typedef enum {
         TogglTimeEntryView *first,
         const bool_t show_load_more_button);
 
+    // Only the rows that changed since the previous call, to be
+    // applied in order. Rows are identified by GUID, group headers
+    // by GroupName. If reset is set, clear the list before applying.
+    typedef void (*TogglDisplayTimeEntryListChanges)(
+        const bool_t open,
+        const bool_t reset,
+        TogglTimeEntryListChangeView *first,
+        const bool_t show_load_more_button);
+
     typedef void (*TogglDisplayTimeline)(
         const bool_t open,
         const char_t *date,
@@ -524,6 +553,11 @@ typedef enum {
         void *context,
         TogglDisplayTimeEntryList cb);
 
+    // Replaces toggl_on_time_entry_list, if set
+    TOGGL_EXPORT void toggl_on_time_entry_list_changes(
+        void *context,
+        TogglDisplayTimeEntryListChanges cb);
+
     TOGGL_EXPORT void toggl_toggle_entries_group(
         void *context,
         const char_t *name);
@@ -548,6 +582,19 @@ typedef enum {
         void *context,
         TogglDisplayAutocomplete cb);
 
+    // Up to limit items of an autocomplete list (kAutocompleteListTimeEntry,
+    // kAutocompleteListMiniTimer or kAutocompleteListProject) matching
+    // every word of the query, best matches first. 0 means no limit.
+    // Free the result with toggl_autocomplete_list_clear.
+    TOGGL_EXPORT TogglAutocompleteView *toggl_autocomplete_query(
+        void *context,
+        const int64_t list,
+        const char_t *query,
+        const uint64_t limit);
+
+    TOGGL_EXPORT void toggl_autocomplete_list_clear(
+        TogglAutocompleteView *first);
+
     TOGGL_EXPORT void toggl_on_workspace_select(
         void *context,
         TogglDisplayViewItems cb);
@@ -1103,6 +1150,13 @@ typedef enum {
     TOGGL_EXPORT bool_t toggl_timeline_is_recording_enabled(
         void *context);
 
+    // Recorded timeline events are written to the database in batches,
+    // at most this many seconds after they were recorded (default 30).
+    // 0 writes each event immediately.
+    TOGGL_EXPORT void toggl_timeline_set_flush_seconds(
+        void *context,
+        const uint64_t flush_seconds);
+
     TOGGL_EXPORT void toggl_set_sleep(
         void *context);
 
@@ -336,7 +336,7 @@ TogglTimeEntryView *time_entry_view_item_init(
     view_item->UpdatedAt = static_cast<unsigned int>(te.UpdatedAt);
     view_item->DateHeader = copy_string(te.DateHeader);
     view_item->DurOnly = te.DurOnly;
-    view_item->IsHeader = false;
+    view_item->IsHeader = te.IsHeader;
 
     view_item->CanAddProjects = te.CanAddProjects;
     view_item->CanSeeBillable = te.CanSeeBillable;
@@ -434,6 +434,40 @@ void time_entry_view_list_clear(TogglTimeEntryView *first) {
     }
 }
 
+TogglTimeEntryListChangeView *time_entry_list_change_view_item_init(
+    const toggl::view::TimeEntryListChange &change) {
+
+    TogglTimeEntryListChangeView *view_item =
+        new TogglTimeEntryListChangeView();
+    poco_check_ptr(view_item);
+
+    view_item->Type = change.Type;
+    view_item->Index = change.Index;
+    if (kTimeEntryListChangeRemove == change.Type) {
+        // Only what identifies the removed row
+        view_item->Item = new TogglTimeEntryView();
+        view_item->Item->GUID = copy_string(change.Item.GUID);
+        view_item->Item->Group = change.Item.Group;
+        view_item->Item->GroupName = copy_string(change.Item.GroupName);
+    } else {
+        view_item->Item = time_entry_view_item_init(change.Item);
+    }
+    view_item->Next = nullptr;
+
+    return view_item;
+}
+
+void time_entry_list_change_view_list_clear(
+    TogglTimeEntryListChangeView *first) {
+    while (first) {
+        TogglTimeEntryListChangeView *next =
+            reinterpret_cast<TogglTimeEntryListChangeView *>(first->Next);
+        time_entry_view_item_clear(first->Item);
+        delete first;
+        first = next;
+    }
+}
+
 TogglSettingsView *settings_view_item_init(
     const bool_t record_timeline,
     const toggl::Settings &settings,
@@ -604,8 +638,8 @@ void timeline_chunk_view_clear(
 TogglTimelineEventView *timeline_event_view_init(
     const toggl::TimelineEvent *event) {
     TogglTimelineEventView *event_view = new TogglTimelineEventView();
-    event_view->Title = copy_string(event->Title());
-    event_view->Filename = copy_string(event->Filename());
+    event_view->Title = copy_string(event->Title().str());
+    event_view->Filename = copy_string(event->Filename().str());
     event_view->Duration = event->EndTime() - event->Start();
     event_view->DurationString = copy_string(toggl::Formatter::FormatDuration(event_view->Duration, toggl::Format::ImprovedOnlyMinAndSec));
     event_view->Header = false;
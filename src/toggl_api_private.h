@@ -23,6 +23,7 @@ class AutotrackerRule;
 class Generic;
 class HelpArticle;
 class TimeEntry;
+class TimeEntryListChange;
 }
 }  // namespace toggl
 
@@ -85,6 +86,12 @@ void time_entry_view_item_clear(TogglTimeEntryView *item);
 
 void time_entry_view_list_clear(TogglTimeEntryView *first);
 
+TogglTimeEntryListChangeView *time_entry_list_change_view_item_init(
+    const toggl::view::TimeEntryListChange &change);
+
+void time_entry_list_change_view_list_clear(
+    TogglTimeEntryListChangeView *first);
+
 TogglSettingsView *settings_view_item_init(
     const bool_t record_timeline,
     const toggl::Settings &settings,
@@ -19,12 +19,15 @@ AutocompleteComboBox::AutocompleteComboBox(QWidget *parent)
     setCompleter(completer);
     disconnect(completer, SIGNAL(highlighted(QString)), lineEdit(), nullptr);
     connect(listView, &AutocompleteListView::visibleChanged, this, &AutocompleteComboBox::onDropdownVisibleChanged);
-    connect(lineEdit(), &QLineEdit::textEdited, proxyModel, &AutocompleteProxyModel::setFilterFixedString);
+    connect(lineEdit(), &QLineEdit::textEdited, proxyModel, &AutocompleteProxyModel::setFilter);
     connect(listView, &AutocompleteListView::selected, this, &AutocompleteComboBox::onDropdownSelected);
 }
 
-void AutocompleteComboBox::setModel(QAbstractItemModel *model) {
+void AutocompleteComboBox::setModel(QAbstractItemModel *model, int64_t list) {
+    proxyModel->setList(list);
     proxyModel->setSourceModel(model);
+    // The library's index already holds the new list when it's displayed
+    connect(model, &QAbstractItemModel::modelReset, proxyModel, &AutocompleteProxyModel::refreshFilter);
 }
 
 void AutocompleteComboBox::showPopup() {
@@ -115,7 +118,7 @@ void AutocompleteComboBox::keyPressEvent(QKeyEvent *event) {
 
 void AutocompleteComboBox::onDropdownVisibleChanged() {
     if (listView->isVisible()) {
-        proxyModel->setFilterFixedString(currentText());
+        proxyModel->setFilter(currentText());
     }
 }
 
@@ -166,30 +169,38 @@ bool AutocompleteCompleter::eventFilter(QObject *o, QEvent *e) {
 }
 
 AutocompleteProxyModel::AutocompleteProxyModel(QObject *parent)
-    : QSortFilterProxyModel(parent) {
+    : QSortFilterProxyModel(parent)
+    , list(kAutocompleteListTimeEntry) {
     setFilterRole(Qt::UserRole);
 }
 
+void AutocompleteProxyModel::setList(int64_t list) {
+    this->list = list;
+}
+
+void AutocompleteProxyModel::setFilter(const QString &text) {
+    // An empty filter shows every row, see filterAcceptsRow
+    if (text.trimmed().isEmpty())
+        matches.clear();
+    else
+        matches = TogglApi::instance->autocompleteMatches(list, text);
+    setFilterFixedString(text);
+}
+
+void AutocompleteProxyModel::refreshFilter() {
+    setFilter(filterRegExp().pattern());
+}
+
 bool AutocompleteProxyModel::filterAcceptsRow(int source_row, const QModelIndex &source_parent) const {
-    QString input = filterRegExp().pattern();
-    QStringList words = input.split(" ");
+    if (filterRegExp().pattern().trimmed().isEmpty())
+        return true;
 
     auto view = qvariant_cast<AutocompleteView*>(sourceModel()->data(sourceModel()->index(source_row, 0), Qt::UserRole));
-    for (auto word : words) {
-        if (word.isEmpty() && words.count() > 1)
-            continue;
-        if (view->_Children.isEmpty()) {
-            if (view->Description.contains(word, Qt::CaseInsensitive))
-                    return true;
-            if (view->Text.contains(word, Qt::CaseInsensitive))
-                    return true;
-        }
-        for (auto v : view->_Children) {
-            if (v->Description.contains(word, Qt::CaseInsensitive))
-                    return true;
-            if (v->Text.contains(word, Qt::CaseInsensitive))
-                    return true;
-        }
+    if (view->_Children.isEmpty())
+        return matches.contains(view->Text);
+    for (auto v : view->_Children) {
+        if (matches.contains(v->Text))
+            return true;
     }
 
     return false;
@@ -5,6 +5,7 @@
 #include <QLineEdit>
 #include <QCompleter>
 #include <QSortFilterProxyModel>
+#include <QSet>
 
 #include "autocompleteview.h"
 
@@ -17,7 +18,9 @@ class AutocompleteComboBox : public QComboBox {
 public:
     AutocompleteComboBox(QWidget *parent = nullptr);
 
-    void setModel(QAbstractItemModel *model);
+    // list is the library's autocomplete list (kAutocompleteList*)
+    // the model shows, used to filter it
+    void setModel(QAbstractItemModel *model, int64_t list);
 
     void showPopup() override;
 
@@ -62,7 +65,18 @@ class AutocompleteProxyModel : public QSortFilterProxyModel {
 public:
     AutocompleteProxyModel(QObject *parent = nullptr);
 
+    void setList(int64_t list);
+
     bool filterAcceptsRow(int source_row, const QModelIndex &source_parent) const override;
+
+public slots:
+    void setFilter(const QString &text);
+    void refreshFilter();
+
+private:
+    int64_t list;
+    // Texts of the matching items, queried once per filter change
+    QSet<QString> matches;
 };
 
 #endif // AUTOCOMPLETECOMBOBOX_H
@@ -57,6 +57,7 @@ int main(int argc, char *argv[]) try {
     qRegisterMetaType<int64_t>("int64_t");
     qRegisterMetaType<bool_t>("bool_t");
     qRegisterMetaType<QVector<TimeEntryView*> >("QVector<TimeEntryView*>");
+    qRegisterMetaType<QVector<TimeEntryListChange*> >("QVector<TimeEntryListChange*>");
     qRegisterMetaType<QVector<AutocompleteView*> >("QVector<AutocompleteView*>");
     qRegisterMetaType<QVector<GenericView*> >("QVector<GenericView*>");
 
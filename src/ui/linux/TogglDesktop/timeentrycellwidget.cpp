@@ -38,7 +38,11 @@ void TimeEntryCellWidget::display(TimeEntryView *view) {
     setLoadMore(false);
     guid = view->GUID;
     groupName = view->GroupName;
-    timeEntry = view;
+    // The cell owns the view it displays
+    if (timeEntry != view) {
+        delete timeEntry;
+        timeEntry = view;
+    }
     description =
         (view->Description.length() > 0) ?
         view->Description : "(no description)";
@@ -171,6 +175,7 @@ void TimeEntryCellWidget::labelClicked(QString field_name) {
 }
 
 TimeEntryCellWidget::~TimeEntryCellWidget() {
+    delete timeEntry;
     delete ui;
 }
 
@@ -33,8 +33,8 @@ projectModel(new AutocompleteListModel(this, QVector<AutocompleteView*>(), AC_PR
 {
     ui->setupUi(this);
 
-    ui->description->setModel(descriptionModel);
-    ui->project->setModel(projectModel);
+    ui->description->setModel(descriptionModel, kAutocompleteListTimeEntry);
+    ui->project->setModel(projectModel, kAutocompleteListProject);
 
     ui->description->installEventFilter(this);
     ui->project->installEventFilter(this);
@@ -8,7 +8,8 @@
 #include "./timeentrycellwidget.h"
 
 TimeEntryListWidget::TimeEntryListWidget(QStackedWidget *parent) : QWidget(parent),
-ui(new Ui::TimeEntryListWidget) {
+ui(new Ui::TimeEntryListWidget),
+rows_(0) {
     ui->setupUi(this);
 
     connect(ui->list, &QListWidget::currentRowChanged, [=](int row) {
@@ -21,6 +22,9 @@ ui(new Ui::TimeEntryListWidget) {
     connect(TogglApi::instance, SIGNAL(displayTimeEntryList(bool,QVector<TimeEntryView*>,bool)),  // NOLINT
             this, SLOT(displayTimeEntryList(bool,QVector<TimeEntryView*>,bool)));  // NOLINT
 
+    connect(TogglApi::instance, SIGNAL(displayTimeEntryListChanges(bool,bool,QVector<TimeEntryListChange*>,bool)),  // NOLINT
+            this, SLOT(displayTimeEntryListChanges(bool,bool,QVector<TimeEntryListChange*>,bool)));  // NOLINT
+
     ui->blankView->setVisible(false);
 }
 
@@ -53,6 +57,7 @@ void TimeEntryListWidget::displayLogin(
 
     if (open || !user_id) {
         ui->list->clear();
+        rows_ = 0;
     }
 }
 
@@ -106,10 +111,82 @@ void TimeEntryListWidget::displayTimeEntryList(
     ui->list->setVisible(!list.isEmpty());
     ui->blankView->setVisible(list.isEmpty());
 
+    rows_ = list.size();
+
+    render_m_.unlock();
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
+}
+
+void TimeEntryListWidget::displayTimeEntryListChanges(
+    const bool open,
+    const bool reset,
+    QVector<TimeEntryListChange *> changes,
+    const bool show_load_more_button) {
+
+    if (open) {
+        display();
+    }
+    setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
+    render_m_.lock();
+
+    if (reset) {
+        ui->list->clear();
+        rows_ = 0;
+    }
+
+    // Load more button goes after the rows, take it out of the way
+    while (ui->list->count() > rows_) {
+        ui->list->model()->removeRow(rows_);
+    }
+
+    for (int i = 0; i < changes.size(); i++) {
+        TimeEntryListChange *change = changes.at(i);
+
+        if (kTimeEntryListChangeRemove == change->Type) {
+            delete ui->list->takeItem(change->Index);
+            delete change->View;
+            rows_--;
+            continue;
+        }
+
+        TimeEntryCellWidget *cell = nullptr;
+        QListWidgetItem *item = nullptr;
+        if (kTimeEntryListChangeInsert == change->Type) {
+            cell = insertCell(change->Index);
+            item = ui->list->item(change->Index);
+            rows_++;
+        } else {
+            item = ui->list->item(change->Index);
+            cell = static_cast<TimeEntryCellWidget *>(
+                ui->list->itemWidget(item));
+        }
+
+        cell->display(change->View);
+        item->setSizeHint(cell->getSizeHint(change->View->IsHeader));
+    }
+    // Cells own the views they display, replaced ones are deleted there
+    qDeleteAll(changes);
+
+    if (show_load_more_button) {
+        showLoadMoreButton(rows_);
+    }
+
+    ui->list->setVisible(rows_ > 0);
+    ui->blankView->setVisible(!rows_);
+
     render_m_.unlock();
     setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Expanding);
 }
 
+TimeEntryCellWidget *TimeEntryListWidget::insertCell(int row) {
+    QListWidgetItem *item = new QListWidgetItem();
+    TimeEntryCellWidget *cell = new TimeEntryCellWidget(item);
+
+    ui->list->insertItem(row, item);
+    ui->list->setItemWidget(item, cell);
+    return cell;
+}
+
 void TimeEntryListWidget::showLoadMoreButton(int size) {
     QListWidgetItem *item = nullptr;
     TimeEntryCellWidget *cell = nullptr;
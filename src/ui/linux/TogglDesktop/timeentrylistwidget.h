@@ -42,14 +42,25 @@ class TimeEntryListWidget : public QWidget {
         QVector<TimeEntryView *> list,
         const bool show_load_more_button);
 
+    void displayTimeEntryListChanges(
+        const bool open,
+        const bool reset,
+        QVector<TimeEntryListChange *> changes,
+        const bool show_load_more_button);
+
     void showLoadMoreButton(int size);
 
     void on_blankView_linkActivated(const QString &link);
 
  private:
+    TimeEntryCellWidget *insertCell(int row);
+
     Ui::TimeEntryListWidget *ui;
 
     QMutex render_m_;
+
+    // Time entry rows, without the load more button
+    int rows_;
 };
 
 #endif  // SRC_UI_LINUX_TOGGLDESKTOP_TIMEENTRYLISTWIDGET_H_
@@ -58,6 +58,24 @@ QVector<TimeEntryView *> TimeEntryView::importAll(
     return result;
 }
 
+QVector<TimeEntryListChange *> TimeEntryListChange::importAll(
+    TogglTimeEntryListChangeView *first) {
+    QVector<TimeEntryListChange *> result;
+    TogglTimeEntryListChangeView *change = first;
+    while (change) {
+        TimeEntryListChange *item = new TimeEntryListChange();
+        item->Type = change->Type;
+        item->Index = static_cast<int>(change->Index);
+        // Removed rows are found by their index
+        item->View = kTimeEntryListChangeRemove == change->Type
+                     ? nullptr
+                     : TimeEntryView::importOne(change->Item);
+        result.push_back(item);
+        change = static_cast<TogglTimeEntryListChangeView *>(change->Next);
+    }
+    return result;
+}
+
 const QString TimeEntryView::lastUpdate() {
     return QString("Last update ") +
            QDateTime::fromTime_t(static_cast<uint>(UpdatedAt)).toString();
@@ -56,4 +56,19 @@ class TimeEntryView : public QObject {
     uint64_t GroupItemCount;
 };
 
+class TimeEntryListChange {
+ public:
+    TimeEntryListChange()
+        : Type(kTimeEntryListChangeInsert)
+    , Index(0)
+    , View(nullptr) {}
+
+    static QVector<TimeEntryListChange *> importAll(
+        TogglTimeEntryListChangeView *first);
+
+    int64_t Type;
+    int Index;
+    TimeEntryView *View;
+};
+
 #endif  // SRC_UI_LINUX_TOGGLDESKTOP_TIMEENTRYVIEW_H_
@@ -58,7 +58,7 @@ selectedProjectId(0) {
     connect(ui->deleteProject, &QPushButton::clicked, this, &TimerWidget::clearProject);
     connect(ui->deleteTask, &QPushButton::clicked, this, &TimerWidget::clearTask);
 
-    ui->description->setModel(descriptionModel);
+    ui->description->setModel(descriptionModel, kAutocompleteListMiniTimer);
     ui->taskFrame->setVisible(false);
     ui->projectFrame->setVisible(false);
 
@@ -106,6 +106,21 @@ void on_display_time_entry_list(
         show_load_more_button);
 }
 
+void on_display_time_entry_list_changes(
+    const bool_t open,
+    const bool_t reset,
+    TogglTimeEntryListChangeView *first,
+    const bool_t show_load_more_button) {
+    if (open) {
+        TogglApi::instance->aboutToDisplayTimeEntryList();
+    }
+    TogglApi::instance->displayTimeEntryListChanges(
+        open,
+        reset,
+        TimeEntryListChange::importAll(first),
+        show_load_more_button);
+}
+
 void on_display_time_entry_autocomplete(
     TogglAutocompleteView *first) {
     TogglApi::instance->displayTimeEntryAutocomplete(
@@ -279,7 +294,7 @@ TogglApi::TogglApi(
     toggl_on_pomodoro(ctx, on_display_pomodoro);
     toggl_on_pomodoro_break(ctx, on_display_pomodoro_break);
     toggl_on_reminder(ctx, on_display_reminder);
-    toggl_on_time_entry_list(ctx, on_display_time_entry_list);
+    toggl_on_time_entry_list_changes(ctx, on_display_time_entry_list_changes);
     toggl_on_time_entry_autocomplete(ctx, on_display_time_entry_autocomplete);
     toggl_on_mini_timer_autocomplete(ctx, on_display_mini_timer_autocomplete);
     toggl_on_project_autocomplete(ctx, on_display_project_autocomplete);
@@ -710,6 +725,20 @@ QString TogglApi::createClient(
     return res;
 }
 
+QSet<QString> TogglApi::autocompleteMatches(
+    const int64_t list,
+    const QString query) {
+    QSet<QString> res;
+    TogglAutocompleteView *first =
+        toggl_autocomplete_query(ctx, list, toCStr(query), 0);
+    for (TogglAutocompleteView *it = first; it;
+            it = static_cast<TogglAutocompleteView *>(it->Next)) {
+        res.insert(toQString(it->Text));
+    }
+    toggl_autocomplete_list_clear(first);
+    return res;
+}
+
 void TogglApi::viewTimeEntryList() {
     toggl_view_time_entry_list(ctx);
 }
@@ -7,6 +7,7 @@
 #include <QUrl>
 #include <QVector>
 #include <QRect>
+#include <QSet>
 
 #include <stdint.h>
 
@@ -16,6 +17,7 @@ class AutocompleteView;
 class GenericView;
 class SettingsView;
 class TimeEntryView;
+class TimeEntryListChange;
 class CountryView;
 
 inline QString toQString(const char_t *cStr) {
@@ -173,6 +175,12 @@ class TogglApi : public QObject {
         const uint64_t wid,
         const QString name);
 
+    // Texts of the items of an autocomplete list (kAutocompleteList*)
+    // matching every word of the query, looked up in the library's index
+    QSet<QString> autocompleteMatches(
+        const int64_t list,
+        const QString query);
+
     // returns false if error
     bool setSettingsAutodetectProxy(const bool value);
 
@@ -289,6 +297,11 @@ class TogglApi : public QObject {
         const bool open,
         QVector<TimeEntryView *> list,
         const bool show_load_more_button);
+    void displayTimeEntryListChanges(
+        const bool open,
+        const bool reset,
+        QVector<TimeEntryListChange *> changes,
+        const bool show_load_more_button);
 
     void aboutToDisplayTimeEntryEditor();
     void displayTimeEntryEditor(
@@ -372,6 +385,11 @@ void on_display_reminder(const char_t *title,
 void on_display_time_entry_list(
     const bool_t open,
     TogglTimeEntryView *first);
+void on_display_time_entry_list_changes(
+    const bool_t open,
+    const bool_t reset,
+    TogglTimeEntryListChangeView *first,
+    const bool_t show_load_more_button);
 void on_display_time_entry_autocomplete(
     TogglAutocompleteView *first);
 void on_display_mini_timer_autocomplete(
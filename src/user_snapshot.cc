@@ -0,0 +1,139 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "user_snapshot.h"
+
+#include "model/time_entry.h"
+#include "model/user.h"
+#include "util/formatter.h"
+
+#include <Poco/LocalDateTime.h>
+#include <Poco/Timespan.h>
+#include <Poco/Timestamp.h>
+
+namespace toggl {
+
+void UserSnapshot::Fill(const User *user, const Poco::UInt64 version) {
+    Version = version;
+    if (!user) {
+        return;
+    }
+    UserID = user->ID();
+
+    TimeEntry *running = user->RunningTimeEntry();
+    if (!running) {
+        return;
+    }
+    setRunning(running);
+
+    for (auto it = user->related.TimeEntries.begin();
+            it != user->related.TimeEntries.end(); ++it) {
+        countInDay(*it, running);
+    }
+}
+
+void UserSnapshot::Update(
+    const User *user,
+    const UserSnapshot &previous,
+    const std::vector<ModelChange> &changes,
+    const Poco::UInt64 version) {
+    if (!user || user->ID() != previous.UserID) {
+        Fill(user, version);
+        return;
+    }
+
+    // Only one entry runs at a time, so it's the previous one
+    // unless a changed entry has started or stopped
+    TimeEntry *running = nullptr;
+    if (previous.Tracking()) {
+        running = user->related.TimeEntryByGUID(previous.RunningGUID);
+        if (running && running->DurationInSeconds() >= 0) {
+            running = nullptr;
+        }
+    }
+    std::vector<std::string> changed;
+    for (auto it = changes.begin(); it != changes.end(); ++it) {
+        if (kModelTimeEntry != it->ModelType()) {
+            continue;
+        }
+        if (it->GUID().empty()) {
+            Fill(user, version);
+            return;
+        }
+        changed.push_back(it->GUID());
+        TimeEntry *te = user->related.TimeEntryByGUID(it->GUID());
+        if (te && te->DurationInSeconds() < 0) {
+            running = te;
+        }
+    }
+
+    Version = version;
+    UserID = user->ID();
+    if (!running) {
+        return;
+    }
+    setRunning(running);
+
+    if (!previous.Tracking() || previous.DayStart != DayStart) {
+        for (auto it = user->related.TimeEntries.begin();
+                it != user->related.TimeEntries.end(); ++it) {
+            countInDay(*it, running);
+        }
+        return;
+    }
+
+    DayDurations = previous.DayDurations;
+    DayStoppedDuration = previous.DayStoppedDuration;
+    // The previously running entry has been stopped into the day
+    changed.push_back(previous.RunningGUID);
+    for (auto it = changed.begin(); it != changed.end(); ++it) {
+        auto counted = DayDurations.find(*it);
+        if (counted != DayDurations.end()) {
+            DayStoppedDuration -= counted->second;
+            DayDurations.erase(counted);
+        }
+        countInDay(user->related.TimeEntryByGUID(*it), running);
+    }
+}
+
+void UserSnapshot::setRunning(const TimeEntry *running) {
+    RunningGUID = running->GUID();
+    RunningStart = running->StartTime();
+    RunningDuration = running->Duration();
+    RunningLastStartAt = running->LastStartAt();
+    RunningDurOnly = running->DurOnly();
+    RunningSkipPomodoro = running->SkipPomodoro();
+    RunningWID = running->WID();
+
+    // Bounds of the local day, so entries are compared by
+    // timestamp instead of formatting a date for each of them
+    Poco::LocalDateTime start(
+        Poco::Timestamp::fromEpochTime(RunningStart));
+    Poco::LocalDateTime midnight(
+        start.year(), start.month(), start.day());
+    DayStart = midnight.utc().timestamp().epochTime();
+    DayEnd = (midnight + Poco::Timespan(1, 0, 0, 0, 0))
+             .utc().timestamp().epochTime();
+}
+
+void UserSnapshot::countInDay(
+    const TimeEntry *te,
+    const TimeEntry *running) {
+    if (!te || te == running || te->GUID().empty() || te->DeletedAt() > 0) {
+        return;
+    }
+    if (te->StartTime() >= DayStart && te->StartTime() < DayEnd
+            && DayDurations.find(te->GUID()) == DayDurations.end()) {
+        const Poco::Int64 duration = Formatter::AbsDuration(te->Duration());
+        DayDurations[te->GUID()] = duration;
+        DayStoppedDuration += duration;
+    }
+}
+
+Poco::Int64 UserSnapshot::RunningDayDuration() const {
+    if (!Tracking()) {
+        return 0;
+    }
+    return DayStoppedDuration + Formatter::AbsDuration(RunningDuration);
+}
+
+}  // namespace toggl
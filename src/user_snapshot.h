@@ -0,0 +1,90 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_USER_SNAPSHOT_H_
+#define SRC_USER_SNAPSHOT_H_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "model_change.h"
+#include "types.h"
+
+#include <Poco/Types.h>
+
+namespace toggl {
+
+class TimeEntry;
+class User;
+
+/**
+ * Read-only copy of the user state that the periodic UI and reminder
+ * checks need. A new snapshot is built under the user lock whenever
+ * time entries are saved and is published by swapping a shared
+ * pointer, so readers never take the user lock and never see a
+ * half-updated snapshot. Saves build it from the previous snapshot
+ * and only look at the time entries they changed.
+ */
+class TOGGL_INTERNAL_EXPORT UserSnapshot {
+ public:
+    UserSnapshot()
+        : Version(0)
+    , UserID(0)
+    , RunningStart(0)
+    , RunningDuration(0)
+    , RunningLastStartAt(0)
+    , RunningDurOnly(false)
+    , RunningSkipPomodoro(false)
+    , RunningWID(0)
+    , DayStart(0)
+    , DayEnd(0)
+    , DayStoppedDuration(0) {}
+
+    void Fill(const User *user, const Poco::UInt64 version);
+
+    // Same result as Fill, taking over what the changes didn't touch
+    // from the previous snapshot. Falls back to Fill when the user or
+    // the day of the running entry is not the previous one's.
+    void Update(
+        const User *user,
+        const UserSnapshot &previous,
+        const std::vector<ModelChange> &changes,
+        const Poco::UInt64 version);
+
+    bool Tracking() const {
+        return !RunningGUID.empty();
+    }
+
+    // Total duration of the day of the running entry, as
+    // RelatedData::TotalDurationForDate would count it right now
+    Poco::Int64 RunningDayDuration() const;
+
+    Poco::UInt64 Version;
+    Poco::UInt64 UserID;
+
+    // Running time entry, empty GUID when nothing is tracking
+    std::string RunningGUID;
+    Poco::Int64 RunningStart;
+    Poco::Int64 RunningDuration;
+    Poco::Int64 RunningLastStartAt;
+    bool RunningDurOnly;
+    bool RunningSkipPomodoro;
+    Poco::UInt64 RunningWID;
+
+    // Local day of the running entry and the stopped time in it
+    Poco::Int64 DayStart;
+    Poco::Int64 DayEnd;
+    Poco::Int64 DayStoppedDuration;
+    // Duration of each stopped entry of the day, by GUID
+    std::map<std::string, Poco::Int64> DayDurations;
+
+ private:
+    void setRunning(const TimeEntry *running);
+
+    // Adds the entry to the day if it's a stopped entry of it
+    void countInDay(const TimeEntry *te, const TimeEntry *running);
+};
+
+}  // namespace toggl
+
+#endif  // SRC_USER_SNAPSHOT_H_
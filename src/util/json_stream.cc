@@ -0,0 +1,211 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "util/json_stream.h"
+
+#include <cctype>
+
+#include <Poco/Bugcheck.h>
+
+namespace toggl {
+
+namespace {
+
+bool isSpace(const char c) {
+    return std::isspace(static_cast<unsigned char>(c)) != 0;
+}
+
+}  // namespace
+
+JsonStreamSplitter::JsonStreamSplitter(
+    const std::set<std::string> &keys,
+    const Callback &callback)
+    : keys_(keys)
+, callback_(callback)
+, in_string_(false)
+, escaped_(false)
+, expect_key_(false)
+, split_depth_(0)
+, element_scalar_(false) {}
+
+bool JsonStreamSplitter::splitArray(const std::string &key) const {
+    if (!keys_.count(key)) {
+        return false;
+    }
+    if (1 == stack_.size()) {
+        return '{' == stack_[0].type;
+    }
+    return 2 == stack_.size()
+           && '{' == stack_[0].type
+           && '{' == stack_[1].type
+           && "data" == stack_[1].key;
+}
+
+error JsonStreamSplitter::scan(const char c) {
+    document_ += c;
+
+    if (in_string_) {
+        if (escaped_) {
+            escaped_ = false;
+        } else if ('\\' == c) {
+            escaped_ = true;
+        } else if ('"' == c) {
+            in_string_ = false;
+            if (expect_key_) {
+                last_key_ = key_;
+            }
+            return noError;
+        }
+        if (expect_key_) {
+            key_ += c;
+        }
+        return noError;
+    }
+
+    std::string key;
+    if (!stack_.empty() && '{' == stack_.back().type) {
+        key = last_key_;
+    }
+
+    switch (c) {
+    case '"':
+        in_string_ = true;
+        key_.clear();
+        break;
+    case '{':
+        stack_.push_back({ c, key });
+        expect_key_ = true;
+        break;
+    case '[':
+        if (splitArray(key)) {
+            split_depth_ = stack_.size() + 1;
+            split_key_ = key;
+            element_.clear();
+        }
+        stack_.push_back({ c, key });
+        expect_key_ = false;
+        break;
+    case '}':
+    case ']':
+        if (stack_.empty() || stack_.back().type != (']' == c ? '[' : '{')) {
+            return error("Unexpected '" + std::string(1, c) + "' in JSON");
+        }
+        stack_.pop_back();
+        expect_key_ = false;
+        break;
+    case ',':
+        expect_key_ = !stack_.empty() && '{' == stack_.back().type;
+        break;
+    case ':':
+        expect_key_ = false;
+        break;
+    default:
+        break;
+    }
+    return noError;
+}
+
+error JsonStreamSplitter::element(const char c) {
+    if (element_.empty()) {
+        if (isSpace(c) || ',' == c) {
+            return noError;
+        }
+        if (']' == c) {
+            stack_.pop_back();
+            split_depth_ = 0;
+            document_ += c;
+            return noError;
+        }
+        element_scalar_ = '{' != c && '[' != c;
+    } else if (element_scalar_ && !in_string_
+               && (',' == c || ']' == c || isSpace(c))) {
+        error err = endElement();
+        if (err != noError) {
+            return err;
+        }
+        return element(c);
+    }
+
+    element_ += c;
+
+    if (in_string_) {
+        if (escaped_) {
+            escaped_ = false;
+        } else if ('\\' == c) {
+            escaped_ = true;
+        } else if ('"' == c) {
+            in_string_ = false;
+        }
+        return noError;
+    }
+
+    switch (c) {
+    case '"':
+        in_string_ = true;
+        break;
+    case '{':
+    case '[':
+        stack_.push_back({ c, "" });
+        break;
+    case '}':
+    case ']':
+        if (stack_.size() <= split_depth_
+                || stack_.back().type != (']' == c ? '[' : '{')) {
+            return error("Unexpected '" + std::string(1, c) + "' in JSON");
+        }
+        stack_.pop_back();
+        if (stack_.size() == split_depth_) {
+            return endElement();
+        }
+        break;
+    default:
+        break;
+    }
+    return noError;
+}
+
+error JsonStreamSplitter::endElement() {
+    bool next = callback_(split_key_, element_);
+    element_.clear();
+    if (!next) {
+        return error("Reading JSON was stopped at " + split_key_);
+    }
+    return noError;
+}
+
+error JsonStreamSplitter::Feed(const char *data, const size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        error err = split_depth_ ? element(data[i]) : scan(data[i]);
+        if (err != noError) {
+            return err;
+        }
+    }
+    return noError;
+}
+
+error JsonStreamSplitter::Finish(std::string *result) {
+    poco_check_ptr(result);
+
+    if (in_string_ || !stack_.empty()) {
+        return error("Unexpected end of JSON");
+    }
+    result->swap(document_);
+    document_.clear();
+    return noError;
+}
+
+error JsonStreamSplitter::Read(std::istream &is, std::string *result) {
+    char buffer[16 * 1024];
+    while (is) {
+        is.read(buffer, sizeof(buffer));
+        error err = Feed(buffer, static_cast<size_t>(is.gcount()));
+        if (err != noError) {
+            return err;
+        }
+    }
+    if (is.bad()) {
+        return error("Failed to read JSON stream");
+    }
+    return Finish(result);
+}
+
+}  // namespace toggl
@@ -0,0 +1,75 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_JSON_STREAM_H_
+#define SRC_JSON_STREAM_H_
+
+#include <functional>
+#include <istream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+namespace toggl {
+
+/**
+ * Splits a JSON document into the elements of some of its arrays while
+ * it's being read, so large responses never have to be kept in memory
+ * as a whole. The arrays are picked by their key, either in the root
+ * object or in a "data" object in the root. Every element of them is
+ * passed to the callback as soon as it's complete; the rest of the
+ * document is kept, with the split arrays left empty.
+ */
+class TOGGL_INTERNAL_EXPORT JsonStreamSplitter {
+ public:
+    // Receives the array key and the element JSON, false stops reading
+    typedef std::function<bool(const std::string &key,
+                               const std::string &element)> Callback;
+
+    JsonStreamSplitter(
+        const std::set<std::string> &keys,
+        const Callback &callback);
+
+    // Reads the whole stream, result is the rest of the document
+    error Read(std::istream &is, std::string *result);
+
+    error Feed(const char *data, const size_t size);
+    error Finish(std::string *result);
+
+ private:
+    struct Frame {
+        char type;
+        std::string key;
+    };
+
+    bool splitArray(const std::string &key) const;
+
+    error scan(const char c);
+    error element(const char c);
+    error endElement();
+
+    std::set<std::string> keys_;
+    Callback callback_;
+
+    std::string document_;
+    std::vector<Frame> stack_;
+
+    bool in_string_;
+    bool escaped_;
+
+    // Object member key, tracked outside of the split arrays
+    bool expect_key_;
+    std::string key_;
+    std::string last_key_;
+
+    // Depth of the array being split, 0 when not in one
+    size_t split_depth_;
+    std::string split_key_;
+    std::string element_;
+    bool element_scalar_;
+};
+
+}  // namespace toggl
+
+#endif  // SRC_JSON_STREAM_H_
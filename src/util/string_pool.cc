@@ -0,0 +1,77 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#include "util/string_pool.h"
+
+namespace toggl {
+
+InternedString::InternedString(const std::string &value)
+    : value_(StringPool::Instance().Intern(value)) {}
+
+const std::string &InternedString::emptyString() {
+    static const std::string empty;
+    return empty;
+}
+
+std::ostream &operator<<(std::ostream &out, const InternedString &value) {
+    return out << value.str();
+}
+
+StringPool &StringPool::Instance() {
+    // Never destroyed, strings may be released during static destruction
+    static StringPool *instance = new StringPool();
+    return *instance;
+}
+
+std::shared_ptr<const std::string> StringPool::Intern(
+    const std::string &value) {
+    if (value.empty()) {
+        return nullptr;
+    }
+
+    Poco::Mutex::ScopedLock lock(m_);
+
+    auto it = strings_.find(std::string_view(value));
+    if (it != strings_.end()) {
+        std::shared_ptr<const std::string> pooled = it->second.lock();
+        if (pooled) {
+            return pooled;
+        }
+        // Its last reference is being released right now
+        length_ -= it->first.size();
+        strings_.erase(it);
+    }
+
+    std::shared_ptr<const std::string> pooled(
+        new std::string(value),
+    [this](const std::string *released) {
+        release(released);
+    });
+    strings_.emplace(std::string_view(*pooled), pooled);
+    length_ += value.size();
+    return pooled;
+}
+
+void StringPool::release(const std::string *value) {
+    {
+        Poco::Mutex::ScopedLock lock(m_);
+        auto it = strings_.find(std::string_view(*value));
+        // May have been replaced already by a new copy
+        if (it != strings_.end() && it->first.data() == value->data()) {
+            length_ -= value->size();
+            strings_.erase(it);
+        }
+    }
+    delete value;
+}
+
+size_t StringPool::Size() const {
+    Poco::Mutex::ScopedLock lock(m_);
+    return strings_.size();
+}
+
+size_t StringPool::Length() const {
+    Poco::Mutex::ScopedLock lock(m_);
+    return length_;
+}
+
+}  // namespace toggl
@@ -0,0 +1,94 @@
+// Copyright 2020 Toggl Desktop developers.
+
+#ifndef SRC_STRING_POOL_H_
+#define SRC_STRING_POOL_H_
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "types.h"
+
+#include <Poco/Mutex.h>
+
+namespace toggl {
+
+/**
+ * Read-only string that shares its memory with every equal
+ * InternedString, for values repeated over and over like window
+ * titles and app file names. Equal strings point to the same pooled
+ * copy, so comparing them only compares pointers.
+ */
+class TOGGL_INTERNAL_EXPORT InternedString {
+ public:
+    InternedString() {}
+    explicit InternedString(const std::string &value);
+
+    const std::string &str() const {
+        return value_ ? *value_ : emptyString();
+    }
+    operator const std::string &() const {  // NOLINT
+        return str();
+    }
+
+    bool empty() const {
+        return !value_;
+    }
+
+    // Identifies the pooled copy, the same for all equal strings
+    const void *id() const {
+        return value_.get();
+    }
+
+    bool operator==(const InternedString &other) const {
+        return value_ == other.value_;
+    }
+    bool operator!=(const InternedString &other) const {
+        return value_ != other.value_;
+    }
+    bool operator==(const std::string &other) const {
+        return str() == other;
+    }
+    bool operator!=(const std::string &other) const {
+        return str() != other;
+    }
+
+ private:
+    static const std::string &emptyString();
+
+    std::shared_ptr<const std::string> value_;
+};
+
+std::ostream &operator<<(std::ostream &out, const InternedString &value);
+
+/**
+ * Keeps a single copy of every string that is in use as an
+ * InternedString. A string leaves the pool with its last reference.
+ */
+class TOGGL_INTERNAL_EXPORT StringPool {
+ public:
+    static StringPool &Instance();
+
+    std::shared_ptr<const std::string> Intern(const std::string &value);
+
+    // Number of pooled strings and their total length
+    size_t Size() const;
+    size_t Length() const;
+
+ private:
+    StringPool() {}
+
+    void release(const std::string *value);
+
+    mutable Poco::Mutex m_;
+    // Keys point into the pooled strings themselves
+    std::unordered_map<std::string_view,
+        std::weak_ptr<const std::string> > strings_;
+    size_t length_ { 0 };
+};
+
+}  // namespace toggl
+
+#endif  // SRC_STRING_POOL_H_
@@ -5,8 +5,6 @@
 #include <string>
 #include <sstream>
 
-#include <json/json.h>  // NOLINT
-
 #include <Poco/Exception.h>
 #include <Poco/Logger.h>
 #include <Poco/Net/AcceptCertificateHandler.h>
@@ -160,25 +158,38 @@ void WebSocketClient::authenticate() {
 }
 
 std::string WebSocketClient::parseWebSocketMessageType(
-    const std::string &json) {
+    const std::string &json,
+    Json::Value *root) {
+
+    poco_check_ptr(root);
 
     if (json.empty()) {
         return "";
     }
 
-    Json::Value root;
     Json::Reader reader;
-    if (!reader.parse(json, root)) {
+    if (!reader.parse(json, *root)) {
         return "";
     }
 
-    if (root.isMember("type")) {
-        return root["type"].asString();
+    if (root->isMember("type")) {
+        return (*root)["type"].asString();
     }
 
     return "data";
 }
 
+std::string WebSocketClient::handleMessage(const std::string &json) {
+    // Parsed once, updates are passed on as they are
+    Json::Value root;
+    std::string type = parseWebSocketMessageType(json, &root);
+
+    if ("data" == type) {
+        on_websocket_message_(ctx_, root);
+    }
+    return type;
+}
+
 const int kWebsocketBufSize = 1024 * 10;
 
 error WebSocketClient::receiveWebSocketMessage(std::string *message) {
@@ -205,7 +216,10 @@ const std::string kPong("{\"type\": \"pong\"}");
 
 error WebSocketClient::poll() {
     try {
-        Poco::Timespan span(250 * Poco::Timespan::MILLISECONDS);
+        // Waits for the next frame, returning now and then
+        // only to check for shutdown and the restart interval
+        Poco::Timespan span(
+            kWebSocketPollMillis * Poco::Timespan::MILLISECONDS);
         if (!ws_->poll(span, Poco::Net::Socket::SELECT_READ)) {
             return noError;
         }
@@ -222,21 +236,14 @@ error WebSocketClient::poll() {
 
         last_connection_at_ = time(nullptr);
 
-        std::string type = parseWebSocketMessageType(json);
-
         if (activity_.isStopped()) {
             return noError;
         }
 
-        if ("ping" == type) {
+        if ("ping" == handleMessage(json)) {
             ws_->sendFrame(kPong.data(),
                            static_cast<int>(kPong.size()),
                            Poco::Net::WebSocket::FRAME_BINARY);
-            return noError;
-        }
-
-        if ("data" == type) {
-            on_websocket_message_(ctx_, json);
         }
     } catch(const Poco::Exception& exc) {
         return error(exc.displayText());
@@ -283,7 +290,10 @@ void WebSocketClient::runActivity() {
             }
         }
 
-        Poco::Thread::sleep(1000);
+        // Without a connection there's no socket to wait on
+        if (!ws_) {
+            Poco::Thread::sleep(kWebSocketPollMillis);
+        }
     }
 
     logger().debug("activity finished");
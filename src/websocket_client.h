@@ -10,6 +10,8 @@
 #include <Poco/Activity.h>
 #include <Poco/Net/HTTPClientSession.h>
 
+#include <json/json.h>  // NOLINT
+
 #include "types.h"
 #include "util/logger.h"
 
@@ -24,20 +26,21 @@ class WebSocket;
 
 namespace toggl {
 
+// Receives data messages, parsed
 typedef void (*WebSocketMessageCallback)(
     void *callback,
-    std::string json);
+    const Json::Value &message);
 
 class TOGGL_INTERNAL_EXPORT WebSocketClient {
  public:
     WebSocketClient() :
+    on_websocket_message_(nullptr),
+    ctx_(nullptr),
     activity_(this, &WebSocketClient::runActivity),
     session_(nullptr),
     req_(nullptr),
     res_(nullptr),
     ws_(nullptr),
-    on_websocket_message_(nullptr),
-    ctx_(nullptr),
     last_connection_at_(0),
     api_token_("") {}
     virtual ~WebSocketClient();
@@ -51,6 +54,18 @@ class TOGGL_INTERNAL_EXPORT WebSocketClient {
  protected:
     void runActivity();
 
+    // Parses a received frame once and hands data messages on
+    // to the callback as they are, returns the message type
+    std::string handleMessage(const std::string &json);
+
+    // Virtual so tests can count the parses
+    virtual std::string parseWebSocketMessageType(
+        const std::string &json,
+        Json::Value *root);
+
+    WebSocketMessageCallback on_websocket_message_;
+    void *ctx_;
+
  private:
     error createSession();
 
@@ -58,8 +73,6 @@ class TOGGL_INTERNAL_EXPORT WebSocketClient {
 
     error poll();
 
-    std::string parseWebSocketMessageType(const std::string &json);
-
     error receiveWebSocketMessage(std::string *message);
 
     void deleteSession();
@@ -73,8 +86,6 @@ class TOGGL_INTERNAL_EXPORT WebSocketClient {
     Poco::Net::HTTPRequest *req_;
     Poco::Net::HTTPResponse *res_;
     Poco::Net::WebSocket *ws_;
-    WebSocketMessageCallback on_websocket_message_;
-    void *ctx_;
 
     std::time_t last_connection_at_;
 
@@ -7,7 +7,6 @@
 #include "get_focused_window.h"
 #include "const.h"
 
-#include <Poco/Thread.h>
 
 #if defined(__APPLE__)
 extern bool isCatalinaOSX(void);
@@ -18,13 +17,18 @@ namespace toggl {
 bool WindowChangeRecorder::hasWindowChanged(
     const std::string &title,
     const std::string &filename) const {
-    return ((title != last_title_) || (filename != last_filename_));
+    return ((title != last_title_.str()) || (filename != last_filename_.str()));
 }
 
 bool WindowChangeRecorder::hasIdlenessChanged(const bool &idle) const {
     return last_idle_ != idle;
 }
 
+void WindowChangeRecorder::wakeup() {
+    wakeup_.set();
+    interruptFocusChangeWait();
+}
+
 void WindowChangeRecorder::inspectFocusedWindow() {
     std::string title("");
     std::string filename("");
@@ -98,7 +102,8 @@ void WindowChangeRecorder::inspectFocusedWindow() {
     // Lite version of timeline recorder
     // Since we don't have Screen Recording permission yet => title will be empty
     // So we only track the primary timeline (treat title is filename)
-    if (is_catalina_OSX && last_title_ == title && last_filename_ == filename) {
+    if (is_catalina_OSX && last_title_.str() == title
+            && last_filename_.str() == filename) {
         return;
     }
 
@@ -121,13 +126,17 @@ void WindowChangeRecorder::inspectFocusedWindow() {
         }
     }
 
-    last_title_ = title;
-    last_filename_ = filename;
+    last_title_ = InternedString(title);
+    last_filename_ = InternedString(filename);
     last_idle_ = idle;
     last_event_started_at_ = now;
 }
 
-#define kWindowRecorderSleepMillis 250
+// Without focus change notifications the focused window is polled
+#define kWindowRecorderSleepMillis 500
+
+// With them, the wait is only cut short as a safety net
+#define kWindowRecorderEventWaitMillis 5000
 
 void WindowChangeRecorder::recordLoop() {
     while (!recording_.isStopped()) {
@@ -140,17 +149,9 @@ void WindowChangeRecorder::recordLoop() {
 
         inspectFocusedWindow();
 
-        if (recording_.isStopped()) {
-            break;
+        if (!waitForFocusChange(kWindowRecorderEventWaitMillis)) {
+            wakeup_.tryWait(kWindowRecorderSleepMillis);
         }
-
-        Poco::Thread::sleep(kWindowRecorderSleepMillis);
-
-        if (recording_.isStopped()) {
-            break;
-        }
-
-        Poco::Thread::sleep(kWindowRecorderSleepMillis);
     }
 }
 
@@ -162,6 +163,7 @@ error WindowChangeRecorder::Shutdown() {
         }
         if (recording_.isRunning()) {
             recording_.stop();
+            wakeup();
             recording_.wait(5);
         }
     } catch(const Poco::Exception& exc) {
@@ -9,8 +9,10 @@
 #include "timeline_notifications.h"
 #include "types.h"
 #include "util/logger.h"
+#include "util/string_pool.h"
 
 #include <Poco/Activity.h>
+#include <Poco/Event.h>
 
 #if defined(__APPLE__)
 extern bool isCatalinaOSX(void);
@@ -21,9 +23,7 @@ namespace toggl {
 class TOGGL_INTERNAL_EXPORT WindowChangeRecorder {
  public:
     explicit WindowChangeRecorder(TimelineDatasource *datasource)
-        : last_title_("")
-    , last_filename_("")
-    , last_event_started_at_(0)
+        : last_event_started_at_(0)
     , last_idle_(false)
     , timeline_datasource_(datasource)
     , recording_(this, &WindowChangeRecorder::recordLoop)
@@ -46,13 +46,19 @@ class TOGGL_INTERNAL_EXPORT WindowChangeRecorder {
     }
 
     void SetIsLocked(bool isLocked) {
-        Poco::Mutex::ScopedLock lock(isLocked_m_);
-        isLocked_ = isLocked;
+        {
+            Poco::Mutex::ScopedLock lock(isLocked_m_);
+            isLocked_ = isLocked;
+        }
+        wakeup();
     }
 
     void SetIsSleeping(bool isSleeping) {
-        Poco::Mutex::ScopedLock lock(isSleeping_m_);
-        isSleeping_ = isSleeping;
+        {
+            Poco::Mutex::ScopedLock lock(isSleeping_m_);
+            isSleeping_ = isSleeping;
+        }
+        wakeup();
     }
 
     error Shutdown();
@@ -70,6 +76,9 @@ class TOGGL_INTERNAL_EXPORT WindowChangeRecorder {
 
     bool hasIdlenessChanged(const bool &idle) const;
 
+    // Inspects the focused window again right away
+    void wakeup();
+
     Logger logger { "WindowChangeRecorder" };
 
     bool getIsLocked() {
@@ -82,14 +91,18 @@ class TOGGL_INTERNAL_EXPORT WindowChangeRecorder {
         return isSleeping_;
     }
 
-    // Last window focus event data
-    std::string last_title_;
-    std::string last_filename_;
+    // Last window focus event data, interned
+    // so the recorded events share them
+    InternedString last_title_;
+    InternedString last_filename_;
     time_t last_event_started_at_;
     bool last_idle_;
 
     TimelineDatasource *timeline_datasource_;
 
+    // Cuts the wait for the next inspection short
+    Poco::Event wakeup_;
+
     Poco::Activity<WindowChangeRecorder> recording_;
 
     std::string last_autotracker_title_;